@@ -1,11 +1,10 @@
 
 #version 450
 
-layout(location = 0) in vec2 texCoord;
-
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 0) uniform sampler2D frame;
+// HDR color written by the previous subpass, read at this pixel
+layout(input_attachment_index = 0, binding = 0) uniform subpassInput frame;
 
 layout(push_constant) uniform Push {
     float exposure;
@@ -25,7 +24,7 @@ vec3 aces_approx(vec3 v)
 }
 
 void main() {
-    vec3 color = texture(frame, texCoord).rgb;
+    vec3 color = subpassLoad(frame).rgb;
     if (push.peak_brightness < 10.0) {
         float lum = 0.2126f * color.r + 0.7152 * color.g + 0.0722 * color.b;
         vec3 mappedLum = aces_approx(push.exposure * vec3(lum));
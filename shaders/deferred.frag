@@ -0,0 +1,228 @@
+#version 450
+
+// Lighting subpass of the deferred path, the same clustered lights and IBL as shader.frag evaluated once per pixel
+
+#define PI 3.1415926535897932384626433832795
+
+layout(location = 0) in vec2 screenUv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionViewMatrix;
+    vec4 ambientLightColor;
+    mat4 viewMatrix;
+    mat4 invViewMatrix;
+    vec4 clusterScale;
+    uvec4 clusterGrid;
+    mat4 invProjectionMatrix;
+    vec4 sunDirection;
+    vec4 sunColor;
+    vec4 cascadeSplits;
+    mat4 cascadeMatrices[4];
+} ubo;
+
+// Clustered lights, see LightClusters
+struct Light {
+    vec4 positionRange;
+    vec4 colorIntensity;
+    vec4 directionType;     // Spot direction, 0 point or 1 spot
+    vec4 cone;              // Spot cosines, inner and outer
+};
+
+layout(std430, set = 0, binding = 10) readonly buffer LightBuffer {
+    Light lights[];
+};
+
+// Offset and count into the index list for every cluster
+layout(std430, set = 0, binding = 11) readonly buffer ClusterBuffer {
+    uvec2 clusters[];
+};
+
+layout(std430, set = 0, binding = 12) readonly buffer LightIndexBuffer {
+    uint lightIndices[];
+};
+
+layout(set = 0, binding = 1) uniform samplerCube irradianceMap;
+layout(set = 0, binding = 2) uniform samplerCube prefilteredMap;
+layout(set = 0, binding = 3) uniform sampler2D brdfLUT;
+layout(set = 0, binding = 13) uniform sampler2DArrayShadow shadowMap;
+
+// G-buffer, written by gbuffer.frag in the previous subpass
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput albedoInput;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput normalInput;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput materialInput;
+layout(input_attachment_index = 3, set = 1, binding = 3) uniform subpassInput depthInput;
+
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 prefilteredReflection(vec3 R, float roughness)
+{
+	const float MAX_REFLECTION_LOD = 9.0;
+	float lod = roughness * MAX_REFLECTION_LOD;
+	float lodf = floor(lod);
+	float lodc = ceil(lod);
+	vec3 a = textureLod(prefilteredMap, R, lodf).rgb;
+	vec3 b = textureLod(prefilteredMap, R, lodc).rgb;
+	return mix(a, b, lod - lodf);
+}
+
+// Normal Distribution function --------------------------------------
+float D_GGX(float dotNH, float roughness)
+{
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+	float denom = dotNH * dotNH * (alpha2 - 1.0) + 1.0;
+	return (alpha2)/(PI * denom*denom);
+}
+
+// Geometric Shadowing function --------------------------------------
+float G_SchlicksmithGGX(float dotNL, float dotNV, float roughness)
+{
+	float r = (roughness + 1.0);
+	float k = (r*r) / 8.0;
+	float GL = dotNL / (dotNL * (1.0 - k) + k);
+	float GV = dotNV / (dotNV * (1.0 - k) + k);
+	return GL * GV;
+}
+
+// Fresnel function ----------------------------------------------------
+vec3 F_Schlick(float cosTheta, vec3 F0)
+{
+    return mix(F0, vec3(1.0), pow(1.01 - cosTheta, 5.0));
+}
+
+// Inverse square falloff windowed to reach zero at the light range
+float distanceAttenuation(float dist, float range)
+{
+	float ratio = dist / range;
+	float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+	return window * window / max(dist * dist, 0.0001);
+}
+
+// Fresnel Roughness function ----------------------------------------------------
+vec3 F_SchlickR(float cosTheta, vec3 F0, float roughness)
+{
+	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// Sun visibility from the cascade covering viewDepth, 3x3 taps of hardware compared bilinear lookups
+float cascadeShadow(vec3 worldPos, float viewDepth)
+{
+	if (ubo.sunDirection.w < 0.5 || viewDepth > ubo.cascadeSplits[3]) {
+		return 1.0;
+	}
+	int cascade = 0;
+	for (int i = 0; i < 3; i++) {
+		if (viewDepth > ubo.cascadeSplits[i]) {
+			cascade = i + 1;
+		}
+	}
+	vec4 shadowCoord = ubo.cascadeMatrices[cascade] * vec4(worldPos, 1.0);
+	vec2 uv = shadowCoord.xy * 0.5 + 0.5;
+	vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0;
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			lit += texture(shadowMap, vec4(uv + vec2(x, y) * texel, float(cascade), shadowCoord.z));
+		}
+	}
+	return lit / 9.0;
+}
+
+// Cook-Torrance specular plus Lambert diffuse for one light direction
+vec3 surfaceRadiance(vec3 N, vec3 viewDir, vec3 lightDir, float dotNV, vec3 radiance, vec3 albedo, vec3 F0, float metalness, float roughness)
+{
+	vec3 halfDir = normalize(lightDir + viewDir);
+	float dotNH = max(0.001, dot(N, halfDir));
+	float dotNL = max(0.001, dot(N, lightDir));
+	float dotHV = max(0.001, dot(halfDir, viewDir));
+	float D = D_GGX(dotNH, roughness);
+	float G = G_SchlicksmithGGX(dotNL, dotNV, roughness);
+	vec3 F = F_Schlick(dotHV, F0);
+	vec3 spec = D * F * G / max(4.0 * dotNL * dotNV, 0.001);
+	vec3 kD = (vec3(1.0) - F) * (1.0 - metalness);
+	return (kD * albedo / PI + spec) * dotNL * radiance;
+}
+
+void main() {
+    // Background, the skybox is drawn over it later in this subpass
+    float depth = subpassLoad(depthInput).r;
+    if (depth >= 1.0) {
+        discard;
+    }
+    
+    vec3 albedo = subpassLoad(albedoInput).rgb;
+    vec3 N = octahedralDecode(subpassLoad(normalInput).xy);
+    vec4 material = subpassLoad(materialInput);
+    float occlusion = material.r;
+    float roughness = material.g;
+    float metalness = material.b;
+    
+    // Position back from depth, framebuffer y grows with NDC y
+    vec4 viewPosition = ubo.invProjectionMatrix * vec4(screenUv * 2.0 - 1.0, depth, 1.0);
+    viewPosition /= viewPosition.w;
+    vec3 worldPos = (ubo.invViewMatrix * viewPosition).xyz;
+    
+    vec3 viewPos = ubo.invViewMatrix[3].xyz;
+    vec3 viewDir = normalize(viewPos - worldPos);
+    vec3 R = reflect(-viewDir, N);
+    
+    float dotNV = max(0.001, dot(N, viewDir));
+
+//Physically Based Rendering (Metalness-Roughness Workflow)
+    vec3 F0 = vec3(0.04);
+    F0 = mix(F0, albedo, metalness);
+    
+    // Specular Light contribution
+    vec3 Lo = vec3(0.0);
+    
+    // Only the lights binned into this pixel's cluster
+    uvec3 cell = uvec3(
+        min(uvec2(gl_FragCoord.xy * ubo.clusterScale.xy), ubo.clusterGrid.xy - 1u),
+        uint(clamp(floor(log(max(viewPosition.z, 0.0001)) * ubo.clusterScale.z + ubo.clusterScale.w), 0.0, float(ubo.clusterGrid.z - 1u))));
+    uvec2 cluster = clusters[cell.x + ubo.clusterGrid.x * (cell.y + ubo.clusterGrid.y * cell.z)];
+    
+    for (uint i = 0u; i < cluster.y; i++) {
+        Light light = lights[lightIndices[cluster.x + i]];
+        
+        vec3 toLight = light.positionRange.xyz - worldPos;
+        float lightDist = length(toLight);
+        vec3 lightDir = toLight / max(lightDist, 0.0001);
+        float attenuation = light.colorIntensity.w * distanceAttenuation(lightDist, light.positionRange.w);
+        if (light.directionType.w > 0.5) {
+            attenuation *= smoothstep(light.cone.y, light.cone.x, dot(-lightDir, light.directionType.xyz));
+        }
+        vec3 radiance = light.colorIntensity.rgb * attenuation;
+        Lo += surfaceRadiance(N, viewDir, lightDir, dotNV, radiance, albedo, F0, metalness, roughness);
+    }
+    
+    // Directional sun, shadowed by the cascades
+    Lo += surfaceRadiance(N, viewDir, -ubo.sunDirection.xyz, dotNV, ubo.sunColor.rgb * cascadeShadow(worldPos, viewPosition.z), albedo, F0, metalness, roughness);
+    
+// IBL Part
+    vec3 reflection = prefilteredReflection(R, roughness);
+    vec3 irradiance = texture(irradianceMap, N).rgb;
+    vec2 brdf  = texture(brdfLUT, vec2(dotNV, roughness)).rg;
+    
+    vec3 F = F_SchlickR(dotNV, F0, roughness);
+    
+    vec3 diffuse = irradiance * albedo;
+    vec3 specular = reflection * (F * brdf.x + brdf.y);
+    
+    vec3 kD = 1.0 - F;
+    kD *= 1.0 - metalness;
+    vec3 ambient = kD * diffuse + specular;
+    ambient = mix(ambient, ambient * occlusion, 0.7);
+    
+// Ambient + Light
+    vec3 pbr = 0.5 * ambient + Lo;
+    
+    outColor = vec4(pbr, 1.0);
+}
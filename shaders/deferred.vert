@@ -0,0 +1,11 @@
+#version 450
+
+// Full screen triangle, no vertex input
+
+layout(location = 0) out vec2 screenUv;
+
+void main() {
+    screenUv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    
+    gl_Position = vec4(screenUv * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,6 @@
+#version 450
+
+// Depth only passes, the depth prepass masks out its color attachment and shadow passes have none
+
+void main() {
+}
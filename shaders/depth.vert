@@ -0,0 +1,54 @@
+#version 450
+
+// Depth prepass, gl_Position must match shader.vert bit for bit or the EQUAL test of the forward pass drops pixels
+
+// Model::PackedVertex input: unorm position in mesh bounds, float models bind the position stream
+layout(constant_id = 0) const bool PACKED_VERTEX = false;
+
+layout(location = 0) in vec4 position;
+
+layout(binding = 0) uniform GlobalUbo {
+    mat4 projectionViewMatrix;
+    vec4 ambientLightColor;
+    mat4 viewMatrix;
+    mat4 invViewMatrix;
+    vec4 clusterScale;
+    uvec4 clusterGrid;
+    mat4 invProjectionMatrix;
+    vec4 sunDirection;
+    vec4 sunColor;
+    vec4 cascadeSplits;
+    mat4 cascadeMatrices[4];
+} ubo;
+
+struct InstanceData {
+    mat4 modelMatrix;
+    vec4 color;
+    int textureIndex;
+    float metalness;
+    float roughness;
+};
+
+layout(std430, binding = 9) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+layout(push_constant) uniform Push {
+    vec4 boundsMin;
+    vec4 boundsExtent;
+} push;
+
+invariant gl_Position;
+
+void main() {
+    InstanceData instance = instances[gl_InstanceIndex];
+    
+    vec3 vertexPosition = position.xyz;
+    if (PACKED_VERTEX) {
+        vertexPosition = push.boundsMin.xyz + position.xyz * push.boundsExtent.xyz;
+    }
+    
+    vec4 positionWorld = instance.modelMatrix * vec4(vertexPosition, 1.0);
+    
+    gl_Position = ubo.projectionViewMatrix * ubo.viewMatrix * positionWorld;
+}
@@ -0,0 +1,117 @@
+#version 450
+
+// Edge adaptive spatial upsampling in the style of FSR1 EASU
+// Every output pixel is a 12 tap windowed lanczos of the input around it, stretched along the local edge
+// and shortened across it, then clamped to the 2x2 nearest input texels so it can't ring
+
+layout(location = 0) out vec4 outColor;
+
+// Tone mapped frame, rendered into the top left part of the image
+layout(binding = 0) uniform sampler2D frame;
+
+layout(push_constant) uniform Push {
+    vec4 scaleOffset;   // Output pixel to input pixel position
+    ivec2 inputMax;     // Last rendered texel
+} push;
+
+// Only relative luma matters, this skips the weights' multiplies
+float luma(vec3 color) {
+    return color.b * 0.5 + (color.r * 0.5 + color.g);
+}
+
+vec3 fetch(ivec2 texel) {
+    return texelFetch(frame, clamp(texel, ivec2(0), push.inputMax), 0).rgb;
+}
+
+// Accumulates the edge direction and length of one of the 2x2 nearest texels, weighted by its bilinear weight
+//    a
+//  b c d
+//    e
+void accumulateEdge(inout vec2 direction, inout float edgeLength, float weight, float lA, float lB, float lC, float lD, float lE) {
+    float dc = lD - lC;
+    float cb = lC - lB;
+    float lengthX = max(abs(dc), abs(cb));
+    float directionX = lD - lB;
+    lengthX = clamp(abs(directionX) / max(lengthX, 1e-5), 0.0, 1.0);
+    direction.x += directionX * weight;
+    edgeLength += lengthX * lengthX * weight;
+
+    float ec = lE - lC;
+    float ca = lC - lA;
+    float lengthY = max(abs(ec), abs(ca));
+    float directionY = lE - lA;
+    lengthY = clamp(abs(directionY) / max(lengthY, 1e-5), 0.0, 1.0);
+    direction.y += directionY * weight;
+    edgeLength += lengthY * lengthY * weight;
+}
+
+// Approximated lanczos2 weight of a tap at offset from the sample position, in the edge aligned space
+void accumulateTap(inout vec3 color, inout float totalWeight, vec2 offset, vec2 direction, vec2 stretch, float lobe, float clip, vec3 tap) {
+    vec2 v = vec2(offset.x * direction.x + offset.y * direction.y, offset.x * -direction.y + offset.y * direction.x) * stretch;
+    float d2 = min(dot(v, v), clip);
+    // (25/16 * (2/5 * x^2 - 1)^2 - (25/16 - 1)) * (lobe * x^2 - 1)^2
+    float base = 2.0 / 5.0 * d2 - 1.0;
+    float window = lobe * d2 - 1.0;
+    float weight = (25.0 / 16.0 * base * base - (25.0 / 16.0 - 1.0)) * window * window;
+    color += tap * weight;
+    totalWeight += weight;
+}
+
+void main() {
+    vec2 position = (gl_FragCoord.xy - 0.5) * push.scaleOffset.xy + push.scaleOffset.zw;
+    vec2 origin = floor(position);
+    vec2 pp = position - origin;
+    ivec2 f0 = ivec2(origin);
+
+    //    b c
+    //  e f g h
+    //  i j k l
+    //    n o
+    vec3 b = fetch(f0 + ivec2(0, -1)), c = fetch(f0 + ivec2(1, -1));
+    vec3 e = fetch(f0 + ivec2(-1, 0)), f = fetch(f0), g = fetch(f0 + ivec2(1, 0)), h = fetch(f0 + ivec2(2, 0));
+    vec3 i = fetch(f0 + ivec2(-1, 1)), j = fetch(f0 + ivec2(0, 1)), k = fetch(f0 + ivec2(1, 1)), l = fetch(f0 + ivec2(2, 1));
+    vec3 n = fetch(f0 + ivec2(0, 2)), o = fetch(f0 + ivec2(1, 2));
+
+    float bL = luma(b), cL = luma(c), eL = luma(e), fL = luma(f), gL = luma(g), hL = luma(h);
+    float iL = luma(i), jL = luma(j), kL = luma(k), lL = luma(l), nL = luma(n), oL = luma(o);
+
+    vec2 direction = vec2(0.0);
+    float edgeLength = 0.0;
+    accumulateEdge(direction, edgeLength, (1.0 - pp.x) * (1.0 - pp.y), bL, eL, fL, gL, jL);
+    accumulateEdge(direction, edgeLength, pp.x * (1.0 - pp.y), cL, fL, gL, hL, kL);
+    accumulateEdge(direction, edgeLength, (1.0 - pp.x) * pp.y, fL, iL, jL, kL, nL);
+    accumulateEdge(direction, edgeLength, pp.x * pp.y, gL, jL, kL, lL, oL);
+
+    // Flat areas have no direction, any axis works
+    float directionLength2 = dot(direction, direction);
+    bool flatArea = directionLength2 < 1.0 / 32768.0;
+    direction = flatArea ? vec2(1.0, 0.0) : direction * inversesqrt(directionLength2);
+
+    // Edges stretch the kernel along them, up to sqrt(2) on diagonals, and sharpen it across
+    edgeLength = edgeLength * 0.5;
+    edgeLength *= edgeLength;
+    float axisStretch = dot(direction, direction) / max(abs(direction.x), abs(direction.y));
+    vec2 stretch = vec2(1.0 + (axisStretch - 1.0) * edgeLength, 1.0 - 0.5 * edgeLength);
+    float lobe = 0.5 + ((1.0 / 4.0 - 0.04) - 0.5) * edgeLength;
+    float clip = 1.0 / lobe;
+
+    vec3 color = vec3(0.0);
+    float totalWeight = 0.0;
+    accumulateTap(color, totalWeight, vec2(0.0, -1.0) - pp, direction, stretch, lobe, clip, b);
+    accumulateTap(color, totalWeight, vec2(1.0, -1.0) - pp, direction, stretch, lobe, clip, c);
+    accumulateTap(color, totalWeight, vec2(-1.0, 1.0) - pp, direction, stretch, lobe, clip, i);
+    accumulateTap(color, totalWeight, vec2(0.0, 1.0) - pp, direction, stretch, lobe, clip, j);
+    accumulateTap(color, totalWeight, vec2(0.0, 0.0) - pp, direction, stretch, lobe, clip, f);
+    accumulateTap(color, totalWeight, vec2(-1.0, 0.0) - pp, direction, stretch, lobe, clip, e);
+    accumulateTap(color, totalWeight, vec2(1.0, 1.0) - pp, direction, stretch, lobe, clip, k);
+    accumulateTap(color, totalWeight, vec2(2.0, 1.0) - pp, direction, stretch, lobe, clip, l);
+    accumulateTap(color, totalWeight, vec2(2.0, 0.0) - pp, direction, stretch, lobe, clip, h);
+    accumulateTap(color, totalWeight, vec2(1.0, 0.0) - pp, direction, stretch, lobe, clip, g);
+    accumulateTap(color, totalWeight, vec2(1.0, 2.0) - pp, direction, stretch, lobe, clip, o);
+    accumulateTap(color, totalWeight, vec2(0.0, 2.0) - pp, direction, stretch, lobe, clip, n);
+
+    // Deringing
+    vec3 nearestMin = min(min(f, g), min(j, k));
+    vec3 nearestMax = max(max(f, g), max(j, k));
+    outColor = vec4(clamp(color / totalWeight, nearestMin, nearestMax), 1.0);
+}
@@ -0,0 +1,52 @@
+#version 450
+
+// G-buffer subpass of the deferred path, same material stack as shader.frag without any lighting
+
+layout(location = 0) in VertexShader {
+    vec3 color;
+    vec3 worldPos;
+    vec3 tangentPos;
+    vec3 tangentViewPos;
+    vec2 texcoord;
+    mat3 TBN;
+    flat vec3 materialColor;
+    flat int textureIndex;
+    flat float metalness;
+    flat float roughness;
+} vert;
+
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec2 outNormal;      // World space, octahedral
+layout(location = 2) out vec4 outMaterial;    // Occlusion, roughness, metalness
+
+layout(binding = 4) uniform sampler2D diffuseMap;
+layout(binding = 5) uniform sampler2D normalMap;
+layout(binding = 6) uniform sampler2D metallicMap;
+layout(binding = 7) uniform sampler2D roughnessMap;
+layout(binding = 8) uniform sampler2D occlusionMap;
+
+vec2 octahedralEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0) {
+        e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return e;
+}
+
+void main() {
+    float texScale = 1.0;
+    vec2 uv = (vert.textureIndex < 24) ? vec2(vert.texcoord.x, -vert.texcoord.y) * texScale : vert.texcoord * texScale;
+    // PBR Material Stack
+    vec3 albedo = (vert.textureIndex < 0) ? vert.materialColor : texture(diffuseMap, uv).rgb;
+    vec3 normal = (vert.textureIndex < 0) ? vec3(0.0, 0.0, 1.0) : normalize(texture(normalMap, uv).rgb * 2.0 - 1.0);
+    float metalness = (vert.textureIndex < 0) ? vert.metalness : vert.metalness * texture(metallicMap, uv).r;
+    float roughness = (vert.textureIndex < 0) ? vert.roughness : vert.roughness  * (1.0 - texture(roughnessMap, uv).r);
+    float occlusion = (vert.textureIndex < 0) ? 1.0 : texture(occlusionMap, uv).r;
+    
+    vec3 N = normalize(transpose(vert.TBN) * normal);
+    
+    outAlbedo = vec4(albedo, 1.0);
+    outNormal = octahedralEncode(N);
+    outMaterial = vec4(occlusion, roughness, metalness, 0.0);
+}
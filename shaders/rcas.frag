@@ -0,0 +1,42 @@
+#version 450
+
+// Robust contrast adaptive sharpening in the style of FSR1 RCAS, run on the upscaled frame
+// A negative lobe on the 4 neighbours, as strong as it can be without pushing the pixel out of the neighbourhood range
+
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2D frame;
+
+layout(push_constant) uniform Push {
+    float sharpness;    // 1 is the strongest, every halving is one stop softer
+} push;
+
+// Past this the sharpening gets unstable
+const float LOBE_LIMIT = 0.25 - 1.0 / 16.0;
+
+vec3 fetch(ivec2 texel) {
+    return texelFetch(frame, clamp(texel, ivec2(0), textureSize(frame, 0) - 1), 0).rgb;
+}
+
+void main() {
+    //   b
+    // d e f
+    //   h
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec3 b = fetch(texel + ivec2(0, -1));
+    vec3 d = fetch(texel + ivec2(-1, 0));
+    vec3 e = fetch(texel);
+    vec3 f = fetch(texel + ivec2(1, 0));
+    vec3 h = fetch(texel + ivec2(0, 1));
+
+    vec3 neighbourMin = min(min(b, d), min(f, h));
+    vec3 neighbourMax = max(max(b, d), max(f, h));
+
+    // Lobe weights that would bring the result to 0 and to 1
+    vec3 hitMin = min(neighbourMin, e) / max(4.0 * neighbourMax, 1e-4);
+    vec3 hitMax = (1.0 - max(neighbourMax, e)) / min(4.0 * neighbourMin - 4.0, -1e-4);
+    vec3 lobeRGB = max(-hitMin, hitMax);
+    float lobe = max(-LOBE_LIMIT, min(max(lobeRGB.r, max(lobeRGB.g, lobeRGB.b)), 0.0)) * push.sharpness;
+
+    outColor = vec4((lobe * (b + d + f + h) + e) / (4.0 * lobe + 1.0), 1.0);
+}
@@ -12,6 +12,10 @@ layout(location = 0) in VertexShader {
     vec3 tangentViewPos;
     vec2 texcoord;
     mat3 TBN;
+    flat vec3 materialColor;
+    flat int textureIndex;
+    flat float metalness;
+    flat float roughness;
 } vert;
 
 layout(location = 0) out vec4 outColor;
@@ -19,12 +23,38 @@ layout(location = 0) out vec4 outColor;
 layout(binding = 0) uniform GlobalUbo {
     mat4 projectionViewMatrix;
     vec4 ambientLightColor;
-    vec4 lightPosition[2];
-    vec4 lightColor;
     mat4 viewMatrix;
     mat4 invViewMatrix;
+    vec4 clusterScale;
+    uvec4 clusterGrid;
+    mat4 invProjectionMatrix;
+    vec4 sunDirection;
+    vec4 sunColor;
+    vec4 cascadeSplits;
+    mat4 cascadeMatrices[4];
 } ubo;
 
+// Clustered lights, see LightClusters
+struct Light {
+    vec4 positionRange;
+    vec4 colorIntensity;
+    vec4 directionType;     // Spot direction, 0 point or 1 spot
+    vec4 cone;              // Spot cosines, inner and outer
+};
+
+layout(std430, binding = 10) readonly buffer LightBuffer {
+    Light lights[];
+};
+
+// Offset and count into the index list for every cluster
+layout(std430, binding = 11) readonly buffer ClusterBuffer {
+    uvec2 clusters[];
+};
+
+layout(std430, binding = 12) readonly buffer LightIndexBuffer {
+    uint lightIndices[];
+};
+
 layout(binding = 1) uniform samplerCube irradianceMap;
 layout(binding = 2) uniform samplerCube prefilteredMap;
 layout(binding = 3) uniform sampler2D brdfLUT;
@@ -33,14 +63,8 @@ layout(binding = 5) uniform sampler2D normalMap;
 layout(binding = 6) uniform sampler2D metallicMap;
 layout(binding = 7) uniform sampler2D roughnessMap;
 layout(binding = 8) uniform sampler2D occlusionMap;
-
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    int textureIndex;
-    float metalness;
-    float roughness;
-    vec3 color;
-} push;
+// Sampled cascades of ShadowCascades, one layer each
+layout(binding = 13) uniform sampler2DArrayShadow shadowMap;
 
 vec3 prefilteredReflection(vec3 R, float roughness)
 {
@@ -79,21 +103,71 @@ vec3 F_Schlick(float cosTheta, vec3 F0)
     return mix(F0, vec3(1.0), pow(1.01 - cosTheta, 5.0));
 }
 
+// Inverse square falloff windowed to reach zero at the light range
+float distanceAttenuation(float dist, float range)
+{
+	float ratio = dist / range;
+	float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+	return window * window / max(dist * dist, 0.0001);
+}
+
 // Fresnel Roughness function ----------------------------------------------------
 vec3 F_SchlickR(float cosTheta, vec3 F0, float roughness)
 {
 	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
+// Sun visibility from the cascade covering viewDepth, 3x3 taps of hardware compared bilinear lookups
+float cascadeShadow(vec3 worldPos, float viewDepth)
+{
+	if (ubo.sunDirection.w < 0.5 || viewDepth > ubo.cascadeSplits[3]) {
+		return 1.0;
+	}
+	int cascade = 0;
+	for (int i = 0; i < 3; i++) {
+		if (viewDepth > ubo.cascadeSplits[i]) {
+			cascade = i + 1;
+		}
+	}
+	vec4 shadowCoord = ubo.cascadeMatrices[cascade] * vec4(worldPos, 1.0);
+	vec2 uv = shadowCoord.xy * 0.5 + 0.5;
+	vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0;
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			lit += texture(shadowMap, vec4(uv + vec2(x, y) * texel, float(cascade), shadowCoord.z));
+		}
+	}
+	return lit / 9.0;
+}
+
+// Cook-Torrance specular plus Lambert diffuse for one light direction
+vec3 surfaceRadiance(vec3 N, vec3 viewDir, vec3 lightDir, float dotNV, vec3 radiance, vec3 albedo, vec3 F0, float metalness, float roughness)
+{
+	vec3 halfDir = normalize(lightDir + viewDir);
+	float dotNH = max(0.001, dot(N, halfDir));
+	float dotNL = max(0.001, dot(N, lightDir));
+	float dotHV = max(0.001, dot(halfDir, viewDir));
+	// D = Normal distribution (Distribution of the microfacets)
+	float D = D_GGX(dotNH, roughness);
+	// G = Geometric shadowing term (Microfacets shadowing)
+	float G = G_SchlicksmithGGX(dotNL, dotNV, roughness);
+	// F = Fresnel factor (Reflectance depending on angle of incidence)
+	vec3 F = F_Schlick(dotHV, F0);
+	vec3 spec = D * F * G / max(4.0 * dotNL * dotNV, 0.001);
+	vec3 kD = (vec3(1.0) - F) * (1.0 - metalness);
+	return (kD * albedo / PI + spec) * dotNL * radiance;
+}
+
 void main() {
     float texScale = 1.0;
-    vec2 uv = (push.textureIndex < 24) ? vec2(vert.texcoord.x, -vert.texcoord.y) * texScale : vert.texcoord * texScale;
+    vec2 uv = (vert.textureIndex < 24) ? vec2(vert.texcoord.x, -vert.texcoord.y) * texScale : vert.texcoord * texScale;
     // PBR Material Stack
-    vec3 albedo = (push.textureIndex < 0) ? push.color : texture(diffuseMap, uv).rgb;
-    vec3 normal = (push.textureIndex < 0) ? vec3(0.0, 0.0, 1.0) : normalize(texture(normalMap, uv).rgb * 2.0 - 1.0);
-    float metalness = (push.textureIndex < 0) ? push.metalness : push.metalness * texture(metallicMap, uv).r;
-    float roughness = (push.textureIndex < 0) ? push.roughness : push.roughness  * (1.0 - texture(roughnessMap, uv).r);
-    float occlusion = (push.textureIndex < 0) ? 1.0 : texture(occlusionMap, uv).r;
+    vec3 albedo = (vert.textureIndex < 0) ? vert.materialColor : texture(diffuseMap, uv).rgb;
+    vec3 normal = (vert.textureIndex < 0) ? vec3(0.0, 0.0, 1.0) : normalize(texture(normalMap, uv).rgb * 2.0 - 1.0);
+    float metalness = (vert.textureIndex < 0) ? vert.metalness : vert.metalness * texture(metallicMap, uv).r;
+    float roughness = (vert.textureIndex < 0) ? vert.roughness : vert.roughness  * (1.0 - texture(roughnessMap, uv).r);
+    float occlusion = (vert.textureIndex < 0) ? 1.0 : texture(occlusionMap, uv).r;
     
     mat3 invTBN = transpose(vert.TBN);
     vec3 N = invTBN * normal;
@@ -113,31 +187,31 @@ void main() {
     // Specular Light contribution
     vec3 Lo = vec3(0.0);
     
-    for (int i = 0; i < 2; i++) {
-        // Lighting coordinates in tangent space
-        vec3 tangentLightPos = vert.TBN * ubo.lightPosition[i].xyz;
-        vec3 tangentLightDir = normalize(tangentLightPos - vert.tangentPos);
-        vec3 halfDir = normalize(tangentLightDir + tangentViewDir);
-        float lightDist = length(tangentLightPos - vert.tangentPos);
-        float attenuation = ubo.lightColor.w / (lightDist * lightDist);
-        vec3 radiance = ubo.lightColor.xyz * attenuation;
+    // Only the lights binned into this fragment's cluster
+    float viewDepth = (ubo.viewMatrix * vec4(vert.worldPos, 1.0)).z;
+    uvec3 cell = uvec3(
+        min(uvec2(gl_FragCoord.xy * ubo.clusterScale.xy), ubo.clusterGrid.xy - 1u),
+        uint(clamp(floor(log(max(viewDepth, 0.0001)) * ubo.clusterScale.z + ubo.clusterScale.w), 0.0, float(ubo.clusterGrid.z - 1u))));
+    uvec2 cluster = clusters[cell.x + ubo.clusterGrid.x * (cell.y + ubo.clusterGrid.y * cell.z)];
+    
+    for (uint i = 0u; i < cluster.y; i++) {
+        Light light = lights[lightIndices[cluster.x + i]];
         
-        float dotNH = max(0.001, dot(normal, halfDir));
-        float dotNL = max(0.001, dot(normal, tangentLightDir));
-        float dotHV = max(0.001, dot(halfDir, tangentViewDir));
-        if (dotNL > 0.0) {
-            // D = Normal distribution (Distribution of the microfacets)
-            float D = D_GGX(dotNH, roughness);
-            // G = Geometric shadowing term (Microfacets shadowing)
-            float G = G_SchlicksmithGGX(dotNL, dotNV, roughness);
-            // F = Fresnel factor (Reflectance depending on angle of incidence)
-            vec3 F = F_Schlick(dotHV, F0);
-            vec3 spec = D * F * G / max(4.0 * dotNL * dotNV, 0.001);
-            vec3 kD = (vec3(1.0) - F) * (1.0 - metalness);
-            Lo += (kD * albedo / PI + spec) * dotNL * radiance;
+        // Lighting in world space
+        vec3 toLight = light.positionRange.xyz - vert.worldPos;
+        float lightDist = length(toLight);
+        vec3 lightDir = toLight / max(lightDist, 0.0001);
+        float attenuation = light.colorIntensity.w * distanceAttenuation(lightDist, light.positionRange.w);
+        if (light.directionType.w > 0.5) {
+            attenuation *= smoothstep(light.cone.y, light.cone.x, dot(-lightDir, light.directionType.xyz));
         }
+        vec3 radiance = light.colorIntensity.rgb * attenuation;
+        Lo += surfaceRadiance(N, viewDir, lightDir, dotNV, radiance, albedo, F0, metalness, roughness);
     }
     
+    // Directional sun, shadowed by the cascades
+    Lo += surfaceRadiance(N, viewDir, -ubo.sunDirection.xyz, dotNV, ubo.sunColor.rgb * cascadeShadow(vert.worldPos, viewDepth), albedo, F0, metalness, roughness);
+    
 // IBL Part (Non-Tangent Space)
     vec3 reflection = prefilteredReflection(R, roughness);
     vec3 irradiance = texture(irradianceMap, N).rgb;
@@ -1,9 +1,11 @@
 
 #version 450
 
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
-layout(location = 2) in vec3 normal;
+// Model::PackedVertex input: unorm position in mesh bounds (w = tangent sign), octahedral normal and tangent
+layout(constant_id = 0) const bool PACKED_VERTEX = false;
+
+layout(location = 0) in vec4 position;
+layout(location = 2) in vec4 normal;
 layout(location = 3) in vec4 tangent;
 layout(location = 4) in vec2 uv;
 
@@ -14,31 +16,71 @@ layout(location = 0) out VertexShader {
     vec3 tangentViewPos;
     vec2 texcoord;
     mat3 TBN;
+    flat vec3 materialColor;
+    flat int textureIndex;
+    flat float metalness;
+    flat float roughness;
 } frag;
 
 layout(binding = 0) uniform GlobalUbo {
     mat4 projectionViewMatrix;
     vec4 ambientLightColor;
-    vec4 lightPosition[2];
-    vec4 lightColor;
     mat4 viewMatrix;
     mat4 invViewMatrix;
+    vec4 clusterScale;
+    uvec4 clusterGrid;
+    mat4 invProjectionMatrix;
+    vec4 sunDirection;
+    vec4 sunColor;
+    vec4 cascadeSplits;
+    mat4 cascadeMatrices[4];
 } ubo;
 
-layout(push_constant) uniform Push {
+struct InstanceData {
     mat4 modelMatrix;
+    vec4 color;
     int textureIndex;
     float metalness;
     float roughness;
-    vec3 color;
+};
+
+layout(std430, binding = 9) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+layout(push_constant) uniform Push {
+    vec4 boundsMin;
+    vec4 boundsExtent;
 } push;
 
+// Same position math as depth.vert, the depth prepass relies on it
+invariant gl_Position;
+
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
-    vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+    InstanceData instance = instances[gl_InstanceIndex];
+    
+    vec3 vertexPosition = position.xyz;
+    vec3 vertexNormal = normal.xyz;
+    vec4 vertexTangent = tangent;
+    if (PACKED_VERTEX) {
+        vertexPosition = push.boundsMin.xyz + position.xyz * push.boundsExtent.xyz;
+        vertexNormal = octahedralDecode(normal.xy);
+        vertexTangent = vec4(octahedralDecode(tangent.xy), position.w * 2.0 - 1.0);
+    }
+    
+    vec4 positionWorld = instance.modelMatrix * vec4(vertexPosition, 1.0);
     
-    vec3 T = normalize( vec3(push.modelMatrix * vec4(tangent.xyz, 0.0)) );
-    vec3 N = normalize( vec3(push.modelMatrix * vec4(normal, 0.0)) );
-    vec3 B = cross(N, T) * tangent.w;
+    vec3 T = normalize( vec3(instance.modelMatrix * vec4(vertexTangent.xyz, 0.0)) );
+    vec3 N = normalize( vec3(instance.modelMatrix * vec4(vertexNormal, 0.0)) );
+    vec3 B = cross(N, T) * vertexTangent.w;
     mat3 TBN = transpose( mat3(T, B, N) );
 
     frag.color = T;
@@ -48,6 +90,10 @@ void main() {
     frag.texcoord = uv;
     frag.texcoord.t = 1.0 - uv.t;
     frag.TBN = TBN;
+    frag.materialColor = instance.color.rgb;
+    frag.textureIndex = instance.textureIndex;
+    frag.metalness = instance.metalness;
+    frag.roughness = instance.roughness;
 
     gl_Position = ubo.projectionViewMatrix * ubo.viewMatrix * positionWorld;
 }
@@ -0,0 +1,23 @@
+#version 450
+
+// Shadow cascades, casters are drawn one by one with their light space matrix pushed
+
+// Model::PackedVertex input: unorm position in mesh bounds, float models bind the position stream
+layout(constant_id = 0) const bool PACKED_VERTEX = false;
+
+layout(location = 0) in vec4 position;
+
+layout(push_constant) uniform Push {
+    mat4 lightMatrix;
+    vec4 boundsMin;
+    vec4 boundsExtent;
+} push;
+
+void main() {
+    vec3 vertexPosition = position.xyz;
+    if (PACKED_VERTEX) {
+        vertexPosition = push.boundsMin.xyz + position.xyz * push.boundsExtent.xyz;
+    }
+    
+    gl_Position = push.lightMatrix * vec4(vertexPosition, 1.0);
+}
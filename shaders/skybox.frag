@@ -8,10 +8,15 @@ layout(location = 0) out vec4 outColor;
 layout(binding = 0) uniform GlobalUbo {
     mat4 projectionViewMatrix;
     vec4 ambientLightColor;
-    vec4 lightPosition[2];
-    vec4 lightColor;
     mat4 viewMatrix;
     mat4 invViewMatrix;
+    vec4 clusterScale;
+    uvec4 clusterGrid;
+    mat4 invProjectionMatrix;
+    vec4 sunDirection;
+    vec4 sunColor;
+    vec4 cascadeSplits;
+    mat4 cascadeMatrices[4];
 } ubo;
 
 layout(binding = 1) uniform samplerCube environmentMap;
@@ -0,0 +1,18 @@
+#version 450
+
+layout(location = 0) in vec2 texCoord;
+
+layout(location = 0) out vec4 outColor;
+
+// Tone mapped frame, rendered into the top left part of the image
+layout(binding = 0) uniform sampler2D frame;
+
+layout(push_constant) uniform Push {
+    vec2 uvScale;   // Rendered part of the image
+    vec2 uvMax;     // Last texel center of it, bilinear taps stay inside
+} push;
+
+void main() {
+    vec2 uv = min(texCoord * push.uvScale, push.uvMax);
+    outColor = vec4(texture(frame, uv).rgb, 1.0);
+}
@@ -9,6 +9,11 @@
 #include "include/RenderSystem.hpp"
 #include "include/UI.hpp"
 #include "include/Buffer.hpp"
+#include "include/ObjLoader.hpp"
+#include "include/MeshOptimizer.hpp"
+#include "include/MeshCollider.hpp"
+#include "include/MeshSimplifier.hpp"
+#include "include/MeshletBuilder.hpp"
 
 //libs
 #define GLM_FORCE_RADIANS
@@ -21,9 +26,12 @@
 
 //std
 #include <cassert>
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <future>
+#include <random>
+#include <unordered_set>
 
 #define ENHANCED_MT
 
@@ -66,15 +74,23 @@ void Application::run() {
     SolidObject cameraObj = SolidObject::createSolidObject();
     cameraObj.transform.translation = {.0f, -2.f, -2.f};
     
+    // Tone mapping and the UI are the last subpass of whichever scene pass ran
     postProcessing = std::make_unique<CompositionPipeline>(
         device,
-        renderer.getSwapChainRenderPass(),
         renderer.getPostProcessingDescriptorSetLayout(),
         binaryDir+"composition"
     );
+    postProcessing->createPipeline(renderer.getOffscreenRenderPass(), Renderer::COMPOSITION_SUBPASS);
+    postProcessing->createPipeline(renderer.getDeferredRenderPass(), Renderer::DEFERRED_COMPOSITION_SUBPASS);
     
-    //TextRender font{device, renderer.getSwapChainRenderPass(), "fonts/Disket-Mono-Regular.ttf"};
-    UI imgui(device, renderer.getSwapChainRenderPass(), binaryDir);
+    //TextRender font{device, renderer.getOffscreenRenderPass(), "fonts/Disket-Mono-Regular.ttf"};
+    UI imgui(device, binaryDir);
+    imgui.createPipeline(renderer.getOffscreenRenderPass(), Renderer::COMPOSITION_SUBPASS);
+    imgui.createPipeline(renderer.getDeferredRenderPass(), Renderer::DEFERRED_COMPOSITION_SUBPASS);
+    // Frames rendered below native resolution are tone mapped into an LDR target, upscaled, then get the UI on top
+    postProcessing->createUpscalePipeline(renderer.getUpscaleRenderPass(), renderer.getUpscaleDescriptorSetLayout(), binaryDir+"upscale");
+    postProcessing->createFsrPipelines(renderer.getEasuRenderPass(), renderer.getUpscaleRenderPass(), binaryDir);
+    const uint32_t upscaleUiPipeline = imgui.createPipeline(renderer.getUpscaleRenderPass(), 0);
 
     // Load heavy assets on a separate thread
     std::thread([this]() {
@@ -153,17 +169,20 @@ void Application::run() {
         currentTime = newTime;
         frameTime = glm::min(frameTime, .05f);
 
+        // Only objects moved since the last frame are rebuilt
+        scene.getTransforms().update();
+        env.getTransforms().update();
+        sceneBvh.update(scene);
+        
         if (auto commandBuffer = renderer.beginFrame()) {
             frameIndex = renderer.getFrameIndex();
             
             //Render
             renderer.beginOffscreenRenderPass(commandBuffer);
-            renderer.endOffscreenRenderPass(commandBuffer);
-            
-            renderer.beginSwapChainRenderPass(commandBuffer);
+            renderer.beginCompositionSubpass(commandBuffer);
             //postProcessing->renderSceneToSwapChain(commandBuffer, renderer.getPostProcessingDescriptorSets()->at(frameIndex));
             //font.render(commandBuffer, frameIndex);
-            renderer.endSwapChainRenderPass(commandBuffer);
+            renderer.endOffscreenRenderPass(commandBuffer);
             
             renderer.endFrame();
 
@@ -249,8 +268,12 @@ void Application::run() {
         renderer.getOffscreenRenderPass(),
         skyboxSetLayout->getDescriptorSetLayout(),
         binaryDir+"skybox",
-        device.msaaSamples
+        device.msaaSamples,
+        RenderSystem::VertexInput::Positions,
+        false
     );
+    // Deferred frames draw the sky after lighting, only where the depth test still finds the clear value
+    skyboxSystem->createDeferredPipelines(renderer.getDeferredRenderPass(), DeferredLighting::SUBPASS, binaryDir+"skybox", 1, false);
     
     /****
     Global Scene
@@ -272,6 +295,11 @@ void Application::run() {
            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, numOfMaterials * SwapChain::MAX_FRAMES_IN_FLIGHT)
            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, numOfMaterials * SwapChain::MAX_FRAMES_IN_FLIGHT)
            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, numOfMaterials * SwapChain::MAX_FRAMES_IN_FLIGHT)
+           .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, numOfMaterials * SwapChain::MAX_FRAMES_IN_FLIGHT)
+           .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, numOfMaterials * SwapChain::MAX_FRAMES_IN_FLIGHT)
+           .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, numOfMaterials * SwapChain::MAX_FRAMES_IN_FLIGHT)
+           .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, numOfMaterials * SwapChain::MAX_FRAMES_IN_FLIGHT)
+           .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, numOfMaterials * SwapChain::MAX_FRAMES_IN_FLIGHT)
            .build();
 
     auto globalSetLayout =
@@ -285,12 +313,63 @@ void Application::run() {
             .addBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .addBinding(7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .addBinding(8, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .addBinding(10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(11, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(12, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(13, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .build();
     
+    // Per-thread command pools for parallel recording
+    renderer.createThreadCommandPools(jobSystem.getWorkerCount());
+    
+    // Global Scene Pipeline, created first since it owns the per-frame instance buffers
+    renderSystem = std::make_unique<RenderSystem>(
+        device,
+        renderer.getOffscreenRenderPass(),
+        globalSetLayout->getDescriptorSetLayout(),
+        binaryDir+"shader",
+        device.msaaSamples,
+        RenderSystem::VertexInput::PackedAttributes
+    );
+    renderSystem->createDeferredPipelines(renderer.getDeferredRenderPass(), 0, binaryDir+"gbuffer", Renderer::GBUFFER_ATTACHMENTS);
+    renderSystem->createDepthPrepassPipelines(renderer.getOffscreenRenderPass(), binaryDir+"depth");
+    deferredLighting = std::make_unique<DeferredLighting>(
+        device,
+        renderer.getDeferredRenderPass(),
+        globalSetLayout->getDescriptorSetLayout(),
+        renderer.getGBufferDescriptorSetLayout(),
+        binaryDir+"deferred"
+    );
+    
+    // GPU driven culling reads the same instance buffers the scene pipeline draws from
+    if (device.multiDrawIndirect) {
+        std::vector<VkDescriptorBufferInfo> instanceInfos{};
+        for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) { instanceInfos.push_back(renderSystem->getInstanceBufferInfo(i)); }
+        gpuCulling = std::make_unique<GpuCulling>(device, renderer, binaryDir, instanceInfos);
+        gpuCulling->build(scene, &pvs);
+        DEBUG_MESSAGE("\tGPU culling: " << gpuCulling->getObjects().size() << " objects, " << gpuCulling->getBatches().size()
+            << " batches, " << gpuCulling->getRecordCount() << " cull clusters"
+            << (device.cmdDrawIndexedIndirectCount ? "" : " (no draw indirect count, full command ranges)"));
+    } else {
+        // Nothing samples depth after the scene pass, it can stay transient
+        renderer.setDepthReadback(false);
+    }
+    const auto targetMemory = renderer.getTargetMemory();
+    DEBUG_MESSAGE("\tRender targets: " << targetMemory.backed / (1024 * 1024) << " MB backed, "
+        << targetMemory.lazy / (1024 * 1024) << " MB lazily allocated");
+    
+    shadowCascades = std::make_unique<ShadowCascades>(device, binaryDir);
+    auto shadowInfo = shadowCascades->descriptorInfo();
+    
     std::vector<VkDescriptorSet> inFlightDescriptorSets[SwapChain::MAX_FRAMES_IN_FLIGHT];
     for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
         std::vector<VkDescriptorSet> descriptorSets(numOfMaterials);
         auto bufferInfo = uboBuffers[i]->descriptorInfo();
+        auto instanceInfo = renderSystem->getInstanceBufferInfo(i);
+        auto lightInfo = lightClusters.getLightBufferInfo(i);
+        auto clusterInfo = lightClusters.getClusterBufferInfo(i);
+        auto lightIndexInfo = lightClusters.getIndexBufferInfo(i);
         int matCnt = 0;
         for (int j = 0; j < numOfMaterials; j++) {
             DescriptorWriter(*globalSetLayout, *globalPool)
@@ -303,19 +382,15 @@ void Application::run() {
                 .writeImage(6, &textureInfos[matCnt++])     // Metallic
                 .writeImage(7, &textureInfos[matCnt++])     // Roughness
                 .writeImage(8, &textureInfos[matCnt++])     // Occlusion
+                .writeBuffer(9, &instanceInfo)              // Instances
+                .writeBuffer(10, &lightInfo)                // Lights
+                .writeBuffer(11, &clusterInfo)              // Light clusters
+                .writeBuffer(12, &lightIndexInfo)           // Light indices
+                .writeImage(13, &shadowInfo)                // Shadow cascades
                 .build(descriptorSets[j]);
         }
         inFlightDescriptorSets[i] = descriptorSets;
     }
-     
-    // Global Scene Pipeline
-    renderSystem = std::make_unique<RenderSystem>(
-        device,
-        renderer.getOffscreenRenderPass(),
-        globalSetLayout->getDescriptorSetLayout(),
-        binaryDir+"shader",
-        device.msaaSamples
-    );
     
     // GUI Style and Sizes definition
     SDL_Vulkan_GetDrawableSize(window.getWindow(), &surfaceExtent.width, &surfaceExtent.height);
@@ -371,6 +446,16 @@ void Application::run() {
         
         // Prepare next GUI Frame
         imgui.newFrame(this);
+        // Every render pass is recreated with the offscreen targets, so is every pipeline registered against one
+        if (recreatePassPipelines) {
+            postProcessing->recreatePipeline(0, renderer.getOffscreenRenderPass(), Renderer::COMPOSITION_SUBPASS);
+            postProcessing->recreatePipeline(1, renderer.getDeferredRenderPass(), Renderer::DEFERRED_COMPOSITION_SUBPASS);
+            postProcessing->recreateUpscalePipelines(renderer.getUpscaleRenderPass(), renderer.getEasuRenderPass());
+            imgui.recreatePipeline(0, renderer.getOffscreenRenderPass(), Renderer::COMPOSITION_SUBPASS);
+            imgui.recreatePipeline(1, renderer.getDeferredRenderPass(), Renderer::DEFERRED_COMPOSITION_SUBPASS);
+            imgui.recreatePipeline(upscaleUiPipeline, renderer.getUpscaleRenderPass(), 0);
+            recreatePassPipelines = false;
+        }
 
         while(SDL_PollEvent(&sdl_event))
         {
@@ -453,6 +538,19 @@ void Application::run() {
                 case SDL_MOUSEBUTTONDOWN:
                     io.MouseDown[0] = sdl_event.button.state;
                     mouseLeft = true;
+                    if (!io.WantCaptureMouse) {
+                        // Unproject the click on the near and far planes of the current view
+                        glm::mat4 invProjectionView = glm::inverse(camera.getProjection() * camera.getView());
+                        glm::vec2 ndc{2.f * sdl_event.button.x / windowExtent.width - 1.f, 2.f * sdl_event.button.y / windowExtent.height - 1.f};
+                        glm::vec4 nearPoint = invProjectionView * glm::vec4(ndc, 0.f, 1.f);
+                        glm::vec4 farPoint = invProjectionView * glm::vec4(ndc, 1.f, 1.f);
+                        glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+                        glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+                        
+                        SceneBvh::Hit hit{};
+                        pickedEntity = sceneBvh.raycast(scene, Ray{origin, direction}, 1e6f, hit) ? hit.entity : Entity{};
+                        pickedDistance = hit.distance;
+                    }
                     break;
                 case SDL_MOUSEBUTTONUP:
                     io.MouseDown[0] = sdl_event.button.state;
@@ -494,7 +592,21 @@ void Application::run() {
             if (movement & 0x10) { moveDir -= upDir; }
             if (movement & 0x20) { moveDir += upDir; }
             if (glm::dot(moveDir, moveDir) > glm::epsilon<float>()) {
-                cameraObj.transform.translation += 8.f * frameTime * glm::normalize(moveDir);
+                // Stop at the first surface, then slide the remaining travel along it once
+                const float cameraRadius = .2f;
+                glm::vec3 direction = glm::normalize(moveDir);
+                float distance = 8.f * frameTime;
+                SceneBvh::Hit hit{};
+                float travel = sceneBvh.sweepSphere(scene, cameraObj.transform.translation, direction, distance, cameraRadius, hit);
+                cameraObj.transform.translation += direction * travel;
+                
+                glm::vec3 slide = direction * (distance - travel);
+                slide -= hit.normal * glm::dot(slide, hit.normal);
+                float slideDistance = glm::length(slide);
+                if (travel < distance && slideDistance > glm::epsilon<float>()) {
+                    glm::vec3 slideDirection = slide / slideDistance;
+                    cameraObj.transform.translation += slideDirection * sceneBvh.sweepSphere(scene, cameraObj.transform.translation, slideDirection, slideDistance, cameraRadius, hit);
+                }
             }
         }
         
@@ -511,6 +623,12 @@ void Application::run() {
         // Polling keystrokes and adjusting the camera position/rotation
         camera.setViewYXZ(cameraObj.transform.translation, cameraObj.transform.rotation);
         
+        // The scale is settled before recording, every pass of the frame uses the same render extent
+        if (useDynamicResolution && gpuTimer.isSupported()) {
+            renderer.setRenderScale(dynamicResolution.update(gpuTimer.getMilliseconds(static_cast<uint32_t>(GpuScope::Frame))));
+        }
+        renderer.setEasuEnabled(postProcessing->upscaler == CompositionPipeline::Upscaler::Fsr);
+        
         if (auto commandBuffer = renderer.beginFrame()) {
             frameIndex = renderer.getFrameIndex();
             FrameInfo frameInfo{
@@ -519,7 +637,8 @@ void Application::run() {
                 commandBuffer,
                 camera,
                 inFlightDescriptorSets[frameIndex],
-                solidObjects
+                scene,
+                &sceneBvh
             };
             
             FrameInfo skyboxInfo{
@@ -535,7 +654,20 @@ void Application::run() {
             ubo.projectionView = frameInfo.camera.getProjection();
             ubo.viewMatrix = frameInfo.camera.getView();
             ubo.invViewMatrix = frameInfo.camera.getInverseView();
-            //ubo.lightPosition = pos;
+            ubo.invProjectionMatrix = glm::inverse(frameInfo.camera.getProjection());
+            lightClusters.update(frameIndex, frameInfo.camera, renderer.getRenderExtent(), jobSystem);
+            ubo.clusterScale = lightClusters.getClusterScale();
+            ubo.clusterGrid = lightClusters.getClusterGrid();
+            // Elevation lifts the sun above the horizon, world up is -y
+            const glm::vec3 sunDirection{
+                glm::cos(sunAngles.x) * glm::sin(sunAngles.y),
+                glm::sin(sunAngles.x),
+                glm::cos(sunAngles.x) * glm::cos(sunAngles.y)};
+            shadowCascades->update(frameInfo.camera, sunDirection, scene);
+            ubo.sunDirection = glm::vec4(sunDirection, useShadows ? 1.f : 0.f);
+            ubo.sunColor = glm::vec4(sunColor * sunIntensity, 0.f);
+            ubo.cascadeSplits = shadowCascades->getSplitDepths();
+            for (uint32_t i = 0; i < ShadowCascades::CASCADE_COUNT; i++) { ubo.cascadeMatrices[i] = shadowCascades->getMatrix(i); }
             uboBuffers[frameIndex]->writeToBuffer(&ubo);
             uboBuffers[frameIndex]->flush();
             
@@ -543,16 +675,102 @@ void Application::run() {
             imgui.updateBuffers(frameIndex);
             
             // RenderPass
-            renderer.beginOffscreenRenderPass(commandBuffer);
-            skyboxSystem->renderSolidObjects(skyboxInfo);
-            renderSystem->renderSolidObjects(frameInfo);
-            renderer.endOffscreenRenderPass(commandBuffer);
+            // Draws are recorded in parallel into secondary buffers, the primary only executes them
+            // Deferred frames fill the G-buffer with the scene, the sky waits for the lighting subpass
+            const bool deferredFrame = useDeferred && renderer.isDeferredAvailable();
+            const bool prepassFrame = useDepthPrepass && !deferredFrame;
+            renderSystem->setDeferred(deferredFrame);
+            renderSystem->setDepthPrepass(prepassFrame);
+            skyboxSystem->setDeferred(deferredFrame);
+            auto beginSecondary = [this, deferredFrame](uint32_t workerIndex) {
+                return renderer.beginOffscreenSecondaryCommandBuffer(workerIndex, deferredFrame);
+            };
+            const bool gpuDriven = gpuCulling && useGpuCulling;
+            const glm::mat4 projectionView = camera.getProjection() * camera.getView();
+            if (!gpuDriven && useOcclusionCulling) {
+                occlusionCuller.rasterize(scene, projectionView, jobSystem);
+                frameInfo.occlusionCuller = &occlusionCuller;
+            }
+            renderSystem->setLodTarget(static_cast<float>(renderer.getRenderExtent().height), lodPixelError);
+            if (gpuDriven) { gpuCulling->setLodTarget(static_cast<float>(renderer.getRenderExtent().height), lodPixelError, camera.getProjection()[1][1]); }
+            if (usePvs && pvs.isLoaded()) { frameInfo.pvsCell = pvs.findCell(cameraObj.transform.translation); }
+            std::vector<VkCommandBuffer> secondaryBuffers{};
+            if (!deferredFrame) { secondaryBuffers = skyboxSystem->recordSolidObjects(skyboxInfo, jobSystem, beginSecondary); }
+            auto sceneBuffers = gpuDriven
+                ? renderSystem->recordIndirect(frameInfo, *gpuCulling, beginSecondary)
+                : renderSystem->recordSolidObjects(frameInfo, jobSystem, beginSecondary);
+            secondaryBuffers.insert(secondaryBuffers.end(), sceneBuffers.begin(), sceneBuffers.end());
+            // Depth goes first, the sky then only covers the background and the scene shades each pixel once
+            auto prepassBuffers = renderSystem->recordDepthPrepass(frameInfo, gpuDriven ? gpuCulling.get() : nullptr, beginSecondary);
+            secondaryBuffers.insert(secondaryBuffers.begin(), prepassBuffers.begin(), prepassBuffers.end());
             
-            renderer.beginSwapChainRenderPass(commandBuffer);
-            postProcessing->renderSceneToSwapChain(commandBuffer, renderer.getPostProcessingDescriptorSets()->at(frameIndex));
-            //font.render(commandBuffer, frameIndex);
-            imgui.draw(commandBuffer, frameIndex);
-            renderer.endSwapChainRenderPass(commandBuffer);
+            gpuTimer.beginFrame(commandBuffer, frameIndex);
+            gpuTimer.begin(commandBuffer, frameIndex, static_cast<uint32_t>(GpuScope::Frame));
+            // Visibility is decided on the GPU before the pass that consumes the indirect draws
+            if (gpuDriven) { gpuCulling->cull(commandBuffer, frameIndex, projectionView, glm::vec3(camera.getInverseView()[3]), frameInfo.pvsCell); }
+            
+            // Cached cascades make this a no-op until the sun turns or the camera leaves a cascade
+            if (useShadows) {
+                gpuTimer.begin(commandBuffer, frameIndex, static_cast<uint32_t>(GpuScope::Shadows));
+                shadowCascades->render(commandBuffer, scene);
+                gpuTimer.end(commandBuffer, frameIndex, static_cast<uint32_t>(GpuScope::Shadows));
+            }
+            
+            const auto scope = static_cast<uint32_t>(deferredFrame ? GpuScope::Deferred : prepassFrame ? GpuScope::DepthPrepass : GpuScope::Forward);
+            // HDR color never leaves tile memory, it is tone mapped straight into the swapchain image or the LDR target
+            const uint32_t compositionPipeline = deferredFrame ? 1 : 0;
+            const bool upscaling = renderer.isUpscaling();
+            auto recordScene = [&](VkCommandBuffer commandBuffer) {
+                gpuTimer.begin(commandBuffer, frameIndex, scope);
+                if (deferredFrame) {
+                    renderer.beginDeferredRenderPass(commandBuffer);
+                } else {
+                    renderer.beginOffscreenRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                }
+                if (!secondaryBuffers.empty()) {
+                    vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
+                }
+                if (deferredFrame) {
+                    renderer.nextDeferredSubpass(commandBuffer);
+                    deferredLighting->render(commandBuffer, frameInfo.globalDescriptorSet[0], renderer.getGBufferDescriptorSet());
+                    skyboxSystem->renderSolidObjects(skyboxInfo);
+                }
+                renderer.beginCompositionSubpass(commandBuffer);
+                postProcessing->renderSceneToSwapChain(commandBuffer, renderer.getPostProcessingDescriptorSets()->at(frameIndex), compositionPipeline);
+                //font.render(commandBuffer, frameIndex);
+                if (!upscaling) { imgui.draw(commandBuffer, frameIndex, compositionPipeline); }
+                renderer.endOffscreenRenderPass(commandBuffer);
+                gpuTimer.end(commandBuffer, frameIndex, scope);
+                
+                // Next frame's occlusion test reads this frame's depth
+                if (gpuDriven) { gpuCulling->buildDepthPyramid(commandBuffer, projectionView); }
+            };
+            
+            if (!upscaling) {
+                recordScene(commandBuffer);
+            } else {
+                // The renderer's graph runs the scene into the LDR target, then the upscale passes, the UI stays at native resolution
+                const bool fsr = postProcessing->upscaler == CompositionPipeline::Upscaler::Fsr;
+                Renderer::UpscaledFrame upscaledFrame{};
+                upscaledFrame.scene = [&](VkCommandBuffer commandBuffer) {
+                    recordScene(commandBuffer);
+                    gpuTimer.begin(commandBuffer, frameIndex, static_cast<uint32_t>(GpuScope::Upscale));
+                };
+                upscaledFrame.easu = [&](VkCommandBuffer commandBuffer) {
+                    postProcessing->easu(commandBuffer, renderer.getUpscaleDescriptorSet(), renderer.getRenderExtent(), renderer.getOffscreenExtent());
+                };
+                upscaledFrame.output = [&](VkCommandBuffer commandBuffer) {
+                    if (fsr) {
+                        postProcessing->sharpen(commandBuffer, renderer.getEasuDescriptorSet());
+                    } else {
+                        postProcessing->upscale(commandBuffer, renderer.getUpscaleDescriptorSet(), renderer.getRenderExtent(), renderer.getOffscreenExtent());
+                    }
+                    imgui.draw(commandBuffer, frameIndex, upscaleUiPipeline);
+                };
+                renderer.recordUpscaledFrame(commandBuffer, upscaledFrame);
+                gpuTimer.end(commandBuffer, frameIndex, static_cast<uint32_t>(GpuScope::Upscale));
+            }
+            gpuTimer.end(commandBuffer, frameIndex, static_cast<uint32_t>(GpuScope::Frame));
             
             renderer.endFrame();
         }
@@ -561,26 +779,166 @@ void Application::run() {
     vkDeviceWaitIdle(device.device());
 }
 
+namespace {
+
+// Static scene, PVS object i is mesh i so the baker and the runtime must agree on this order
+const std::vector<std::string> meshNames = {
+    "arches", "brickwalls", "ceilings", "columns_a", "columns_b", "columns_c",
+    "details", "fabric_curtains_blue", "fabric_curtains_green", "fabric_curtains_red",
+    "fabric_rounds_blue", "fabric_rounds_green", "fabric_rounds_red", "flagpoles",
+    "floors", "ivys", "lion_heads", "lion_shields", "roofs", "vases_hanging",
+    "vases_hanging_chain", "vases_octagonal", "vases_round", "vases_round_plants"
+};
+const std::string pvsFile = "sponza/sponza.pvs";
+
+}
+
+void Application::bakeVisibility(const char *binaryPath) {
+    std::string directory{binaryPath};
+    while(directory.back() != '/' && !directory.empty()) directory.pop_back();
+    
+    // Prepared like loadSolidObjects does, the cluster bits must line up with the clusters the models get
+    std::vector<std::shared_ptr<MeshCollider>> colliders{};
+    std::vector<std::vector<Aabb>> clusterBounds{};
+    for (const auto &name : meshNames) {
+        Model::Data meshData{};
+        meshData.loadModel(directory + "sponza/sponza_" + name + ".obj", VK_TRUE);
+        MeshOptimizer::optimize(meshData);
+        colliders.push_back(std::make_shared<MeshCollider>(meshData));
+        MeshSimplifier::generateLods(meshData);
+        MeshletBuilder::build(meshData);
+        meshData.splitIntoShortIndexChunks();
+        
+        clusterBounds.emplace_back();
+        for (const auto &cluster : Model::buildCullClusters(meshData)) { clusterBounds.back().push_back(Aabb{cluster.boundsMin, cluster.boundsMax}); }
+    }
+    
+    JobSystem bakeJobs{};
+    PotentiallyVisibleSet pvs{};
+    auto bakeStart = std::chrono::high_resolution_clock::now();
+    pvs.bake(colliders, clusterBounds, {}, bakeJobs);
+    pvs.save(directory + pvsFile);
+    std::cout << "PVS: " << pvs.getBakedCellCount() << " / " << pvs.getCellCount() << " cells, " << pvs.getObjectCount() << " objects, "
+        << pvs.getClusterCount() << " clusters in "
+        << std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - bakeStart).count() << "s\n";
+}
+
+void Application::benchmarkBvh(const char *binaryPath) {
+    std::string directory{binaryPath};
+    while(directory.back() != '/' && !directory.empty()) directory.pop_back();
+    
+    std::vector<std::shared_ptr<MeshCollider>> colliders{};
+    std::vector<Aabb> bounds{};
+    double buildSeconds = 0.0;
+    size_t triangles = 0;
+    for (const auto &name : meshNames) {
+        Model::Data meshData{};
+        meshData.loadModel(directory + "sponza/sponza_" + name + ".obj", VK_TRUE);
+        auto buildStart = std::chrono::high_resolution_clock::now();
+        colliders.push_back(std::make_shared<MeshCollider>(meshData));
+        buildSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - buildStart).count();
+        triangles += colliders.back()->getTriangleCount();
+        bounds.push_back(colliders.back()->getBounds());
+    }
+    // Meshes sit at the origin in the scene, the top level is the same one SceneBvh builds
+    Bvh topLevel{};
+    topLevel.build(bounds);
+    std::cout << "BVH build: " << triangles << " triangles in " << buildSeconds << "s (" << triangles / buildSeconds / 1e6 << " Mtri/s)\n";
+    
+    // Random rays from inside the atrium, the same queries picking and collision issue
+    const uint32_t rayCount = 100000;
+    std::mt19937 generator{1234};
+    std::uniform_real_distribution<float> unit{-1.f, 1.f};
+    Aabb sceneBounds = topLevel.getBounds();
+    glm::vec3 center = sceneBounds.center();
+    glm::vec3 halfExtent = .25f * (sceneBounds.max - sceneBounds.min);
+    
+    uint32_t hits = 0;
+    auto queryStart = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < rayCount; i++) {
+        glm::vec3 origin = center + halfExtent * glm::vec3{unit(generator), unit(generator), unit(generator)};
+        glm::vec3 direction{unit(generator), unit(generator), unit(generator)};
+        if (glm::dot(direction, direction) < 1e-4f) { direction = {0.f, 1.f, 0.f}; }
+        Ray ray{origin, glm::normalize(direction)};
+        float tMax = 1e6f;
+        bool hit = topLevel.intersect(ray, tMax, [&](uint32_t primitive, float &closest) {
+            glm::vec3 normal;
+            return colliders[primitive]->intersect(ray, closest, normal);
+        });
+        hits += hit ? 1 : 0;
+    }
+    double querySeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - queryStart).count();
+    std::cout << "BVH rays: " << rayCount << " in " << querySeconds << "s (" << rayCount / querySeconds / 1e6 << " Mrays/s, " << hits << " hits)\n";
+}
+
 void Application::loadSolidObjects() {
-    std::vector<std::string> meshNames = {
-        "arches", "brickwalls", "ceilings", "columns_a", "columns_b", "columns_c",
-        "details", "fabric_curtains_blue", "fabric_curtains_green", "fabric_curtains_red",
-        "fabric_rounds_blue", "fabric_rounds_green", "fabric_rounds_red", "flagpoles",
-        "floors", "ivys", "lion_heads", "lion_shields", "roofs", "vases_hanging",
-        "vases_hanging_chain", "vases_octagonal", "vases_round", "vases_round_plants"
-    };
+    const std::unordered_set<std::string> occluderNames = {"arches", "brickwalls", "columns_a", "columns_b", "columns_c"};
 
+    double colliderSeconds = 0.0;
+    size_t colliderTriangles = 0;
+    size_t occluderTriangles = 0;
+    std::vector<uint32_t> clusterCounts{};
     for (int i = 0; i < meshNames.size(); i++) {
-        auto group = SolidObject::createSolidObject();
-        group.model = Model::createModelFromFile(device, binaryDir + "sponza/sponza_" + meshNames[i] + ".obj", VK_TRUE);
-        group.textureIndex = i;
-        group.roughness = .7f;
-        group.metalness = 1.f;
-        solidObjects.emplace(group.getId(), std::move(group));
+        Model::Data meshData{};
+        meshData.loadModel(binaryDir + "sponza/sponza_" + meshNames[i] + ".obj", VK_TRUE);
+        auto report = MeshOptimizer::optimize(meshData);
+        DEBUG_MESSAGE("\t" << meshNames[i] << ": " << report.verticesBefore << " -> " << report.verticesAfter << " vertices, "
+            << report.clusters << " clusters, ACMR " << report.before.acmr << " -> " << report.after.acmr
+            << ", ATVR " << report.before.atvr << " -> " << report.after.atvr);
+        
+        // Triangle BVH for picking and collision, built before the index buffer is split into chunks
+        auto buildStart = std::chrono::high_resolution_clock::now();
+        auto collider = std::make_shared<MeshCollider>(meshData);
+        colliderSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - buildStart).count();
+        colliderTriangles += collider->getTriangleCount();
+        
+        // Walls and columns hide most of the atrium, the rest is too thin or too small to bother
+        std::shared_ptr<OccluderMesh> occluder{};
+        if (occluderNames.count(meshNames[i])) {
+            occluder = std::make_shared<OccluderMesh>(meshData);
+            occluderTriangles += occluder->getTriangleCount();
+        }
+        
+        auto lodReport = MeshSimplifier::generateLods(meshData);
+        DEBUG_MESSAGE("\t\tLODs: " << lodReport.triangles[0] << ", " << lodReport.triangles[1] << ", " << lodReport.triangles[2] << ", "
+            << lodReport.triangles[3] << " triangles, error " << lodReport.errors[lodReport.lods - 1]);
+        
+        auto meshletReport = MeshletBuilder::build(meshData);
+        DEBUG_MESSAGE("\t\tMeshlets: " << meshletReport.meshlets << ", " << meshletReport.averageVertices << " vertices "
+            << meshletReport.averageTriangles << " triangles on average, " << meshletReport.coneCullable << " with a normal cone");
+        
+        meshData.splitIntoShortIndexChunks();
+        Entity group = scene.create();
+        scene.addTransform(group);
+        auto model = std::make_shared<Model>(device, meshData, Model::VertexFormat::Packed);
+        clusterCounts.push_back(static_cast<uint32_t>(model->getCullClusters().size()));
+        scene.add<RenderComponent>(group, {model});
+        scene.add<MaterialComponent>(group, {{}, i, 1.f, .7f});
+        scene.add<ColliderComponent>(group, {collider});
+        if (occluder) { scene.add<OccluderComponent>(group, {occluder}); }
+        scene.add<PvsComponent>(group, {static_cast<uint32_t>(i)});
     }
+    scene.getTransforms().update();
+    sceneBvh.build(scene);
+    DEBUG_MESSAGE("\tBVH build: " << colliderTriangles << " triangles in " << colliderSeconds << "s ("
+        << colliderTriangles / colliderSeconds / 1e6 << " Mtri/s)");
+    
+    // Baked offline with --bake-pvs, a stale file from other meshes or cluster splits is ignored
+    pvs.load(binaryDir + pvsFile, clusterCounts);
+    DEBUG_MESSAGE("\tPVS: " << (pvs.isLoaded() ? std::to_string(pvs.getBakedCellCount()) + " cells, "
+        + std::to_string(pvs.getClusterCount()) + " clusters" : std::string{"not baked"}));
+    DEBUG_MESSAGE("\tOccluders: " << occluderNames.size() << " meshes, " << occluderTriangles << " triangles");
+    
+    // Two main lights mirrored across the atrium, moved from the UI
+    lightClusters.lights.resize(2);
+    lightClusters.lights[0].position = {.0f, -1.f, .0f};
+    lightClusters.lights[1].position = {.0f, -1.f, .0f};
+    
+    auto objStats = ObjLoader::getTotalStats();
+    DEBUG_MESSAGE("\tOBJ parsing: " << objStats.bytes / (1024 * 1024) << " MB in " << objStats.seconds << "s (" << objStats.megabytesPerSecond() << " MB/s)");
     
     // Cubemap 3D canvas
-    auto cube = SolidObject::createSolidObject();
+    Entity cube = env.create();
     Model::Data cubeData;
     cubeData.vertices = {
         {{-1.f, -1.f, 1.f}, {}, {}, {}, {0.f, 0.f}},
@@ -600,12 +958,9 @@ void Application::loadSolidObjects() {
         4,1,5,1,4,0,
         3,6,2,6,3,7
     };
-    cube.model = std::make_unique<Model>(device, cubeData);
-    cube.textureIndex = 0;
-    cube.transform.translation = {.0f, .0f, .0f};
-    cube.transform.scale = {1.f, 1.f, 1.f};
-    cube.transform.rotation = {.0f, .0f, .0f};
-    env.emplace(cube.getId(), std::move(cube));
+    env.addTransform(cube, {.0f, .0f, .0f}, {.0f, .0f, .0f}, {1.f, 1.f, 1.f});
+    env.add<RenderComponent>(cube, {std::make_shared<Model>(device, cubeData)});
+    env.add<MaterialComponent>(cube, {{}, 0});
 }
 
 void Application::renderImguiContent() {
@@ -637,6 +992,40 @@ void Application::renderImguiContent() {
     ImGui::NewLine();
     ImGui::Text("FIF: %i", SwapChain::MAX_FRAMES_IN_FLIGHT);
     
+    const auto &queueStats = renderSystem->getQueueStats();
+    ImGui::Text("Draws %u, instances %u", queueStats.draws, queueStats.instances);
+    ImGui::Text("Binds: pipeline %u, descriptor %u, buffer %u", queueStats.pipelineBinds, queueStats.descriptorBinds, queueStats.bufferBinds);
+    ImGui::Text("Redundant binds skipped %u", queueStats.skippedBinds);
+    ImGui::Text("Triangles %.2fM, %.0f Mtri/s", queueStats.triangles / 1e6f, queueStats.triangles / 1e6f * framesPerSecond.back());
+    if (gpuCulling) {
+        ImGui::Checkbox("GPU culling", &useGpuCulling);
+        ImGui::Checkbox("Occlusion culling", &gpuCulling->occlusionEnabled);
+        ImGui::Checkbox("Meshlet cone culling", &gpuCulling->coneCullingEnabled);
+    }
+    if (pvs.isLoaded()) { ImGui::Checkbox("PVS", &usePvs); }
+    if (gpuCulling && useGpuCulling) {
+        ImGui::Text("GPU drawn clusters %u / %u", gpuCulling->getLastDrawnCount(), gpuCulling->getRecordCount());
+        ImGui::Text("GPU drawn triangles %.2fM / %.2fM", gpuCulling->getLastDrawnTriangleCount() / 1e6f, gpuCulling->getRecordTriangleCount() / 1e6f);
+        if (pvs.isLoaded()) { ImGui::Text("PVS culled clusters %u / %u", gpuCulling->getLastPvsCulledCount(), gpuCulling->getPvsRecordCount()); }
+    } else {
+        ImGui::Text("Frustum culled %u", renderSystem->getCulledCount());
+        if (pvs.isLoaded()) { ImGui::Text("PVS culled objects %u", renderSystem->getPvsCulledCount()); }
+        ImGui::Checkbox("CPU occlusion culling", &useOcclusionCulling);
+        if (useOcclusionCulling) {
+            const auto &occlusionStats = occlusionCuller.getStats();
+            ImGui::Text("Occlusion culled %u / %u", occlusionStats.culled, occlusionStats.tested);
+            ImGui::Text("Occluders %u, %u tris: raster %.2f ms, test %.2f ms", occlusionStats.occluders, occlusionStats.triangles,
+                occlusionStats.rasterMilliseconds, occlusionStats.testMilliseconds);
+        }
+    }
+    if (scene.isAlive(pickedEntity)) {
+        ImGui::Text("Picked entity %u at %.2f", pickedEntity.index, pickedDistance);
+    }
+    const auto &lodCounts = gpuCulling && useGpuCulling ? gpuCulling->getLastLodCounts() : renderSystem->getLodCounts();
+    ImGui::Text("LOD objects %u / %u / %u / %u", lodCounts[0], lodCounts[1], lodCounts[2], lodCounts[3]);
+    ImGui::SliderFloat("LOD pixel error", &lodPixelError, .25f, 8.f);
+    ImGui::Text("Transforms updated %u / %u", scene.getTransforms().getLastUpdateCount(), scene.getEntityCount());
+    
     ImGui::NewLine();
     static int windowMode = 0;
     if (ImGui::Combo("##fullscreen", &windowMode, "Windowed\0Windowed Borderless\0Full Screen\0")) {
@@ -678,6 +1067,70 @@ void Application::renderImguiContent() {
         renderer.recreateSwapChain();
         renderSystem->recreatePipeline(renderer.getOffscreenRenderPass(), device.msaaSamples);
         skyboxSystem->recreatePipeline(renderer.getOffscreenRenderPass(), device.msaaSamples);
+        recreatePassPipelines = true;
+    }
+    if (renderer.isDeferredAvailable()) {
+        ImGui::Checkbox("Deferred shading", &useDeferred);
+    } else {
+        ImGui::TextDisabled("Deferred shading needs MSAA off");
+    }
+    ImGui::Checkbox("Depth prepass", &useDepthPrepass);
+    if (gpuTimer.isSupported()) {
+        float forwardTime = gpuTimer.getMilliseconds(static_cast<uint32_t>(GpuScope::Forward));
+        float prepassTime = gpuTimer.getMilliseconds(static_cast<uint32_t>(GpuScope::DepthPrepass));
+        ImGui::Text("Scene GPU: forward %.2f ms, prepass %.2f ms (%+.2f)", forwardTime, prepassTime, prepassTime - forwardTime);
+        ImGui::Text("Scene GPU: deferred %.2f ms", gpuTimer.getMilliseconds(static_cast<uint32_t>(GpuScope::Deferred)));
+    }
+    const auto targetMemory = renderer.getTargetMemory();
+    constexpr float MB = 1024.f * 1024.f;
+    ImGui::Text("Render targets: %.1f MB backed", targetMemory.backed / MB);
+    ImGui::Text("Render targets: %.1f MB lazy, %.1f MB committed", targetMemory.lazy / MB, targetMemory.committed / MB);
+    
+    ImGui::NewLine();
+    ImGui::Text("Render Scale");
+    if (gpuTimer.isSupported() && ImGui::Checkbox("Dynamic resolution", &useDynamicResolution) && useDynamicResolution) {
+        dynamicResolution.reset();
+    }
+    if (useDynamicResolution) {
+        static float targetFps = 60.f;
+        if (ImGui::SliderFloat("Target FPS", &targetFps, 30.f, 144.f, "%.0f")) {
+            dynamicResolution.budgetMilliseconds = 1000.f / targetFps;
+        }
+    } else {
+        // Per axis scales of the FSR1 quality modes, Performance shades a quarter of the pixels
+        static const char *scalePresets[] = {"Native", "Ultra Quality", "Quality", "Balanced", "Performance"};
+        static const float presetScales[] = {1.f, 1.f / 1.3f, 1.f / 1.5f, 1.f / 1.7f, 1.f / 2.f};
+        float renderScale = renderer.getRenderScale();
+        int presetIndex = -1;
+        for (int i = 0; i < IM_ARRAYSIZE(presetScales); i++) {
+            if (glm::abs(presetScales[i] - renderScale) < .001f) { presetIndex = i; }
+        }
+        if (ImGui::Combo("##renderscalepreset", &presetIndex, scalePresets, IM_ARRAYSIZE(scalePresets))) {
+            renderer.setRenderScale(presetScales[presetIndex]);
+        }
+        if (ImGui::SliderFloat("##renderscale", &renderScale, Renderer::MIN_RENDER_SCALE, 1.f, "%.2f")) {
+            renderer.setRenderScale(renderScale);
+        }
+    }
+    static int upscalerIndex = static_cast<int>(postProcessing->upscaler);
+    static const char *upscalers[] = {"Bilinear", "FSR (EASU + RCAS)"};
+    if (ImGui::Combo("##upscaler", &upscalerIndex, upscalers, IM_ARRAYSIZE(upscalers))) {
+        postProcessing->upscaler = static_cast<CompositionPipeline::Upscaler>(upscalerIndex);
+    }
+    if (postProcessing->upscaler == CompositionPipeline::Upscaler::Fsr) {
+        ImGui::SliderFloat("Sharpness stops", &postProcessing->sharpness, 0.f, 2.f, "%.2f");
+    }
+    const VkExtent2D renderExtent = renderer.getRenderExtent();
+    ImGui::Text("%.0f%%, %ux%u", renderer.getRenderScale() * 100.f, renderExtent.width, renderExtent.height);
+    if (gpuTimer.isSupported()) {
+        ImGui::Text("Frame GPU %.2f ms, upscale %.2f ms",
+            gpuTimer.getMilliseconds(static_cast<uint32_t>(GpuScope::Frame)),
+            renderer.isUpscaling() ? gpuTimer.getMilliseconds(static_cast<uint32_t>(GpuScope::Upscale)) : 0.f);
+    }
+    if (renderer.isUpscaling()) {
+        const auto &graphStats = renderer.getUpscaleGraphStats();
+        ImGui::Text("Upscale targets %.1f MB, %u/%u passes culled",
+            static_cast<float>(graphStats.transientBytes) / (1024.f * 1024.f), graphStats.culledPasses, graphStats.passes);
     }
     
     ImGui::NewLine();
@@ -689,17 +1142,66 @@ void Application::renderImguiContent() {
     ImGui::SliderFloat("##gamma", &postProcessing->gamma, 1.f, 3.f);
     
     ImGui::NewLine();
-    float color[4] = {ubo.lightColor.r, ubo.lightColor.g, ubo.lightColor.b, ubo.lightColor.a};
-    ImGui::ColorEdit3("Light Color", color);
-    ImGui::SliderFloat("##strength", &color[3], 1.f, 100.f);
-    ubo.lightColor = {color[0], color[1], color[2], color[3]};
-    
-    glm::vec4 lightPos = ubo.lightPosition[0];
-    ImGui::SliderFloat("LPosX", &lightPos.x, -3.f, 3.f);
-    ImGui::SliderFloat("LPosY", &lightPos.y, -.5f, -5.f);
-    ImGui::SliderFloat("LPosZ", &lightPos.z, -4.f, 4.f);
-    ubo.lightPosition[0] = lightPos;
-    ubo.lightPosition[1].z = - lightPos.z;
+    auto &mainLight = lightClusters.lights[0];
+    ImGui::ColorEdit3("Light Color", &mainLight.color.r);
+    ImGui::SliderFloat("##strength", &mainLight.intensity, 1.f, 100.f);
+    
+    ImGui::SliderFloat("LPosX", &mainLight.position.x, -3.f, 3.f);
+    ImGui::SliderFloat("LPosY", &mainLight.position.y, -.5f, -5.f);
+    ImGui::SliderFloat("LPosZ", &mainLight.position.z, -4.f, 4.f);
+    lightClusters.lights[1] = mainLight;
+    lightClusters.lights[1].position.z = - mainLight.position.z;
+    
+    ImGui::NewLine();
+    ImGui::Checkbox("Sun shadows", &useShadows);
+    ImGui::SameLine();
+    ImGui::Checkbox("Cache static casters", &shadowCascades->cacheStatic);
+    ImGui::ColorEdit3("Sun Color", &sunColor.r);
+    ImGui::SliderFloat("##sunstrength", &sunIntensity, 0.f, 10.f);
+    ImGui::SliderAngle("Sun elevation", &sunAngles.x, 5.f, 90.f);
+    ImGui::SliderAngle("Sun azimuth", &sunAngles.y, -180.f, 180.f);
+    ImGui::SliderFloat("Shadow distance", &shadowCascades->maxDistance, 5.f, 100.f);
+    auto &shadowStats = shadowCascades->getStats();
+    ImGui::Text("Cascades redrawn %u, copied %u, draws %u static %u dynamic", shadowStats.redrawnCascades, shadowStats.copiedCascades, shadowStats.staticDraws, shadowStats.dynamicDraws);
+    if (gpuTimer.isSupported()) {
+        ImGui::Text("Shadows GPU %.2f ms", gpuTimer.getMilliseconds(static_cast<uint32_t>(GpuScope::Shadows)));
+    }
+    
+    if (ImGui::SliderInt("Extra lights", &extraLightCount, 0, LightClusters::MAX_LIGHTS - 2)) {
+        spawnLights(extraLightCount);
+    }
+    auto &lightStats = lightClusters.getStats();
+    ImGui::Text("Lights visible %u / %u, binning %.2f ms", lightStats.visibleLights, lightStats.lights, lightStats.milliseconds);
+    ImGui::Text("Cluster indices %u, max per cluster %u, dropped %u", lightStats.indices, lightStats.maxPerCluster, lightStats.dropped);
 
     ImGui::End();
 }
+
+// Scatters count small point and spot lights through the scene bounds after the two main lights
+// The generator restarts from the same seed, so raising the count keeps the lights already placed
+void Application::spawnLights(uint32_t count) {
+    auto &lights = lightClusters.lights;
+    lights.resize(2);
+    Aabb bounds{};
+    for (Entity entity : scene.view<ColliderComponent>().getEntities()) {
+        bounds.grow(scene.get<ColliderComponent>(entity).collider->getBounds());
+    }
+    if (bounds.isEmpty()) { return; }
+    
+    std::mt19937 generator{1234};
+    std::uniform_real_distribution<float> unit{0.f, 1.f};
+    for (uint32_t i = 0; i < count; i++) {
+        LightClusters::Light light{};
+        light.position = bounds.min + (bounds.max - bounds.min) * glm::vec3(unit(generator), unit(generator), unit(generator));
+        light.range = .5f + 1.5f * unit(generator);
+        glm::vec3 color{unit(generator), unit(generator), unit(generator)};
+        light.color = color / std::max(std::max(color.r, color.g), std::max(color.b, 1e-3f));
+        light.intensity = 1.f + 4.f * unit(generator);
+        // Every fourth one is a spot pointing at the floor, up is -y
+        if (i % 4 == 3) {
+            light.type = LightClusters::LightType::Spot;
+            light.direction = {.0f, 1.f, .0f};
+        }
+        lights.push_back(light);
+    }
+}
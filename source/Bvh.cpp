@@ -0,0 +1,268 @@
+//
+//  Bvh.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/Bvh.hpp"
+
+//std
+#include <functional>
+
+float Aabb::surfaceArea() const {
+    if (isEmpty()) { return 0.f; }
+    glm::vec3 extent = max - min;
+    return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+Aabb Aabb::transformed(const glm::mat4 &matrix) const {
+    // Arvo's method, each output axis takes the min/max product per input axis
+    Aabb result{};
+    result.min = result.max = glm::vec3(matrix[3]);
+    for (int column = 0; column < 3; column++) {
+        glm::vec3 a = glm::vec3(matrix[column]) * min[column];
+        glm::vec3 b = glm::vec3(matrix[column]) * max[column];
+        result.min += glm::min(a, b);
+        result.max += glm::max(a, b);
+    }
+    return result;
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4 &clip) {
+    // Gribb-Hartmann on the rows of the clip matrix, near is row 2 alone for 0..1 depth
+    auto row = [&](int i) { return glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]); };
+    Frustum frustum{};
+    frustum.planes[0] = row(3) + row(0);
+    frustum.planes[1] = row(3) - row(0);
+    frustum.planes[2] = row(3) + row(1);
+    frustum.planes[3] = row(3) - row(1);
+    frustum.planes[4] = row(2);
+    frustum.planes[5] = row(3) - row(2);
+    for (auto &plane : frustum.planes) { plane /= glm::length(glm::vec3(plane)); }
+    return frustum;
+}
+
+bool Frustum::intersects(const Aabb &box) const {
+    for (const auto &plane : planes) {
+        glm::vec3 corner{plane.x > 0.f ? box.max.x : box.min.x, plane.y > 0.f ? box.max.y : box.min.y, plane.z > 0.f ? box.max.z : box.min.z};
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.f) { return false; }
+    }
+    return true;
+}
+
+void Bvh::build(const std::vector<Aabb> &primitiveBounds) {
+    nodes.clear();
+    parents.clear();
+    primitiveIndices.resize(primitiveBounds.size());
+    primitiveNodes.assign(primitiveBounds.size(), INVALID);
+    if (primitiveBounds.empty()) { return; }
+
+    std::vector<glm::vec3> centroids(primitiveBounds.size());
+    for (uint32_t i = 0; i < primitiveBounds.size(); i++) {
+        primitiveIndices[i] = i;
+        centroids[i] = primitiveBounds[i].center();
+    }
+
+    std::vector<BuildNode> buildNodes{};
+    buildNodes.reserve(2 * primitiveBounds.size() / MAX_LEAF_SIZE + 1);
+    uint32_t root = buildRecursive(buildNodes, primitiveBounds, centroids, 0, static_cast<uint32_t>(primitiveBounds.size()), 0);
+
+    // A single leaf root still needs an inner node so traversal always starts from nodes[0]
+    nodes.reserve(buildNodes.size() / 2 + 1);
+    if (buildNodes[root].count > 0) {
+        BuildNode wrapper{buildNodes[root].bounds, root, INVALID, 0, 0};
+        buildNodes.push_back(wrapper);
+        root = static_cast<uint32_t>(buildNodes.size()) - 1;
+    }
+    collapse(buildNodes, root, INVALID);
+    dirtyNodes.assign(nodes.size(), 0);
+}
+
+uint32_t Bvh::buildRecursive(
+    std::vector<BuildNode> &buildNodes,
+    const std::vector<Aabb> &bounds,
+    const std::vector<glm::vec3> &centroids,
+    uint32_t first,
+    uint32_t count,
+    uint32_t depth) {
+    BuildNode node{{}, INVALID, INVALID, first, count};
+    Aabb centroidBounds{};
+    for (uint32_t i = first; i < first + count; i++) {
+        node.bounds.grow(bounds[primitiveIndices[i]]);
+        centroidBounds.grow(centroids[primitiveIndices[i]]);
+    }
+
+    uint32_t nodeIndex = static_cast<uint32_t>(buildNodes.size());
+    buildNodes.push_back(node);
+    // Degenerate splits can chain one primitive per level, the depth cap keeps traversal within its stack
+    if (count <= 1 || depth >= MAX_DEPTH) { return nodeIndex; }
+
+    // Binned SAH over the three axes, costs are scaled by the parent area which cancels out
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    glm::vec3 centroidExtent = centroidBounds.max - centroidBounds.min;
+    for (int axis = 0; axis < 3; axis++) {
+        if (centroidExtent[axis] <= 0.f) { continue; }
+        const float binScale = SAH_BINS / centroidExtent[axis];
+
+        Aabb binBounds[SAH_BINS];
+        uint32_t binCounts[SAH_BINS] = {};
+        for (uint32_t i = first; i < first + count; i++) {
+            uint32_t primitive = primitiveIndices[i];
+            uint32_t bin = std::min(SAH_BINS - 1, static_cast<uint32_t>((centroids[primitive][axis] - centroidBounds.min[axis]) * binScale));
+            binCounts[bin]++;
+            binBounds[bin].grow(bounds[primitive]);
+        }
+
+        float rightAreas[SAH_BINS];
+        uint32_t rightCounts[SAH_BINS];
+        Aabb accumulated{};
+        uint32_t accumulatedCount = 0;
+        for (uint32_t bin = SAH_BINS - 1; bin > 0; bin--) {
+            accumulated.grow(binBounds[bin]);
+            accumulatedCount += binCounts[bin];
+            rightAreas[bin] = accumulated.surfaceArea();
+            rightCounts[bin] = accumulatedCount;
+        }
+
+        accumulated = Aabb{};
+        accumulatedCount = 0;
+        for (uint32_t split = 1; split < SAH_BINS; split++) {
+            accumulated.grow(binBounds[split - 1]);
+            accumulatedCount += binCounts[split - 1];
+            if (accumulatedCount == 0 || rightCounts[split] == 0) { continue; }
+            float cost = accumulated.surfaceArea() * accumulatedCount + rightAreas[split] * rightCounts[split];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    bestCost += node.bounds.surfaceArea() * TRAVERSAL_COST;
+    float leafCost = node.bounds.surfaceArea() * count;
+    if (count <= MAX_LEAF_SIZE && (bestAxis < 0 || bestCost >= leafCost)) { return nodeIndex; }
+
+    uint32_t middle;
+    if (bestAxis >= 0) {
+        const float binScale = SAH_BINS / centroidExtent[bestAxis];
+        auto split = std::partition(primitiveIndices.begin() + first, primitiveIndices.begin() + first + count, [&](uint32_t primitive) {
+            uint32_t bin = std::min(SAH_BINS - 1, static_cast<uint32_t>((centroids[primitive][bestAxis] - centroidBounds.min[bestAxis]) * binScale));
+            return bin < bestSplit;
+        });
+        middle = static_cast<uint32_t>(split - primitiveIndices.begin());
+    } else {
+        // Every centroid coincides, any split is as good as another
+        middle = first + count / 2;
+    }
+
+    uint32_t left = buildRecursive(buildNodes, bounds, centroids, first, middle - first, depth + 1);
+    uint32_t right = buildRecursive(buildNodes, bounds, centroids, middle, first + count - middle, depth + 1);
+    buildNodes[nodeIndex].left = left;
+    buildNodes[nodeIndex].right = right;
+    buildNodes[nodeIndex].count = 0;
+    return nodeIndex;
+}
+
+uint32_t Bvh::collapse(const std::vector<BuildNode> &buildNodes, uint32_t buildIndex, uint32_t parent) {
+    // Open the largest inner child until four lanes are filled
+    uint32_t children[WIDTH] = {buildNodes[buildIndex].left, buildNodes[buildIndex].right, INVALID, INVALID};
+    uint32_t childCount = children[1] == INVALID ? 1 : 2;
+    while (childCount < WIDTH) {
+        int largest = -1;
+        float largestArea = -1.f;
+        for (uint32_t i = 0; i < childCount; i++) {
+            const BuildNode &child = buildNodes[children[i]];
+            if (child.count == 0 && child.bounds.surfaceArea() > largestArea) {
+                largest = static_cast<int>(i);
+                largestArea = child.bounds.surfaceArea();
+            }
+        }
+        if (largest < 0) { break; }
+        const BuildNode &opened = buildNodes[children[largest]];
+        children[largest] = opened.left;
+        children[childCount++] = opened.right;
+    }
+
+    uint32_t nodeIndex = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    parents.push_back(parent);
+    for (uint32_t lane = 0; lane < WIDTH; lane++) {
+        nodes[nodeIndex].child[lane] = INVALID;
+        nodes[nodeIndex].count[lane] = 0;
+        setLane(nodes[nodeIndex], lane, Aabb{});
+    }
+
+    for (uint32_t lane = 0; lane < childCount; lane++) {
+        const BuildNode &child = buildNodes[children[lane]];
+        setLane(nodes[nodeIndex], lane, child.bounds);
+        if (child.count > 0) {
+            nodes[nodeIndex].child[lane] = child.first;
+            nodes[nodeIndex].count[lane] = child.count;
+            for (uint32_t i = child.first; i < child.first + child.count; i++) { primitiveNodes[primitiveIndices[i]] = nodeIndex; }
+        } else {
+            // Children are appended after their parent, refit relies on it
+            uint32_t childNode = collapse(buildNodes, children[lane], nodeIndex);
+            nodes[nodeIndex].child[lane] = childNode;
+        }
+    }
+    return nodeIndex;
+}
+
+void Bvh::setLane(Node &node, uint32_t lane, const Aabb &bounds) {
+    node.minX[lane] = bounds.min.x;
+    node.minY[lane] = bounds.min.y;
+    node.minZ[lane] = bounds.min.z;
+    node.maxX[lane] = bounds.max.x;
+    node.maxY[lane] = bounds.max.y;
+    node.maxZ[lane] = bounds.max.z;
+}
+
+Aabb Bvh::getBounds() const {
+    Aabb bounds{};
+    if (nodes.empty()) { return bounds; }
+    for (uint32_t lane = 0; lane < WIDTH; lane++) {
+        if (nodes[0].child[lane] == INVALID) { continue; }
+        bounds.grow(Aabb{{nodes[0].minX[lane], nodes[0].minY[lane], nodes[0].minZ[lane]}, {nodes[0].maxX[lane], nodes[0].maxY[lane], nodes[0].maxZ[lane]}});
+    }
+    return bounds;
+}
+
+void Bvh::refit(const std::vector<Aabb> &primitiveBounds, const std::vector<uint32_t> &changedPrimitives) {
+    if (nodes.empty() || changedPrimitives.empty()) { return; }
+
+    // Flag the leaves and their ancestors, children have higher indices so a descending pass sees them first
+    std::vector<uint32_t> dirtyList{};
+    for (uint32_t primitive : changedPrimitives) {
+        for (uint32_t node = primitiveNodes[primitive]; node != INVALID && !dirtyNodes[node]; node = parents[node]) {
+            dirtyNodes[node] = 1;
+            dirtyList.push_back(node);
+        }
+    }
+    std::sort(dirtyList.begin(), dirtyList.end(), std::greater<uint32_t>());
+    for (uint32_t node : dirtyList) {
+        refitNode(node, primitiveBounds);
+        dirtyNodes[node] = 0;
+    }
+}
+
+void Bvh::refitNode(uint32_t nodeIndex, const std::vector<Aabb> &primitiveBounds) {
+    Node &node = nodes[nodeIndex];
+    for (uint32_t lane = 0; lane < WIDTH; lane++) {
+        if (node.child[lane] == INVALID) { continue; }
+        Aabb bounds{};
+        if (node.count[lane] > 0) {
+            for (uint32_t i = node.child[lane]; i < node.child[lane] + node.count[lane]; i++) { bounds.grow(primitiveBounds[primitiveIndices[i]]); }
+        } else {
+            const Node &child = nodes[node.child[lane]];
+            for (uint32_t childLane = 0; childLane < WIDTH; childLane++) {
+                if (child.child[childLane] == INVALID) { continue; }
+                bounds.grow(Aabb{{child.minX[childLane], child.minY[childLane], child.minZ[childLane]}, {child.maxX[childLane], child.maxY[childLane], child.maxZ[childLane]}});
+            }
+        }
+        setLane(node, lane, bounds);
+    }
+}
@@ -8,8 +8,10 @@
 #include "include/CompositionPipeline.hpp"
 
 //std
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
 #include <stdexcept>
 
 struct PushConstantData {
@@ -18,17 +20,35 @@ struct PushConstantData {
     float gamma{};
 };
 
+struct UpscalePushConstantData {
+    glm::vec2 uvScale{};
+    glm::vec2 uvMax{};
+};
+
+struct EasuPushConstantData {
+    glm::vec4 scaleOffset{};
+    glm::ivec2 inputMax{};
+};
+
+struct RcasPushConstantData {
+    float sharpness{};
+};
+
+// The upscale pipelines share one layout
+constexpr uint32_t UPSCALE_PUSH_CONSTANT_SIZE = static_cast<uint32_t>(std::max({
+    sizeof(UpscalePushConstantData), sizeof(EasuPushConstantData), sizeof(RcasPushConstantData)}));
+
 CompositionPipeline::CompositionPipeline(
     Device& passDevice,
-    VkRenderPass renderPass,
     VkDescriptorSetLayout compositionSetLayout,
     std::string dynamicShaderPath) : device{passDevice}, shaderPath{dynamicShaderPath} {
   createPipelineLayout(compositionSetLayout);
-  createPipeline(renderPass);
+  createQuad();
 }
 
 CompositionPipeline::~CompositionPipeline() {
   vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+  vkDestroyPipelineLayout(device.device(), upscalePipelineLayout, nullptr);
 }
 
 void CompositionPipeline::createPipelineLayout(VkDescriptorSetLayout compositionSetLayout) {
@@ -51,22 +71,34 @@ void CompositionPipeline::createPipelineLayout(VkDescriptorSetLayout composition
     }
 }
 
-void CompositionPipeline::createPipeline(VkRenderPass renderPass) {
+uint32_t CompositionPipeline::createPipeline(VkRenderPass renderPass, uint32_t subpass) {
+    pipelines.push_back(buildPipeline(renderPass, subpass));
+    return static_cast<uint32_t>(pipelines.size() - 1);
+}
+
+void CompositionPipeline::recreatePipeline(uint32_t index, VkRenderPass renderPass, uint32_t subpass) {
+    pipelines[index] = buildPipeline(renderPass, subpass);
+}
+
+std::unique_ptr<Pipeline> CompositionPipeline::buildPipeline(VkRenderPass renderPass, uint32_t subpass) {
     assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
     PipelineConfigInfo pipelineConfig{};
     Pipeline::defaultPipelineConfigInfo(pipelineConfig);
     pipelineConfig.renderPass = renderPass;
+    pipelineConfig.subpass = subpass;
     pipelineConfig.pipelineLayout = pipelineLayout;
     pipelineConfig.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
     pipelineConfig.multisampleInfo.sampleShadingEnable = VK_TRUE;
     pipelineConfig.multisampleInfo.minSampleShading = .2f;
-    pipeline = std::make_unique<Pipeline>(
+    return std::make_unique<Pipeline>(
       device,
       shaderPath+".vert.spv",
       shaderPath+".frag.spv",
       pipelineConfig);
-      
+}
+
+void CompositionPipeline::createQuad() {
     Model::Data data;
     data.vertices = {
         {{-1.f, -1.f, .0f}, {}, {}, {}, {0.f, 0.f}},
@@ -81,8 +113,8 @@ void CompositionPipeline::createPipeline(VkRenderPass renderPass) {
     quad = std::make_unique<Model>(device, data);
 }
 
-void CompositionPipeline::renderSceneToSwapChain(VkCommandBuffer commandBuffer, VkDescriptorSet &descriptorSets) {
-    pipeline->bind(commandBuffer);
+void CompositionPipeline::renderSceneToSwapChain(VkCommandBuffer commandBuffer, VkDescriptorSet &descriptorSets, uint32_t pipelineIndex) {
+    pipelines[pipelineIndex]->bind(commandBuffer);
               
     vkCmdBindDescriptorSets(
         commandBuffer,
@@ -111,3 +143,88 @@ void CompositionPipeline::renderSceneToSwapChain(VkCommandBuffer commandBuffer,
     quad->bind(commandBuffer);
     quad->draw(commandBuffer);
 }
+
+void CompositionPipeline::createUpscalePipeline(VkRenderPass renderPass, VkDescriptorSetLayout upscaleSetLayout, const std::string &upscaleShader) {
+    VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_FRAGMENT_BIT, 0, UPSCALE_PUSH_CONSTANT_SIZE};
+    
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &upscaleSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &upscalePipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+    
+    upscaleShaderPath = upscaleShader;
+    upscalePipeline = buildUpscalePipeline(renderPass, upscaleShaderPath+".frag.spv");
+}
+
+std::unique_ptr<Pipeline> CompositionPipeline::buildUpscalePipeline(VkRenderPass renderPass, const std::string &fragmentShaderPath) {
+    PipelineConfigInfo pipelineConfig{};
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.pipelineLayout = upscalePipelineLayout;
+    return std::make_unique<Pipeline>(
+      device,
+      shaderPath+".vert.spv",
+      fragmentShaderPath,
+      pipelineConfig);
+}
+
+void CompositionPipeline::upscale(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, VkExtent2D renderExtent, VkExtent2D frameExtent) {
+    upscalePipeline->bind(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    
+    UpscalePushConstantData push{};
+    push.uvScale = glm::vec2(renderExtent.width, renderExtent.height) / glm::vec2(frameExtent.width, frameExtent.height);
+    push.uvMax = (glm::vec2(renderExtent.width, renderExtent.height) - .5f) / glm::vec2(frameExtent.width, frameExtent.height);
+    vkCmdPushConstants(commandBuffer, upscalePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UpscalePushConstantData), &push);
+    
+    quad->bind(commandBuffer);
+    quad->draw(commandBuffer);
+}
+
+void CompositionPipeline::createFsrPipelines(VkRenderPass easuRenderPass, VkRenderPass sharpenRenderPass, const std::string &shaderDirectory) {
+    assert(upscalePipelineLayout != VK_NULL_HANDLE && "Upscale pipeline layout must be created before the FSR pipelines");
+    
+    fsrShaderDirectory = shaderDirectory;
+    easuPipeline = buildUpscalePipeline(easuRenderPass, fsrShaderDirectory+"easu.frag.spv");
+    rcasPipeline = buildUpscalePipeline(sharpenRenderPass, fsrShaderDirectory+"rcas.frag.spv");
+}
+
+void CompositionPipeline::recreateUpscalePipelines(VkRenderPass upscaleRenderPass, VkRenderPass easuRenderPass) {
+    assert(upscalePipeline && easuPipeline && "Upscale and FSR pipelines must be created before they are recreated");
+    
+    upscalePipeline = buildUpscalePipeline(upscaleRenderPass, upscaleShaderPath+".frag.spv");
+    easuPipeline = buildUpscalePipeline(easuRenderPass, fsrShaderDirectory+"easu.frag.spv");
+    rcasPipeline = buildUpscalePipeline(upscaleRenderPass, fsrShaderDirectory+"rcas.frag.spv");
+}
+
+void CompositionPipeline::easu(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, VkExtent2D renderExtent, VkExtent2D frameExtent) {
+    easuPipeline->bind(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    
+    // Output pixel centers mapped to input pixel positions, the output covers the whole frame
+    EasuPushConstantData push{};
+    glm::vec2 scale = glm::vec2(renderExtent.width, renderExtent.height) / glm::vec2(frameExtent.width, frameExtent.height);
+    push.scaleOffset = glm::vec4(scale, .5f * scale - .5f);
+    push.inputMax = glm::ivec2(renderExtent.width, renderExtent.height) - 1;
+    vkCmdPushConstants(commandBuffer, upscalePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(EasuPushConstantData), &push);
+    
+    quad->bind(commandBuffer);
+    quad->draw(commandBuffer);
+}
+
+void CompositionPipeline::sharpen(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet) {
+    rcasPipeline->bind(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    
+    RcasPushConstantData push{};
+    push.sharpness = std::exp2(-std::max(sharpness, 0.f));
+    vkCmdPushConstants(commandBuffer, upscalePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(RcasPushConstantData), &push);
+    
+    quad->bind(commandBuffer);
+    quad->draw(commandBuffer);
+}
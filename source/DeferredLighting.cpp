@@ -0,0 +1,82 @@
+//
+//  DeferredLighting.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/DeferredLighting.hpp"
+
+//std
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+DeferredLighting::DeferredLighting(
+    Device &passDevice,
+    VkRenderPass renderPass,
+    VkDescriptorSetLayout globalSetLayout,
+    VkDescriptorSetLayout gbufferSetLayout,
+    std::string dynamicShaderPath) : device{passDevice}, shaderPath{dynamicShaderPath} {
+    createPipelineLayout(globalSetLayout, gbufferSetLayout);
+    createPipeline(renderPass);
+}
+
+DeferredLighting::~DeferredLighting() {
+    vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+}
+
+void DeferredLighting::createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout gbufferSetLayout) {
+    std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts{globalSetLayout, gbufferSetLayout};
+    
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+}
+
+void DeferredLighting::createPipeline(VkRenderPass renderPass) {
+    assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+    
+    PipelineConfigInfo pipelineConfig{};
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.subpass = SUBPASS;
+    pipelineConfig.pipelineLayout = pipelineLayout;
+    
+    // The triangle is generated from gl_VertexIndex, depth is only read through the input attachment
+    pipelineConfig.bindingDescriptions.clear();
+    pipelineConfig.attributeDescriptions.clear();
+    pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+    pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+    pipelineConfig.colorBlendAttachment.blendEnable = VK_FALSE;
+    
+    pipeline = std::make_unique<Pipeline>(
+        device,
+        shaderPath+".vert.spv",
+        shaderPath+".frag.spv",
+        pipelineConfig);
+}
+
+void DeferredLighting::render(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet, VkDescriptorSet gbufferDescriptorSet) {
+    pipeline->bind(commandBuffer);
+    
+    std::array<VkDescriptorSet, 2> descriptorSets{globalDescriptorSet, gbufferDescriptorSet};
+    vkCmdBindDescriptorSets(
+        commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        pipelineLayout,
+        0,
+        static_cast<uint32_t>(descriptorSets.size()),
+        descriptorSets.data(),
+        0,
+        nullptr
+    );
+    
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
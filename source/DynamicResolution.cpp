@@ -0,0 +1,24 @@
+//
+//  DynamicResolution.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/DynamicResolution.hpp"
+
+//std
+#include <algorithm>
+#include <cmath>
+
+float DynamicResolution::update(float gpuMilliseconds) {
+    // No timestamps yet
+    if (gpuMilliseconds <= 0.f) { return scale; }
+
+    float ideal = scale * std::sqrt(budgetMilliseconds * HEADROOM / gpuMilliseconds);
+    ideal = std::clamp(ideal, minScale, maxScale);
+    if (std::abs(ideal - scale) > DEAD_BAND * scale) {
+        scale = std::clamp(scale + (ideal - scale) * RESPONSE, minScale, maxScale);
+    }
+    return scale;
+}
@@ -0,0 +1,53 @@
+//
+//  EntityRegistry.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/EntityRegistry.hpp"
+
+Entity EntityRegistry::create() {
+    Entity entity{};
+    if (!freeIndices.empty()) {
+        entity.index = freeIndices.back();
+        freeIndices.pop_back();
+    } else {
+        entity.index = static_cast<uint32_t>(generations.size());
+        generations.push_back(0);
+    }
+    entity.generation = generations[entity.index];
+    aliveCount++;
+    return entity;
+}
+
+void EntityRegistry::destroy(Entity entity) {
+    if (!isAlive(entity)) { return; }
+
+    if (transformHandles.has(entity.index)) { transforms.destroy(getTransform(entity)); }
+    transformHandles.remove(entity.index);
+    renderComponents.remove(entity.index);
+    materialComponents.remove(entity.index);
+    colliderComponents.remove(entity.index);
+    occluderComponents.remove(entity.index);
+    pvsComponents.remove(entity.index);
+    physicsComponents.remove(entity.index);
+
+    // Bumping the generation invalidates every copy of the handle
+    generations[entity.index]++;
+    freeIndices.push_back(entity.index);
+    aliveCount--;
+}
+
+TransformSystem::Handle EntityRegistry::addTransform(Entity entity, glm::vec3 translation, glm::vec3 rotation, glm::vec3 scale, Entity parent) {
+    checkAlive(entity);
+    TransformSystem::Handle parentHandle = TransformSystem::NO_PARENT;
+    if (parent.index != UINT32_MAX) {
+        checkAlive(parent);
+        parentHandle = getTransform(parent);
+    }
+
+    TransformSystem::Handle handle = transforms.create(translation, rotation, scale, parentHandle);
+    transformHandles.add(entity, {handle});
+    return handle;
+}
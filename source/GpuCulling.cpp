@@ -0,0 +1,582 @@
+//
+//  GpuCulling.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/GpuCulling.hpp"
+#include "include/Bvh.hpp"
+#include "include/RenderSystem.hpp"
+
+//std
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+// std430 layout of CullRecord in cull.comp
+struct CullRecord {
+    glm::vec4 boundsMin{};
+    glm::vec4 boundsMax{};
+    glm::vec4 sphere{};         // center, radius
+    glm::vec4 cone{};           // axis, cutoff
+    uint32_t firstIndex{};
+    uint32_t indexCount{};
+    int32_t vertexOffset{};
+    uint32_t objectIndex{};
+    uint32_t batchIndex{};
+    uint32_t commandOffset{};
+    uint32_t pvsBit{};          // NO_PVS_BIT when the cluster has no baked visibility
+    uint32_t lod{};
+};
+
+// std430 layout of CullObject in cull.comp
+struct CullObject {
+    glm::vec4 sphere{};         // Model space bounding sphere of the whole model, as RenderSystem picks levels with
+    glm::vec4 lodErrors{};      // Model space error of each level
+    uint32_t lodCount{};
+    uint32_t firstRecord{};     // Record keeping the picked level for the next frame
+    uint32_t pvsFirst{};        // Base level cluster bits, a coarser level is visible when any of them is set
+    uint32_t pvsCount{};
+};
+
+// std140 layout of CullingUbo in cull.comp
+struct CullingUbo {
+    glm::mat4 pyramidProjectionView{1.f};
+    glm::vec4 frustumPlanes[6]{};
+    glm::vec4 pyramidSize{};    // width, height, levels
+    glm::vec4 cameraPosition{};
+    glm::uvec4 params{};        // record count, occlusion test enabled, cone test enabled, triangle counter slot
+    glm::uvec4 pvs{};           // PVS test enabled, rejected record counter slot
+    glm::vec4 lod{};            // pixels per unit of projected radius at unit distance, pixel error, hysteresis
+    glm::uvec4 lodState{};      // read offset, write offset, first per level object counter slot
+};
+
+struct ReducePush {
+    glm::ivec2 destinationSize;
+    glm::ivec2 sourceSize;      // Part of the source covered, level 0 only has the render extent rendered
+    int sampleCount;
+};
+
+constexpr uint32_t CULL_GROUP_SIZE = 64;
+constexpr uint32_t NO_PVS_BIT = UINT32_MAX;
+// Clusters of the PVS never outnumber the records drawing them
+constexpr uint32_t MAX_PVS_BYTES = GpuCulling::MAX_RECORDS / 8;
+constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+// Objects own an instance slot each
+constexpr uint32_t MAX_OBJECTS = RenderSystem::MAX_INSTANCES;
+static_assert(Model::MAX_LODS <= 4, "CullObject keeps the level errors in a vec4");
+
+uint32_t previousPowerOfTwo(uint32_t value) {
+    uint32_t result = 1;
+    while (result * 2 <= value) { result *= 2; }
+    return result;
+}
+
+}
+
+GpuCulling::GpuCulling(Device &dev, Renderer &passRenderer, const std::string &shaderDir, const std::vector<VkDescriptorBufferInfo> &instanceBufferInfos) : device{dev}, renderer{passRenderer} {
+    createBuffers(instanceBufferInfos);
+    createPipelines(shaderDir);
+    createDepthPyramid();
+    writeDescriptorSets();
+}
+
+GpuCulling::~GpuCulling() {
+    destroyDepthPyramid();
+    vkDestroyPipelineLayout(device.device(), cullPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(device.device(), reducePipelineLayout, nullptr);
+}
+
+void GpuCulling::createBuffers(const std::vector<VkDescriptorBufferInfo> &instanceBufferInfos) {
+    if (instanceBufferInfos.size() < SwapChain::MAX_FRAMES_IN_FLIGHT) {
+        throw std::runtime_error("GPU culling needs one instance buffer per frame in flight!");
+    }
+    instanceInfos = instanceBufferInfos;
+
+    recordBuffer = std::make_unique<Buffer>(
+        device,
+        sizeof(CullRecord),
+        MAX_RECORDS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    recordBuffer->map();
+
+    objectBuffer = std::make_unique<Buffer>(
+        device,
+        sizeof(CullObject),
+        MAX_OBJECTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    objectBuffer->map();
+
+    // Two halves, each cull reads the levels the previous one wrote, host visible so a build can reset them
+    lodStateBuffer = std::make_unique<Buffer>(
+        device,
+        sizeof(uint32_t),
+        2 * MAX_OBJECTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    lodStateBuffer->map();
+    std::memset(lodStateBuffer->getMappedMemory(), 0, lodStateBuffer->getBufferSize());
+
+    for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+        commandBuffers[i] = std::make_unique<Buffer>(
+            device,
+            sizeof(VkDrawIndexedIndirectCommand),
+            MAX_RECORDS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        // Host visible so the draw counts can be read back once the frame slot comes around again
+        countBuffers[i] = std::make_unique<Buffer>(
+            device,
+            sizeof(uint32_t),
+            MAX_RECORDS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        countBuffers[i]->map();
+        std::memset(countBuffers[i]->getMappedMemory(), 0, countBuffers[i]->getBufferSize());
+
+        uboBuffers[i] = std::make_unique<Buffer>(
+            device,
+            sizeof(CullingUbo),
+            1,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        uboBuffers[i]->map();
+
+        pvsBuffers[i] = std::make_unique<Buffer>(
+            device,
+            sizeof(uint32_t),
+            MAX_PVS_BYTES / sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        pvsBuffers[i]->map();
+    }
+}
+
+void GpuCulling::createPipelines(const std::string &shaderDir) {
+    descriptorPool =
+        DescriptorPool::Builder(device)
+            .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT + MAX_PYRAMID_LEVELS)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7 * SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT + MAX_PYRAMID_LEVELS)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_PYRAMID_LEVELS)
+            .build();
+
+    cullSetLayout =
+        DescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)          // Instances
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)          // Records
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)          // Draw commands
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)          // Draw counts
+            .addBinding(4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)  // Depth pyramid
+            .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)          // PVS cluster bits
+            .addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)          // Objects
+            .addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)          // Picked levels
+            .build();
+
+    reduceSetLayout =
+        DescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+
+    VkDescriptorSetLayout cullLayout = cullSetLayout->getDescriptorSetLayout();
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullLayout;
+    if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    VkDescriptorSetLayout reduceLayout = reduceSetLayout->getDescriptorSetLayout();
+    VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReducePush)};
+    pipelineLayoutInfo.pSetLayouts = &reduceLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &reducePipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    cullPipeline = std::make_unique<ComputePipeline>(device, shaderDir + "cull.comp.spv", cullPipelineLayout);
+    reducePipeline = std::make_unique<ComputePipeline>(device, shaderDir + "depth_reduce.comp.spv", reducePipelineLayout);
+    resolvePipeline = std::make_unique<ComputePipeline>(device, shaderDir + "depth_resolve.comp.spv", reducePipelineLayout);
+}
+
+void GpuCulling::createDepthPyramid() {
+    // Power of two levels so every texel past level 0 reduces exactly a 2x2 footprint
+    VkExtent2D extent = renderer.getOffscreenExtent();
+    pyramid.width = previousPowerOfTwo(extent.width);
+    pyramid.height = previousPowerOfTwo(extent.height);
+    pyramid.levels = 1;
+    while ((std::max(pyramid.width, pyramid.height) >> pyramid.levels) > 0 && pyramid.levels < MAX_PYRAMID_LEVELS) { pyramid.levels++; }
+    pyramid.offscreenGeneration = renderer.getOffscreenGeneration();
+    pyramid.valid = false;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = pyramid.width;
+    imageInfo.extent.height = pyramid.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = pyramid.levels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+
+    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pyramid.image, pyramid.mem);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = pyramid.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = pyramid.levels;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &pyramid.view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid view!");
+    }
+
+    viewInfo.subresourceRange.levelCount = 1;
+    for (uint32_t level = 0; level < pyramid.levels; level++) {
+        viewInfo.subresourceRange.baseMipLevel = level;
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &pyramid.levelViews[level]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid view!");
+        }
+    }
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = samplerInfo.addressModeU;
+    samplerInfo.addressModeW = samplerInfo.addressModeU;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(pyramid.levels);
+
+    if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &pyramid.sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid sampler!");
+    }
+
+    // The pyramid lives in GENERAL, written as storage and sampled by the next levels and the cull pass
+    VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = pyramid.image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.levels, 0, 1};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    device.endSingleTimeCommands(commandBuffer);
+}
+
+void GpuCulling::destroyDepthPyramid() {
+    if (pyramid.image == VK_NULL_HANDLE) { return; }
+    vkDestroySampler(device.device(), pyramid.sampler, nullptr);
+    for (uint32_t level = 0; level < pyramid.levels; level++) {
+        vkDestroyImageView(device.device(), pyramid.levelViews[level], nullptr);
+    }
+    vkDestroyImageView(device.device(), pyramid.view, nullptr);
+    vkDestroyImage(device.device(), pyramid.image, nullptr);
+    vkFreeMemory(device.device(), pyramid.mem, nullptr);
+    pyramid.image = VK_NULL_HANDLE;
+}
+
+void GpuCulling::writeDescriptorSets() {
+    descriptorPool->resetPool();
+
+    VkDescriptorImageInfo pyramidInfo{pyramid.sampler, pyramid.view, VK_IMAGE_LAYOUT_GENERAL};
+    auto recordInfo = recordBuffer->descriptorInfo();
+    auto objectInfo = objectBuffer->descriptorInfo();
+    auto lodStateInfo = lodStateBuffer->descriptorInfo();
+    for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+        auto commandInfo = commandBuffers[i]->descriptorInfo();
+        auto countInfo = countBuffers[i]->descriptorInfo();
+        auto uboInfo = uboBuffers[i]->descriptorInfo();
+        auto pvsInfo = pvsBuffers[i]->descriptorInfo();
+        DescriptorWriter(*cullSetLayout, *descriptorPool)
+            .writeBuffer(0, &instanceInfos[i])
+            .writeBuffer(1, &recordInfo)
+            .writeBuffer(2, &commandInfo)
+            .writeBuffer(3, &countInfo)
+            .writeBuffer(4, &uboInfo)
+            .writeImage(5, &pyramidInfo)
+            .writeBuffer(6, &pvsInfo)
+            .writeBuffer(7, &objectInfo)
+            .writeBuffer(8, &lodStateInfo)
+            .build(cullDescriptorSets[i]);
+    }
+
+    // Level 0 reads the offscreen depth, every other level the one above it
+    for (uint32_t level = 0; level < pyramid.levels; level++) {
+        VkDescriptorImageInfo sourceInfo = level == 0
+            ? VkDescriptorImageInfo{pyramid.sampler, renderer.getOffscreenDepthView(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL}
+            : VkDescriptorImageInfo{pyramid.sampler, pyramid.levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorImageInfo destinationInfo{VK_NULL_HANDLE, pyramid.levelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+        DescriptorWriter(*reduceSetLayout, *descriptorPool)
+            .writeImage(0, &sourceInfo)
+            .writeImage(1, &destinationInfo)
+            .build(reduceDescriptorSets[level]);
+    }
+}
+
+void GpuCulling::build(EntityRegistry &scene, const PotentiallyVisibleSet *visibility) {
+    objects.clear();
+    batches.clear();
+    pvs = visibility && visibility->isLoaded() && visibility->getClusterCount() <= MAX_PVS_BYTES * 8 ? visibility : nullptr;
+    pvsRecordCount = 0;
+
+    // First pass sizes the batches, command ranges follow in batch order
+    std::map<std::pair<Model *, int>, uint32_t> batchIndices{};
+    std::vector<uint32_t> objectBatches{};
+    for (Entity entity : scene.view<RenderComponent>().getEntities()) {
+        if (!scene.isRenderable(entity)) { continue; }
+        Model *model = scene.get<RenderComponent>(entity).model.get();
+        int textureIndex = scene.get<MaterialComponent>(entity).textureIndex;
+        if (model->getCullClusters().empty()) {
+            throw std::runtime_error("GPU culling needs indexed models!");
+        }
+
+        // An object only ever draws one of its levels
+        size_t levelClusters = 0;
+        for (uint32_t lod = 0; lod < model->getLodCount(); lod++) { levelClusters = std::max(levelClusters, model->getCullClusters(lod).size()); }
+        auto inserted = batchIndices.emplace(std::make_pair(model, textureIndex), static_cast<uint32_t>(batches.size()));
+        if (inserted.second) { batches.push_back({model, textureIndex, 0, 0}); }
+        batches[inserted.first->second].maxDraws += static_cast<uint32_t>(levelClusters);
+        objectBatches.push_back(inserted.first->second);
+        objects.push_back(entity);
+    }
+    if (objects.size() > MAX_OBJECTS) {
+        throw std::runtime_error("too many objects for the GPU culling buffers!");
+    }
+
+    totalDraws = 0;
+    recordTriangles = 0;
+    for (auto &batch : batches) {
+        batch.commandOffset = totalDraws;
+        totalDraws += batch.maxDraws;
+    }
+    if (totalDraws > MAX_RECORDS) {
+        throw std::runtime_error("too many cull clusters for the GPU culling buffers!");
+    }
+
+    // Records of a batch are filled in order, the shader compacts them at its command range
+    std::vector<CullRecord> records{};
+    std::vector<CullObject> objectData(objects.size());
+    records.reserve(totalDraws);
+    for (uint32_t object = 0; object < objects.size(); object++) {
+        const Batch &batch = batches[objectBatches[object]];
+        const Model &model = *batch.model;
+        const auto &clusters = model.getCullClusters();
+
+        CullObject &data = objectData[object];
+        data.sphere = glm::vec4(model.getBoundsMin() + .5f * model.getBoundsExtent(), .5f * glm::length(model.getBoundsExtent()));
+        data.lodCount = model.getLodCount();
+        for (uint32_t lod = 0; lod < model.getLodCount(); lod++) { data.lodErrors[lod] = model.getLod(lod).error; }
+        data.firstRecord = static_cast<uint32_t>(records.size());
+
+        // Baked for the same clusters, the bake prepares meshes like the loader does
+        uint32_t pvsBit = NO_PVS_BIT;
+        if (pvs && scene.has<PvsComponent>(objects[object])) {
+            uint32_t pvsObject = scene.get<PvsComponent>(objects[object]).object;
+            if (pvsObject < pvs->getObjectCount() &&
+                pvs->getClusterOffset(pvsObject + 1) - pvs->getClusterOffset(pvsObject) == clusters.size()) {
+                pvsBit = pvs->getClusterOffset(pvsObject);
+                data.pvsFirst = pvsBit;
+                data.pvsCount = static_cast<uint32_t>(clusters.size());
+                pvsRecordCount += static_cast<uint32_t>(clusters.size());
+            }
+        }
+
+        for (uint32_t lod = 0; lod < model.getLodCount(); lod++) {
+            for (const auto &cluster : model.getCullClusters(lod)) {
+                CullRecord record{};
+                record.boundsMin = glm::vec4(cluster.boundsMin, 0.f);
+                record.boundsMax = glm::vec4(cluster.boundsMax, 0.f);
+                record.sphere = glm::vec4(cluster.center, cluster.radius);
+                record.cone = glm::vec4(cluster.coneAxis, cluster.coneCutoff);
+                record.firstIndex = cluster.firstIndex;
+                record.indexCount = cluster.indexCount;
+                record.vertexOffset = cluster.vertexOffset;
+                record.objectIndex = object;
+                record.batchIndex = objectBatches[object];
+                record.commandOffset = batch.commandOffset;
+                record.pvsBit = lod == 0 ? pvsBit : NO_PVS_BIT;
+                record.lod = lod;
+                if (lod == 0 && pvsBit != NO_PVS_BIT) { pvsBit++; }
+                records.push_back(record);
+                // Triangles of the full detail scene, before levels and culling
+                if (lod == 0) { recordTriangles += cluster.indexCount / 3; }
+            }
+        }
+    }
+    if (records.size() > MAX_RECORDS) {
+        throw std::runtime_error("too many cull clusters for the GPU culling buffers!");
+    }
+    recordCount = static_cast<uint32_t>(records.size());
+    if (recordCount > 0) {
+        recordBuffer->writeToBuffer(records.data(), records.size() * sizeof(CullRecord));
+        objectBuffer->writeToBuffer(objectData.data(), objectData.size() * sizeof(CullObject));
+    }
+
+    // Object indices changed meaning, every object starts again from the base level
+    std::memset(lodStateBuffer->getMappedMemory(), 0, lodStateBuffer->getBufferSize());
+    lodStateHalf = 0;
+}
+
+void GpuCulling::cull(VkCommandBuffer commandBuffer, int frameIndex, const glm::mat4 &projectionView, const glm::vec3 &cameraPosition, const uint8_t *pvsCell) {
+    // The offscreen pass was recreated: frames in flight still reference the old pyramid
+    if (pyramid.offscreenGeneration != renderer.getOffscreenGeneration()) {
+        vkDeviceWaitIdle(device.device());
+        destroyDepthPyramid();
+        createDepthPyramid();
+        writeDescriptorSets();
+    }
+
+    // The frame fence has been waited on, this slot's counts are final
+    const uint32_t *counts = static_cast<const uint32_t *>(countBuffers[frameIndex]->getMappedMemory());
+    lastDrawnCount = 0;
+    for (size_t i = 0; i < batches.size(); i++) { lastDrawnCount += counts[i]; }
+    lastDrawnTriangles = counts[batches.size()];
+    lastPvsCulled = counts[batches.size() + 1];
+    for (uint32_t lod = 0; lod < Model::MAX_LODS; lod++) { lastLodCounts[lod] = counts[batches.size() + 2 + lod]; }
+
+    const bool pvsTest = pvs && pvsCell && pvsRecordCount > 0;
+    if (pvsTest) { pvsBuffers[frameIndex]->writeToBuffer(const_cast<uint8_t *>(pvs->getClusterBits(pvsCell)), pvs->getClusterByteCount()); }
+
+    CullingUbo ubo{};
+    Frustum frustum = Frustum::fromMatrix(projectionView);
+    std::copy(std::begin(frustum.planes), std::end(frustum.planes), ubo.frustumPlanes);
+    ubo.pyramidProjectionView = pyramid.projectionView;
+    ubo.pyramidSize = glm::vec4(pyramid.width, pyramid.height, pyramid.levels, 0.f);
+    ubo.cameraPosition = glm::vec4(cameraPosition, 1.f);
+    ubo.params = glm::uvec4(recordCount, occlusionEnabled && pyramid.valid ? 1 : 0, coneCullingEnabled ? 1 : 0, static_cast<uint32_t>(batches.size()));
+    ubo.pvs = glm::uvec4(pvsTest ? 1 : 0, static_cast<uint32_t>(batches.size()) + 1, 0, 0);
+    // Same thresholds and hysteresis as the CPU path, so switching paths keeps the picked levels
+    ubo.lod = glm::vec4(lodProjectionScale * .5f * lodViewportHeight, lodPixelError, RenderSystem::LOD_HYSTERESIS, 0.f);
+    ubo.lodState = glm::uvec4((1 - lodStateHalf) * MAX_OBJECTS, lodStateHalf * MAX_OBJECTS, static_cast<uint32_t>(batches.size()) + 2, 0);
+    uboBuffers[frameIndex]->writeToBuffer(&ubo);
+
+    if (recordCount == 0) { return; }
+    lodStateHalf = 1 - lodStateHalf;
+
+    // One count per batch, then the drawn triangle total, the PVS rejected records and the objects per level
+    vkCmdFillBuffer(commandBuffer, countBuffers[frameIndex]->getBuffer(), 0, (batches.size() + 2 + Model::MAX_LODS) * sizeof(uint32_t), 0);
+    if (!device.cmdDrawIndexedIndirectCount) {
+        // Every command slot gets drawn, the unwritten ones must stay empty
+        vkCmdFillBuffer(commandBuffer, commandBuffers[frameIndex]->getBuffer(), 0, totalDraws * sizeof(VkDrawIndexedIndirectCommand), 0);
+    }
+
+    // Covers the fills and the previous depth pyramid build
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    cullPipeline->bind(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSets[frameIndex], 0, nullptr);
+    vkCmdDispatch(commandBuffer, (recordCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCulling::buildDepthPyramid(VkCommandBuffer commandBuffer, const glm::mat4 &projectionView) {
+    // This frame's cull pass read the pyramid that is about to be overwritten
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkImageMemoryBarrier levelBarrier{};
+    levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    levelBarrier.image = pyramid.image;
+    levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    // Dynamic resolution leaves the scene in the top left of the depth target, the pyramid only covers that part
+    const VkExtent2D renderExtent = renderer.getRenderExtent();
+    for (uint32_t level = 0; level < pyramid.levels; level++) {
+        ReducePush push{};
+        push.destinationSize = glm::ivec2(std::max(pyramid.width >> level, 1u), std::max(pyramid.height >> level, 1u));
+        push.sourceSize = level == 0
+            ? glm::ivec2(renderExtent.width, renderExtent.height)
+            : glm::ivec2(std::max(pyramid.width >> (level - 1), 1u), std::max(pyramid.height >> (level - 1), 1u));
+        push.sampleCount = static_cast<int>(device.msaaSamples);
+
+        bool resolve = level == 0 && device.msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+        (resolve ? resolvePipeline : reducePipeline)->bind(commandBuffer);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipelineLayout, 0, 1, &reduceDescriptorSets[level], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, reducePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReducePush), &push);
+        vkCmdDispatch(
+            commandBuffer,
+            (push.destinationSize.x + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+            (push.destinationSize.y + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+            1);
+
+        levelBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+    }
+
+    pyramid.projectionView = projectionView;
+    pyramid.valid = true;
+}
+
+void GpuCulling::drawBatch(VkCommandBuffer commandBuffer, int frameIndex, uint32_t batchIndex) {
+    const Batch &batch = batches[batchIndex];
+    VkDeviceSize offset = batch.commandOffset * sizeof(VkDrawIndexedIndirectCommand);
+    if (device.cmdDrawIndexedIndirectCount) {
+        device.cmdDrawIndexedIndirectCount(
+            commandBuffer,
+            commandBuffers[frameIndex]->getBuffer(),
+            offset,
+            countBuffers[frameIndex]->getBuffer(),
+            batchIndex * sizeof(uint32_t),
+            batch.maxDraws,
+            sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+        vkCmdDrawIndexedIndirect(commandBuffer, commandBuffers[frameIndex]->getBuffer(), offset, batch.maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
@@ -0,0 +1,63 @@
+//
+//  GpuTimer.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/GpuTimer.hpp"
+
+//std
+#include <stdexcept>
+
+namespace {
+    // Weight of the newest sample in the running average
+    constexpr float SMOOTHING = .1f;
+}
+
+GpuTimer::GpuTimer(Device &device) : device{device} {
+    if (!device.properties.limits.timestampComputeAndGraphics) { return; }
+    nanosecondsPerTick = device.properties.limits.timestampPeriod;
+    
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = SwapChain::MAX_FRAMES_IN_FLIGHT * MAX_SCOPES * 2;
+    if (vkCreateQueryPool(device.device(), &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+}
+
+GpuTimer::~GpuTimer() {
+    vkDestroyQueryPool(device.device(), queryPool, nullptr);
+}
+
+void GpuTimer::beginFrame(VkCommandBuffer commandBuffer, int frameIndex) {
+    if (!isSupported()) { return; }
+    
+    for (uint32_t scope = 0; scope < MAX_SCOPES; scope++) {
+        if (!(writtenScopes[frameIndex] & (1u << scope))) { continue; }
+        
+        // Still pending when the slot's fence wasn't waited on yet, that sample is skipped
+        uint64_t timestamps[2];
+        if (vkGetQueryPoolResults(device.device(), queryPool, queryIndex(frameIndex, scope), 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            continue;
+        }
+        float sample = static_cast<float>(timestamps[1] - timestamps[0]) * nanosecondsPerTick * 1e-6f;
+        milliseconds[scope] = milliseconds[scope] == 0.f ? sample : milliseconds[scope] + SMOOTHING * (sample - milliseconds[scope]);
+    }
+    
+    vkCmdResetQueryPool(commandBuffer, queryPool, queryIndex(frameIndex, 0), MAX_SCOPES * 2);
+    writtenScopes[frameIndex] = 0;
+}
+
+void GpuTimer::begin(VkCommandBuffer commandBuffer, int frameIndex, uint32_t scope) {
+    if (!isSupported()) { return; }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, queryIndex(frameIndex, scope));
+}
+
+void GpuTimer::end(VkCommandBuffer commandBuffer, int frameIndex, uint32_t scope) {
+    if (!isSupported()) { return; }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, queryIndex(frameIndex, scope) + 1);
+    writtenScopes[frameIndex] |= 1u << scope;
+}
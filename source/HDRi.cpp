@@ -175,7 +175,7 @@ void HDRi::renderFaces() {
                 nullptr
             );
             
-            cubeEnvironment.at(cube.getId()).model->bind(commandBuffer);
+            cubeEnvironment.at(cube.getId()).model->bindPositionsOnly(commandBuffer);
             cubeEnvironment.at(cube.getId()).model->draw(commandBuffer);
             
             endRenderPass();
@@ -369,6 +369,8 @@ void HDRi::createPipeline() {
   pipelineConfig.pipelineLayout = pipelineLayout;
   pipelineConfig.colorBlendAttachment.blendEnable = VK_FALSE;
   pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  pipelineConfig.bindingDescriptions = Model::getPositionBindingDescriptions();
+  pipelineConfig.attributeDescriptions = Model::getPositionAttributeDescriptions();
   pipeline = std::make_unique<Pipeline>(
       device,
       binaryPath+"cubemap.vert.spv",
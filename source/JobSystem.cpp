@@ -0,0 +1,98 @@
+//
+//  JobSystem.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/JobSystem.hpp"
+
+JobSystem::JobSystem(uint32_t threadCount) {
+    threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (auto &thread : threads) { thread.join(); }
+}
+
+void JobSystem::dispatch(uint32_t count, const Job &job) {
+    if (count == 0) { return; }
+
+    // Nothing to fork, skip the wake-up round trip
+    if (threads.empty() || count == 1) {
+        for (uint32_t i = 0; i < count; i++) { job(i, getWorkerCount() - 1); }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentJob = &job;
+        jobCount = count;
+        nextJob = 0;
+        finishedJobs = 0;
+        error = nullptr;
+        // Every worker checks in once per batch, so none can linger into the next one
+        activeWorkers = static_cast<uint32_t>(threads.size());
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    runJobs(getWorkerCount() - 1);
+
+    std::exception_ptr jobError;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this]() { return finishedJobs == jobCount && activeWorkers == 0; });
+        currentJob = nullptr;
+        jobError = error;
+    }
+    if (jobError) { std::rethrow_exception(jobError); }
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex) {
+    uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+            if (stopping) { return; }
+            seenGeneration = generation;
+        }
+
+        runJobs(workerIndex);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeWorkers--;
+        }
+        doneCondition.notify_all();
+    }
+}
+
+void JobSystem::runJobs(uint32_t workerIndex) {
+    uint32_t done = 0;
+    for (uint32_t job = nextJob.fetch_add(1); job < jobCount; job = nextJob.fetch_add(1)) {
+        try {
+            (*currentJob)(job, workerIndex);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) { error = std::current_exception(); }
+        }
+        done++;
+    }
+    if (done == 0) { return; }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finishedJobs += done;
+    }
+    doneCondition.notify_all();
+}
@@ -0,0 +1,278 @@
+//
+//  LightClusters.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/LightClusters.hpp"
+
+//libs
+#include <glm/gtc/constants.hpp>
+
+//std
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// std430 layout of Light in shader.frag
+struct GpuLight {
+    glm::vec4 positionRange{};
+    glm::vec4 colorIntensity{};
+    glm::vec4 directionType{};
+    glm::vec4 cone{};           // cos inner, cos outer
+};
+
+constexpr uint32_t TILE_COUNT = LightClusters::GRID_X * LightClusters::GRID_Y;
+
+glm::vec3 unproject(const glm::mat4 &inverseProjection, float x, float y, float z) {
+    glm::vec4 point = inverseProjection * glm::vec4{x, y, z, 1.f};
+    return glm::vec3(point) / point.w;
+}
+
+// NDC depth of a view space depth, both projections keep z and w independent of x and y
+float projectDepth(const glm::mat4 &projection, float z) {
+    return (projection[2][2] * z + projection[3][2]) / (projection[2][3] * z + projection[3][3]);
+}
+
+}
+
+LightClusters::LightClusters(Device &dev) : device{dev} {
+    for (int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+        lightBuffers[i] = std::make_unique<Buffer>(
+            device,
+            sizeof(GpuLight),
+            MAX_LIGHTS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        lightBuffers[i]->map();
+
+        // Offset and count of every cluster
+        clusterBuffers[i] = std::make_unique<Buffer>(
+            device,
+            2 * sizeof(uint32_t),
+            CLUSTER_COUNT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        clusterBuffers[i]->map();
+
+        indexBuffers[i] = std::make_unique<Buffer>(
+            device,
+            sizeof(uint32_t),
+            INDICES_PER_SLICE * GRID_Z,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        indexBuffers[i]->map();
+    }
+
+    boxMinX.resize(CLUSTER_COUNT);
+    boxMinY.resize(CLUSTER_COUNT);
+    boxMinZ.resize(CLUSTER_COUNT);
+    boxMaxX.resize(CLUSTER_COUNT);
+    boxMaxY.resize(CLUSTER_COUNT);
+    boxMaxZ.resize(CLUSTER_COUNT);
+    slicePairs.resize(GRID_Z);
+    sliceUsed.resize(GRID_Z);
+    sliceDropped.resize(GRID_Z);
+    sliceMaxPerCluster.resize(GRID_Z);
+}
+
+void LightClusters::buildGrid(const glm::mat4 &projection) {
+    gridProjection = projection;
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    near = unproject(inverseProjection, 0.f, 0.f, 0.f).z;
+    far = unproject(inverseProjection, 0.f, 0.f, 1.f).z;
+
+    // Orthographic near planes may sit behind the camera, the logarithm needs a positive start
+    sliceNear = near > 0.f ? near : far * 1e-3f;
+    const float logRatio = std::log(far / sliceNear);
+    clusterScale.z = GRID_Z / logRatio;
+    clusterScale.w = -(GRID_Z * std::log(sliceNear)) / logRatio;
+
+    for (uint32_t z = 0; z <= GRID_Z; z++) {
+        sliceDepths[z] = z == 0 ? near : sliceNear * std::pow(far / sliceNear, static_cast<float>(z) / GRID_Z);
+    }
+
+    for (uint32_t z = 0; z < GRID_Z; z++) {
+        float depths[2] = {projectDepth(projection, sliceDepths[z]), projectDepth(projection, sliceDepths[z + 1])};
+        for (uint32_t y = 0; y < GRID_Y; y++) {
+            for (uint32_t x = 0; x < GRID_X; x++) {
+                glm::vec3 boxMin{std::numeric_limits<float>::max()};
+                glm::vec3 boxMax{-std::numeric_limits<float>::max()};
+                for (uint32_t corner = 0; corner < 8; corner++) {
+                    float ndcX = -1.f + 2.f * (x + (corner & 1)) / GRID_X;
+                    float ndcY = -1.f + 2.f * (y + ((corner >> 1) & 1)) / GRID_Y;
+                    glm::vec3 point = unproject(inverseProjection, ndcX, ndcY, depths[corner >> 2]);
+                    boxMin = glm::min(boxMin, point);
+                    boxMax = glm::max(boxMax, point);
+                }
+                uint32_t cluster = x + GRID_X * (y + GRID_Y * z);
+                boxMinX[cluster] = boxMin.x;
+                boxMinY[cluster] = boxMin.y;
+                boxMinZ[cluster] = boxMin.z;
+                boxMaxX[cluster] = boxMax.x;
+                boxMaxY[cluster] = boxMax.y;
+                boxMaxZ[cluster] = boxMax.z;
+            }
+        }
+    }
+}
+
+bool LightClusters::computeBounds(const Light &light, const glm::mat4 &view, Bounds &bounds) const {
+    glm::vec3 center = light.position;
+    float radius = light.range;
+    if (light.type == LightType::Spot) {
+        // Tightest sphere around the cone, wide cones are bounded by their cap
+        glm::vec3 direction = glm::normalize(light.direction);
+        float cosAngle = glm::clamp(light.outerCone, 1e-3f, 1.f);
+        if (cosAngle < glm::one_over_root_two<float>()) {
+            center += direction * (light.range * cosAngle);
+            radius = light.range * std::sqrt(1.f - cosAngle * cosAngle);
+        } else {
+            radius = light.range / (2.f * cosAngle);
+            center += direction * radius;
+        }
+    }
+    bounds.center = glm::vec3(view * glm::vec4(center, 1.f));
+    bounds.radius = radius;
+    if (bounds.center.z + radius < near || bounds.center.z - radius > far) { return false; }
+
+    auto sliceOf = [this](float z) {
+        if (z <= sliceNear) { return 0u; }
+        return static_cast<uint32_t>(glm::clamp(std::floor(std::log(z) * clusterScale.z + clusterScale.w), 0.f, GRID_Z - 1.f));
+    };
+    // One slice of slack for rounding, binSlice() tests the exact slice depths
+    bounds.minSlice = std::max(sliceOf(bounds.center.z - radius), 1u) - 1;
+    bounds.maxSlice = std::min(sliceOf(bounds.center.z + radius) + 1, GRID_Z - 1);
+
+    uint32_t minTile[2], maxTile[2];
+    return findTiles(bounds.center, radius, bounds.center.z - radius, bounds.center.z + radius, minTile, maxTile);
+}
+
+bool LightClusters::findTiles(const glm::vec3 &center, float halfSize, float z0, float z1, uint32_t minTile[2], uint32_t maxTile[2]) const {
+    // A box reaching behind the eye covers the whole screen
+    glm::vec2 ndcMin{1.f}, ndcMax{-1.f};
+    for (uint32_t corner = 0; corner < 8; corner++) {
+        glm::vec3 point{center.x + (corner & 1 ? halfSize : -halfSize), center.y + (corner & 2 ? halfSize : -halfSize), corner & 4 ? z1 : z0};
+        glm::vec4 clip = gridProjection * glm::vec4(point, 1.f);
+        if (clip.w <= 1e-4f) {
+            ndcMin = glm::vec2(-1.f);
+            ndcMax = glm::vec2(1.f);
+            break;
+        }
+        ndcMin = glm::min(ndcMin, glm::vec2(clip) / clip.w);
+        ndcMax = glm::max(ndcMax, glm::vec2(clip) / clip.w);
+    }
+    if (ndcMin.x > 1.f || ndcMin.y > 1.f || ndcMax.x < -1.f || ndcMax.y < -1.f) { return false; }
+
+    const glm::vec2 grid{GRID_X, GRID_Y};
+    glm::vec2 tileMin = glm::clamp(glm::floor((ndcMin * .5f + .5f) * grid), glm::vec2(0.f), grid - 1.f);
+    glm::vec2 tileMax = glm::clamp(glm::floor((ndcMax * .5f + .5f) * grid), glm::vec2(0.f), grid - 1.f);
+    minTile[0] = static_cast<uint32_t>(tileMin.x);
+    minTile[1] = static_cast<uint32_t>(tileMin.y);
+    maxTile[0] = static_cast<uint32_t>(tileMax.x);
+    maxTile[1] = static_cast<uint32_t>(tileMax.y);
+    return true;
+}
+
+void LightClusters::binSlice(uint32_t slice, uint32_t *clusters, uint32_t *indices) {
+    // (tile << 16 | light) for every overlap, lights come in ascending order
+    auto &pairs = slicePairs[slice];
+    pairs.clear();
+    for (size_t i = 0; i < visibleBounds.size(); i++) {
+        const Bounds &bounds = visibleBounds[i];
+        if (slice < bounds.minSlice || slice > bounds.maxSlice) { continue; }
+        const float radiusSquared = bounds.radius * bounds.radius;
+
+        // Only the widest cross section of the sphere inside the slice can touch its clusters
+        float z0 = std::max(sliceDepths[slice], bounds.center.z - bounds.radius);
+        float z1 = std::min(sliceDepths[slice + 1], bounds.center.z + bounds.radius);
+        float dz = glm::clamp(bounds.center.z, z0, z1) - bounds.center.z;
+        if (z0 > z1 || dz * dz > radiusSquared) { continue; }
+        uint32_t minTile[2], maxTile[2];
+        if (!findTiles(bounds.center, std::sqrt(radiusSquared - dz * dz), z0, z1, minTile, maxTile)) { continue; }
+
+        for (uint32_t y = minTile[1]; y <= maxTile[1]; y++) {
+            const uint32_t row = GRID_X * (y + GRID_Y * slice);
+            for (uint32_t x = minTile[0]; x <= maxTile[0]; x++) {
+                const uint32_t cluster = row + x;
+                float dx = std::max(std::max(boxMinX[cluster] - bounds.center.x, bounds.center.x - boxMaxX[cluster]), 0.f);
+                float dy = std::max(std::max(boxMinY[cluster] - bounds.center.y, bounds.center.y - boxMaxY[cluster]), 0.f);
+                float dz = std::max(std::max(boxMinZ[cluster] - bounds.center.z, bounds.center.z - boxMaxZ[cluster]), 0.f);
+                if (dx * dx + dy * dy + dz * dz <= radiusSquared) {
+                    pairs.push_back((x + GRID_X * y) << 16 | visibleLights[i]);
+                }
+            }
+        }
+    }
+
+    // Counting sort into the slice's own index range, clusters past the budget keep what fits
+    std::array<uint32_t, TILE_COUNT> counts{};
+    for (auto pair : pairs) { counts[pair >> 16]++; }
+    const uint32_t base = slice * INDICES_PER_SLICE;
+    std::array<uint32_t, TILE_COUNT> cursors{};
+    uint32_t used = 0;
+    sliceDropped[slice] = 0;
+    sliceMaxPerCluster[slice] = 0;
+    for (uint32_t tile = 0; tile < TILE_COUNT; tile++) {
+        uint32_t kept = std::min(counts[tile], INDICES_PER_SLICE - used);
+        uint32_t cluster = tile + TILE_COUNT * slice;
+        clusters[cluster * 2] = base + used;
+        clusters[cluster * 2 + 1] = kept;
+        cursors[tile] = base + used;
+        used += kept;
+        sliceDropped[slice] += counts[tile] - kept;
+        sliceMaxPerCluster[slice] = std::max(sliceMaxPerCluster[slice], counts[tile]);
+        counts[tile] = kept;
+    }
+    for (auto pair : pairs) {
+        uint32_t tile = pair >> 16;
+        if (counts[tile] == 0) { continue; }
+        counts[tile]--;
+        indices[cursors[tile]++] = pair & 0xFFFF;
+    }
+    sliceUsed[slice] = used;
+}
+
+void LightClusters::update(int frameIndex, const Camera &camera, VkExtent2D extent, JobSystem &jobSystem) {
+    auto start = std::chrono::high_resolution_clock::now();
+    if (camera.getProjection() != gridProjection) { buildGrid(camera.getProjection()); }
+    clusterScale.x = static_cast<float>(GRID_X) / extent.width;
+    clusterScale.y = static_cast<float>(GRID_Y) / extent.height;
+
+    const uint32_t lightCount = std::min(static_cast<uint32_t>(lights.size()), MAX_LIGHTS);
+    GpuLight *gpuLights = static_cast<GpuLight *>(lightBuffers[frameIndex]->getMappedMemory());
+    visibleBounds.clear();
+    visibleLights.clear();
+    for (uint32_t i = 0; i < lightCount; i++) {
+        const Light &light = lights[i];
+        gpuLights[i].positionRange = glm::vec4(light.position, light.range);
+        gpuLights[i].colorIntensity = glm::vec4(light.color, light.intensity);
+        gpuLights[i].directionType = glm::vec4(glm::normalize(light.direction), static_cast<float>(light.type));
+        gpuLights[i].cone = glm::vec4(light.innerCone, light.outerCone, 0.f, 0.f);
+
+        Bounds bounds{};
+        if (computeBounds(light, camera.getView(), bounds)) {
+            visibleBounds.push_back(bounds);
+            visibleLights.push_back(i);
+        }
+    }
+
+    uint32_t *clusters = static_cast<uint32_t *>(clusterBuffers[frameIndex]->getMappedMemory());
+    uint32_t *indices = static_cast<uint32_t *>(indexBuffers[frameIndex]->getMappedMemory());
+    jobSystem.dispatch(GRID_Z, [&](uint32_t slice, uint32_t) { binSlice(slice, clusters, indices); });
+
+    stats = {};
+    stats.lights = lightCount;
+    stats.visibleLights = static_cast<uint32_t>(visibleLights.size());
+    for (uint32_t slice = 0; slice < GRID_Z; slice++) {
+        stats.indices += sliceUsed[slice];
+        stats.dropped += sliceDropped[slice];
+        stats.maxPerCluster = std::max(stats.maxPerCluster, sliceMaxPerCluster[slice]);
+    }
+    stats.milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
@@ -0,0 +1,50 @@
+//
+//  MeshCollider.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/MeshCollider.hpp"
+
+MeshCollider::MeshCollider(const Model::Data &data) : indices{data.indices} {
+    positions.reserve(data.vertices.size());
+    for (const auto &vertex : data.vertices) {
+        positions.push_back(vertex.position);
+        bounds.grow(vertex.position);
+    }
+
+    std::vector<Aabb> triangleBounds(getTriangleCount());
+    for (size_t i = 0; i < triangleBounds.size(); i++) {
+        triangleBounds[i].grow(positions[indices[3 * i + 0]]);
+        triangleBounds[i].grow(positions[indices[3 * i + 1]]);
+        triangleBounds[i].grow(positions[indices[3 * i + 2]]);
+    }
+    bvh.build(triangleBounds);
+}
+
+bool MeshCollider::intersect(const Ray &ray, float &tMax, glm::vec3 &normal) const {
+    return bvh.intersect(ray, tMax, [&](uint32_t triangle, float &closest) {
+        // Moller-Trumbore, both faces count so walls block from either side
+        const glm::vec3 &p0 = positions[indices[3 * triangle + 0]];
+        const glm::vec3 edge1 = positions[indices[3 * triangle + 1]] - p0;
+        const glm::vec3 edge2 = positions[indices[3 * triangle + 2]] - p0;
+        const glm::vec3 p = glm::cross(ray.direction, edge2);
+        const float determinant = glm::dot(edge1, p);
+        if (std::abs(determinant) < 1e-12f) { return false; }
+
+        const float invDeterminant = 1.f / determinant;
+        const glm::vec3 s = ray.origin - p0;
+        const float u = glm::dot(s, p) * invDeterminant;
+        if (u < 0.f || u > 1.f) { return false; }
+        const glm::vec3 q = glm::cross(s, edge1);
+        const float v = glm::dot(ray.direction, q) * invDeterminant;
+        if (v < 0.f || u + v > 1.f) { return false; }
+
+        const float t = glm::dot(edge2, q) * invDeterminant;
+        if (t < 0.f || t >= closest) { return false; }
+        closest = t;
+        normal = glm::cross(edge1, edge2);
+        return true;
+    });
+}
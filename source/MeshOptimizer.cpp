@@ -0,0 +1,294 @@
+//
+//  MeshOptimizer.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/MeshOptimizer.hpp"
+
+//std
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+    // FIFO post-transform cache, a vertex only refreshes its timestamp when it misses
+    class CacheSimulator {
+    public:
+        CacheSimulator(size_t vertexCount, uint32_t size) : cacheTime(vertexCount, 0), cacheSize{size}, timestamp{size + 1} {}
+
+        bool access(uint32_t vertex) {
+            if (timestamp - cacheTime[vertex] > cacheSize) {
+                cacheTime[vertex] = timestamp++;
+                return true;
+            }
+            return false;
+        }
+
+        void flush() { timestamp += cacheSize + 1; }
+
+    private:
+        std::vector<uint32_t> cacheTime;
+        uint32_t cacheSize;
+        uint32_t timestamp;
+    };
+
+    struct VertexBytesHash {
+        size_t operator()(const Model::Vertex &vertex) const {
+            return std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char *>(&vertex), sizeof(Model::Vertex)));
+        }
+    };
+
+    struct VertexBytesEqual {
+        bool operator()(const Model::Vertex &a, const Model::Vertex &b) const {
+            return std::memcmp(&a, &b, sizeof(Model::Vertex)) == 0;
+        }
+    };
+}
+
+MeshOptimizer::Report MeshOptimizer::optimize(Model::Data &data, float overdrawThreshold) {
+    Report report{};
+    report.verticesBefore = data.vertices.size();
+    report.before = analyzeVertexCache(data.indices, data.vertices.size());
+
+    if (data.indices.size() >= 3) {
+        weldVertices(data.vertices, data.indices);
+        auto hardBoundaries = optimizeVertexCache(data.indices, data.vertices.size());
+        auto clusters = splitClusters(data.indices, hardBoundaries, data.vertices.size(), overdrawThreshold);
+        optimizeOverdraw(data.indices, data.vertices, clusters);
+        optimizeVertexFetch(data.vertices, data.indices);
+        report.clusters = clusters.size();
+    }
+
+    report.verticesAfter = data.vertices.size();
+    report.after = analyzeVertexCache(data.indices, data.vertices.size());
+    return report;
+}
+
+void MeshOptimizer::weldVertices(std::vector<Model::Vertex> &vertices, std::vector<uint32_t> &indices) {
+    // Only bit-identical vertices are merged, tangents included, so shading can't change
+    std::unordered_map<Model::Vertex, uint32_t, VertexBytesHash, VertexBytesEqual> uniqueVertices{};
+    uniqueVertices.reserve(vertices.size());
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<Model::Vertex> welded{};
+    welded.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        auto inserted = uniqueVertices.emplace(vertices[i], static_cast<uint32_t>(welded.size()));
+        if (inserted.second) { welded.push_back(vertices[i]); }
+        remap[i] = inserted.first->second;
+    }
+    for (auto &index : indices) { index = remap[index]; }
+    vertices = std::move(welded);
+}
+
+std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount) {
+    // Tipsify (Sander, Nehab, Barczak 2007), returns the triangles where the cache had to restart cold
+    const size_t triangleCount = indices.size() / 3;
+    std::vector<uint32_t> hardBoundaries{0};
+
+    // Vertex -> triangle adjacency
+    std::vector<uint32_t> liveCount(vertexCount, 0);
+    for (auto index : indices) { liveCount[index]++; }
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    std::partial_sum(liveCount.begin(), liveCount.end(), offsets.begin() + 1);
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> cursorOffsets(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[cursorOffsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd{};
+    std::vector<uint32_t> candidates{};
+    std::vector<uint32_t> result{};
+    deadEnd.reserve(indices.size());
+    result.reserve(indices.size());
+
+    uint32_t timestamp = CACHE_SIZE + 1;
+    size_t cursor = 0;
+
+    auto nextLiveVertex = [&]() -> int64_t {
+        for (; cursor < vertexCount; cursor++) {
+            if (liveCount[cursor] > 0) { return static_cast<int64_t>(cursor); }
+        }
+        return -1;
+    };
+
+    int64_t fanning = nextLiveVertex();
+    while (fanning >= 0) {
+        candidates.clear();
+
+        // Emit every remaining triangle around the fanning vertex
+        for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; k++) {
+            uint32_t triangle = adjacency[k];
+            if (emitted[triangle]) { continue; }
+            for (uint32_t c = 0; c < 3; c++) {
+                uint32_t vertex = indices[3 * triangle + c];
+                result.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                liveCount[vertex]--;
+                if (timestamp - cacheTime[vertex] > CACHE_SIZE) { cacheTime[vertex] = timestamp++; }
+            }
+            emitted[triangle] = true;
+        }
+
+        // Prefer the oldest candidate that will still be in cache after fanning around it
+        int64_t next = -1;
+        int64_t bestPriority = -1;
+        for (auto vertex : candidates) {
+            if (liveCount[vertex] == 0) { continue; }
+            int64_t priority = 0;
+            if (timestamp - cacheTime[vertex] + 2 * liveCount[vertex] <= CACHE_SIZE) { priority = timestamp - cacheTime[vertex]; }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+
+        // Dead end, walk back through recent vertices before falling back to a linear scan
+        while (next < 0 && !deadEnd.empty()) {
+            uint32_t vertex = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveCount[vertex] > 0) { next = vertex; }
+        }
+        if (next < 0) {
+            next = nextLiveVertex();
+            if (next >= 0) { hardBoundaries.push_back(static_cast<uint32_t>(result.size() / 3)); }
+        }
+        fanning = next;
+    }
+
+    indices = std::move(result);
+    return hardBoundaries;
+}
+
+std::vector<uint32_t> MeshOptimizer::splitClusters(const std::vector<uint32_t> &indices, const std::vector<uint32_t> &hardBoundaries, size_t vertexCount, float threshold) {
+    // Soft boundaries: cut a cluster as soon as its running ACMR is within threshold of the whole hard cluster
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    std::vector<uint32_t> clusters{};
+    CacheSimulator cache{vertexCount, CACHE_SIZE};
+
+    for (size_t h = 0; h < hardBoundaries.size(); h++) {
+        uint32_t begin = hardBoundaries[h];
+        uint32_t end = h + 1 < hardBoundaries.size() ? hardBoundaries[h + 1] : triangleCount;
+        if (begin >= end) { continue; }
+
+        cache.flush();
+        uint32_t misses = 0;
+        for (uint32_t t = begin; t < end; t++) {
+            for (uint32_t c = 0; c < 3; c++) { misses += cache.access(indices[3 * t + c]); }
+        }
+        float targetAcmr = threshold * static_cast<float>(misses) / static_cast<float>(end - begin);
+
+        cache.flush();
+        clusters.push_back(begin);
+        uint32_t clusterMisses = 0;
+        uint32_t clusterTriangles = 0;
+        for (uint32_t t = begin; t < end; t++) {
+            for (uint32_t c = 0; c < 3; c++) { clusterMisses += cache.access(indices[3 * t + c]); }
+            clusterTriangles++;
+
+            if (t + 1 < end && static_cast<float>(clusterMisses) / clusterTriangles <= targetAcmr) {
+                clusters.push_back(t + 1);
+                cache.flush();
+                clusterMisses = 0;
+                clusterTriangles = 0;
+            }
+        }
+    }
+    return clusters;
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &clusters) {
+    // Clusters facing away from the mesh center are likely occluders, draw them first
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    glm::vec3 meshCentroid{0.f};
+    float meshArea = 0.f;
+    std::vector<glm::vec3> clusterCentroids(clusters.size(), glm::vec3{0.f});
+    std::vector<glm::vec3> clusterNormals(clusters.size(), glm::vec3{0.f});
+
+    for (size_t c = 0; c < clusters.size(); c++) {
+        uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        float clusterArea = 0.f;
+        for (uint32_t t = clusters[c]; t < end; t++) {
+            const glm::vec3 &p0 = vertices[indices[3 * t + 0]].position;
+            const glm::vec3 &p1 = vertices[indices[3 * t + 1]].position;
+            const glm::vec3 &p2 = vertices[indices[3 * t + 2]].position;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+            glm::vec3 centroid = (p0 + p1 + p2) / 3.f;
+
+            clusterCentroids[c] += centroid * area;
+            clusterNormals[c] += normal;
+            clusterArea += area;
+            meshCentroid += centroid * area;
+            meshArea += area;
+        }
+        clusterCentroids[c] = clusterArea > 0.f ? clusterCentroids[c] / clusterArea : clusterCentroids[c];
+        float normalLength = glm::length(clusterNormals[c]);
+        clusterNormals[c] = normalLength > 0.f ? clusterNormals[c] / normalLength : clusterNormals[c];
+    }
+    meshCentroid = meshArea > 0.f ? meshCentroid / meshArea : meshCentroid;
+
+    std::vector<float> sortKeys(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+    }
+    std::vector<uint32_t> order(clusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> result{};
+    result.reserve(indices.size());
+    for (auto c : order) {
+        uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        result.insert(result.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * end);
+    }
+    indices = std::move(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Model::Vertex> &vertices, std::vector<uint32_t> &indices) {
+    // Renumber vertices in first-use order so fetches walk the vertex buffer forward, unused vertices are dropped
+    constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+    std::vector<Model::Vertex> ordered{};
+    ordered.reserve(vertices.size());
+
+    for (auto &index : indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices = std::move(ordered);
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize) {
+    CacheStats stats{};
+    if (indices.empty()) { return stats; }
+
+    CacheSimulator cache{vertexCount, cacheSize};
+    std::vector<bool> referenced(vertexCount, false);
+    size_t referencedCount = 0;
+    size_t misses = 0;
+    for (auto index : indices) {
+        misses += cache.access(index);
+        if (!referenced[index]) {
+            referenced[index] = true;
+            referencedCount++;
+        }
+    }
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(referencedCount);
+    return stats;
+}
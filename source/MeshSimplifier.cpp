@@ -0,0 +1,391 @@
+//
+//  MeshSimplifier.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/MeshSimplifier.hpp"
+#include "include/MeshOptimizer.hpp"
+
+//std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+    constexpr uint32_t NONE = UINT32_MAX;
+    // Border and seam edges resist sliding off their line much more than faces resist bending
+    constexpr double EDGE_WEIGHT = 10.0;
+
+    enum class VertexKind : uint8_t { Manifold, Border, Seam, Locked };
+
+    // Symmetric 4x4 quadric, error() is the area weighted mean squared distance to the accumulated planes
+    struct Quadric {
+        double a00{0.0}, a11{0.0}, a22{0.0}, a10{0.0}, a20{0.0}, a21{0.0};
+        double b0{0.0}, b1{0.0}, b2{0.0}, c{0.0};
+        double weight{0.0};
+
+        static Quadric fromPlane(const glm::dvec3 &n, double d, double weight) {
+            Quadric q{};
+            q.a00 = n.x * n.x * weight;
+            q.a11 = n.y * n.y * weight;
+            q.a22 = n.z * n.z * weight;
+            q.a10 = n.y * n.x * weight;
+            q.a20 = n.z * n.x * weight;
+            q.a21 = n.z * n.y * weight;
+            q.b0 = n.x * d * weight;
+            q.b1 = n.y * d * weight;
+            q.b2 = n.z * d * weight;
+            q.c = d * d * weight;
+            q.weight = weight;
+            return q;
+        }
+
+        Quadric &operator+=(const Quadric &o) {
+            a00 += o.a00; a11 += o.a11; a22 += o.a22; a10 += o.a10; a20 += o.a20; a21 += o.a21;
+            b0 += o.b0; b1 += o.b1; b2 += o.b2; c += o.c;
+            weight += o.weight;
+            return *this;
+        }
+
+        double error(const glm::dvec3 &p) const {
+            double rx = a00 * p.x + a10 * p.y + a20 * p.z;
+            double ry = a10 * p.x + a11 * p.y + a21 * p.z;
+            double rz = a20 * p.x + a21 * p.y + a22 * p.z;
+            double result = rx * p.x + ry * p.y + rz * p.z + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return weight > 0.0 ? std::max(result, 0.0) / weight : 0.0;
+        }
+    };
+
+    // Vertex -> triangle lists over the current index buffer
+    struct Adjacency {
+        std::vector<uint32_t> offsets{};
+        std::vector<uint32_t> triangles{};
+
+        void build(const std::vector<uint32_t> &indices, size_t vertexCount) {
+            offsets.assign(vertexCount + 1, 0);
+            for (auto index : indices) { offsets[index + 1]++; }
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            triangles.resize(indices.size());
+            std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++) { triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3); }
+        }
+
+        // Directed edge a -> b in some triangle's winding
+        bool hasEdge(const std::vector<uint32_t> &indices, uint32_t a, uint32_t b) const {
+            for (uint32_t i = offsets[a]; i < offsets[a + 1]; i++) {
+                const uint32_t *triangle = &indices[3 * triangles[i]];
+                for (int k = 0; k < 3; k++) {
+                    if (triangle[k] == a && triangle[(k + 1) % 3] == b) { return true; }
+                }
+            }
+            return false;
+        }
+    };
+
+    template<size_t Floats>
+    struct FloatKey {
+        float values[Floats];
+        bool operator==(const FloatKey &other) const { return std::memcmp(values, other.values, sizeof(values)) == 0; }
+    };
+
+    struct FloatKeyHash {
+        template<size_t Floats>
+        size_t operator()(const FloatKey<Floats> &key) const {
+            return std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char *>(key.values), sizeof(key.values)));
+        }
+    };
+
+    struct Collapse {
+        uint32_t vertex;
+        uint32_t target;
+        double error;
+    };
+}
+
+std::vector<uint32_t> MeshSimplifier::simplify(
+    const std::vector<Model::Vertex> &vertices,
+    const std::vector<uint32_t> &indices,
+    size_t targetIndexCount,
+    float maxError,
+    float &error) {
+    const size_t vertexCount = vertices.size();
+    error = 0.f;
+
+    // Tangents differ per face after import, wedges are told apart by the attributes that show
+    std::vector<uint32_t> attributeRemap(vertexCount), positionRemap(vertexCount);
+    {
+        std::unordered_map<FloatKey<11>, uint32_t, FloatKeyHash> attributeIds{};
+        std::unordered_map<FloatKey<3>, uint32_t, FloatKeyHash> positionIds{};
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            const auto &vertex = vertices[v];
+            FloatKey<3> position{{vertex.position.x, vertex.position.y, vertex.position.z}};
+            FloatKey<11> attributes{{vertex.position.x, vertex.position.y, vertex.position.z, vertex.color.x, vertex.color.y, vertex.color.z,
+                vertex.normal.x, vertex.normal.y, vertex.normal.z, vertex.uv.x, vertex.uv.y}};
+            attributeRemap[v] = attributeIds.emplace(attributes, v).first->second;
+            positionRemap[v] = positionIds.emplace(position, v).first->second;
+        }
+    }
+
+    // Circular list of the wedges sharing a position
+    std::vector<uint32_t> wedge(vertexCount);
+    std::iota(wedge.begin(), wedge.end(), 0u);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        uint32_t head = positionRemap[v];
+        if (attributeRemap[v] != v || head == v) { continue; }
+        wedge[v] = wedge[head];
+        wedge[head] = v;
+    }
+
+    auto position = [&](uint32_t v) { return glm::dvec3(vertices[v].position); };
+    auto isDegenerate = [&](const uint32_t *triangle) {
+        uint32_t p0 = positionRemap[triangle[0]], p1 = positionRemap[triangle[1]], p2 = positionRemap[triangle[2]];
+        return p0 == p1 || p1 == p2 || p2 == p0;
+    };
+
+    std::vector<uint32_t> result{};
+    result.reserve(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t triangle[3] = {attributeRemap[indices[i]], attributeRemap[indices[i + 1]], attributeRemap[indices[i + 2]]};
+        if (!isDegenerate(triangle)) { result.insert(result.end(), triangle, triangle + 3); }
+    }
+
+    Adjacency adjacency{};
+    adjacency.build(result, vertexCount);
+
+    // Open edges have no twin with the same wedges, a single in and out edge makes a vertex slide along them
+    std::vector<uint32_t> openOut(vertexCount, NONE), openIn(vertexCount, NONE);
+    std::vector<uint32_t> openOutCount(vertexCount, 0), openInCount(vertexCount, 0);
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3) {
+        const uint32_t *triangle = &result[i];
+        glm::dvec3 p0 = position(triangle[0]), p1 = position(triangle[1]), p2 = position(triangle[2]);
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double doubleArea = glm::length(normal);
+        if (doubleArea > 0.0) {
+            normal /= doubleArea;
+            Quadric face = Quadric::fromPlane(normal, -glm::dot(normal, p0), .5 * doubleArea);
+            for (int k = 0; k < 3; k++) { quadrics[positionRemap[triangle[k]]] += face; }
+        }
+
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = triangle[k], b = triangle[(k + 1) % 3];
+            if (adjacency.hasEdge(result, b, a)) { continue; }
+            openOut[a] = b;
+            openOutCount[a]++;
+            openIn[b] = a;
+            openInCount[b]++;
+
+            // Plane through the edge, perpendicular to the face
+            glm::dvec3 edge = position(b) - position(a);
+            double length = glm::length(edge);
+            if (doubleArea <= 0.0 || length <= 0.0) { continue; }
+            glm::dvec3 edgeNormal = glm::normalize(glm::cross(edge, normal));
+            Quadric border = Quadric::fromPlane(edgeNormal, -glm::dot(edgeNormal, position(a)), length * length * EDGE_WEIGHT);
+            quadrics[positionRemap[a]] += border;
+            quadrics[positionRemap[b]] += border;
+        }
+    }
+
+    std::vector<VertexKind> kinds(vertexCount, VertexKind::Locked);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (attributeRemap[v] != v || adjacency.offsets[v] == adjacency.offsets[v + 1]) { continue; }
+        const uint32_t w = wedge[v];
+        if (w == v) {
+            if (openOutCount[v] == 0 && openInCount[v] == 0) {
+                kinds[v] = VertexKind::Manifold;
+            } else if (openOutCount[v] == 1 && openInCount[v] == 1) {
+                // An open edge with a twin on another wedge of the neighbour ends a seam here
+                bool seamEnd = false;
+                for (uint32_t x = wedge[openOut[v]]; x != openOut[v]; x = wedge[x]) { seamEnd |= adjacency.hasEdge(result, x, v); }
+                for (uint32_t x = wedge[openIn[v]]; x != openIn[v]; x = wedge[x]) { seamEnd |= adjacency.hasEdge(result, v, x); }
+                kinds[v] = seamEnd ? VertexKind::Locked : VertexKind::Border;
+            }
+        } else if (wedge[w] == v) {
+            bool simple = openOutCount[v] == 1 && openInCount[v] == 1 && openOutCount[w] == 1 && openInCount[w] == 1;
+            if (simple && positionRemap[openOut[v]] == positionRemap[openIn[w]] && positionRemap[openIn[v]] == positionRemap[openOut[w]]) {
+                kinds[v] = VertexKind::Seam;
+            }
+        }
+    }
+    for (uint32_t v = 0; v < vertexCount; v++) { kinds[v] = kinds[attributeRemap[v]]; }
+
+    // Wedge of the seam's other side that must follow a collapse of v onto t
+    auto seamSibling = [&](uint32_t v, uint32_t t) {
+        uint32_t w = wedge[v];
+        uint32_t sibling = t == openOut[v] ? openIn[w] : openOut[w];
+        return sibling != NONE && positionRemap[sibling] == positionRemap[t] ? sibling : NONE;
+    };
+
+    auto canCollapse = [&](uint32_t v, uint32_t t) {
+        switch (kinds[v]) {
+            case VertexKind::Manifold:
+                return true;
+            case VertexKind::Border:
+                return openOut[v] != openIn[v] && (t == openOut[v] || t == openIn[v]) &&
+                    (kinds[t] == VertexKind::Border || kinds[t] == VertexKind::Locked);
+            case VertexKind::Seam:
+                return openOut[v] != openIn[v] && (t == openOut[v] || t == openIn[v]) &&
+                    (kinds[t] == VertexKind::Seam || kinds[t] == VertexKind::Locked) && seamSibling(v, t) != NONE;
+            default:
+                return false;
+        }
+    };
+
+    // The open chain skips v once it is gone
+    auto relinkOpenEdges = [&](uint32_t v, uint32_t t) {
+        if (t == openOut[v]) {
+            openIn[t] = openIn[v];
+            if (openIn[v] != NONE) { openOut[openIn[v]] = t; }
+        } else if (t == openIn[v]) {
+            openOut[t] = openOut[v];
+            if (openOut[v] != NONE) { openIn[openOut[v]] = t; }
+        }
+    };
+
+    auto flipsTriangle = [&](uint32_t v, uint32_t t) {
+        const uint32_t pv = positionRemap[v], pt = positionRemap[t];
+        const glm::dvec3 moved = position(t);
+        uint32_t x = v;
+        do {
+            for (uint32_t i = adjacency.offsets[x]; i < adjacency.offsets[x + 1]; i++) {
+                const uint32_t *triangle = &result[3 * adjacency.triangles[i]];
+                glm::dvec3 before[3], after[3];
+                bool collapses = false;
+                for (int k = 0; k < 3; k++) {
+                    collapses |= positionRemap[triangle[k]] == pt;
+                    before[k] = position(triangle[k]);
+                    after[k] = positionRemap[triangle[k]] == pv ? moved : before[k];
+                }
+                if (collapses) { continue; }
+                glm::dvec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::dvec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                // Rotating a face by more than about 75 degrees counts as a flip, slivers included
+                if (glm::dot(n0, n1) <= .25 * glm::length(n0) * glm::length(n1)) { return true; }
+            }
+            x = wedge[x];
+        } while (x != v);
+        return false;
+    };
+
+    const size_t targetTriangles = targetIndexCount / 3;
+    const double maxErrorSquared = static_cast<double>(maxError) * maxError;
+    double worstError = 0.0;
+    std::vector<Collapse> collapses{};
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t> locked(vertexCount);
+
+    while (result.size() / 3 > targetTriangles) {
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+                for (auto [v, t] : {std::pair{a, b}, std::pair{b, a}}) {
+                    if (!canCollapse(v, t)) { continue; }
+                    Quadric merged = quadrics[positionRemap[v]];
+                    merged += quadrics[positionRemap[t]];
+                    collapses.push_back({v, t, merged.error(position(t))});
+                }
+            }
+        }
+        if (collapses.empty()) { break; }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+        // Each collapse removes about two triangles, stop a little past the target
+        const size_t collapseGoal = (result.size() / 3 - targetTriangles) / 2 + 1;
+        size_t applied = 0;
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::fill(locked.begin(), locked.end(), 0);
+        for (const auto &collapse : collapses) {
+            if (applied >= collapseGoal || collapse.error > maxErrorSquared) { break; }
+            const uint32_t v = collapse.vertex, t = collapse.target;
+            const uint32_t pv = positionRemap[v], pt = positionRemap[t];
+            // Neighbourhoods touched this pass would make the flip test stale
+            if (locked[pv] || locked[pt] || !canCollapse(v, t) || flipsTriangle(v, t)) { continue; }
+
+            if (kinds[v] == VertexKind::Seam) {
+                uint32_t w = wedge[v], sibling = seamSibling(v, t);
+                remap[w] = sibling;
+                relinkOpenEdges(w, sibling);
+            }
+            remap[v] = t;
+            relinkOpenEdges(v, t);
+            quadrics[pt] += quadrics[pv];
+
+            uint32_t x = v;
+            do {
+                for (uint32_t i = adjacency.offsets[x]; i < adjacency.offsets[x + 1]; i++) {
+                    const uint32_t *triangle = &result[3 * adjacency.triangles[i]];
+                    for (int k = 0; k < 3; k++) { locked[positionRemap[triangle[k]]] = 1; }
+                }
+                x = wedge[x];
+            } while (x != v);
+            locked[pt] = 1;
+
+            worstError = std::max(worstError, collapse.error);
+            applied++;
+        }
+        if (applied == 0) { break; }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t triangle[3] = {remap[result[i]], remap[result[i + 1]], remap[result[i + 2]]};
+            if (isDegenerate(triangle)) { continue; }
+            std::copy(triangle, triangle + 3, result.begin() + kept);
+            kept += 3;
+        }
+        result.resize(kept);
+        adjacency.build(result, vertexCount);
+    }
+
+    error = static_cast<float>(std::sqrt(worstError));
+    return result;
+}
+
+MeshSimplifier::Report MeshSimplifier::generateLods(Model::Data &data, float reduction, float maxRelativeError) {
+    if (!data.submeshes.empty()) {
+        throw std::runtime_error("LODs must be generated before splitting into short index chunks!");
+    }
+
+    Report report{};
+    data.lods.clear();
+    data.lods.push_back({0, static_cast<uint32_t>(data.indices.size()), 0, 0, 0.f});
+    report.triangles[0] = data.indices.size() / 3;
+    if (data.indices.empty()) { return report; }
+
+    glm::vec3 boundsMin{data.vertices[0].position}, boundsMax{data.vertices[0].position};
+    for (const auto &vertex : data.vertices) {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+    const float maxError = maxRelativeError * glm::length(boundsMax - boundsMin);
+
+    std::vector<uint32_t> current = data.indices;
+    float accumulatedError = 0.f;
+    for (uint32_t lod = 1; lod < Model::MAX_LODS; lod++) {
+        // Coarser levels are only picked further away, so they may stray further
+        size_t target = static_cast<size_t>(current.size() / 3 * reduction) * 3;
+        float levelError;
+        auto simplified = simplify(data.vertices, current, target, maxError * static_cast<float>(1u << (lod - 1)), levelError);
+
+        // Not worth an index range of its own
+        if (simplified.empty() || simplified.size() > current.size() * 9 / 10) { break; }
+
+        // Errors are measured against the previous level, their sum bounds the distance to the base one
+        accumulatedError += levelError;
+        MeshOptimizer::optimizeVertexCache(simplified, data.vertices.size());
+        data.lods.push_back({static_cast<uint32_t>(data.indices.size()), static_cast<uint32_t>(simplified.size()), 0, 0, accumulatedError});
+        data.indices.insert(data.indices.end(), simplified.begin(), simplified.end());
+        report.triangles[lod] = simplified.size() / 3;
+        report.errors[lod] = accumulatedError;
+        report.lods = lod + 1;
+        current = std::move(simplified);
+    }
+    return report;
+}
@@ -0,0 +1,200 @@
+//
+//  MeshletBuilder.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/MeshletBuilder.hpp"
+
+//std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+    constexpr uint32_t NONE = UINT32_MAX;
+    // Unemitted triangles searched when nothing touches the meshlet, the optimized order keeps them nearby
+    constexpr uint32_t SEARCH_WINDOW = 256;
+    // Turning the meshlet's facing around weighs as much as half a meshlet of distance
+    constexpr float CONE_WEIGHT = .5f;
+    // Wider cones reject almost nothing, the test is skipped for them
+    constexpr float MIN_CONE_DOT = .1f;
+}
+
+MeshletBuilder::Report MeshletBuilder::build(Model::Data &data, uint32_t maxVertices, uint32_t maxTriangles) {
+    if (!data.submeshes.empty()) {
+        throw std::runtime_error("meshlets must be built before splitting into short index chunks!");
+    }
+    if (maxVertices < 3 || maxTriangles == 0) {
+        throw std::runtime_error("meshlet limits too small!");
+    }
+
+    Report report{};
+    data.meshlets.clear();
+    const uint32_t firstIndex = data.lods.empty() ? 0 : data.lods[0].firstIndex;
+    const uint32_t indexCount = data.lods.empty() ? static_cast<uint32_t>(data.indices.size()) : data.lods[0].indexCount;
+    const uint32_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) { return report; }
+    const uint32_t *indices = data.indices.data() + firstIndex;
+    const size_t vertexCount = data.vertices.size();
+
+    // Winding decides which side the rasterizer keeps, the vertex normals tell which winding faces outwards
+    std::vector<glm::vec3> normals(triangleCount);
+    std::vector<glm::vec3> centroids(triangleCount);
+    float windingAgreement = 0.f;
+    float edgeLength = 0.f;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const auto &v0 = data.vertices[indices[t * 3]];
+        const auto &v1 = data.vertices[indices[t * 3 + 1]];
+        const auto &v2 = data.vertices[indices[t * 3 + 2]];
+        glm::vec3 normal = glm::cross(v1.position - v0.position, v2.position - v0.position);
+        windingAgreement += glm::dot(normal, v0.normal + v1.normal + v2.normal);
+        float length = glm::length(normal);
+        normals[t] = length > 0.f ? normal / length : glm::vec3(0.f);
+        centroids[t] = (v0.position + v1.position + v2.position) / 3.f;
+        edgeLength += glm::length(v1.position - v0.position) + glm::length(v2.position - v1.position) + glm::length(v0.position - v2.position);
+    }
+    if (windingAgreement < 0.f) {
+        for (auto &normal : normals) { normal = -normal; }
+    }
+    // Expected meshlet diameter, brings distances to the scale of the facing term
+    const float meshletSize = std::max(edgeLength / (3.f * triangleCount) * std::sqrt(static_cast<float>(maxTriangles)), 1e-6f);
+
+    // Triangles around each vertex
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    for (uint32_t i = 0; i < triangleCount * 3; i++) { adjacencyOffsets[indices[i] + 1]++; }
+    std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+    std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t i = 0; i < triangleCount * 3; i++) { adjacency[adjacencyFill[indices[i]]++] = i / 3; }
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> slots(vertexCount, NONE);
+    std::vector<uint32_t> meshletVertices{};
+    std::vector<uint32_t> meshletTriangles{};
+    std::vector<uint32_t> reordered{};
+    reordered.reserve(triangleCount * 3);
+    glm::vec3 centroidSum{0.f};
+    glm::vec3 normalSum{0.f};
+
+    auto extraVertices = [&](uint32_t t) {
+        uint32_t extra = 0;
+        for (uint32_t c = 0; c < 3; c++) {
+            uint32_t index = indices[t * 3 + c];
+            bool repeated = (c > 0 && indices[t * 3] == index) || (c > 1 && indices[t * 3 + 1] == index);
+            extra += slots[index] == NONE && !repeated;
+        }
+        return extra;
+    };
+
+    auto cost = [&](uint32_t t) {
+        glm::vec3 center = centroidSum / static_cast<float>(meshletTriangles.size());
+        float facing = glm::length(normalSum) > 0.f ? glm::dot(normals[t], glm::normalize(normalSum)) : 1.f;
+        return glm::length(centroids[t] - center) / meshletSize + CONE_WEIGHT * (1.f - facing);
+    };
+
+    auto closeMeshlet = [&]() {
+        if (meshletTriangles.empty()) { return; }
+        Model::CullCluster meshlet{};
+        meshlet.firstIndex = firstIndex + static_cast<uint32_t>(reordered.size());
+        meshlet.indexCount = static_cast<uint32_t>(meshletTriangles.size()) * 3;
+        meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+        for (auto t : meshletTriangles) { reordered.insert(reordered.end(), indices + t * 3, indices + t * 3 + 3); }
+
+        meshlet.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        meshlet.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        for (auto index : meshletVertices) {
+            meshlet.boundsMin = glm::min(meshlet.boundsMin, data.vertices[index].position);
+            meshlet.boundsMax = glm::max(meshlet.boundsMax, data.vertices[index].position);
+        }
+        meshlet.center = .5f * (meshlet.boundsMin + meshlet.boundsMax);
+        for (auto index : meshletVertices) {
+            meshlet.radius = std::max(meshlet.radius, glm::length(data.vertices[index].position - meshlet.center));
+        }
+
+        // Every normal lies within acos(minDot) of the axis, degenerate triangles face nowhere
+        if (glm::length(normalSum) > 0.f) {
+            glm::vec3 axis = glm::normalize(normalSum);
+            float minDot = 1.f;
+            for (auto t : meshletTriangles) {
+                if (normals[t] != glm::vec3(0.f)) { minDot = std::min(minDot, glm::dot(normals[t], axis)); }
+            }
+            if (minDot > MIN_CONE_DOT) {
+                meshlet.coneAxis = axis;
+                meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+                report.coneCullable++;
+            }
+        }
+        data.meshlets.push_back(meshlet);
+        report.averageVertices += meshletVertices.size();
+        report.averageTriangles += meshletTriangles.size();
+
+        for (auto index : meshletVertices) { slots[index] = NONE; }
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        centroidSum = glm::vec3(0.f);
+        normalSum = glm::vec3(0.f);
+    };
+
+    uint32_t scan = 0;
+    for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        // Fewest new vertices first, then the closest and best aligned
+        uint32_t best = NONE;
+        uint32_t bestExtra = 4;
+        float bestCost = std::numeric_limits<float>::max();
+        auto consider = [&](uint32_t t) {
+            uint32_t extra = extraVertices(t);
+            if (extra > bestExtra) { return; }
+            float candidateCost = cost(t);
+            if (extra < bestExtra || candidateCost < bestCost) {
+                best = t;
+                bestExtra = extra;
+                bestCost = candidateCost;
+            }
+        };
+
+        for (auto index : meshletVertices) {
+            for (uint32_t a = adjacencyOffsets[index]; a < adjacencyOffsets[index + 1]; a++) {
+                if (!emitted[adjacency[a]]) { consider(adjacency[a]); }
+            }
+        }
+
+        // Nothing connected is left, take the closest of the next triangles in optimized order
+        if (best == NONE) {
+            while (emitted[scan]) { scan++; }
+            if (meshletTriangles.empty()) {
+                best = scan;
+            } else {
+                for (uint32_t t = scan, checked = 0; t < triangleCount && checked < SEARCH_WINDOW; t++) {
+                    if (emitted[t]) { continue; }
+                    consider(t);
+                    checked++;
+                }
+            }
+        }
+
+        if (meshletVertices.size() + extraVertices(best) > maxVertices || meshletTriangles.size() >= maxTriangles) { closeMeshlet(); }
+
+        emitted[best] = 1;
+        for (uint32_t c = 0; c < 3; c++) {
+            uint32_t index = indices[best * 3 + c];
+            if (slots[index] == NONE) {
+                slots[index] = static_cast<uint32_t>(meshletVertices.size());
+                meshletVertices.push_back(index);
+            }
+        }
+        meshletTriangles.push_back(best);
+        centroidSum += centroids[best];
+        normalSum += normals[best];
+    }
+    closeMeshlet();
+
+    std::copy(reordered.begin(), reordered.end(), data.indices.begin() + firstIndex);
+    report.meshlets = data.meshlets.size();
+    report.averageVertices /= report.meshlets;
+    report.averageTriangles /= report.meshlets;
+    return report;
+}
@@ -6,30 +6,19 @@
 //
 
 #include "include/Model.hpp"
-#include "include/utils.h"
+#include "include/ObjLoader.hpp"
+#include "include/MeshOptimizer.hpp"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny-obj/tiny_obj_loader.h>
-
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+//libs
+#include <glm/gtc/packing.hpp>
 
 //std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
-#include <unordered_map>
 #include <iostream>
-
-namespace std {
-    template <>
-    struct hash<Model::Vertex> {
-        size_t operator()(Model::Vertex const &vertex) const {
-            size_t seed = 0;
-            hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-            return seed;
-        }
-    };
-}
+#include <limits>
 
 
 std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions() {
@@ -52,6 +41,71 @@ std::vector<VkVertexInputAttributeDescription> Model::Vertex::getAttributeDescri
     return attributeDescriptions;
 }
 
+std::vector<VkVertexInputBindingDescription> Model::PackedVertex::getBindingDescriptions() {
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(PackedVertex);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> Model::PackedVertex::getAttributeDescriptions() {
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+    
+    // No color stream, location 1 is left unused
+    attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(PackedVertex, position)});
+    attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal)});
+    attributeDescriptions.push_back({3, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, tangent)});
+    attributeDescriptions.push_back({4, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv)});
+
+    return attributeDescriptions;
+}
+
+std::vector<VkVertexInputBindingDescription> Model::getPositionBindingDescriptions() {
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(glm::vec3);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> Model::getPositionAttributeDescriptions() {
+    return {{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}};
+}
+
+// Octahedral mapping of a unit vector onto the [-1, 1] square
+static glm::vec2 octahedralEncode(glm::vec3 n) {
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 == 0.f) { return glm::vec2(0.f); }
+    n /= l1;
+    glm::vec2 e{n.x, n.y};
+    if (n.z < 0.f) {
+        e = (1.f - glm::abs(glm::vec2{n.y, n.x})) * glm::vec2{n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f};
+    }
+    return e;
+}
+
+Model::PackedVertex Model::PackedVertex::pack(const Vertex &vertex, const glm::vec3 &boundsMin, const glm::vec3 &boundsExtent) {
+    PackedVertex packed{};
+    glm::vec3 position = (vertex.position - boundsMin) / boundsExtent;
+    packed.position[0] = glm::packUnorm1x16(position.x);
+    packed.position[1] = glm::packUnorm1x16(position.y);
+    packed.position[2] = glm::packUnorm1x16(position.z);
+    packed.position[3] = vertex.tangent.w < 0.f ? 0 : 0xFFFF;
+    
+    glm::vec2 normal = octahedralEncode(vertex.normal);
+    packed.normal[0] = static_cast<int16_t>(glm::packSnorm1x16(normal.x));
+    packed.normal[1] = static_cast<int16_t>(glm::packSnorm1x16(normal.y));
+    
+    glm::vec2 tangent = octahedralEncode(glm::vec3(vertex.tangent));
+    packed.tangent[0] = static_cast<int16_t>(glm::packSnorm1x16(tangent.x));
+    packed.tangent[1] = static_cast<int16_t>(glm::packSnorm1x16(tangent.y));
+    
+    packed.uv[0] = glm::packHalf1x16(vertex.uv.x);
+    packed.uv[1] = glm::packHalf1x16(vertex.uv.y);
+    return packed;
+}
+
 void Model::Data::computeTangentBasis(Model::Vertex &v0, Model::Vertex &v1, Model::Vertex &v2, glm::vec3 *tanOut) {
     // Edges of the triangle : position delta
     glm::vec3 deltaPos1 = v1.position - v0.position;
@@ -74,59 +128,9 @@ void Model::Data::computeTangentBasis(Model::Vertex &v0, Model::Vertex &v1, Mode
  }
 
 void Model::Data::loadModel(const std::string &filePath, bool allUniqueVertices) {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-    
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.c_str())) {
-        throw std::runtime_error(warn + err);
-    }
-    
-    vertices.clear();
-    indices.clear();
-    
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-    for (const auto &shape: shapes) {
-        
-        for (const auto &index: shape.mesh.indices) {
-            Vertex vertex{};
-            
-            if (index.vertex_index >= 0) {
-                vertex.position = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]
-                };
-                vertex.color = {
-                    attrib.colors[3 * index.vertex_index + 0],
-                    attrib.colors[3 * index.vertex_index + 1],
-                    attrib.colors[3 * index.vertex_index + 2]
-                };
-            }
-            if (index.normal_index >= 0) {
-                vertex.normal = {
-                    attrib.normals[3 * index.normal_index + 0],
-                    attrib.normals[3 * index.normal_index + 1],
-                    attrib.normals[3 * index.normal_index + 2]
-                };
-            }
-            if (index.texcoord_index >= 0) {
-                vertex.uv = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    attrib.texcoords[2 * index.texcoord_index + 1]
-                };
-            }
-            
-            // allUniqueVertices == True treats ALL vertices as unique (bypass overlapping UV bug)
-            if (uniqueVertices.count(vertex) == 0 || allUniqueVertices) {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                vertices.push_back(vertex);
-            }
-            indices.push_back(uniqueVertices[vertex]);
-        }
-        
-    }
+    // allUniqueVertices == True treats ALL vertices as unique (bypass overlapping UV bug)
+    ObjLoader loader{filePath};
+    loader.load(vertices, indices, allUniqueVertices);
     
     std::vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.f));
     std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3(0.f));
@@ -156,17 +160,150 @@ void Model::Data::loadModel(const std::string &filePath, bool allUniqueVertices)
     
 }
 
-Model::Model(Device &dev, const Data &data) : device{dev} {
+void Model::Data::splitIntoShortIndexChunks() {
+    submeshes.clear();
+    if (vertices.size() <= MAX_SHORT_INDEX_VERTICES) { return; }
+    
+    // Triangles keep their order, vertices shared across a chunk border get duplicated
+    constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+    std::vector<uint32_t> chunkVertices{};
+    std::vector<Vertex> chunkedVertices{};
+    std::vector<uint32_t> chunkedIndices{};
+    chunkedVertices.reserve(vertices.size());
+    chunkedIndices.reserve(indices.size());
+    
+    std::vector<Lod> levels = lods;
+    if (levels.empty()) { levels.push_back({0, static_cast<uint32_t>(indices.size())}); }
+    
+    Submesh current{};
+    auto closeSubmesh = [&]() {
+        current.indexCount = static_cast<uint32_t>(chunkedIndices.size()) - current.firstIndex;
+        if (current.indexCount > 0) { submeshes.push_back(current); }
+        current.firstIndex = static_cast<uint32_t>(chunkedIndices.size());
+    };
+    
+    for (auto &level : levels) {
+        closeSubmesh();
+        const uint32_t levelFirst = static_cast<uint32_t>(chunkedIndices.size());
+        level.firstSubmesh = static_cast<uint32_t>(submeshes.size());
+        
+        for (size_t i = level.firstIndex; i + 2 < level.firstIndex + level.indexCount; i += 3) {
+            uint32_t added = 0;
+            for (size_t c = 0; c < 3; c++) {
+                uint32_t index = indices[i + c];
+                bool repeated = (c > 0 && indices[i] == index) || (c > 1 && indices[i + 1] == index);
+                added += remap[index] == UNUSED && !repeated;
+            }
+            
+            if (chunkVertices.size() + added > MAX_SHORT_INDEX_VERTICES) {
+                closeSubmesh();
+                for (auto index : chunkVertices) { remap[index] = UNUSED; }
+                chunkVertices.clear();
+                current.vertexOffset = static_cast<int32_t>(chunkedVertices.size());
+            }
+            
+            for (size_t c = 0; c < 3; c++) {
+                uint32_t index = indices[i + c];
+                if (remap[index] == UNUSED) {
+                    remap[index] = static_cast<uint32_t>(chunkVertices.size());
+                    chunkVertices.push_back(index);
+                    chunkedVertices.push_back(vertices[index]);
+                }
+                chunkedIndices.push_back(remap[index]);
+            }
+        }
+        closeSubmesh();
+        level.firstIndex = levelFirst;
+        level.indexCount = static_cast<uint32_t>(chunkedIndices.size()) - levelFirst;
+        level.submeshCount = static_cast<uint32_t>(submeshes.size()) - level.firstSubmesh;
+    }
+    
+    vertices = std::move(chunkedVertices);
+    indices = std::move(chunkedIndices);
+    if (!lods.empty()) { lods = std::move(levels); }
+}
+
+Model::Model(Device &dev, const Data &data, VertexFormat format) : device{dev}, vertexFormat{format}, submeshes{data.submeshes}, lods{data.lods} {
     createVertexBuffer(data.vertices);
+    // Depth and shadow passes draw packed models from their packed stream
+    if (vertexFormat == VertexFormat::Float) { createPositionBuffer(data.vertices); }
     createIndexBuffer(data.indices);
+    if (lods.empty()) { lods.push_back({0, indexCount, 0, static_cast<uint32_t>(submeshes.size()), 0.f}); }
+    createCullClusters(data);
 }
 
 Model::~Model() {}
 
-std::unique_ptr<Model> Model::createModelFromFile(Device &device, const std::string &filePath, bool allUniqueVertices) {
+void Model::createCullClusters(const Data &data) {
+    cullClusters.assign(lods.size(), {});
+    cullClusters[0] = buildCullClusters(data);
+    // GPU culling picks the level per object, every level needs its own clusters
+    for (uint32_t lod = 1; lod < lods.size() && !data.indices.empty(); lod++) {
+        cullClusters[lod] = buildRunClusters(data, data.lods[lod]);
+    }
+}
+
+std::vector<Model::Submesh> Model::getLevelRanges(const Data &data, const Lod &level) {
+    std::vector<Submesh> ranges(data.submeshes.begin() + level.firstSubmesh, data.submeshes.begin() + level.firstSubmesh + level.submeshCount);
+    if (ranges.empty()) { ranges.push_back({level.firstIndex, level.indexCount, 0}); }
+    return ranges;
+}
+
+std::vector<Model::CullCluster> Model::buildCullClusters(const Data &data) {
+    std::vector<CullCluster> clusters{};
+    if (data.indices.empty()) { return clusters; }
+    
+    const Lod base = data.lods.empty() ? Lod{0, static_cast<uint32_t>(data.indices.size()), 0, static_cast<uint32_t>(data.submeshes.size()), 0.f} : data.lods[0];
+    if (data.meshlets.empty()) { return buildRunClusters(data, base); }
+    
+    // Splitting keeps the base triangles in place, a meshlet crossing a chunk border becomes one cluster per chunk
+    // Each part keeps the bounds and cone of the whole meshlet, they still enclose its triangles
+    const std::vector<Submesh> ranges = getLevelRanges(data, base);
+    for (const auto &meshlet : data.meshlets) {
+        for (const auto &range : ranges) {
+            uint32_t first = std::max(meshlet.firstIndex, range.firstIndex);
+            uint32_t last = std::min(meshlet.firstIndex + meshlet.indexCount, range.firstIndex + range.indexCount);
+            if (first >= last) { continue; }
+            CullCluster cluster = meshlet;
+            cluster.firstIndex = first;
+            cluster.indexCount = last - first;
+            cluster.vertexOffset = range.vertexOffset;
+            clusters.push_back(cluster);
+        }
+    }
+    return clusters;
+}
+
+std::vector<Model::CullCluster> Model::buildRunClusters(const Data &data, const Lod &level) {
+    // Optimized meshes keep neighbouring triangles close in the index buffer, so fixed size runs stay compact in space
+    std::vector<CullCluster> clusters{};
+    for (const auto &range : getLevelRanges(data, level)) {
+        for (uint32_t first = 0; first < range.indexCount; first += CULL_CLUSTER_TRIANGLES * 3) {
+            CullCluster cluster{};
+            cluster.firstIndex = range.firstIndex + first;
+            cluster.indexCount = std::min(CULL_CLUSTER_TRIANGLES * 3, range.indexCount - first);
+            cluster.vertexOffset = range.vertexOffset;
+            cluster.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+            cluster.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+            for (uint32_t i = cluster.firstIndex; i < cluster.firstIndex + cluster.indexCount; i++) {
+                const glm::vec3 &position = data.vertices[data.indices[i] + range.vertexOffset].position;
+                cluster.boundsMin = glm::min(cluster.boundsMin, position);
+                cluster.boundsMax = glm::max(cluster.boundsMax, position);
+            }
+            cluster.center = .5f * (cluster.boundsMin + cluster.boundsMax);
+            cluster.radius = .5f * glm::length(cluster.boundsMax - cluster.boundsMin);
+            clusters.push_back(cluster);
+        }
+    }
+    return clusters;
+}
+
+std::unique_ptr<Model> Model::createModelFromFile(Device &device, const std::string &filePath, bool allUniqueVertices, VertexFormat format) {
     Data data{};
     data.loadModel(filePath, allUniqueVertices);
-    return std::make_unique<Model>(device, data);
+    MeshOptimizer::optimize(data);
+    return std::make_unique<Model>(device, data, format);
 }
 
 void Model::bind(VkCommandBuffer commandBuffer) {
@@ -175,15 +312,31 @@ void Model::bind(VkCommandBuffer commandBuffer) {
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
     
     if (hasIndexBuffer) {
-        vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, indexType);
     }
 }
 
-void Model::draw(VkCommandBuffer commandBuffer) {
+void Model::bindPositionsOnly(VkCommandBuffer commandBuffer) {
+    assert(positionBuffer && "Packed models have no position stream, bind them with bind");
+    VkBuffer buffers[] = {positionBuffer->getBuffer()};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+    
     if (hasIndexBuffer) {
-        vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, indexType);
+    }
+}
+
+void Model::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod) {
+    const Lod &level = lods[std::min(lod, getLodCount() - 1)];
+    if (hasIndexBuffer && submeshes.empty()) {
+        vkCmdDrawIndexed(commandBuffer, level.indexCount, instanceCount, level.firstIndex, 0, firstInstance);
+    } else if (hasIndexBuffer) {
+        for (uint32_t i = level.firstSubmesh; i < level.firstSubmesh + level.submeshCount; i++) {
+            vkCmdDrawIndexed(commandBuffer, submeshes[i].indexCount, instanceCount, submeshes[i].firstIndex, submeshes[i].vertexOffset, firstInstance);
+        }
     } else {
-        vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+        vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
     }
 }
 
@@ -191,7 +344,35 @@ void Model::createVertexBuffer(const std::vector<Vertex> &vertices) {
     vertexCount = static_cast<uint32_t>(vertices.size());
     assert(vertexCount >= 3 && "Vertex count must be at least 3");
     
-    uint32_t vertexSize = sizeof(vertices[0]);
+    // Kept for every format since culling uses them too
+    glm::vec3 boundsMax{vertices[0].position};
+    boundsMin = vertices[0].position;
+    for (const auto &vertex : vertices) {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+    boundsExtent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+    
+    if (vertexFormat == VertexFormat::Float) {
+        vertexBuffer = uploadVertexBuffer(vertices.data(), sizeof(Vertex));
+        return;
+    }
+    
+    // Quantize against the mesh bounds, the shader gets min and extent to rebuild positions
+    std::vector<PackedVertex> packedVertices(vertexCount);
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        packedVertices[i] = PackedVertex::pack(vertices[i], boundsMin, boundsExtent);
+    }
+    vertexBuffer = uploadVertexBuffer(packedVertices.data(), sizeof(PackedVertex));
+}
+
+void Model::createPositionBuffer(const std::vector<Vertex> &vertices) {
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) { positions[i] = vertices[i].position; }
+    positionBuffer = uploadVertexBuffer(positions.data(), sizeof(glm::vec3));
+}
+
+std::unique_ptr<Buffer> Model::uploadVertexBuffer(const void *data, uint32_t vertexSize) {
     VkDeviceSize bufferSize = vertexSize * vertexCount;
     
     Buffer stagingBuffer{
@@ -203,10 +384,10 @@ void Model::createVertexBuffer(const std::vector<Vertex> &vertices) {
     };
 
     stagingBuffer.map();
-    stagingBuffer.writeToBuffer((void *)vertices.data());
+    stagingBuffer.writeToBuffer(const_cast<void *>(data));
 
 
-    vertexBuffer = std::make_unique<Buffer>(
+    auto buffer = std::make_unique<Buffer>(
         device,
         vertexSize,
         vertexCount,
@@ -214,7 +395,8 @@ void Model::createVertexBuffer(const std::vector<Vertex> &vertices) {
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
     );
 
-    device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+    device.copyBuffer(stagingBuffer.getBuffer(), buffer->getBuffer(), bufferSize);
+    return buffer;
 }
 
 void Model::createIndexBuffer(const std::vector<uint32_t> &indices) {
@@ -223,7 +405,20 @@ void Model::createIndexBuffer(const std::vector<uint32_t> &indices) {
     
     if (!hasIndexBuffer) { return; }
     
-    uint32_t indexSize = sizeof(indices[0]);
+    // Half the index memory and fetch bandwidth whenever every index fits in 16 bits
+    uint32_t maxIndex = *std::max_element(indices.begin(), indices.end());
+    if (maxIndex > MAX_SHORT_INDEX_VERTICES - 1) {
+        indexType = VK_INDEX_TYPE_UINT32;
+        uploadIndexBuffer(indices.data(), sizeof(uint32_t));
+        return;
+    }
+    
+    std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+    indexType = VK_INDEX_TYPE_UINT16;
+    uploadIndexBuffer(shortIndices.data(), sizeof(uint16_t));
+}
+
+void Model::uploadIndexBuffer(const void *data, uint32_t indexSize) {
     VkDeviceSize bufferSize = indexSize * indexCount;
     
     Buffer stagingBuffer{
@@ -235,7 +430,7 @@ void Model::createIndexBuffer(const std::vector<uint32_t> &indices) {
     };
 
     stagingBuffer.map();
-    stagingBuffer.writeToBuffer((void *)indices.data());
+    stagingBuffer.writeToBuffer(const_cast<void *>(data));
 
     indexBuffer = std::make_unique<Buffer>(
         device,
@@ -0,0 +1,472 @@
+//
+//  ObjLoader.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/ObjLoader.hpp"
+#include "include/utils.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+ObjLoader::Stats ObjLoader::totalStats{};
+std::mutex ObjLoader::statsMutex{};
+
+namespace {
+    constexpr int32_t MISSING = std::numeric_limits<int32_t>::min();
+    constexpr int32_t RELATIVE_BIAS = 1 << 30;
+    constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+    const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    inline bool isDigit(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+    inline bool isBlank(char c) { return c == ' ' || c == '\t'; }
+    inline bool isLineEnd(char c) { return c == '\n' || c == '\r'; }
+
+    inline const char *skipBlanks(const char *p, const char *end) {
+        while (p < end && isBlank(*p)) { p++; }
+        return p;
+    }
+
+    // SWAR digit parsing: eight ASCII digits are validated and converted with a few 64-bit ops
+    inline bool isEightDigits(uint64_t chunk) {
+        return !(((chunk + 0x4646464646464646ULL) | (chunk - 0x3030303030303030ULL)) & 0x8080808080808080ULL);
+    }
+
+    inline uint32_t parseEightDigits(uint64_t chunk) {
+        const uint64_t mask = 0x000000FF000000FFULL;
+        const uint64_t mul1 = 0x000F424000000064ULL; // 100 + (1000000ULL << 32)
+        const uint64_t mul2 = 0x0000271000000001ULL; // 1 + (10000ULL << 32)
+        chunk -= 0x3030303030303030ULL;
+        chunk = (chunk * 10) + (chunk >> 8);
+        chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+        return static_cast<uint32_t>(chunk);
+    }
+
+    inline int32_t encodeIndex(int32_t index, size_t localCount) {
+        if (index > 0) { return index - 1; }
+        if (index < 0) { return static_cast<int32_t>(localCount) + index - RELATIVE_BIAS; }
+        return MISSING;
+    }
+
+    // Run one job per chunk on its own thread, rethrowing the first failure on the caller
+    void runParallel(size_t count, const std::function<void(size_t)> &job) {
+        std::vector<std::exception_ptr> errors(count);
+        std::vector<std::thread> workers;
+        workers.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            workers.emplace_back([i, &job, &errors]() {
+                try {
+                    job(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+        for (auto &worker : workers) { worker.join(); }
+        for (auto &error : errors) {
+            if (error) { std::rethrow_exception(error); }
+        }
+    }
+}
+
+size_t ObjLoader::CornerHash::operator()(const Corner &corner) const {
+    size_t seed = 0;
+    hashCombine(seed, corner.v, corner.vt, corner.vn);
+    return seed;
+}
+
+ObjLoader::ObjLoader(const std::string &filePath) : filePath{filePath} {
+    startTime = std::chrono::high_resolution_clock::now();
+    // The destructor doesn't run when the constructor throws, release whatever was opened before the failure
+    try {
+        mapFile();
+    } catch (...) {
+        unmapFile();
+        throw;
+    }
+}
+
+ObjLoader::~ObjLoader() {
+    unmapFile();
+}
+
+ObjLoader::Stats ObjLoader::getTotalStats() {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return totalStats;
+}
+
+void ObjLoader::resetTotalStats() {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    totalStats = Stats{};
+}
+
+void ObjLoader::mapFile() {
+#ifdef _WIN32
+    fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        throw std::runtime_error("Failed to open file: " + filePath);
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    if (size == 0) { return; }
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr) {
+        throw std::runtime_error("Failed to map file: " + filePath);
+    }
+    data = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (data == nullptr) {
+        throw std::runtime_error("Failed to map file: " + filePath);
+    }
+#else
+    fileDescriptor = open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        throw std::runtime_error("Failed to open file: " + filePath);
+    }
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) != 0) {
+        throw std::runtime_error("Failed to stat file: " + filePath);
+    }
+    size = static_cast<size_t>(fileStat.st_size);
+    if (size == 0) { return; }
+
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file: " + filePath);
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    data = static_cast<const char *>(mapped);
+#endif
+}
+
+void ObjLoader::unmapFile() {
+#ifdef _WIN32
+    if (data) { UnmapViewOfFile(data); }
+    if (mappingHandle) { CloseHandle(mappingHandle); }
+    if (fileHandle) { CloseHandle(fileHandle); }
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (data) { munmap(const_cast<char *>(data), size); }
+    if (fileDescriptor >= 0) { close(fileDescriptor); }
+    fileDescriptor = -1;
+#endif
+    data = nullptr;
+}
+
+void ObjLoader::splitChunks(size_t chunkCount) {
+    chunks.clear();
+    const char *fileEnd = data + size;
+    const char *begin = data;
+    for (size_t i = 1; i <= chunkCount && begin < fileEnd; i++) {
+        const char *end = i == chunkCount ? fileEnd : std::max(begin, data + (size * i) / chunkCount);
+        // Move the split after the next line break so no line straddles two chunks
+        end = std::find(end, fileEnd, '\n');
+        if (end < fileEnd) { end++; }
+        Chunk chunk{};
+        chunk.begin = begin;
+        chunk.end = end;
+        chunks.push_back(std::move(chunk));
+        begin = end;
+    }
+}
+
+const char *ObjLoader::parseIndex(const char *p, const char *end, int32_t &value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    int32_t result = 0;
+    while (p < end && isDigit(*p)) {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+const char *ObjLoader::parseFloat(const char *p, const char *end, float &value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+
+    // Integer part
+    while (end - p >= 8 && digits + 8 <= 19) {
+        uint64_t chunk;
+        std::memcpy(&chunk, p, 8);
+        if (!isEightDigits(chunk)) { break; }
+        mantissa = mantissa * 100000000ULL + parseEightDigits(chunk);
+        digits += 8;
+        p += 8;
+    }
+    while (p < end && isDigit(*p)) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+        p++;
+    }
+
+    // Fractional part
+    if (p < end && *p == '.') {
+        p++;
+        while (end - p >= 8 && digits + 8 <= 19) {
+            uint64_t chunk;
+            std::memcpy(&chunk, p, 8);
+            if (!isEightDigits(chunk)) { break; }
+            mantissa = mantissa * 100000000ULL + parseEightDigits(chunk);
+            digits += 8;
+            exponent -= 8;
+            p += 8;
+        }
+        while (p < end && isDigit(*p)) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+            p++;
+        }
+    }
+
+    // Exponent
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int32_t explicitExponent;
+        p = parseIndex(p + 1, end, explicitExponent);
+        exponent += explicitExponent;
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (exponent < 0) {
+        result = -exponent <= 22 ? result / powersOfTen[-exponent] : result * std::pow(10., exponent);
+    } else if (exponent > 0) {
+        result = exponent <= 22 ? result * powersOfTen[exponent] : result * std::pow(10., exponent);
+    }
+
+    value = static_cast<float>(negative ? -result : result);
+    return p;
+}
+
+void ObjLoader::parseChunk(Chunk &chunk) {
+    // Rough reservation, a Sponza-like OBJ averages ~30 bytes per line
+    const size_t estimatedLines = (chunk.end - chunk.begin) / 30;
+    chunk.positions.reserve(estimatedLines);
+    chunk.colors.reserve(estimatedLines);
+    chunk.corners.reserve(estimatedLines);
+
+    std::vector<Corner> polygon;
+    const char *p = chunk.begin;
+    const char *end = chunk.end;
+
+    while (p < end) {
+        p = skipBlanks(p, end);
+
+        if (end - p >= 2 && p[0] == 'v' && isBlank(p[1])) {
+            float value[6] = {0.f, 0.f, 0.f, 1.f, 1.f, 1.f};
+            p += 2;
+            int count = 0;
+            for (; count < 6; count++) {
+                p = skipBlanks(p, end);
+                if (p >= end || isLineEnd(*p)) { break; }
+                p = parseFloat(p, end, value[count]);
+            }
+            if (count < 6) { value[3] = value[4] = value[5] = 1.f; }
+            chunk.positions.insert(chunk.positions.end(), value, value + 3);
+            chunk.colors.insert(chunk.colors.end(), value + 3, value + 6);
+        }
+        else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+            float value[3] = {0.f, 0.f, 0.f};
+            p += 3;
+            for (int i = 0; i < 3; i++) {
+                p = skipBlanks(p, end);
+                p = parseFloat(p, end, value[i]);
+            }
+            chunk.normals.insert(chunk.normals.end(), value, value + 3);
+        }
+        else if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+            float value[2] = {0.f, 0.f};
+            p += 3;
+            for (int i = 0; i < 2; i++) {
+                p = skipBlanks(p, end);
+                p = parseFloat(p, end, value[i]);
+            }
+            chunk.texcoords.insert(chunk.texcoords.end(), value, value + 2);
+        }
+        else if (end - p >= 2 && p[0] == 'f' && isBlank(p[1])) {
+            p += 2;
+            polygon.clear();
+            while (true) {
+                p = skipBlanks(p, end);
+                if (p >= end || isLineEnd(*p) || *p == '#') { break; }
+
+                Corner corner{MISSING, MISSING, MISSING};
+                int32_t index;
+                const char *next = parseIndex(p, end, index);
+                if (next == p) { break; }
+                corner.v = encodeIndex(index, chunk.positions.size() / 3);
+                p = next;
+
+                if (p < end && *p == '/') {
+                    p++;
+                    if (p < end && *p != '/') {
+                        next = parseIndex(p, end, index);
+                        if (next != p) { corner.vt = encodeIndex(index, chunk.texcoords.size() / 2); }
+                        p = next;
+                    }
+                    if (p < end && *p == '/') {
+                        p++;
+                        next = parseIndex(p, end, index);
+                        if (next != p) { corner.vn = encodeIndex(index, chunk.normals.size() / 3); }
+                        p = next;
+                    }
+                }
+                polygon.push_back(corner);
+
+                while (p < end && !isBlank(*p) && !isLineEnd(*p)) { p++; }
+            }
+
+            // Triangle fan, same as the convex triangulation tinyobj applied
+            for (size_t i = 2; i < polygon.size(); i++) {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[i - 1]);
+                chunk.corners.push_back(polygon[i]);
+            }
+        }
+
+        // Anything else (comments, groups, materials, smoothing) is skipped
+        while (p < end && *p != '\n') { p++; }
+        p++;
+    }
+}
+
+int32_t ObjLoader::resolve(int32_t index, int32_t base) {
+    if (index == MISSING || index >= 0) { return index; }
+    return base + index + RELATIVE_BIAS;
+}
+
+void ObjLoader::load(std::vector<Model::Vertex> &vertices, std::vector<uint32_t> &indices, bool allUniqueVertices) {
+    vertices.clear();
+    indices.clear();
+
+    if (size > 0) {
+        size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+        splitChunks(std::min(threadCount, size / MIN_CHUNK_SIZE + 1));
+
+        runParallel(chunks.size(), [this](size_t i) { parseChunk(chunks[i]); });
+
+        // Global offsets of every chunk
+        size_t positionCount = 0, normalCount = 0, texcoordCount = 0, cornerCount = 0;
+        for (auto &chunk : chunks) {
+            chunk.positionBase = static_cast<int32_t>(positionCount);
+            chunk.normalBase = static_cast<int32_t>(normalCount);
+            chunk.texcoordBase = static_cast<int32_t>(texcoordCount);
+            chunk.cornerBase = cornerCount;
+            positionCount += chunk.positions.size() / 3;
+            normalCount += chunk.normals.size() / 3;
+            texcoordCount += chunk.texcoords.size() / 2;
+            cornerCount += chunk.corners.size();
+        }
+
+        std::vector<float> positions(positionCount * 3);
+        std::vector<float> colors(positionCount * 3);
+        std::vector<float> normals(normalCount * 3);
+        std::vector<float> texcoords(texcoordCount * 2);
+
+        // Gather attributes into contiguous arrays and resolve relative references
+        runParallel(chunks.size(), [&](size_t i) {
+            Chunk &chunk = chunks[i];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase * 3);
+            std::copy(chunk.colors.begin(), chunk.colors.end(), colors.begin() + chunk.positionBase * 3);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase * 3);
+            std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoordBase * 2);
+            for (auto &corner : chunk.corners) {
+                corner.v = resolve(corner.v, chunk.positionBase);
+                corner.vt = resolve(corner.vt, chunk.texcoordBase);
+                corner.vn = resolve(corner.vn, chunk.normalBase);
+                if (corner.v < 0 || corner.v >= static_cast<int32_t>(positionCount) ||
+                    corner.vt >= static_cast<int32_t>(texcoordCount) || (corner.vt < 0 && corner.vt != MISSING) ||
+                    corner.vn >= static_cast<int32_t>(normalCount) || (corner.vn < 0 && corner.vn != MISSING)) {
+                    throw std::runtime_error("Face index out of range in " + filePath);
+                }
+            }
+        });
+
+        auto makeVertex = [&](const Corner &corner) {
+            Model::Vertex vertex{};
+            vertex.position = {positions[3 * corner.v + 0], positions[3 * corner.v + 1], positions[3 * corner.v + 2]};
+            vertex.color = {colors[3 * corner.v + 0], colors[3 * corner.v + 1], colors[3 * corner.v + 2]};
+            if (corner.vn != MISSING) {
+                vertex.normal = {normals[3 * corner.vn + 0], normals[3 * corner.vn + 1], normals[3 * corner.vn + 2]};
+            }
+            if (corner.vt != MISSING) {
+                vertex.uv = {texcoords[2 * corner.vt + 0], texcoords[2 * corner.vt + 1]};
+            }
+            return vertex;
+        };
+
+        if (allUniqueVertices) {
+            // Every corner is its own vertex, so chunks can emit straight into their output range
+            vertices.resize(cornerCount);
+            indices.resize(cornerCount);
+            runParallel(chunks.size(), [&](size_t i) {
+                const Chunk &chunk = chunks[i];
+                for (size_t k = 0; k < chunk.corners.size(); k++) {
+                    vertices[chunk.cornerBase + k] = makeVertex(chunk.corners[k]);
+                    indices[chunk.cornerBase + k] = static_cast<uint32_t>(chunk.cornerBase + k);
+                }
+            });
+        } else {
+            std::unordered_map<Corner, uint32_t, CornerHash> uniqueVertices{};
+            uniqueVertices.reserve(cornerCount / 2);
+            indices.reserve(cornerCount);
+            for (const auto &chunk : chunks) {
+                for (const auto &corner : chunk.corners) {
+                    auto inserted = uniqueVertices.emplace(corner, static_cast<uint32_t>(vertices.size()));
+                    if (inserted.second) { vertices.push_back(makeVertex(corner)); }
+                    indices.push_back(inserted.first->second);
+                }
+            }
+        }
+        chunks.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    totalStats.bytes += size;
+    totalStats.seconds += std::chrono::duration<double, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
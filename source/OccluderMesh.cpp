@@ -0,0 +1,43 @@
+//
+//  OccluderMesh.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/OccluderMesh.hpp"
+
+//std
+#include <algorithm>
+#include <numeric>
+
+OccluderMesh::OccluderMesh(const Model::Data &data, uint32_t maxTriangles) {
+    const uint32_t triangleCount = static_cast<uint32_t>(data.indices.size() / 3);
+    std::vector<float> areas(triangleCount);
+    for (uint32_t i = 0; i < triangleCount; i++) {
+        const glm::vec3 &p0 = data.vertices[data.indices[3 * i + 0]].position;
+        const glm::vec3 &p1 = data.vertices[data.indices[3 * i + 1]].position;
+        const glm::vec3 &p2 = data.vertices[data.indices[3 * i + 2]].position;
+        areas[i] = glm::length(glm::cross(p1 - p0, p2 - p0));
+    }
+
+    std::vector<uint32_t> order(triangleCount);
+    std::iota(order.begin(), order.end(), 0u);
+    const uint32_t keptCount = std::min(triangleCount, maxTriangles);
+    std::partial_sort(order.begin(), order.begin() + keptCount, order.end(), [&](uint32_t a, uint32_t b) { return areas[a] > areas[b]; });
+
+    // Compact the vertices referenced by the kept triangles
+    std::vector<uint32_t> remap(data.vertices.size(), UINT32_MAX);
+    indices.reserve(3 * keptCount);
+    for (uint32_t i = 0; i < keptCount; i++) {
+        if (areas[order[i]] <= 0.f) { break; }
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            uint32_t vertex = data.indices[3 * order[i] + corner];
+            if (remap[vertex] == UINT32_MAX) {
+                remap[vertex] = static_cast<uint32_t>(positions.size());
+                positions.push_back(data.vertices[vertex].position);
+            }
+            indices.push_back(remap[vertex]);
+        }
+    }
+}
@@ -0,0 +1,225 @@
+//
+//  OcclusionCuller.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/OcclusionCuller.hpp"
+
+//std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+constexpr uint32_t TILES_X = OcclusionCuller::WIDTH / OcclusionCuller::TILE_WIDTH;
+constexpr uint32_t TILES_Y = OcclusionCuller::HEIGHT / OcclusionCuller::TILE_HEIGHT;
+constexpr uint32_t BLOCKS_X = OcclusionCuller::WIDTH / OcclusionCuller::BLOCK_SIZE;
+constexpr uint32_t BLOCKS_Y = OcclusionCuller::HEIGHT / OcclusionCuller::BLOCK_SIZE;
+
+static_assert(OcclusionCuller::WIDTH % OcclusionCuller::TILE_WIDTH == 0 && OcclusionCuller::HEIGHT % OcclusionCuller::TILE_HEIGHT == 0, "tiles must cover the buffer");
+static_assert(OcclusionCuller::TILE_WIDTH % OcclusionCuller::LANES == 0, "spans must not cross tiles");
+static_assert(OcclusionCuller::TILE_WIDTH % OcclusionCuller::BLOCK_SIZE == 0 && OcclusionCuller::TILE_HEIGHT % OcclusionCuller::BLOCK_SIZE == 0, "blocks must not cross tiles");
+
+// Projected coordinates past this many pixels lose too much precision in the edge functions
+constexpr float GUARD_BAND = 4096.f;
+constexpr float MIN_W = 1e-5f;
+
+float elapsedMilliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+}
+
+OcclusionCuller::OcclusionCuller() : depth(WIDTH * HEIGHT, 1.f), blockDepth(BLOCKS_X * BLOCKS_Y, 1.f) {}
+
+void OcclusionCuller::rasterize(EntityRegistry &scene, const glm::mat4 &clip, JobSystem &jobSystem) {
+    auto start = std::chrono::high_resolution_clock::now();
+    projectionView = clip;
+
+    auto &occluders = scene.view<OccluderComponent>();
+    occluderTriangles.resize(occluders.size());
+    jobSystem.dispatch(static_cast<uint32_t>(occluders.size()), [&](uint32_t jobIndex, uint32_t) {
+        occluderTriangles[jobIndex].clear();
+        Entity entity = occluders.getEntities()[jobIndex];
+        if (!scene.has<TransformHandle>(entity)) { return; }
+        glm::mat4 world = scene.getTransforms().getWorldMatrix(scene.getTransform(entity));
+        transformOccluder(*occluders.getComponents()[jobIndex].mesh, clip * world, occluderTriangles[jobIndex]);
+    });
+
+    triangles.clear();
+    for (const auto &list : occluderTriangles) { triangles.insert(triangles.end(), list.begin(), list.end()); }
+
+    // Tiles own disjoint pixels and blocks, each job bins the whole triangle list by itself
+    jobSystem.dispatch(TILES_X * TILES_Y, [this](uint32_t jobIndex, uint32_t) { rasterizeTile(jobIndex); });
+
+    valid = !triangles.empty();
+    stats.occluders = static_cast<uint32_t>(occluders.size());
+    stats.triangles = static_cast<uint32_t>(triangles.size());
+    stats.rasterMilliseconds = elapsedMilliseconds(start);
+}
+
+void OcclusionCuller::transformOccluder(const OccluderMesh &mesh, const glm::mat4 &clip, std::vector<Triangle> &out) const {
+    std::vector<glm::vec4> projected(mesh.getPositions().size());
+    for (size_t i = 0; i < projected.size(); i++) { projected[i] = clip * glm::vec4(mesh.getPositions()[i], 1.f); }
+
+    const auto &indices = mesh.getIndices();
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        glm::vec3 screen[3];
+        bool rejected = false;
+        for (int corner = 0; corner < 3; corner++) {
+            const glm::vec4 &p = projected[indices[i + corner]];
+            // Crossing the near plane, dropping an occluder only ever hides less
+            if (p.w < MIN_W || p.z < 0.f) { rejected = true; break; }
+            float invW = 1.f / p.w;
+            screen[corner] = {(p.x * invW * .5f + .5f) * WIDTH, (p.y * invW * .5f + .5f) * HEIGHT, p.z * invW};
+            if (std::abs(screen[corner].x) > GUARD_BAND || std::abs(screen[corner].y) > GUARD_BAND) { rejected = true; break; }
+        }
+        if (rejected) { continue; }
+
+        // Both faces occlude, orient every triangle so its edge functions are positive inside
+        float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+        if (std::abs(area) < 1e-6f) { continue; }
+        if (area < 0.f) {
+            std::swap(screen[1], screen[2]);
+            area = -area;
+        }
+
+        Triangle triangle{};
+        float minX = std::min({screen[0].x, screen[1].x, screen[2].x});
+        float maxX = std::max({screen[0].x, screen[1].x, screen[2].x});
+        float minY = std::min({screen[0].y, screen[1].y, screen[2].y});
+        float maxY = std::max({screen[0].y, screen[1].y, screen[2].y});
+        if (maxX < 0.f || maxY < 0.f || minX >= WIDTH || minY >= HEIGHT) { continue; }
+        if (std::min({screen[0].z, screen[1].z, screen[2].z}) > 1.f) { continue; }
+        triangle.minX = std::max(0, static_cast<int>(std::floor(minX)));
+        triangle.maxX = std::min(static_cast<int>(WIDTH) - 1, static_cast<int>(std::floor(maxX)));
+        triangle.minY = std::max(0, static_cast<int>(std::floor(minY)));
+        triangle.maxY = std::min(static_cast<int>(HEIGHT) - 1, static_cast<int>(std::floor(maxY)));
+
+        for (int edge = 0; edge < 3; edge++) {
+            const glm::vec3 &a = screen[edge];
+            const glm::vec3 &b = screen[(edge + 1) % 3];
+            triangle.edgeA[edge] = a.y - b.y;
+            triangle.edgeB[edge] = b.x - a.x;
+            triangle.edgeC[edge] = -(triangle.edgeA[edge] * a.x + triangle.edgeB[edge] * a.y);
+        }
+
+        // Post-projection depth is affine in screen space
+        glm::vec3 d1 = screen[1] - screen[0];
+        glm::vec3 d2 = screen[2] - screen[0];
+        triangle.depthX = (d1.z * d2.y - d2.z * d1.y) / area;
+        triangle.depthY = (d2.z * d1.x - d1.z * d2.x) / area;
+        triangle.depthC = screen[0].z - triangle.depthX * screen[0].x - triangle.depthY * screen[0].y;
+        out.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::rasterizeTile(uint32_t tile) {
+    const int tileLeft = static_cast<int>((tile % TILES_X) * TILE_WIDTH);
+    const int tileTop = static_cast<int>((tile / TILES_X) * TILE_HEIGHT);
+    const int tileRight = tileLeft + TILE_WIDTH - 1;
+    const int tileBottom = tileTop + TILE_HEIGHT - 1;
+
+    for (int y = tileTop; y <= tileBottom; y++) {
+        std::fill_n(depth.begin() + y * WIDTH + tileLeft, TILE_WIDTH, 1.f);
+    }
+
+    for (const Triangle &triangle : triangles) {
+        if (triangle.maxX < tileLeft || triangle.minX > tileRight || triangle.maxY < tileTop || triangle.minY > tileBottom) { continue; }
+        // Spans start and end on lane boundaries, the extra lanes fail the edge tests
+        uint32_t xBegin = static_cast<uint32_t>(std::max(triangle.minX, tileLeft)) / LANES * LANES;
+        uint32_t xEnd = (static_cast<uint32_t>(std::min(triangle.maxX, tileRight)) / LANES + 1) * LANES;
+        for (int y = std::max(triangle.minY, tileTop); y <= std::min(triangle.maxY, tileBottom); y++) {
+            rasterizeSpan(triangle, static_cast<uint32_t>(y), xBegin, xEnd);
+        }
+    }
+
+    for (uint32_t blockY = tileTop / BLOCK_SIZE; blockY < (tileBottom + 1) / BLOCK_SIZE; blockY++) {
+        for (uint32_t blockX = tileLeft / BLOCK_SIZE; blockX < (tileRight + 1) / BLOCK_SIZE; blockX++) {
+            float farthest = 0.f;
+            for (uint32_t y = blockY * BLOCK_SIZE; y < (blockY + 1) * BLOCK_SIZE; y++) {
+                const float *row = depth.data() + y * WIDTH + blockX * BLOCK_SIZE;
+                for (uint32_t x = 0; x < BLOCK_SIZE; x++) { farthest = std::max(farthest, row[x]); }
+            }
+            blockDepth[blockY * BLOCKS_X + blockX] = farthest;
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeSpan(const Triangle &triangle, uint32_t y, uint32_t xBegin, uint32_t xEnd) {
+    const float centerY = static_cast<float>(y) + .5f;
+    const float row0 = triangle.edgeB[0] * centerY + triangle.edgeC[0];
+    const float row1 = triangle.edgeB[1] * centerY + triangle.edgeC[1];
+    const float row2 = triangle.edgeB[2] * centerY + triangle.edgeC[2];
+    const float rowDepth = triangle.depthY * centerY + triangle.depthC;
+    float *pixels = depth.data() + y * WIDTH;
+
+    for (uint32_t x = xBegin; x < xEnd; x += LANES) {
+        // Branch free lanes, kept simple enough to be auto-vectorized
+        float *lanes = pixels + x;
+        for (uint32_t lane = 0; lane < LANES; lane++) {
+            const float centerX = static_cast<float>(x + lane) + .5f;
+            const bool inside = (triangle.edgeA[0] * centerX + row0 >= 0.f) &
+                                (triangle.edgeA[1] * centerX + row1 >= 0.f) &
+                                (triangle.edgeA[2] * centerX + row2 >= 0.f);
+            const float z = triangle.depthX * centerX + rowDepth;
+            lanes[lane] = inside ? std::min(z, lanes[lane]) : lanes[lane];
+        }
+    }
+}
+
+bool OcclusionCuller::isOccluded(const Aabb &worldBox) const {
+    if (!valid) { return false; }
+
+    float minX = std::numeric_limits<float>::max(), maxX = -std::numeric_limits<float>::max();
+    float minY = std::numeric_limits<float>::max(), maxY = -std::numeric_limits<float>::max();
+    float nearest = std::numeric_limits<float>::max();
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 position{corner & 1 ? worldBox.max.x : worldBox.min.x, corner & 2 ? worldBox.max.y : worldBox.min.y, corner & 4 ? worldBox.max.z : worldBox.min.z};
+        glm::vec4 p = projectionView * glm::vec4(position, 1.f);
+        // Touching the near plane, the box may cover the whole view
+        if (p.w < MIN_W || p.z < 0.f) { return false; }
+        float invW = 1.f / p.w;
+        float x = (p.x * invW * .5f + .5f) * WIDTH;
+        float y = (p.y * invW * .5f + .5f) * HEIGHT;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, p.z * invW);
+    }
+    if (maxX < 0.f || maxY < 0.f || minX >= WIDTH || minY >= HEIGHT) { return false; }
+
+    const uint32_t x0 = static_cast<uint32_t>(std::max(minX, 0.f));
+    const uint32_t x1 = static_cast<uint32_t>(std::min(maxX, WIDTH - 1.f));
+    const uint32_t y0 = static_cast<uint32_t>(std::max(minY, 0.f));
+    const uint32_t y1 = static_cast<uint32_t>(std::min(maxY, HEIGHT - 1.f));
+
+    for (uint32_t blockY = y0 / BLOCK_SIZE; blockY <= y1 / BLOCK_SIZE; blockY++) {
+        for (uint32_t blockX = x0 / BLOCK_SIZE; blockX <= x1 / BLOCK_SIZE; blockX++) {
+            // Fully behind the farthest occluder depth of the block
+            if (nearest > blockDepth[blockY * BLOCKS_X + blockX]) { continue; }
+            for (uint32_t y = std::max(y0, blockY * BLOCK_SIZE); y <= std::min(y1, blockY * BLOCK_SIZE + BLOCK_SIZE - 1); y++) {
+                for (uint32_t x = std::max(x0, blockX * BLOCK_SIZE); x <= std::min(x1, blockX * BLOCK_SIZE + BLOCK_SIZE - 1); x++) {
+                    if (nearest <= depth[y * WIDTH + x]) { return false; }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void OcclusionCuller::cull(const EntityRegistry &scene, const SceneBvh &sceneBvh, std::vector<Entity> &entities) {
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t kept = 0;
+    for (Entity entity : entities) {
+        if (!isOccluded(sceneBvh.getWorldBounds(scene, entity))) { entities[kept++] = entity; }
+    }
+    stats.tested = static_cast<uint32_t>(entities.size());
+    stats.culled = static_cast<uint32_t>(entities.size() - kept);
+    entities.resize(kept);
+    stats.testMilliseconds = elapsedMilliseconds(start);
+}
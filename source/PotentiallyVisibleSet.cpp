@@ -0,0 +1,238 @@
+//
+//  PotentiallyVisibleSet.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/PotentiallyVisibleSet.hpp"
+
+//libs
+#include <glm/gtc/constants.hpp>
+
+//std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t FILE_MAGIC = 0x32535650;     // "PVS2"
+constexpr uint32_t UNBAKED = UINT32_MAX;
+
+// Zero bytes become a zero followed by the run length, everything else is copied
+void compressCell(const uint8_t *cell, uint32_t size, std::vector<uint8_t> &out) {
+    for (uint32_t i = 0; i < size; i++) {
+        out.push_back(cell[i]);
+        if (cell[i] != 0) { continue; }
+        uint32_t run = 1;
+        while (i + 1 < size && cell[i + 1] == 0 && run < 255) {
+            run++;
+            i++;
+        }
+        out.push_back(static_cast<uint8_t>(run));
+    }
+}
+
+void decompressCell(const uint8_t *data, size_t dataSize, size_t offset, uint8_t *cell, uint32_t size) {
+    for (uint32_t i = 0; i < size;) {
+        if (offset >= dataSize) { throw std::runtime_error("truncated PVS cell data!"); }
+        uint8_t value = data[offset++];
+        if (value != 0) {
+            cell[i++] = value;
+            continue;
+        }
+        if (offset >= dataSize) { throw std::runtime_error("truncated PVS cell data!"); }
+        uint32_t run = data[offset++];
+        if (run == 0 || i + run > size) { throw std::runtime_error("corrupted PVS cell data!"); }
+        std::memset(cell + i, 0, run);
+        i += run;
+    }
+}
+
+template<typename T>
+void writeValue(std::ofstream &file, const T &value) { file.write(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+template<typename T>
+void readValue(std::ifstream &file, T &value) {
+    if (!file.read(reinterpret_cast<char *>(&value), sizeof(T))) { throw std::runtime_error("truncated PVS file!"); }
+}
+
+}
+
+void PotentiallyVisibleSet::bake(
+    const std::vector<std::shared_ptr<MeshCollider>> &objects,
+    const std::vector<std::vector<Aabb>> &clusterBounds,
+    const BakeSettings &settings,
+    JobSystem &jobSystem) {
+    if (clusterBounds.size() != objects.size()) { throw std::runtime_error("PVS needs the cull clusters of every object!"); }
+    std::vector<Aabb> objectBounds{};
+    Aabb sceneBounds{};
+    for (const auto &object : objects) {
+        objectBounds.push_back(object->getBounds());
+        sceneBounds.grow(object->getBounds());
+    }
+    objectCount = static_cast<uint32_t>(objects.size());
+    if (objects.empty() || sceneBounds.isEmpty()) { throw std::runtime_error("nothing to bake the PVS against!"); }
+
+    glm::vec3 extent = sceneBounds.max - sceneBounds.min;
+    origin = sceneBounds.min;
+    cellSize = std::max(settings.cellSize, std::max({extent.x, extent.y, extent.z}) / settings.maxCellsPerAxis);
+    cellCounts = glm::max(glm::uvec3{1}, glm::uvec3(glm::ceil(extent / cellSize)));
+
+    // Hit points sit on a triangle of the cluster, the slack absorbs the error of reconstructing them from the ray
+    const float slack = .01f * cellSize;
+    clusterOffsets.assign(1, 0);
+    std::vector<Bvh> clusterBvhs(objectCount);
+    for (uint32_t object = 0; object < objectCount; object++) {
+        std::vector<Aabb> bounds = clusterBounds[object];
+        for (auto &box : bounds) {
+            box.min -= slack;
+            box.max += slack;
+        }
+        clusterBvhs[object].build(bounds);
+        clusterOffsets.push_back(clusterOffsets.back() + static_cast<uint32_t>(bounds.size()));
+    }
+    bits.assign(static_cast<size_t>(getCellCount()) * bytesPerCell(), 0);
+    baked.assign(getCellCount(), 0);
+
+    Bvh objectBvh{};
+    objectBvh.build(objectBounds);
+    const float maxDistance = 2.f * glm::length(extent) + cellSize;
+    auto trace = [&](const Ray &ray, uint32_t &hitObject, glm::vec3 &hitPoint) {
+        float tMax = maxDistance;
+        bool hit = objectBvh.intersect(ray, tMax, [&](uint32_t primitive, float &closest) {
+            glm::vec3 normal;
+            if (!objects[primitive]->intersect(ray, closest, normal)) { return false; }
+            hitObject = primitive;
+            return true;
+        });
+        hitPoint = ray.origin + ray.direction * tMax;
+        return hit;
+    };
+
+    // Cells only write their own bits, one job each
+    jobSystem.dispatch(getCellCount(), [&](uint32_t cell, uint32_t) {
+        glm::uvec3 coords{cell % cellCounts.x, (cell / cellCounts.x) % cellCounts.y, cell / (cellCounts.x * cellCounts.y)};
+        glm::vec3 cellMin = origin + glm::vec3(coords) * cellSize;
+        const Aabb cellBox{cellMin, cellMin + cellSize};
+
+        // Walkable space has a floor somewhere below it, down is +y
+        uint32_t hitObject;
+        glm::vec3 hitPoint;
+        if (!trace(Ray{cellMin + .5f * cellSize, {0.f, 1.f, 0.f}}, hitObject, hitPoint)) { return; }
+        baked[cell] = 1;
+
+        // Seeded by the cell so every bake of the same scene writes the same file
+        std::mt19937 generator{cell};
+        std::uniform_real_distribution<float> unit{0.f, 1.f};
+        uint8_t *cellBits = bits.data() + static_cast<size_t>(cell) * bytesPerCell();
+        uint8_t *cellClusterBits = cellBits + objectBytes();
+        auto markBit = [](uint8_t *bitSet, uint32_t index) { bitSet[index >> 3] |= static_cast<uint8_t>(1u << (index & 7)); };
+        auto markClusters = [&](uint32_t object, const Aabb &box) {
+            markBit(cellBits, object);
+            clusterBvhs[object].query(box, [&](uint32_t cluster) { markBit(cellClusterBits, clusterOffsets[object] + cluster); });
+        };
+
+        // Objects reaching into the cell can be arbitrarily close to the camera, rays easily miss them
+        for (uint32_t object = 0; object < objectCount; object++) {
+            const Aabb &box = objectBounds[object];
+            if (glm::all(glm::lessThanEqual(box.min, cellBox.max)) && glm::all(glm::greaterThanEqual(box.max, cellBox.min))) { markClusters(object, cellBox); }
+        }
+        for (uint32_t i = 0; i < settings.raysPerCell; i++) {
+            glm::vec3 rayOrigin = cellMin + cellSize * glm::vec3{unit(generator), unit(generator), unit(generator)};
+            float z = 2.f * unit(generator) - 1.f;
+            float phi = glm::two_pi<float>() * unit(generator);
+            float radius = std::sqrt(std::max(0.f, 1.f - z * z));
+            if (trace(Ray{rayOrigin, {radius * std::cos(phi), radius * std::sin(phi), z}}, hitObject, hitPoint)) {
+                markClusters(hitObject, Aabb{hitPoint, hitPoint});
+            }
+        }
+    });
+}
+
+void PotentiallyVisibleSet::save(const std::string &filePath) const {
+    std::vector<uint32_t> offsets(getCellCount(), UNBAKED);
+    std::vector<uint8_t> data{};
+    for (uint32_t cell = 0; cell < getCellCount(); cell++) {
+        if (!baked[cell]) { continue; }
+        offsets[cell] = static_cast<uint32_t>(data.size());
+        compressCell(bits.data() + static_cast<size_t>(cell) * bytesPerCell(), bytesPerCell(), data);
+    }
+
+    std::ofstream file{filePath, std::ios::binary};
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + filePath);
+    }
+    writeValue(file, FILE_MAGIC);
+    writeValue(file, origin);
+    writeValue(file, cellSize);
+    writeValue(file, cellCounts);
+    writeValue(file, objectCount);
+    file.write(reinterpret_cast<const char *>(clusterOffsets.data()), clusterOffsets.size() * sizeof(uint32_t));
+    writeValue(file, static_cast<uint32_t>(data.size()));
+    file.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+bool PotentiallyVisibleSet::load(const std::string &filePath, const std::vector<uint32_t> &clusterCounts) {
+    std::ifstream file{filePath, std::ios::binary};
+    if (!file.is_open()) { return false; }
+
+    uint32_t magic, dataSize;
+    readValue(file, magic);
+    if (magic != FILE_MAGIC) { throw std::runtime_error("not a PVS file: " + filePath); }
+    readValue(file, origin);
+    readValue(file, cellSize);
+    readValue(file, cellCounts);
+    readValue(file, objectCount);
+    if (objectCount != clusterCounts.size()) {
+        objectCount = 0;
+        return false;
+    }
+    clusterOffsets.resize(objectCount + 1);
+    if (!file.read(reinterpret_cast<char *>(clusterOffsets.data()), clusterOffsets.size() * sizeof(uint32_t))) {
+        throw std::runtime_error("truncated PVS file!");
+    }
+    // Meshes prepared differently since the bake have other clusters, their bits would hide the wrong ones
+    for (uint32_t object = 0; object < objectCount; object++) {
+        if (clusterOffsets[object + 1] - clusterOffsets[object] != clusterCounts[object]) {
+            objectCount = 0;
+            clusterOffsets.clear();
+            return false;
+        }
+    }
+    readValue(file, dataSize);
+
+    std::vector<uint32_t> offsets(getCellCount());
+    std::vector<uint8_t> data(dataSize);
+    if (!file.read(reinterpret_cast<char *>(offsets.data()), offsets.size() * sizeof(uint32_t)) ||
+        !file.read(reinterpret_cast<char *>(data.data()), data.size())) {
+        throw std::runtime_error("truncated PVS file!");
+    }
+
+    bits.assign(static_cast<size_t>(getCellCount()) * bytesPerCell(), 0);
+    baked.assign(getCellCount(), 0);
+    for (uint32_t cell = 0; cell < getCellCount(); cell++) {
+        if (offsets[cell] == UNBAKED) { continue; }
+        decompressCell(data.data(), data.size(), offsets[cell], bits.data() + static_cast<size_t>(cell) * bytesPerCell(), bytesPerCell());
+        baked[cell] = 1;
+    }
+    return true;
+}
+
+const uint8_t *PotentiallyVisibleSet::findCell(const glm::vec3 &position) const {
+    glm::vec3 local = (position - origin) / cellSize;
+    if (local.x < 0.f || local.y < 0.f || local.z < 0.f) { return nullptr; }
+    glm::uvec3 coords{local};
+    if (coords.x >= cellCounts.x || coords.y >= cellCounts.y || coords.z >= cellCounts.z) { return nullptr; }
+    uint32_t cell = coords.x + cellCounts.x * (coords.y + cellCounts.y * coords.z);
+    return baked[cell] ? bits.data() + static_cast<size_t>(cell) * bytesPerCell() : nullptr;
+}
+
+uint32_t PotentiallyVisibleSet::getBakedCellCount() const {
+    return static_cast<uint32_t>(std::count(baked.begin(), baked.end(), 1));
+}
@@ -0,0 +1,513 @@
+//
+//  RenderGraph.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/RenderGraph.hpp"
+
+//std
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    VkImageAspectFlags aspectOf(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D32_SFLOAT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT;
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            default:
+                return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    VkImageUsageFlags usageOf(RenderGraph::Access access) {
+        switch (access) {
+            case RenderGraph::Access::ColorAttachment: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            case RenderGraph::Access::DepthAttachment:
+            case RenderGraph::Access::DepthRead: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            case RenderGraph::Access::Sampled:
+            case RenderGraph::Access::ComputeSampled: return VK_IMAGE_USAGE_SAMPLED_BIT;
+            case RenderGraph::Access::StorageWrite: return VK_IMAGE_USAGE_STORAGE_BIT;
+            case RenderGraph::Access::TransferSrc: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            case RenderGraph::Access::TransferDst: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        }
+        return 0;
+    }
+
+    bool isAttachment(RenderGraph::Access access) {
+        return access == RenderGraph::Access::ColorAttachment || access == RenderGraph::Access::DepthAttachment || access == RenderGraph::Access::DepthRead;
+    }
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+RenderGraph::RenderGraph(Device &device) : device{device} {}
+
+RenderGraph::~RenderGraph() {
+    release();
+}
+
+RenderGraph::Resource RenderGraph::importImage(const std::string &name, VkImage image, VkImageView view, const ImageDesc &desc, VkImageLayout layout, VkImageLayout finalLayout) {
+    ResourceNode resource{};
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = true;
+    resource.image = image;
+    resource.view = view;
+    resource.initialLayout = layout;
+    resource.finalLayout = finalLayout;
+    resource.aspect = aspectOf(desc.format);
+    resources.push_back(resource);
+    return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::createImage(const std::string &name, const ImageDesc &desc) {
+    ResourceNode resource{};
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = false;
+    resource.aspect = aspectOf(desc.format);
+    resources.push_back(resource);
+    return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Pass RenderGraph::addPass(PassDesc pass) {
+    PassNode node{};
+    node.desc = std::move(pass);
+    passes.push_back(std::move(node));
+    return static_cast<Pass>(passes.size() - 1);
+}
+
+RenderGraph::AccessInfo RenderGraph::accessInfo(Access access, VkImageAspectFlags aspect) {
+    bool depth = aspect & VK_IMAGE_ASPECT_DEPTH_BIT;
+    VkImageLayout readLayout = depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    const VkPipelineStageFlags tests = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    switch (access) {
+        case Access::ColorAttachment:
+            return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true};
+        case Access::DepthAttachment:
+            return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, tests, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true};
+        case Access::DepthRead:
+            return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, tests, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, false};
+        case Access::Sampled:
+            return {readLayout, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, false};
+        case Access::ComputeSampled:
+            return {readLayout, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, false};
+        case Access::StorageWrite:
+            return {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, true};
+        case Access::TransferSrc:
+            return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, false};
+        case Access::TransferDst:
+            return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, true};
+    }
+    throw std::runtime_error("unknown render graph access!");
+}
+
+void RenderGraph::compile() {
+    release();
+    stats = {};
+
+    cullPasses();
+    std::vector<Pass> livePasses{};
+    for (Pass p = 0; p < passes.size(); p++) {
+        if (!passes[p].culled) { livePasses.push_back(p); }
+    }
+
+    allocateTransients(livePasses);
+    for (uint32_t i = 0; i < livePasses.size(); i++) {
+        createRenderPass(passes[livePasses[i]], i);
+    }
+    planBarriers(livePasses);
+
+    stats.passes = static_cast<uint32_t>(livePasses.size());
+    stats.culledPasses = static_cast<uint32_t>(passes.size() - livePasses.size());
+}
+
+void RenderGraph::cullPasses() {
+    // Walks back from the passes with visible results, a resource is needed while a later live pass reads what's in it
+    std::vector<bool> needed(resources.size(), false);
+    for (size_t p = passes.size(); p-- > 0;) {
+        auto &pass = passes[p];
+        bool live = pass.desc.sideEffects;
+        for (const auto &use : pass.desc.writes) {
+            live = live || resources[use.resource].imported || needed[use.resource];
+        }
+        pass.culled = !live;
+        if (!live) { continue; }
+
+        // Attachments not loaded are overwritten entirely, earlier writers of them no longer matter
+        for (const auto &use : pass.desc.writes) {
+            if (isAttachment(use.access) && use.loadOp != VK_ATTACHMENT_LOAD_OP_LOAD) { needed[use.resource] = false; }
+        }
+        for (const auto &use : pass.desc.writes) {
+            if (!isAttachment(use.access) || use.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) { needed[use.resource] = true; }
+        }
+        for (const auto &use : pass.desc.reads) { needed[use.resource] = true; }
+    }
+}
+
+void RenderGraph::allocateTransients(const std::vector<Pass> &livePasses) {
+    std::vector<VkPipelineStageFlags> lastStages(resources.size(), 0);
+    std::vector<VkAccessFlags> lastAccess(resources.size(), 0);
+    for (auto &resource : resources) {
+        resource.usage = 0;
+        resource.firstPass = UINT32_MAX;
+        resource.lastPass = 0;
+    }
+    for (uint32_t i = 0; i < livePasses.size(); i++) {
+        const auto &pass = passes[livePasses[i]];
+        for (const auto *uses : {&pass.desc.reads, &pass.desc.writes}) {
+            for (const auto &use : *uses) {
+                auto &resource = resources[use.resource];
+                auto info = accessInfo(use.access, resource.aspect);
+                resource.usage |= usageOf(use.access);
+                if (resource.firstPass == UINT32_MAX) { resource.firstPass = i; }
+                if (resource.lastPass != i) {
+                    lastStages[use.resource] = 0;
+                    lastAccess[use.resource] = 0;
+                }
+                resource.lastPass = i;
+                lastStages[use.resource] |= info.stages;
+                lastAccess[use.resource] |= info.access;
+            }
+        }
+    }
+
+    std::vector<Resource> transients{};
+    for (Resource r = 0; r < resources.size(); r++) {
+        auto &resource = resources[r];
+        if (resource.imported || resource.usage == 0) { continue; }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {resource.desc.extent.width, resource.desc.extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = resource.desc.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = resource.usage;
+        imageInfo.samples = resource.desc.samples;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateImage(device.device(), &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image!");
+        }
+        vkGetImageMemoryRequirements(device.device(), resource.image, &resource.requirements);
+        resource.size = resource.requirements.size;
+        transients.push_back(r);
+    }
+    if (transients.empty()) { return; }
+
+    // Largest first, each at the lowest offset clear of every placed image alive at the same time
+    std::sort(transients.begin(), transients.end(), [&](Resource a, Resource b) { return resources[a].size > resources[b].size; });
+    auto overlapsInTime = [&](const ResourceNode &a, const ResourceNode &b) { return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass; };
+    auto overlapsInMemory = [](const ResourceNode &a, const ResourceNode &b) { return a.offset < b.offset + b.size && b.offset < a.offset + a.size; };
+
+    uint32_t memoryTypeBits = UINT32_MAX;
+    VkDeviceSize heapSize = 0;
+    VkDeviceSize totalSize = 0;
+    std::vector<Resource> placed{};
+    for (auto r : transients) {
+        auto &resource = resources[r];
+        memoryTypeBits &= resource.requirements.memoryTypeBits;
+        if (memoryTypeBits == 0) {
+            throw std::runtime_error("transient images have no memory type in common!");
+        }
+
+        std::vector<VkDeviceSize> candidates{0};
+        for (auto q : placed) {
+            if (overlapsInTime(resource, resources[q])) {
+                candidates.push_back(alignUp(resources[q].offset + resources[q].size, resource.requirements.alignment));
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (auto candidate : candidates) {
+            resource.offset = candidate;
+            bool clear = std::none_of(placed.begin(), placed.end(), [&](Resource q) {
+                return overlapsInTime(resource, resources[q]) && overlapsInMemory(resource, resources[q]);
+            });
+            if (clear) { break; }
+        }
+        heapSize = std::max(heapSize, resource.offset + resource.size);
+        totalSize += resource.size;
+        placed.push_back(r);
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = heapSize;
+    allocInfo.memoryTypeIndex = device.findMemoryType(memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate render graph memory!");
+    }
+
+    for (auto r : transients) {
+        auto &resource = resources[r];
+        if (vkBindImageMemory(device.device(), resource.image, memory, resource.offset) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind render graph image memory!");
+        }
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = resource.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = resource.desc.format;
+        viewInfo.subresourceRange = {resource.aspect, 0, 1, 0, 1};
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &resource.view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image view!");
+        }
+
+        // The first use waits on whatever used the memory last, earlier in the frame or else in the previous one
+        VkPipelineStageFlags earlierStages = 0, anyStages = 0;
+        VkAccessFlags earlierAccess = 0, anyAccess = 0;
+        for (auto q : transients) {
+            if (!overlapsInMemory(resource, resources[q])) { continue; }
+            anyStages |= lastStages[q];
+            anyAccess |= lastAccess[q];
+            if (resources[q].lastPass < resource.firstPass) {
+                earlierStages |= lastStages[q];
+                earlierAccess |= lastAccess[q];
+            }
+        }
+        resource.aliasStages = earlierStages ? earlierStages : anyStages;
+        resource.aliasAccess = earlierStages ? earlierAccess : anyAccess;
+    }
+
+    stats.transientImages = static_cast<uint32_t>(transients.size());
+    stats.transientBytes = heapSize;
+    stats.aliasedBytes = totalSize - heapSize;
+}
+
+void RenderGraph::createRenderPass(PassNode &pass, uint32_t liveIndex) {
+    if (pass.desc.ownRenderPass) { return; }
+
+    std::vector<VkAttachmentDescription> attachments{};
+    std::vector<VkImageView> views{};
+    std::vector<VkAttachmentReference> colorReferences{};
+    VkAttachmentReference depthReference{};
+    bool hasDepth = false;
+
+    auto addAttachment = [&](const Use &use, bool write) {
+        const auto &resource = resources[use.resource];
+        auto info = accessInfo(use.access, resource.aspect);
+        // Stored only when someone looks at it afterwards, read only depth keeps its contents
+        bool store = !write || resource.imported || resource.lastPass > liveIndex;
+
+        VkAttachmentDescription attachment{};
+        attachment.format = resource.desc.format;
+        attachment.samples = resource.desc.samples;
+        attachment.loadOp = write ? use.loadOp : VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachment.storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        bool stencil = resource.aspect & VK_IMAGE_ASPECT_STENCIL_BIT;
+        attachment.stencilLoadOp = stencil ? attachment.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = stencil ? attachment.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        // Transitions are barriers recorded by execute, the render pass itself keeps every layout
+        attachment.initialLayout = info.layout;
+        attachment.finalLayout = info.layout;
+
+        VkAttachmentReference reference{static_cast<uint32_t>(attachments.size()), info.layout};
+        if (use.access == Access::ColorAttachment) {
+            colorReferences.push_back(reference);
+        } else {
+            depthReference = reference;
+            hasDepth = true;
+        }
+        attachments.push_back(attachment);
+        views.push_back(resource.view);
+        pass.clearValues.push_back(use.clearValue);
+        if (pass.extent.width == 0) { pass.extent = resource.desc.extent; }
+    };
+
+    for (const auto &use : pass.desc.writes) {
+        if (isAttachment(use.access)) { addAttachment(use, true); }
+    }
+    for (const auto &use : pass.desc.reads) {
+        if (use.access == Access::DepthRead) { addAttachment(use, false); }
+    }
+    if (attachments.empty()) { return; }
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+    subpass.pColorAttachments = colorReferences.data();
+    subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &pass.renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph render pass!");
+    }
+
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = pass.renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+    framebufferInfo.pAttachments = views.data();
+    framebufferInfo.width = pass.extent.width;
+    framebufferInfo.height = pass.extent.height;
+    framebufferInfo.layers = 1;
+    if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &pass.framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph framebuffer!");
+    }
+}
+
+void RenderGraph::planBarriers(const std::vector<Pass> &livePasses) {
+    struct State {
+        VkImageLayout layout;
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        bool written;
+        bool touched;
+    };
+    std::vector<State> states(resources.size());
+    for (Resource r = 0; r < resources.size(); r++) {
+        // Nothing is known about what happened to imported images before, their first barrier waits on everything
+        states[r] = resources[r].imported
+            ? State{resources[r].initialLayout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT, true, true}
+            : State{VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, false, false};
+    }
+
+    auto makeBarrier = [&](Resource r, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resources[r].image;
+        barrier.subresourceRange = {resources[r].aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+        return barrier;
+    };
+
+    for (auto p : livePasses) {
+        auto &pass = passes[p];
+        for (const auto *uses : {&pass.desc.reads, &pass.desc.writes}) {
+            for (const auto &use : *uses) {
+                auto &state = states[use.resource];
+                auto info = accessInfo(use.access, resources[use.resource].aspect);
+
+                // Reads following reads in the same layout need nothing, later writers then wait on all of them
+                if (state.touched && !state.written && !info.write && state.layout == info.layout) {
+                    state.stages |= info.stages;
+                    continue;
+                }
+
+                VkImageLayout oldLayout = state.touched ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+                VkPipelineStageFlags srcStages = state.touched ? state.stages : resources[use.resource].aliasStages;
+                VkAccessFlags srcAccess = state.touched ? (state.written ? state.access : 0) : resources[use.resource].aliasAccess;
+                pass.barriers.push_back(makeBarrier(use.resource, oldLayout, info.layout, srcAccess, info.access));
+                pass.srcStages |= srcStages;
+                pass.dstStages |= info.stages;
+                state = {info.layout, info.stages, info.access, info.write, true};
+            }
+        }
+        stats.barriers += static_cast<uint32_t>(pass.barriers.size());
+    }
+
+    // Whatever comes after the graph is unknown too, so imported images are handed back visible to everything
+    for (Resource r = 0; r < resources.size(); r++) {
+        const auto &resource = resources[r];
+        const auto &state = states[r];
+        if (!resource.imported || resource.usage == 0) { continue; }
+        if (state.layout == resource.finalLayout && !state.written) { continue; }
+        finalBarriers.push_back(makeBarrier(r, state.layout, resource.finalLayout, state.written ? state.access : 0, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT));
+        finalSrcStages |= state.stages;
+    }
+    stats.barriers += static_cast<uint32_t>(finalBarriers.size());
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+    for (auto &pass : passes) {
+        if (pass.culled) { continue; }
+
+        if (!pass.barriers.empty()) {
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                pass.srcStages ? pass.srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT), pass.dstStages,
+                0,
+                0, nullptr,
+                0, nullptr,
+                static_cast<uint32_t>(pass.barriers.size()), pass.barriers.data());
+        }
+
+        if (pass.renderPass == VK_NULL_HANDLE) {
+            if (pass.desc.record) { pass.desc.record(commandBuffer); }
+            continue;
+        }
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = pass.renderPass;
+        renderPassInfo.framebuffer = pass.framebuffer;
+        renderPassInfo.renderArea = {{0, 0}, pass.extent};
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+        renderPassInfo.pClearValues = pass.clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport{0.f, 0.f, static_cast<float>(pass.extent.width), static_cast<float>(pass.extent.height), 0.f, 1.f};
+        VkRect2D scissor{{0, 0}, pass.extent};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        if (pass.desc.record) { pass.desc.record(commandBuffer); }
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    if (!finalBarriers.empty()) {
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            finalSrcStages, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            static_cast<uint32_t>(finalBarriers.size()), finalBarriers.data());
+    }
+}
+
+void RenderGraph::reset() {
+    release();
+    resources.clear();
+    passes.clear();
+    stats = {};
+}
+
+void RenderGraph::release() {
+    for (auto &pass : passes) {
+        vkDestroyFramebuffer(device.device(), pass.framebuffer, nullptr);
+        vkDestroyRenderPass(device.device(), pass.renderPass, nullptr);
+        pass.framebuffer = VK_NULL_HANDLE;
+        pass.renderPass = VK_NULL_HANDLE;
+        pass.extent = {0, 0};
+        pass.clearValues.clear();
+        pass.barriers.clear();
+        pass.srcStages = 0;
+        pass.dstStages = 0;
+    }
+    for (auto &resource : resources) {
+        if (resource.imported) { continue; }
+        vkDestroyImageView(device.device(), resource.view, nullptr);
+        vkDestroyImage(device.device(), resource.image, nullptr);
+        resource.view = VK_NULL_HANDLE;
+        resource.image = VK_NULL_HANDLE;
+    }
+    vkFreeMemory(device.device(), memory, nullptr);
+    memory = VK_NULL_HANDLE;
+    finalBarriers.clear();
+    finalSrcStages = 0;
+}
@@ -0,0 +1,134 @@
+//
+//  RenderQueue.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/RenderQueue.hpp"
+
+//std
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+static_assert(Model::MAX_LODS <= 4, "the key holds the level of detail in 2 bits");
+
+uint64_t RenderQueue::makeKey(Pass pass, uint8_t pipelineId, uint16_t materialId, const Model *model, uint8_t lod, float viewDepth) {
+    // Bits of a non-negative float sort like the value, the top 24 keep enough precision for ordering
+    float depth = std::max(viewDepth, 0.f);
+    uint32_t depthBits;
+    std::memcpy(&depthBits, &depth, sizeof(float));
+    uint64_t depthKey = depthBits >> 8;
+    if (pass == Pass::Transparent) { depthKey = 0xFFFFFF - depthKey; }
+
+    // Only meant to group instances, a collision just splits a run since batching compares pointers
+    // Levels of one model share its buffers, keeping them adjacent saves the rebind
+    uint64_t modelKey = ((reinterpret_cast<uintptr_t>(model) >> 4) & 0x3FF) << 2 | (lod & 0x3);
+
+    return (static_cast<uint64_t>(pass) & 0xF) << 60 |
+        static_cast<uint64_t>(pipelineId) << 52 |
+        static_cast<uint64_t>(materialId) << 36 |
+        modelKey << 24 |
+        (depthKey & 0xFFFFFF);
+}
+
+void RenderQueue::sort() {
+    // LSD radix sort, one byte per pass, passes where every key shares the byte are skipped
+    scratch.resize(packets.size());
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        std::array<size_t, 257> offsets{};
+        for (const auto &packet : packets) { offsets[((packet.key >> shift) & 0xFF) + 1]++; }
+        if (std::any_of(offsets.begin() + 1, offsets.end(), [&](size_t count) { return count == packets.size(); })) { continue; }
+
+        for (size_t i = 1; i < offsets.size(); i++) { offsets[i] += offsets[i - 1]; }
+        for (const auto &packet : packets) { scratch[offsets[(packet.key >> shift) & 0xFF]++] = packet; }
+        packets.swap(scratch);
+    }
+}
+
+void RenderQueue::submit(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool positionsOnly, const PushConstantsFn &pushConstants) {
+    stats = submitRange(commandBuffer, pipelineLayout, positionsOnly, pushConstants, 0, packets.size());
+}
+
+RenderQueue::Stats RenderQueue::submitRange(
+    VkCommandBuffer commandBuffer,
+    VkPipelineLayout pipelineLayout,
+    bool positionsOnly,
+    const PushConstantsFn &pushConstants,
+    size_t begin,
+    size_t end) const {
+    Stats rangeStats{};
+
+    Pipeline *boundPipeline = nullptr;
+    VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+    Model *boundModel = nullptr;
+
+    size_t i = begin;
+    while (i < end) {
+        const auto &packet = packets[i];
+        
+        // Extend the run while nothing but per-instance data changes
+        size_t runEnd = i + 1;
+        while (runEnd < end && sharesDraw(packet, packets[runEnd])) { runEnd++; }
+        
+        if (packet.pipeline != boundPipeline) {
+            packet.pipeline->bind(commandBuffer);
+            boundPipeline = packet.pipeline;
+            rangeStats.pipelineBinds++;
+        } else {
+            rangeStats.skippedBinds++;
+        }
+
+        if (packet.descriptorSet != boundDescriptorSet) {
+            vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                pipelineLayout,
+                0,
+                1,
+                &packet.descriptorSet,
+                0,
+                nullptr
+            );
+            boundDescriptorSet = packet.descriptorSet;
+            rangeStats.descriptorBinds++;
+        } else {
+            rangeStats.skippedBinds++;
+        }
+
+        if (packet.model != boundModel) {
+            if (positionsOnly) {
+                packet.model->bindPositionsOnly(commandBuffer);
+            } else {
+                packet.model->bind(commandBuffer);
+            }
+            boundModel = packet.model;
+            rangeStats.bufferBinds++;
+        } else {
+            rangeStats.skippedBinds++;
+        }
+
+        pushConstants(commandBuffer, packet);
+        packet.model->draw(commandBuffer, static_cast<uint32_t>(runEnd - i), static_cast<uint32_t>(i), packet.lod);
+        rangeStats.draws++;
+        rangeStats.instances += static_cast<uint32_t>(runEnd - i);
+        rangeStats.triangles += static_cast<uint32_t>(runEnd - i) * (packet.model->getLod(packet.lod).indexCount / 3);
+        i = runEnd;
+    }
+    return rangeStats;
+}
+
+void RenderQueue::collectRunsFrontToBack(std::vector<Run> &runs) const {
+    runs.clear();
+    size_t i = 0;
+    while (i < packets.size()) {
+        size_t runEnd = i + 1;
+        while (runEnd < packets.size() && sharesDraw(packets[i], packets[runEnd])) { runEnd++; }
+        
+        // Depth is the lowest key field, the first packet of a run is its nearest
+        runs.push_back({static_cast<uint32_t>(i), static_cast<uint32_t>(runEnd - i), static_cast<uint32_t>(packets[i].key & 0xFFFFFF)});
+        i = runEnd;
+    }
+    std::sort(runs.begin(), runs.end(), [](const Run &a, const Run &b) { return a.depthKey < b.depthKey; });
+}
@@ -9,16 +9,25 @@
 
 
 //std
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
 
+// Per-model data, constant across an instanced draw
 struct PushConstantData {
+  glm::vec4 boundsMin{0.f};
+  glm::vec4 boundsExtent{1.f};
+};
+
+// std430 layout of InstanceData in shader.vert
+struct InstanceData {
   glm::mat4 modelMatrix{1.f};
+  glm::vec4 color{};
   int textureIndex{};
   float metalness{};
   float roughness{};
-  alignas(16) glm::vec3 color{};
+  float padding{};
 };
 
 RenderSystem::RenderSystem(
@@ -26,19 +35,36 @@ RenderSystem::RenderSystem(
     VkRenderPass renderPass,
     VkDescriptorSetLayout globalSetLayout,
     std::string dynamicShaderPath,
-    VkSampleCountFlagBits samples) : device{passDevice}, shaderPath{dynamicShaderPath}, sampleCount{samples} {
+    VkSampleCountFlagBits samples,
+    VertexInput input,
+    bool instanced) : device{passDevice}, shaderPath{dynamicShaderPath}, sampleCount{samples}, vertexInput{input}, instanced{instanced} {
   createPipelineLayout(globalSetLayout);
   createPipeline(renderPass);
+  if (instanced) { createInstanceBuffers(); }
 }
 
 RenderSystem::~RenderSystem() {
   vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
 }
 
+void RenderSystem::createInstanceBuffers() {
+  for (auto &instanceBuffer : instanceBuffers) {
+    instanceBuffer = std::make_unique<Buffer>(
+        device,
+        sizeof(InstanceData),
+        MAX_INSTANCES,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    instanceBuffer->map();
+  }
+}
+
 void RenderSystem::recreatePipeline(VkRenderPass renderPass, VkSampleCountFlagBits samples) {
     pipeline.reset();
+    packedPipeline.reset();
     sampleCount = samples;
     createPipeline(renderPass);
+    if (!depthShaderPath.empty()) { createDepthPrepassPipelines(renderPass, depthShaderPath); }
 }
 
 void RenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
@@ -80,57 +106,471 @@ void RenderSystem::createPipeline(VkRenderPass renderPass) {
     pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
     pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
     pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    
+    if (vertexInput == VertexInput::Positions) {
+        pipelineConfig.bindingDescriptions = Model::getPositionBindingDescriptions();
+        pipelineConfig.attributeDescriptions = Model::getPositionAttributeDescriptions();
+    }
 
     pipeline = std::make_unique<Pipeline>(
         device,
         shaderPath+".vert.spv",
         shaderPath+".frag.spv",
         pipelineConfig);
+    
+    if (vertexInput != VertexInput::PackedAttributes) { return; }
+    
+    // Packed variant, the vertex shader switches decode on constant_id 0
+    VkBool32 packed = VK_TRUE;
+    VkSpecializationMapEntry specializationEntry{0, 0, sizeof(VkBool32)};
+    VkSpecializationInfo specializationInfo{1, &specializationEntry, sizeof(VkBool32), &packed};
+    pipelineConfig.bindingDescriptions = Model::PackedVertex::getBindingDescriptions();
+    pipelineConfig.attributeDescriptions = Model::PackedVertex::getAttributeDescriptions();
+    pipelineConfig.vertexSpecializationInfo = &specializationInfo;
+    
+    packedPipeline = std::make_unique<Pipeline>(
+        device,
+        shaderPath+".vert.spv",
+        shaderPath+".frag.spv",
+        pipelineConfig);
     }
 
+void RenderSystem::createDeferredPipelines(
+    VkRenderPass renderPass,
+    uint32_t subpass,
+    const std::string &fragmentShaderPath,
+    uint32_t colorAttachmentCount,
+    bool depthWrite) {
+  assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+  
+    PipelineConfigInfo pipelineConfig{};
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.subpass = subpass;
+    pipelineConfig.pipelineLayout = pipelineLayout;
+    pipelineConfig.depthStencilInfo.depthWriteEnable = depthWrite ? VK_TRUE : VK_FALSE;
+    
+    pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+    pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    
+    // G-buffer channels hold material data, nothing to blend
+    std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(colorAttachmentCount, pipelineConfig.colorBlendAttachment);
+    for (auto &blendAttachment : blendAttachments) { blendAttachment.blendEnable = VK_FALSE; }
+    pipelineConfig.colorBlendInfo.attachmentCount = colorAttachmentCount;
+    pipelineConfig.colorBlendInfo.pAttachments = blendAttachments.data();
+    
+    if (vertexInput == VertexInput::Positions) {
+        pipelineConfig.bindingDescriptions = Model::getPositionBindingDescriptions();
+        pipelineConfig.attributeDescriptions = Model::getPositionAttributeDescriptions();
+    }
+    
+    deferredPipeline = std::make_unique<Pipeline>(
+        device,
+        shaderPath+".vert.spv",
+        fragmentShaderPath+".frag.spv",
+        pipelineConfig);
+    
+    if (vertexInput != VertexInput::PackedAttributes) { return; }
+    
+    VkBool32 packed = VK_TRUE;
+    VkSpecializationMapEntry specializationEntry{0, 0, sizeof(VkBool32)};
+    VkSpecializationInfo specializationInfo{1, &specializationEntry, sizeof(VkBool32), &packed};
+    pipelineConfig.bindingDescriptions = Model::PackedVertex::getBindingDescriptions();
+    pipelineConfig.attributeDescriptions = Model::PackedVertex::getAttributeDescriptions();
+    pipelineConfig.vertexSpecializationInfo = &specializationInfo;
+    
+    deferredPackedPipeline = std::make_unique<Pipeline>(
+        device,
+        shaderPath+".vert.spv",
+        fragmentShaderPath+".frag.spv",
+        pipelineConfig);
+}
+
+void RenderSystem::createDepthPrepassPipelines(VkRenderPass renderPass, const std::string &depthShaderPath) {
+  assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+  this->depthShaderPath = depthShaderPath;
+  
+    PipelineConfigInfo pipelineConfig{};
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.pipelineLayout = pipelineLayout;
+    pipelineConfig.multisampleInfo.rasterizationSamples = sampleCount;
+    
+    pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+    pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    
+    // Depth only, the color attachment is left alone
+    pipelineConfig.colorBlendAttachment.blendEnable = VK_FALSE;
+    pipelineConfig.colorBlendAttachment.colorWriteMask = 0;
+    pipelineConfig.bindingDescriptions = Model::getPositionBindingDescriptions();
+    pipelineConfig.attributeDescriptions = Model::getPositionAttributeDescriptions();
+    
+    depthPipeline = std::make_unique<Pipeline>(
+        device,
+        depthShaderPath+".vert.spv",
+        depthShaderPath+".frag.spv",
+        pipelineConfig);
+    
+    // Packed models keep their quantized positions, a float stream would not land on the same depth
+    VkBool32 packed = VK_TRUE;
+    VkSpecializationMapEntry specializationEntry{0, 0, sizeof(VkBool32)};
+    VkSpecializationInfo specializationInfo{1, &specializationEntry, sizeof(VkBool32), &packed};
+    if (vertexInput == VertexInput::PackedAttributes) {
+        pipelineConfig.bindingDescriptions = Model::PackedVertex::getBindingDescriptions();
+        pipelineConfig.attributeDescriptions = {Model::PackedVertex::getAttributeDescriptions()[0]};
+        pipelineConfig.vertexSpecializationInfo = &specializationInfo;
+        
+        depthPackedPipeline = std::make_unique<Pipeline>(
+            device,
+            depthShaderPath+".vert.spv",
+            depthShaderPath+".frag.spv",
+            pipelineConfig);
+    }
+    
+    // Forward variants, only the fragments that won the prepass survive the EQUAL test
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.pipelineLayout = pipelineLayout;
+    pipelineConfig.multisampleInfo.rasterizationSamples = sampleCount;
+    pipelineConfig.multisampleInfo.sampleShadingEnable = VK_TRUE;
+    pipelineConfig.multisampleInfo.minSampleShading = .2f;
+    
+    pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+    pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+    pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+    
+    equalPipeline = std::make_unique<Pipeline>(
+        device,
+        shaderPath+".vert.spv",
+        shaderPath+".frag.spv",
+        pipelineConfig);
+    
+    if (vertexInput != VertexInput::PackedAttributes) { return; }
+    
+    pipelineConfig.bindingDescriptions = Model::PackedVertex::getBindingDescriptions();
+    pipelineConfig.attributeDescriptions = Model::PackedVertex::getAttributeDescriptions();
+    pipelineConfig.vertexSpecializationInfo = &specializationInfo;
+    
+    equalPackedPipeline = std::make_unique<Pipeline>(
+        device,
+        shaderPath+".vert.spv",
+        shaderPath+".frag.spv",
+        pipelineConfig);
+}
+
+Pipeline *RenderSystem::selectPipeline(bool packed) const {
+  if (deferred) { return packed ? deferredPackedPipeline.get() : deferredPipeline.get(); }
+  if (depthPrepass) { return packed ? equalPackedPipeline.get() : equalPipeline.get(); }
+  return packed ? packedPipeline.get() : pipeline.get();
+}
+
+void RenderSystem::buildRenderQueue(FrameInfo &frameInfo) {
+  glm::vec3 cameraPosition{frameInfo.camera.getInverseView()[3]};
+
+  auto &scene = frameInfo.scene;
+  auto &transforms = scene.getTransforms();
+  auto &renderables = scene.view<RenderComponent>();
+
+  // Without a scene BVH every renderable is submitted
+  const std::vector<Entity> *entities = &renderables.getEntities();
+  if (frameInfo.sceneBvh) {
+    frameInfo.sceneBvh->cullFrustum(frameInfo.camera.getProjection() * frameInfo.camera.getView(), visibleEntities);
+    entities = &visibleEntities;
+  }
+  culledCount = static_cast<uint32_t>(renderables.size() - entities->size());
+  
+  // Baked visibility of the camera cell, entities outside the PVS are always kept
+  pvsCulledCount = 0;
+  if (frameInfo.pvsCell) {
+    if (entities != &visibleEntities) { visibleEntities = *entities; }
+    auto kept = std::remove_if(visibleEntities.begin(), visibleEntities.end(), [&](Entity entity) {
+      return scene.has<PvsComponent>(entity) && !PotentiallyVisibleSet::isVisible(frameInfo.pvsCell, scene.get<PvsComponent>(entity).object);
+    });
+    pvsCulledCount = static_cast<uint32_t>(visibleEntities.end() - kept);
+    visibleEntities.erase(kept, visibleEntities.end());
+    entities = &visibleEntities;
+  }
+  if (frameInfo.sceneBvh && frameInfo.occlusionCuller) {
+    frameInfo.occlusionCuller->cull(scene, *frameInfo.sceneBvh, visibleEntities);
+  }
+
+  renderQueue.clear();
+  lodCounts.fill(0);
+  const float projectionScale = frameInfo.camera.getProjection()[1][1];
+  for (const Entity entity : *entities) {
+    if (!scene.isRenderable(entity)) { continue; }
+    Model *model = scene.get<RenderComponent>(entity).model.get();
+    const auto &material = scene.get<MaterialComponent>(entity);
+    uint8_t lod = selectLod(entity, *model, transforms.getWorldMatrix(scene.getTransform(entity)), cameraPosition, projectionScale);
+    
+    // Positions-only pipelines read the float position stream whatever the attribute format
+    bool packed = vertexInput != VertexInput::Positions && model->getVertexFormat() == Model::VertexFormat::Packed;
+    assert((!packed || packedPipeline) && "Packed model drawn by a RenderSystem without packed vertex support");
+    
+    RenderQueue::Packet packet{};
+    packet.key = RenderQueue::makeKey(
+        RenderQueue::Pass::Opaque,
+        packed ? 1 : 0,
+        static_cast<uint16_t>(material.textureIndex),
+        model,
+        lod,
+        glm::length(transforms.getWorldPosition(scene.getTransform(entity)) - cameraPosition));
+    packet.pipeline = selectPipeline(packed);
+    packet.descriptorSet = frameInfo.globalDescriptorSet[material.textureIndex];
+    packet.model = model;
+    packet.entity = entity;
+    packet.lod = lod;
+    renderQueue.push(packet);
+  }
+  renderQueue.sort();
+  
+  if (renderQueue.getPackets().size() > MAX_INSTANCES) {
+    throw std::runtime_error("too many objects for the instance buffer!");
+  }
+}
+
+uint8_t RenderSystem::selectLod(Entity entity, const Model &model, const glm::mat4 &world, const glm::vec3 &cameraPosition, float projectionScale) {
+  if (entity.index >= entityLods.size()) { entityLods.resize(entity.index + 1, 0); }
+  uint32_t lod = std::min<uint32_t>(entityLods[entity.index], model.getLodCount() - 1);
+  
+  const glm::vec3 center{world * glm::vec4(model.getBoundsMin() + .5f * model.getBoundsExtent(), 1.f)};
+  const float scale = std::max({glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))});
+  const float radius = .5f * glm::length(model.getBoundsExtent()) * scale;
+  const float distanceSquared = glm::dot(center - cameraPosition, center - cameraPosition);
+  
+  if (model.getLodCount() == 1 || distanceSquared <= radius * radius) {
+    lod = 0;
+  } else {
+    // Projected bounding sphere radius in pixels, a level's error covers the same fraction of it as of the radius
+    const float projectedRadius = radius * projectionScale * .5f * lodViewportHeight / std::sqrt(distanceSquared - radius * radius);
+    auto pixelError = [&](uint32_t level) { return model.getLod(level).error * scale / radius * projectedRadius; };
+    
+    // Coarser levels need a margin below the target, so a sphere sitting on a threshold doesn't flicker
+    while (lod > 0 && pixelError(lod) > lodPixelError) { lod--; }
+    while (lod + 1 < model.getLodCount() && pixelError(lod + 1) <= lodPixelError * (1.f - LOD_HYSTERESIS)) { lod++; }
+  }
+  
+  entityLods[entity.index] = static_cast<uint8_t>(lod);
+  lodCounts[lod]++;
+  return static_cast<uint8_t>(lod);
+}
+
+void RenderSystem::writeInstances(FrameInfo &frameInfo, size_t begin, size_t end) {
+  if (!instanced) { return; }
+  // Packet i is instance i, ranges never overlap so jobs can write concurrently
+  auto &packets = renderQueue.getPackets();
+  for (size_t i = begin; i < end; i++) {
+    writeInstance(frameInfo, packets[i].entity, static_cast<int>(i));
+  }
+}
+
+void RenderSystem::writeInstance(FrameInfo &frameInfo, Entity entity, int slot) {
+  const auto &scene = frameInfo.scene;
+  assert(scene.isRenderable(entity) && "Instance written for an entity without material or transform");
+  const auto &material = scene.get<MaterialComponent>(entity);
+  
+  InstanceData instance{};
+  instance.modelMatrix = scene.getTransforms().getWorldMatrix(scene.getTransform(entity));
+  instance.color = glm::vec4(material.color, 1.f);
+  instance.textureIndex = material.textureIndex;
+  instance.metalness = material.metalness;
+  instance.roughness = material.roughness;
+  instanceBuffers[frameInfo.frameIndex]->writeToIndex(&instance, slot);
+}
+
+void RenderSystem::pushConstants(VkCommandBuffer commandBuffer, const Model *model) {
+  PushConstantData push{};
+  push.boundsMin = glm::vec4(model->getBoundsMin(), 0.f);
+  push.boundsExtent = glm::vec4(model->getBoundsExtent(), 0.f);
+
+  vkCmdPushConstants(
+      commandBuffer,
+      pipelineLayout,
+      VK_SHADER_STAGE_ALL_GRAPHICS,
+      0,
+      sizeof(PushConstantData),
+      &push);
+}
+
 void RenderSystem::renderSolidObjects(FrameInfo &frameInfo) {
-  pipeline->bind(frameInfo.commandBuffer);
+  buildRenderQueue(frameInfo);
+  writeInstances(frameInfo, 0, renderQueue.getPackets().size());
+  renderQueue.submit(
+      frameInfo.commandBuffer,
+      pipelineLayout,
+      vertexInput == VertexInput::Positions,
+      [this](VkCommandBuffer commandBuffer, const RenderQueue::Packet &packet) { pushConstants(commandBuffer, packet.model); });
+}
+
+std::vector<VkCommandBuffer> RenderSystem::recordSolidObjects(
+    FrameInfo &frameInfo,
+    JobSystem &jobSystem,
+    const std::function<VkCommandBuffer(uint32_t workerIndex)> &beginSecondary) {
+  // Below this many draws per job, the extra bind state of a new buffer costs more than it saves
+  constexpr size_t MIN_DRAWS_PER_JOB = 256;
 
-  for (auto &kv : frameInfo.solidObjects) {
-    auto &obj = kv.second;
+  buildRenderQueue(frameInfo);
+  const size_t drawCount = renderQueue.getPackets().size();
+  if (drawCount == 0) { return {}; }
+  
+  const uint32_t jobCount = static_cast<uint32_t>(std::min<size_t>(
+      jobSystem.getWorkerCount(),
+      (drawCount + MIN_DRAWS_PER_JOB - 1) / MIN_DRAWS_PER_JOB));
+  std::vector<VkCommandBuffer> secondaryBuffers(jobCount);
+  std::vector<RenderQueue::Stats> jobStats(jobCount);
+  
+  jobSystem.dispatch(jobCount, [&](uint32_t jobIndex, uint32_t workerIndex) {
+    size_t begin = drawCount * jobIndex / jobCount;
+    size_t end = drawCount * (jobIndex + 1) / jobCount;
     
+    writeInstances(frameInfo, begin, end);
+    
+    VkCommandBuffer commandBuffer = beginSecondary(workerIndex);
+    jobStats[jobIndex] = renderQueue.submitRange(
+        commandBuffer,
+        pipelineLayout,
+        vertexInput == VertexInput::Positions,
+        [this](VkCommandBuffer commandBuffer, const RenderQueue::Packet &packet) { pushConstants(commandBuffer, packet.model); },
+        begin,
+        end);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record secondary command buffer!");
+    }
+    secondaryBuffers[jobIndex] = commandBuffer;
+  });
+  
+  RenderQueue::Stats frameStats{};
+  for (const auto &stats : jobStats) { frameStats += stats; }
+  renderQueue.setStats(frameStats);
+  return secondaryBuffers;
+}
+
+std::vector<VkCommandBuffer> RenderSystem::recordIndirect(
+    FrameInfo &frameInfo,
+    GpuCulling &gpuCulling,
+    const std::function<VkCommandBuffer(uint32_t workerIndex)> &beginSecondary) {
+  assert(instanced && "GPU driven draws need the instance buffers");
+  const auto &objects = gpuCulling.getObjects();
+  if (objects.size() > MAX_INSTANCES) {
+    throw std::runtime_error("too many objects for the instance buffer!");
+  }
+  // Every object is written, the cull pass reads the matrices of the ones it rejects too
+  for (size_t i = 0; i < objects.size(); i++) {
+    writeInstance(frameInfo, objects[i], static_cast<int>(i));
+  }
+  culledCount = 0;
+  
+  const auto &batches = gpuCulling.getBatches();
+  if (batches.empty()) { return {}; }
+  
+  // A handful of binds per batch, not worth splitting across workers
+  RenderQueue::Stats stats{};
+  VkCommandBuffer commandBuffer = beginSecondary(0);
+  Pipeline *boundPipeline = nullptr;
+  for (uint32_t i = 0; i < batches.size(); i++) {
+    const auto &batch = batches[i];
+    bool packed = vertexInput != VertexInput::Positions && batch.model->getVertexFormat() == Model::VertexFormat::Packed;
+    assert((!packed || packedPipeline) && "Packed model drawn by a RenderSystem without packed vertex support");
+    
+    Pipeline *batchPipeline = selectPipeline(packed);
+    if (batchPipeline != boundPipeline) {
+      batchPipeline->bind(commandBuffer);
+      boundPipeline = batchPipeline;
+      stats.pipelineBinds++;
+    }
     vkCmdBindDescriptorSets(
-        frameInfo.commandBuffer,
+        commandBuffer,
         VK_PIPELINE_BIND_POINT_GRAPHICS,
         pipelineLayout,
         0,
         1,
-        &frameInfo.globalDescriptorSet[obj.textureIndex],
-        0,
-        nullptr
-    );
-    
-    PushConstantData push{};
-    push.modelMatrix = obj.transform.mat4();
-    push.textureIndex = obj.textureIndex;
-    push.metalness = obj.metalness;
-    push.roughness = obj.roughness;
-    push.color = obj.color;
-
-    vkCmdPushConstants(
-        frameInfo.commandBuffer,
-        pipelineLayout,
-        VK_SHADER_STAGE_ALL_GRAPHICS,
+        &frameInfo.globalDescriptorSet[batch.textureIndex],
         0,
-        sizeof(PushConstantData),
-        &push);
-        
-    /*
-    vkCmdPushConstants(
-        frameInfo.commandBuffer,
-        pipelineLayout,
-        VK_SHADER_STAGE_FRAGMENT_BIT,
-        sizeof(PushConstantData), // offset by previus push_constant size
-        sizeof(PushConstant2),
-        &push2);
-    */
-        
-    obj.model->bind(frameInfo.commandBuffer);
-    obj.model->draw(frameInfo.commandBuffer);
+        nullptr);
+    if (vertexInput == VertexInput::Positions) {
+      batch.model->bindPositionsOnly(commandBuffer);
+    } else {
+      batch.model->bind(commandBuffer);
+    }
+    pushConstants(commandBuffer, batch.model);
+    gpuCulling.drawBatch(commandBuffer, frameInfo.frameIndex, i);
+    stats.descriptorBinds++;
+    stats.bufferBinds++;
+    stats.draws++;
+  }
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record secondary command buffer!");
+  }
+  
+  stats.instances = static_cast<uint32_t>(objects.size());
+  stats.triangles = gpuCulling.getLastDrawnTriangleCount();
+  renderQueue.setStats(stats);
+  return {commandBuffer};
+}
+
+std::vector<VkCommandBuffer> RenderSystem::recordDepthPrepass(
+    FrameInfo &frameInfo,
+    GpuCulling *gpuCulling,
+    const std::function<VkCommandBuffer(uint32_t workerIndex)> &beginSecondary) {
+  if (!depthPrepass) { return {}; }
+  
+  // Position only draws are cheap to record, one buffer is enough
+  VkCommandBuffer commandBuffer = beginSecondary(0);
+  Pipeline *boundPipeline = nullptr;
+  Model *boundModel = nullptr;
+  
+  // Every material set holds the same UBO and instance buffer, the first one serves all draws
+  vkCmdBindDescriptorSets(
+      commandBuffer,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      pipelineLayout,
+      0,
+      1,
+      &frameInfo.globalDescriptorSet[0],
+      0,
+      nullptr);
+  
+  auto bindModel = [&](Model *model) {
+    bool packed = vertexInput == VertexInput::PackedAttributes && model->getVertexFormat() == Model::VertexFormat::Packed;
+    Pipeline *modelPipeline = packed ? depthPackedPipeline.get() : depthPipeline.get();
+    if (modelPipeline != boundPipeline) {
+      modelPipeline->bind(commandBuffer);
+      boundPipeline = modelPipeline;
+    }
+    if (model != boundModel) {
+      if (packed) {
+        model->bind(commandBuffer);
+      } else {
+        model->bindPositionsOnly(commandBuffer);
+      }
+      boundModel = model;
+    }
+    pushConstants(commandBuffer, model);
+  };
+  
+  if (gpuCulling) {
+    // Batches come in material order, the GPU decides which of their instances are drawn
+    const auto &batches = gpuCulling->getBatches();
+    for (uint32_t i = 0; i < batches.size(); i++) {
+      bindModel(batches[i].model);
+      gpuCulling->drawBatch(commandBuffer, frameInfo.frameIndex, i);
+    }
+  } else {
+    const auto &packets = renderQueue.getPackets();
+    renderQueue.collectRunsFrontToBack(depthRuns);
+    for (const auto &run : depthRuns) {
+      const auto &packet = packets[run.first];
+      bindModel(packet.model);
+      packet.model->draw(commandBuffer, run.count, run.first, packet.lod);
+    }
+  }
+  
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record secondary command buffer!");
   }
+  return {commandBuffer};
 }
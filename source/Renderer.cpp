@@ -6,12 +6,71 @@
 //
 
 #include "include/Renderer.hpp"
+#include "include/RenderGraph.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
 #include <iostream>
 
+namespace {
+    // Dependencies every frame pass and its upscaled variant share, compositionSubpass reads the color its previous subpass wrote
+    std::vector<VkSubpassDependency> frameDependencies(uint32_t compositionSubpass) {
+        std::vector<VkSubpassDependency> dependencies(4);
+        // The previous frame's depth pyramid build and composition may still be reading the targets
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        
+        // The swapchain image is first written by the composition, after the acquire semaphore's stage
+        // The render graph synchronizes the LDR target of upscaled frames itself
+        dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcAccessMask = 0;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].dstSubpass = compositionSubpass;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        
+        // HDR color is handed over pixel by pixel, tilers keep it on chip
+        dependencies[2].srcSubpass = compositionSubpass - 1;
+        dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[2].dstSubpass = compositionSubpass;
+        dependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dependencies[2].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        
+        // Depth goes to the depth pyramid build
+        dependencies[3].srcSubpass = 0;
+        dependencies[3].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[3].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[3].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[3].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependencies[3].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        return dependencies;
+    }
+    
+    // Copy of a frame pass whose last attachment is the LDR target of the upscale graph
+    // Only its layouts differ, so the variant stays compatible and shares the pipelines of the original
+    VkRenderPass createUpscaledVariant(VkDevice device, VkRenderPassCreateInfo renderPassInfo) {
+        std::vector<VkAttachmentDescription> attachments(renderPassInfo.pAttachments, renderPassInfo.pAttachments + renderPassInfo.attachmentCount);
+        // The graph transitions the target around the pass, which keeps it as a color attachment
+        attachments.back().initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachments.back().finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        renderPassInfo.pAttachments = attachments.data();
+        
+        VkRenderPass renderPass;
+        if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upscaled render pass!");
+        }
+        return renderPass;
+    }
+}
+
 Renderer::Renderer(SDLWindow &passWindow, Device &passDevice) : window{passWindow}, device{passDevice} {
     recreateSwapChain();
     createCommandBuffers();
@@ -19,7 +78,9 @@ Renderer::Renderer(SDLWindow &passWindow, Device &passDevice) : window{passWindo
 
 Renderer::~Renderer() {
     freeCommandBuffers();
+    destroyThreadCommandPools();
     
+    destroyFrameBuffers();
     destroyOffscreenPass();
     
     vkDestroySampler(device.device(), brdfSampler, nullptr);
@@ -40,9 +101,12 @@ void Renderer::recreateSwapChain() {
         swapChain = std::make_unique<SwapChain>(device, extent);
         createOffscreenPass();
     } else {
+        destroyFrameBuffers();
         std::shared_ptr<SwapChain> oldSwapChain = std::move(swapChain);
         swapChain = std::make_unique<SwapChain>(device, extent, std::move(swapChain));
-        if(oldSwapChain->getSwapChainExtent().width != extent.width || oldSwapChain->getSwapChainExtent().height != extent.height || recreateOffscreenFlag) {
+        // The composition subpass writes the swapchain image, its format is part of the render passes
+        if(oldSwapChain->getSwapChainExtent().width != extent.width || oldSwapChain->getSwapChainExtent().height != extent.height || recreateOffscreenFlag
+           || swapChain->getSwapChainImageFormat() != offscreen.swapChainFormat) {
             destroyOffscreenPass();
             createOffscreenPass();
             recreateOffscreenFlag = false;
@@ -51,6 +115,7 @@ void Renderer::recreateSwapChain() {
         //    throw std::runtime_error("Swap chain image(or depth) format has changed");
         //}
     }
+    createFrameBuffers();
 }
 
 void Renderer::createCommandBuffers() {
@@ -91,8 +156,15 @@ VkCommandBuffer Renderer::beginFrame() {
         throw std::runtime_error("Failed to acquire swap chain image");
     }
     
+    updateUpscaleGraph();
     isFrameStarted = true;
     
+    // The frame fence was waited on acquire, secondary buffers recorded for this slot are free again
+    for (auto &threadPool : threadPools[currentFrameIndex]) {
+        vkResetCommandPool(device.device(), threadPool.pool, 0);
+        threadPool.usedBuffers = 0;
+    }
+    
     auto commandBuffer = getCurrentCommandBuffer();
     
     VkCommandBufferBeginInfo beginInfo{};
@@ -124,18 +196,92 @@ void Renderer::endFrame() {
     currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
 }
 
-void Renderer::beginOffscreenRenderPass(VkCommandBuffer commandBuffer) {
+void Renderer::createThreadCommandPools(uint32_t threadCount) {
+    destroyThreadCommandPools();
+    
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = device.findPhysicalQueueFamilies().graphicsFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    
+    for (auto &framePools : threadPools) {
+        framePools.resize(threadCount);
+        for (auto &threadPool : framePools) {
+            if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &threadPool.pool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create thread command pool");
+            }
+        }
+    }
+}
+
+void Renderer::destroyThreadCommandPools() {
+    for (auto &framePools : threadPools) {
+        for (auto &threadPool : framePools) {
+            vkDestroyCommandPool(device.device(), threadPool.pool, nullptr);
+        }
+        framePools.clear();
+    }
+}
+
+VkCommandBuffer Renderer::beginOffscreenSecondaryCommandBuffer(uint32_t threadIndex, bool deferredPass) {
+    assert(isFrameStarted && "Cannot record secondary command buffers when frame not in progress");
+    assert(threadIndex < threadPools[currentFrameIndex].size() && "No command pool for this thread");
+    
+    // Only the owning thread touches its pool, no locking needed
+    auto &threadPool = threadPools[currentFrameIndex][threadIndex];
+    if (threadPool.usedBuffers == threadPool.secondaryBuffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = threadPool.pool;
+        allocInfo.commandBufferCount = 1;
+        
+        VkCommandBuffer secondaryBuffer;
+        if (vkAllocateCommandBuffers(device.device(), &allocInfo, &secondaryBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate secondary command buffer");
+        }
+        threadPool.secondaryBuffers.push_back(secondaryBuffer);
+    }
+    VkCommandBuffer commandBuffer = threadPool.secondaryBuffers[threadPool.usedBuffers++];
+    
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    if (isUpscaling()) {
+        inheritanceInfo.renderPass = deferredPass ? deferred.upscaledRenderPass : offscreen.upscaledRenderPass;
+        inheritanceInfo.framebuffer = deferredPass ? deferred.upscaledFrameBuffer : offscreen.upscaledFrameBuffer;
+    } else {
+        inheritanceInfo.renderPass = deferredPass ? deferred.renderPass : offscreen.renderPass;
+        inheritanceInfo.framebuffer = deferredPass ? deferred.frameBuffers[currentImageIndex] : offscreen.frameBuffers[currentImageIndex];
+    }
+    inheritanceInfo.subpass = 0;
+    
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin recording secondary command buffer");
+    }
+    
+    // Dynamic state is not inherited from the primary buffer
+    setRenderViewport(commandBuffer);
+    
+    return commandBuffer;
+}
+
+void Renderer::beginOffscreenRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
     assert(isFrameStarted && "Can't call endFrame while frame is not in progress");
     assert(commandBuffer == getCurrentCommandBuffer() &&
         "Can't begin render pass on command buffer from a different frame");
     
     VkRenderPassBeginInfo renderpassInfo{};
     renderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderpassInfo.renderPass = offscreen.renderPass;
-    renderpassInfo.framebuffer = offscreen.frameBuffer;
+    renderpassInfo.renderPass = isUpscaling() ? offscreen.upscaledRenderPass : offscreen.renderPass;
+    renderpassInfo.framebuffer = isUpscaling() ? offscreen.upscaledFrameBuffer : offscreen.frameBuffers[currentImageIndex];
     
     renderpassInfo.renderArea.offset = {0, 0};
-    renderpassInfo.renderArea.extent = swapChain->getSwapChainExtent();
+    renderpassInfo.renderArea.extent = getRenderExtent();
     
     std::array<VkClearValue, 2> clearValues{};
     clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
@@ -143,18 +289,12 @@ void Renderer::beginOffscreenRenderPass(VkCommandBuffer commandBuffer) {
     renderpassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderpassInfo.pClearValues = clearValues.data();
     
-    vkCmdBeginRenderPass(commandBuffer, &renderpassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(commandBuffer, &renderpassInfo, contents);
     
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(swapChain->getSwapChainExtent().width);
-    viewport.height = static_cast<float>(swapChain->getSwapChainExtent().height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    VkRect2D scissor{{0, 0}, swapChain->getSwapChainExtent()};
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    // Secondary buffers set their own dynamic state
+    if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) { return; }
+    
+    setRenderViewport(commandBuffer);
 }
 
 void Renderer::endOffscreenRenderPass(VkCommandBuffer commandBuffer) {
@@ -164,27 +304,157 @@ void Renderer::endOffscreenRenderPass(VkCommandBuffer commandBuffer) {
     vkCmdEndRenderPass(commandBuffer);
 }
 
-void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
-    assert(isFrameStarted && "Can't call endFrame while frame is not in progress");
+void Renderer::beginDeferredRenderPass(VkCommandBuffer commandBuffer) {
+    assert(isFrameStarted && "Can't call beginDeferredRenderPass while frame is not in progress");
     assert(commandBuffer == getCurrentCommandBuffer() &&
         "Can't begin render pass on command buffer from a different frame");
+    assert(isDeferredAvailable() && "No G-buffer targets with MSAA enabled");
     
     VkRenderPassBeginInfo renderpassInfo{};
     renderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderpassInfo.renderPass = swapChain->getCompositionRenderPass();
-    renderpassInfo.framebuffer = swapChain->getSwapChainFrameBuffer(currentImageIndex);
+    renderpassInfo.renderPass = isUpscaling() ? deferred.upscaledRenderPass : deferred.renderPass;
+    renderpassInfo.framebuffer = isUpscaling() ? deferred.upscaledFrameBuffer : deferred.frameBuffers[currentImageIndex];
     
     renderpassInfo.renderArea.offset = {0, 0};
-    renderpassInfo.renderArea.extent = swapChain->getSwapChainExtent();
+    renderpassInfo.renderArea.extent = getRenderExtent();
     
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
+    // Color is fully covered by the lighting and skybox draws
+    std::array<VkClearValue, 5> clearValues{};
     clearValues[1].depthStencil = {1.0f, 0};
     renderpassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderpassInfo.pClearValues = clearValues.data();
     
+    vkCmdBeginRenderPass(commandBuffer, &renderpassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+}
+
+void Renderer::nextDeferredSubpass(VkCommandBuffer commandBuffer) {
+    assert(isFrameStarted && "Can't call nextDeferredSubpass while frame is not in progress");
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+    setRenderViewport(commandBuffer);
+}
+
+void Renderer::beginCompositionSubpass(VkCommandBuffer commandBuffer) {
+    assert(isFrameStarted && "Can't call beginCompositionSubpass while frame is not in progress");
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+    setRenderViewport(commandBuffer);
+}
+
+void Renderer::beginUpscaleRenderPass(VkCommandBuffer commandBuffer) {
+    assert(isFrameStarted && "Can't call beginUpscaleRenderPass while frame is not in progress");
+    assert(commandBuffer == getCurrentCommandBuffer() &&
+        "Can't begin render pass on command buffer from a different frame");
+    
+    VkRenderPassBeginInfo renderpassInfo{};
+    renderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderpassInfo.renderPass = upscale.renderPass;
+    renderpassInfo.framebuffer = upscale.frameBuffers[currentImageIndex];
+    
+    renderpassInfo.renderArea.offset = {0, 0};
+    renderpassInfo.renderArea.extent = swapChain->getSwapChainExtent();
+    
     vkCmdBeginRenderPass(commandBuffer, &renderpassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    setOutputViewport(commandBuffer);
+}
+
+void Renderer::endUpscaleRenderPass(VkCommandBuffer commandBuffer) {
+    assert(isFrameStarted && "Can't call endUpscaleRenderPass while frame is not in progress");
+    assert(commandBuffer == getCurrentCommandBuffer() &&
+        "Can't end render pass on command buffer from a different frame");
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void Renderer::recordUpscaledFrame(VkCommandBuffer commandBuffer, const UpscaledFrame &frame) {
+    assert(isFrameStarted && "Can't call recordUpscaledFrame while frame is not in progress");
+    assert(upscale.compiled && "Upscale graph is only compiled while upscaling");
+    
+    upscale.frame = &frame;
+    upscaleGraph.execute(commandBuffer);
+    upscale.frame = nullptr;
+}
+
+void Renderer::updateUpscaleGraph() {
+    const bool upscaling = isUpscaling();
+    if (upscaling == upscale.compiled && (!upscaling || upscale.withEasu == easuEnabled)) { return; }
+    
+    // Frames in flight may still sample the targets
+    vkDeviceWaitIdle(device.device());
+    releaseUpscaleGraph();
+    if (!upscaling) { return; }
+    
+    // Output sized, the scene covers the top left render extent of the LDR target
+    const RenderGraph::ImageDesc targetDesc{offscreen.swapChainFormat, getOffscreenExtent()};
+    upscale.ldr = upscaleGraph.createImage("ldr", targetDesc);
+    upscale.easuTarget = upscaleGraph.createImage("easu", targetDesc);
+    upscale.withEasu = easuEnabled;
+    
+    // The scene pass is the offscreen or deferred variant, begun by the recording itself
+    upscaleGraph.addPass({
+        "scene",
+        {},
+        {{upscale.ldr, RenderGraph::Access::ColorAttachment}},
+        [this](VkCommandBuffer commandBuffer) { upscale.frame->scene(commandBuffer); },
+        false,
+        true
+    });
+    // Culled when the output samples the LDR target directly
+    upscaleGraph.addPass({
+        "easu",
+        {{upscale.ldr, RenderGraph::Access::Sampled}},
+        {{upscale.easuTarget, RenderGraph::Access::ColorAttachment}},
+        [this](VkCommandBuffer commandBuffer) { upscale.frame->easu(commandBuffer); }
+    });
+    // The swapchain image changes every frame, the upscale pass keeps its own framebuffers
+    upscaleGraph.addPass({
+        "upscale",
+        {{upscale.withEasu ? upscale.easuTarget : upscale.ldr, RenderGraph::Access::Sampled}},
+        {},
+        [this](VkCommandBuffer commandBuffer) {
+            beginUpscaleRenderPass(commandBuffer);
+            upscale.frame->output(commandBuffer);
+            endUpscaleRenderPass(commandBuffer);
+        },
+        true
+    });
+    upscaleGraph.compile();
+    upscale.compiled = true;
+    
+    const bool multisampled = device.msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    const VkImageView ldrView = upscaleGraph.getView(upscale.ldr);
+    createFrameBuffer(
+        offscreen.upscaledRenderPass,
+        multisampled
+            ? std::vector<VkImageView>{offscreen.multisampling.view, offscreen.depth.view, offscreen.color.view, ldrView}
+            : std::vector<VkImageView>{offscreen.color.view, offscreen.depth.view, ldrView},
+        offscreen.upscaledFrameBuffer);
+    if (isDeferredAvailable()) {
+        createFrameBuffer(
+            deferred.upscaledRenderPass,
+            {offscreen.color.view, offscreen.depth.view, deferred.albedo.view, deferred.normal.view, deferred.material.view, ldrView},
+            deferred.upscaledFrameBuffer);
+    }
     
+    VkDescriptorImageInfo ldrInfo{upscale.sampler, ldrView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    DescriptorWriter(*upscaleSetLayout, *upscalePool)
+        .writeImage(0, &ldrInfo)
+        .overwrite(upscaleDescriptorSet);
+    if (upscale.withEasu) {
+        VkDescriptorImageInfo easuInfo{upscale.sampler, upscaleGraph.getView(upscale.easuTarget), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        DescriptorWriter(*upscaleSetLayout, *upscalePool)
+            .writeImage(0, &easuInfo)
+            .overwrite(easuDescriptorSet);
+    }
+}
+
+void Renderer::releaseUpscaleGraph() {
+    for (auto *frameBuffer : {&offscreen.upscaledFrameBuffer, &deferred.upscaledFrameBuffer}) {
+        vkDestroyFramebuffer(device.device(), *frameBuffer, nullptr);
+        *frameBuffer = VK_NULL_HANDLE;
+    }
+    upscaleGraph.reset();
+    upscale.compiled = false;
+}
+
+void Renderer::setOutputViewport(VkCommandBuffer commandBuffer) {
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
@@ -197,16 +467,38 @@ void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
 
-void Renderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
-    assert(isFrameStarted && "Can't call endFrame while frame is not in progress");
-    assert(commandBuffer == getCurrentCommandBuffer() &&
-        "Can't end render pass on command buffer from a different frame");
-    vkCmdEndRenderPass(commandBuffer);
+void Renderer::setRenderScale(float scale) {
+    assert(!isFrameStarted && "Can't change the render scale while frame is in progress");
+    renderScale = glm::clamp(scale, MIN_RENDER_SCALE, 1.f);
+}
+
+VkExtent2D Renderer::getRenderExtent() const {
+    return {
+        std::max(static_cast<uint32_t>(offscreen.width * renderScale + .5f), 1u),
+        std::max(static_cast<uint32_t>(offscreen.height * renderScale + .5f), 1u)
+    };
+}
+
+void Renderer::setRenderViewport(VkCommandBuffer commandBuffer) {
+    VkExtent2D renderExtent = getRenderExtent();
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(renderExtent.width);
+    viewport.height = static_cast<float>(renderExtent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{{0, 0}, renderExtent};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
 
 void Renderer::createOffscreenPass() {
     // Color Resources
     VkExtent2D swapChainExtent = getSwapChainExtent();
+    offscreen.width = static_cast<int32_t>(swapChainExtent.width);
+    offscreen.height = static_cast<int32_t>(swapChainExtent.height);
+    offscreenGeneration++;
 
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -219,12 +511,13 @@ void Renderer::createOffscreenPass() {
     imageInfo.format = offscreen.colorFormat;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage =  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // HDR color never leaves the pass, the composition subpass reads it as an input attachment
+    imageInfo.usage =  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = 0;
 
-    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, offscreen.color.image, offscreen.color.mem);
+    allocateAttachment(imageInfo, offscreen.color);
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -254,12 +547,14 @@ void Renderer::createOffscreenPass() {
     imageInfo.format = offscreen.depthFormat;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    // Only the depth pyramid build reads depth after the pass, without it depth stays in tile memory like color
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    imageInfo.usage |= depthReadback ? VK_IMAGE_USAGE_SAMPLED_BIT : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
     imageInfo.samples = device.msaaSamples;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = 0;
 
-    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, offscreen.depth.image, offscreen.depth.mem);
+    allocateAttachment(imageInfo, offscreen.depth);
 
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = offscreen.depth.image;
@@ -275,44 +570,49 @@ void Renderer::createOffscreenPass() {
       throw std::runtime_error("failed to create texture image view!");
     }
     
-    // Multisampling Resources
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = swapChainExtent.width;
-    imageInfo.extent.height = swapChainExtent.height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = offscreen.colorFormat;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage =  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    imageInfo.samples = device.msaaSamples;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.flags = 0;
+    // Multisampling Resources, resolved into the HDR color within the pass
+    const bool multisampled = device.msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    if (multisampled) {
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = swapChainExtent.width;
+        imageInfo.extent.height = swapChainExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = offscreen.colorFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage =  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        imageInfo.samples = device.msaaSamples;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.flags = 0;
 
-    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, offscreen.multisampling.image, offscreen.multisampling.mem);
+        allocateAttachment(imageInfo, offscreen.multisampling);
 
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = offscreen.multisampling.image;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = offscreen.colorFormat;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = offscreen.multisampling.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = offscreen.colorFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
 
-    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &offscreen.multisampling.view) != VK_SUCCESS) {
-      throw std::runtime_error("failed to create texture image view!");
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &offscreen.multisampling.view) != VK_SUCCESS) {
+          throw std::runtime_error("failed to create texture image view!");
+        }
     }
     
     // Renderpass
+    offscreen.swapChainFormat = swapChain->getSwapChainImageFormat();
+    
     VkAttachmentDescription colorAttachment = {};
     colorAttachment.format = offscreen.colorFormat;
     colorAttachment.samples = device.msaaSamples;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -327,11 +627,11 @@ void Renderer::createOffscreenPass() {
     depthAttachment.format = offscreen.depthFormat;
     depthAttachment.samples = device.msaaSamples;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.storeOp = depthReadback ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
     VkAttachmentReference depthAttachmentRef{};
     depthAttachmentRef.attachment = 1;
@@ -342,7 +642,7 @@ void Renderer::createOffscreenPass() {
     colorAttachmentResolve.format = offscreen.colorFormat;
     colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
     colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -351,122 +651,450 @@ void Renderer::createOffscreenPass() {
     VkAttachmentReference colorAttachmentResolveRef{};
     colorAttachmentResolveRef.attachment = 2;
     colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    
+    // Fully covered by the composition draw, nothing to load
+    VkAttachmentDescription swapChainAttachment{};
+    swapChainAttachment.format = offscreen.swapChainFormat;
+    swapChainAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    swapChainAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    swapChainAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    swapChainAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    swapChainAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    swapChainAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    swapChainAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    
+    VkAttachmentReference hdrInputRef{multisampled ? 2u : 0u, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkAttachmentReference swapChainRef{multisampled ? 3u : 2u, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
 
 
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-    subpass.pDepthStencilAttachment = &depthAttachmentRef;
-    if (device.msaaSamples != VK_SAMPLE_COUNT_1_BIT) { subpass.pResolveAttachments = &colorAttachmentResolveRef; }
+    std::array<VkSubpassDescription, 2> subpasses{};
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].colorAttachmentCount = 1;
+    subpasses[0].pColorAttachments = &colorAttachmentRef;
+    subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
+    if (multisampled) { subpasses[0].pResolveAttachments = &colorAttachmentResolveRef; }
+    
+    subpasses[COMPOSITION_SUBPASS].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[COMPOSITION_SUBPASS].inputAttachmentCount = 1;
+    subpasses[COMPOSITION_SUBPASS].pInputAttachments = &hdrInputRef;
+    subpasses[COMPOSITION_SUBPASS].colorAttachmentCount = 1;
+    subpasses[COMPOSITION_SUBPASS].pColorAttachments = &swapChainRef;
 
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.srcAccessMask = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.dstSubpass = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    auto dependencies = frameDependencies(COMPOSITION_SUBPASS);
       
     std::vector<VkAttachmentDescription> attachments;
-    if (device.msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
-        attachments = {colorAttachment, depthAttachment};
+    if (!multisampled) {
+        attachments = {colorAttachment, depthAttachment, swapChainAttachment};
     } else {
-        attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
+        attachments = {colorAttachment, depthAttachment, colorAttachmentResolve, swapChainAttachment};
     }
 
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
     renderPassInfo.pAttachments = attachments.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
 
     if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &offscreen.renderPass) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
+    offscreen.upscaledRenderPass = createUpscaledVariant(device.device(), renderPassInfo);
     
-    // Framebuffer
-    std::vector<VkImageView> imageViewAttachments;
-    if (device.msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
-        imageViewAttachments = {offscreen.color.view, offscreen.depth.view};
-    } else {
-        imageViewAttachments = {offscreen.multisampling.view, offscreen.depth.view, offscreen.color.view};
+    VkDescriptorImageInfo offscreenDescriptorInfo{
+        VK_NULL_HANDLE,
+        offscreen.color.view,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    
+    // Post-processing Pipeline
+    postprocPool =
+       DescriptorPool::Builder(device)
+           .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+           .addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, SwapChain::MAX_FRAMES_IN_FLIGHT)
+           .build();
+    
+    postprocSetLayout =
+        DescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build();
+    
+    postprocDescriptorSets = new std::vector<VkDescriptorSet>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < postprocDescriptorSets->size(); i++) {
+        DescriptorWriter(*postprocSetLayout, *postprocPool)
+            .writeImage(0, &offscreenDescriptorInfo)
+            .build(postprocDescriptorSets->at(i));
     }
+    
+    createDeferredPass();
+    createUpscalePass();
+}
 
-    VkFramebufferCreateInfo framebufferInfo = {};
-    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferInfo.renderPass = offscreen.renderPass;
-    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-    framebufferInfo.pAttachments = imageViewAttachments.data();
-    framebufferInfo.width = swapChainExtent.width;
-    framebufferInfo.height = swapChainExtent.height;
-    framebufferInfo.layers = 1;
+void Renderer::createDeferredPass() {
+    // G-buffer targets only live within the pass, tile based GPUs never write them to memory
+    auto createTarget = [&](VkFormat format, FrameBufferAttachment &target) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = static_cast<uint32_t>(offscreen.width);
+        imageInfo.extent.height = static_cast<uint32_t>(offscreen.height);
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        
+        allocateAttachment(imageInfo, target);
+        
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = target.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &target.view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create G-buffer image view!");
+        }
+    };
+    
+    // Renderpass
+    // 0 lit color, 1 depth, 2 albedo, 3 normal, 4 material, 5 swapchain image
+    std::array<VkAttachmentDescription, 6> attachments{};
+    attachments[0].format = offscreen.colorFormat;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    
+    attachments[1].format = offscreen.depthFormat;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = depthReadback ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    
+    const VkFormat gbufferFormats[GBUFFER_ATTACHMENTS] = {deferred.albedoFormat, deferred.normalFormat, deferred.materialFormat};
+    for (uint32_t i = 0; i < GBUFFER_ATTACHMENTS; i++) {
+        auto &attachment = attachments[2 + i];
+        attachment.format = gbufferFormats[i];
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    
+    attachments[5].format = offscreen.swapChainFormat;
+    attachments[5].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[5].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[5].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[5].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[5].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[5].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[5].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    
+    VkAttachmentReference gbufferWriteRefs[GBUFFER_ATTACHMENTS] = {
+        {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+        {3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+        {4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
+    };
+    VkAttachmentReference depthWriteRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    
+    // Depth stays bound read only in the lighting subpass, so the skybox still tests against the scene
+    VkAttachmentReference gbufferReadRefs[GBUFFER_ATTACHMENTS + 1] = {
+        {2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        {3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        {4, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL}
+    };
+    VkAttachmentReference colorRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depthReadRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+    VkAttachmentReference hdrInputRef{0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkAttachmentReference swapChainRef{5, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    
+    std::array<VkSubpassDescription, 3> subpasses{};
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].colorAttachmentCount = GBUFFER_ATTACHMENTS;
+    subpasses[0].pColorAttachments = gbufferWriteRefs;
+    subpasses[0].pDepthStencilAttachment = &depthWriteRef;
+    
+    subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[1].inputAttachmentCount = GBUFFER_ATTACHMENTS + 1;
+    subpasses[1].pInputAttachments = gbufferReadRefs;
+    subpasses[1].colorAttachmentCount = 1;
+    subpasses[1].pColorAttachments = &colorRef;
+    subpasses[1].pDepthStencilAttachment = &depthReadRef;
+    
+    subpasses[DEFERRED_COMPOSITION_SUBPASS].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[DEFERRED_COMPOSITION_SUBPASS].inputAttachmentCount = 1;
+    subpasses[DEFERRED_COMPOSITION_SUBPASS].pInputAttachments = &hdrInputRef;
+    subpasses[DEFERRED_COMPOSITION_SUBPASS].colorAttachmentCount = 1;
+    subpasses[DEFERRED_COMPOSITION_SUBPASS].pColorAttachments = &swapChainRef;
+    
+    // Same dependencies as the forward pass, the G-buffer is handed over pixel by pixel too
+    auto dependencies = frameDependencies(DEFERRED_COMPOSITION_SUBPASS);
+    VkSubpassDependency gbufferDependency{};
+    gbufferDependency.srcSubpass = 0;
+    gbufferDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    gbufferDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    gbufferDependency.dstSubpass = 1;
+    gbufferDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    gbufferDependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    gbufferDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies.push_back(gbufferDependency);
+    
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+    
+    if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &deferred.renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create deferred render pass!");
+    }
+    deferred.upscaledRenderPass = createUpscaledVariant(device.device(), renderPassInfo);
+    
+    // Lighting Descriptors
+    gbufferPool =
+       DescriptorPool::Builder(device)
+           .setMaxSets(1)
+           .addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, GBUFFER_ATTACHMENTS + 1)
+           .build();
+    
+    gbufferSetLayout =
+        DescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build();
+    
+    // Multisampled G-buffers would need per sample lighting, MSAA stays forward only
+    if (device.msaaSamples != VK_SAMPLE_COUNT_1_BIT) { return; }
+    
+    createTarget(deferred.albedoFormat, deferred.albedo);
+    createTarget(deferred.normalFormat, deferred.normal);
+    createTarget(deferred.materialFormat, deferred.material);
+    
+    VkDescriptorImageInfo inputInfos[GBUFFER_ATTACHMENTS + 1] = {
+        {VK_NULL_HANDLE, deferred.albedo.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        {VK_NULL_HANDLE, deferred.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        {VK_NULL_HANDLE, deferred.material.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        {VK_NULL_HANDLE, offscreen.depth.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL}
+    };
+    DescriptorWriter(*gbufferSetLayout, *gbufferPool)
+        .writeImage(0, &inputInfos[0])
+        .writeImage(1, &inputInfos[1])
+        .writeImage(2, &inputInfos[2])
+        .writeImage(3, &inputInfos[3])
+        .build(gbufferDescriptorSet);
+}
 
-    if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &offscreen.frameBuffer) != VK_SUCCESS) {
-      throw std::runtime_error("failed to create framebuffer!");
+void Renderer::destroyDeferredPass() {
+    vkDestroyRenderPass(device.device(), deferred.renderPass, nullptr);
+    vkDestroyRenderPass(device.device(), deferred.upscaledRenderPass, nullptr);
+    deferred.renderPass = VK_NULL_HANDLE;
+    deferred.upscaledRenderPass = VK_NULL_HANDLE;
+    
+    for (auto *target : {&deferred.albedo, &deferred.normal, &deferred.material}) {
+        vkDestroyImageView(device.device(), target->view, nullptr);
+        vkDestroyImage(device.device(), target->image, nullptr);
+        vkFreeMemory(device.device(), target->mem, nullptr);
+        *target = {};
     }
     
-    // Image Sampler
+    gbufferDescriptorSet = VK_NULL_HANDLE;
+    gbufferSetLayout.reset();
+    gbufferPool.reset();
+}
+
+void Renderer::createUpscalePass() {
+    VkAttachmentDescription swapChainAttachment{};
+    swapChainAttachment.format = offscreen.swapChainFormat;
+    swapChainAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    swapChainAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    swapChainAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    swapChainAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    swapChainAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    swapChainAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    swapChainAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    
+    VkAttachmentReference swapChainRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &swapChainRef;
+    
+    // The graph's barriers make the LDR or EASU target visible, only the acquire semaphore's stage is left
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = 0;
+    dependency.dstSubpass = 0;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &swapChainAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+    
+    if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &upscale.renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale render pass!");
+    }
+    
+    // Same description the graph gives its EASU pass, pipelines are built against this one since the graph's only exists while upscaling
+    VkAttachmentDescription easuAttachment = swapChainAttachment;
+    easuAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    easuAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    renderPassInfo.pAttachments = &easuAttachment;
+    renderPassInfo.dependencyCount = 0;
+    renderPassInfo.pDependencies = nullptr;
+    
+    if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &upscale.easuRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create EASU render pass!");
+    }
+    
+    // Bilinear taps must not reach past the rendered part, the shader clamps to it
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_NEAREST;
-    samplerInfo.minFilter = VK_FILTER_NEAREST;
-
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
     samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     samplerInfo.addressModeV = samplerInfo.addressModeU;
     samplerInfo.addressModeW = samplerInfo.addressModeU;
-    
     samplerInfo.anisotropyEnable = VK_FALSE;
-    samplerInfo.maxAnisotropy = device.properties.limits.maxSamplerAnisotropy;
-    
-    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
     samplerInfo.unnormalizedCoordinates = VK_FALSE;
-    
     samplerInfo.compareEnable = VK_FALSE;
     samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
-    
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 1.0f;
+    samplerInfo.maxLod = 0.0f;
     
-    if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &offscreen.sampler) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create offscreen sampler!");
+    if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &upscale.sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale sampler!");
     }
     
-    VkDescriptorImageInfo offscreenDescriptorInfo{
-        offscreen.sampler,
-        offscreen.color.view,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-    };
-    
-    // Post-processing Pipeline
-    postprocPool =
+    upscalePool =
        DescriptorPool::Builder(device)
-           .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
-           .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+           .setMaxSets(2)
+           .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
            .build();
     
-    postprocSetLayout =
+    upscaleSetLayout =
         DescriptorSetLayout::Builder(device)
             .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .build();
     
-    postprocDescriptorSets = new std::vector<VkDescriptorSet>(SwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < postprocDescriptorSets->size(); i++) {
-        DescriptorWriter(*postprocSetLayout, *postprocPool)
-            .writeImage(0, &offscreenDescriptorInfo)
-            .build(postprocDescriptorSets->at(i));
+    // Written when the graph creates the targets
+    DescriptorWriter(*upscaleSetLayout, *upscalePool).build(upscaleDescriptorSet);
+    DescriptorWriter(*upscaleSetLayout, *upscalePool).build(easuDescriptorSet);
+}
+
+void Renderer::destroyUpscalePass() {
+    vkDestroyRenderPass(device.device(), upscale.renderPass, nullptr);
+    vkDestroyRenderPass(device.device(), upscale.easuRenderPass, nullptr);
+    vkDestroySampler(device.device(), upscale.sampler, nullptr);
+    upscale.renderPass = VK_NULL_HANDLE;
+    upscale.easuRenderPass = VK_NULL_HANDLE;
+    upscale.sampler = VK_NULL_HANDLE;
+    
+    upscaleDescriptorSet = VK_NULL_HANDLE;
+    easuDescriptorSet = VK_NULL_HANDLE;
+    upscaleSetLayout.reset();
+    upscalePool.reset();
+}
+
+void Renderer::createFrameBuffer(VkRenderPass renderPass, const std::vector<VkImageView> &views, VkFramebuffer &frameBuffer) {
+    VkExtent2D swapChainExtent = getSwapChainExtent();
+    
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+    framebufferInfo.pAttachments = views.data();
+    framebufferInfo.width = swapChainExtent.width;
+    framebufferInfo.height = swapChainExtent.height;
+    framebufferInfo.layers = 1;
+    
+    if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &frameBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer!");
+    }
+}
+
+void Renderer::createFrameBuffers() {
+    const bool multisampled = device.msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    
+    offscreen.frameBuffers.resize(swapChain->imageCount());
+    for (size_t i = 0; i < swapChain->imageCount(); i++) {
+        if (!multisampled) {
+            createFrameBuffer(offscreen.renderPass, {offscreen.color.view, offscreen.depth.view, swapChain->getImageView(i)}, offscreen.frameBuffers[i]);
+        } else {
+            createFrameBuffer(offscreen.renderPass, {offscreen.multisampling.view, offscreen.depth.view, offscreen.color.view, swapChain->getImageView(i)}, offscreen.frameBuffers[i]);
+        }
+    }
+    
+    upscale.frameBuffers.resize(swapChain->imageCount());
+    for (size_t i = 0; i < swapChain->imageCount(); i++) {
+        createFrameBuffer(upscale.renderPass, {swapChain->getImageView(i)}, upscale.frameBuffers[i]);
+    }
+    
+    // No G-buffer targets with MSAA
+    if (deferred.albedo.view == VK_NULL_HANDLE) { return; }
+    deferred.frameBuffers.resize(swapChain->imageCount());
+    for (size_t i = 0; i < swapChain->imageCount(); i++) {
+        createFrameBuffer(
+            deferred.renderPass,
+            {offscreen.color.view, offscreen.depth.view, deferred.albedo.view, deferred.normal.view, deferred.material.view, swapChain->getImageView(i)},
+            deferred.frameBuffers[i]);
+    }
+}
+
+void Renderer::destroyFrameBuffers() {
+    for (auto *frameBuffers : {&offscreen.frameBuffers, &deferred.frameBuffers, &upscale.frameBuffers}) {
+        for (auto frameBuffer : *frameBuffers) {
+            vkDestroyFramebuffer(device.device(), frameBuffer, nullptr);
+        }
+        frameBuffers->clear();
     }
 }
 
 void Renderer::destroyOffscreenPass() {
-    vkDestroySampler(device.device(), offscreen.sampler, nullptr);
-    vkDestroyFramebuffer(device.device(), offscreen.frameBuffer, nullptr);
+    // Its framebuffers hold the offscreen targets, the next upscaled frame compiles it again
+    releaseUpscaleGraph();
+    destroyUpscalePass();
+    destroyDeferredPass();
+    
     vkDestroyRenderPass(device.device(), offscreen.renderPass, nullptr);
+    vkDestroyRenderPass(device.device(), offscreen.upscaledRenderPass, nullptr);
     
     vkDestroyImageView(device.device(), offscreen.color.view, nullptr);
     vkDestroyImage(device.device(), offscreen.color.image, nullptr);
@@ -479,6 +1107,9 @@ void Renderer::destroyOffscreenPass() {
     vkDestroyImageView(device.device(), offscreen.multisampling.view, nullptr);
     vkDestroyImage(device.device(), offscreen.multisampling.image, nullptr);
     vkFreeMemory(device.device(), offscreen.multisampling.mem, nullptr);
+    offscreen.color = {};
+    offscreen.depth = {};
+    offscreen.multisampling = {};
     
     // TODO: migrate all deletions to unique_ptr = nullptr
     delete(postprocDescriptorSets);
@@ -486,81 +1117,44 @@ void Renderer::destroyOffscreenPass() {
     postprocPool.reset();
 }
 
-void Renderer::integrateBrdfLut(std::string shaderPath) {
-    VkAttachmentDescription attachment = {};
-
-    attachment.format = VK_FORMAT_R16G16_SFLOAT;
-    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentReference colorReference = {};
-    colorReference.attachment = 0;
-    colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorReference;
-    
-    std::array<VkSubpassDependency, 2> dependencies;
-    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[0].dstSubpass = 0;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    dependencies[1].srcSubpass = 0;
-    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-    VkRenderPassCreateInfo renderPassCreateInfo{};
-    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.attachmentCount = 1;
-    renderPassCreateInfo.pAttachments = &attachment;
-    renderPassCreateInfo.subpassCount = 1;
-    renderPassCreateInfo.pSubpasses = &subpass;
-    renderPassCreateInfo.dependencyCount = 2;
-    renderPassCreateInfo.pDependencies = dependencies.data();
-    
-    VkRenderPass renderPass;
-
-    if (vkCreateRenderPass(device.device(), &renderPassCreateInfo, nullptr, &renderPass) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create brdf renderpass!");
-    }
+void Renderer::allocateAttachment(const VkImageCreateInfo &imageInfo, FrameBufferAttachment &target) {
+    // Transient attachments never leave tile memory on tilers, lazily allocated memory only gets backed if the driver spills
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if (imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) { properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT; }
+    device.createImageWithInfo(imageInfo, properties, target.image, target.mem);
+    
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device.device(), target.image, &memRequirements);
+    target.size = memRequirements.size;
+    target.lazy = (properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) && device.hasMemoryType(memRequirements.memoryTypeBits, properties);
+}
 
-    VkPipelineLayout pipelineLayout;
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pSetLayouts = nullptr;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
-    if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
+Renderer::TargetMemory Renderer::getTargetMemory() const {
+    TargetMemory memory{};
+    // Upscale targets only take memory while upscaling
+    memory.backed += upscaleGraph.getStats().transientBytes;
+    for (auto *target : {&offscreen.color, &offscreen.depth, &offscreen.multisampling, &deferred.albedo, &deferred.normal, &deferred.material}) {
+        if (target->mem == VK_NULL_HANDLE) { continue; }
+        if (!target->lazy) {
+            memory.backed += target->size;
+            continue;
+        }
+        VkDeviceSize committed = 0;
+        vkGetDeviceMemoryCommitment(device.device(), target->mem, &committed);
+        memory.lazy += target->size;
+        memory.committed += committed;
     }
-    PipelineConfigInfo pipelineConfig{};
-    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
-    pipelineConfig.renderPass = renderPass;
-    pipelineConfig.pipelineLayout = pipelineLayout;
-    pipelineConfig.colorBlendAttachment.blendEnable = VK_FALSE;
-    pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    Pipeline pipeline{
-        device,
-        shaderPath+"brdf.vert.spv",
-        shaderPath+"brdf.frag.spv",
-        pipelineConfig
-    };
-    
+    return memory;
+}
+
+void Renderer::setDepthReadback(bool enabled) {
+    if (depthReadback == enabled) { return; }
+    depthReadback = enabled;
+    recreateOffscreenFlag = true;
+    recreateSwapChain();
+}
+
+void Renderer::integrateBrdfLut(std::string shaderPath) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -598,21 +1192,6 @@ void Renderer::integrateBrdfLut(std::string shaderPath) {
       throw std::runtime_error("failed to create brdf image view!");
     }
         
-    VkFramebuffer frameBuffer;
-        
-    VkFramebufferCreateInfo fbufCreateInfo{};
-    fbufCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    fbufCreateInfo.renderPass = renderPass;
-    fbufCreateInfo.attachmentCount = 1;
-    fbufCreateInfo.pAttachments = &brdf.view;
-    fbufCreateInfo.width = 512;
-    fbufCreateInfo.height = 512;
-    fbufCreateInfo.layers = 1;
-
-	if (vkCreateFramebuffer(device.device(), &fbufCreateInfo, nullptr, &frameBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create brdf framebuffer!");
-    }
-    
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
     samplerInfo.magFilter = VK_FILTER_NEAREST;
@@ -640,53 +1219,15 @@ void Renderer::integrateBrdfLut(std::string shaderPath) {
         throw std::runtime_error("failed to create brdf sampler!");
     }
     
-    VkCommandBuffer commandBuffer;
-    
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = device.getCommandPool();
-    allocInfo.commandBufferCount = 1;
-    
-    if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to allocate command buffers");
-    }
-    
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    
-    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to begin recording command buffers");
-    }
-    
-    VkRenderPassBeginInfo renderpassInfo{};
-    renderpassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderpassInfo.renderPass = renderPass;
-    renderpassInfo.framebuffer = frameBuffer;
-    
-    renderpassInfo.renderArea.offset = {0, 0};
-    renderpassInfo.renderArea.extent.width = 512;
-    renderpassInfo.renderArea.extent.height = 512;
-    
-    VkClearValue clearValue{};
-    clearValue.color = {0.f, 0.f, 0.f, 0.f};
-    renderpassInfo.clearValueCount = 1;
-    renderpassInfo.pClearValues = &clearValue;
-    
-    vkCmdBeginRenderPass(commandBuffer, &renderpassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = 512;
-    viewport.height = 512;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    VkRect2D scissor{{0, 0}, {512, 512}};
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    RenderGraph graph{device};
+    auto lut = graph.importImage(
+        "brdfLut",
+        brdf.image,
+        brdf.view,
+        {VK_FORMAT_R16G16_SFLOAT, {512, 512}},
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     
-    //RENDER
     Model::Data data;
     data.vertices = {
         {{-1.f, -1.f, .0f}, {}, {}, {}, {0.f, 0.f}},
@@ -697,46 +1238,50 @@ void Renderer::integrateBrdfLut(std::string shaderPath) {
     data.indices = {
         0,1,2,3,0,2
     };
-    
     Model quad{device, data};
+    std::unique_ptr<Pipeline> pipeline;
     
-    pipeline.bind(commandBuffer);
-    
-    quad.bind(commandBuffer);
-    quad.draw(commandBuffer);
-    
-    vkCmdEndRenderPass(commandBuffer);
-    
-    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to record command buffer");
-    }
-    
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.pWaitDstStageMask = waitStages;
+    VkClearValue clearValue{};
+    clearValue.color = {0.f, 0.f, 0.f, 0.f};
+    auto pass = graph.addPass({
+        "brdf",
+        {},
+        {{lut, RenderGraph::Access::ColorAttachment, VK_ATTACHMENT_LOAD_OP_CLEAR, clearValue}},
+        [&](VkCommandBuffer commandBuffer) {
+            pipeline->bind(commandBuffer);
+            quad.bind(commandBuffer);
+            quad.draw(commandBuffer);
+        }
+    });
+    graph.compile();
 
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-    
-    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, nullptr) != VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
+    VkPipelineLayout pipelineLayout;
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 0;
+    pipelineLayoutInfo.pSetLayouts = nullptr;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
     }
+    PipelineConfigInfo pipelineConfig{};
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.renderPass = graph.getRenderPass(pass);
+    pipelineConfig.pipelineLayout = pipelineLayout;
+    pipelineConfig.colorBlendAttachment.blendEnable = VK_FALSE;
+    pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    pipeline = std::make_unique<Pipeline>(
+        device,
+        shaderPath+"brdf.vert.spv",
+        shaderPath+"brdf.frag.spv",
+        pipelineConfig);
     
-    vkDeviceWaitIdle(device.device());
-    
-    vkFreeCommandBuffers(
-        device.device(),
-        device.getCommandPool(),
-        1,
-        &commandBuffer
-    );
-    commandBuffer = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+    graph.execute(commandBuffer);
+    device.endSingleTimeCommands(commandBuffer);
     
-    vkDestroyFramebuffer(device.device(), frameBuffer, nullptr);
     vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
-    vkDestroyRenderPass(device.device(), renderPass, nullptr);
     
     brdfImageInfo = VkDescriptorImageInfo {
         brdfSampler,
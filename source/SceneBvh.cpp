@@ -0,0 +1,130 @@
+//
+//  SceneBvh.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/SceneBvh.hpp"
+
+//std
+#include <cmath>
+
+namespace {
+
+bool intersectBox(const Aabb &box, const Ray &ray, float tMax, float &t) {
+    float tNear = 0.f, tFar = tMax;
+    for (int axis = 0; axis < 3; axis++) {
+        float invDirection = 1.f / (std::abs(ray.direction[axis]) < 1e-12f ? 1e-12f : ray.direction[axis]);
+        float t0 = (box.min[axis] - ray.origin[axis]) * invDirection;
+        float t1 = (box.max[axis] - ray.origin[axis]) * invDirection;
+        tNear = std::max(tNear, std::min(t0, t1));
+        tFar = std::min(tFar, std::max(t0, t1));
+    }
+    t = tNear;
+    return tNear <= tFar;
+}
+
+}
+
+Aabb SceneBvh::worldBounds(const EntityRegistry &scene, Entity entity) const {
+    Aabb local{};
+    if (scene.has<ColliderComponent>(entity)) {
+        local = scene.get<ColliderComponent>(entity).collider->getBounds();
+    } else {
+        const auto &model = scene.get<RenderComponent>(entity).model;
+        local.grow(model->getBoundsMin());
+        local.grow(model->getBoundsMin() + model->getBoundsExtent());
+    }
+    return local.transformed(scene.getTransforms().getWorldMatrix(scene.getTransform(entity)));
+}
+
+void SceneBvh::build(EntityRegistry &scene) {
+    entities.clear();
+    bounds.clear();
+    transformPrimitives.assign(scene.getTransforms().size(), Bvh::INVALID);
+
+    for (Entity entity : scene.view<RenderComponent>().getEntities()) {
+        if (!scene.isRenderable(entity)) { continue; }
+        transformPrimitives[scene.getTransform(entity)] = static_cast<uint32_t>(entities.size());
+        entities.push_back(entity);
+        bounds.push_back(worldBounds(scene, entity));
+    }
+    bvh.build(bounds);
+}
+
+void SceneBvh::update(EntityRegistry &scene) {
+    changed.clear();
+    for (TransformSystem::Handle handle : scene.getTransforms().getLastUpdated()) {
+        if (handle >= transformPrimitives.size() || transformPrimitives[handle] == Bvh::INVALID) { continue; }
+        uint32_t primitive = transformPrimitives[handle];
+        bounds[primitive] = worldBounds(scene, entities[primitive]);
+        changed.push_back(primitive);
+    }
+    bvh.refit(bounds, changed);
+    lastRefitCount = static_cast<uint32_t>(changed.size());
+}
+
+void SceneBvh::cullFrustum(const glm::mat4 &projectionView, std::vector<Entity> &visible) const {
+    visible.clear();
+    Frustum frustum = Frustum::fromMatrix(projectionView);
+    bvh.query(frustum, [&](uint32_t primitive) {
+        // Leaves hold several entities, test each one's own box too
+        if (frustum.intersects(bounds[primitive])) { visible.push_back(entities[primitive]); }
+    });
+}
+
+bool SceneBvh::raycast(const EntityRegistry &scene, const Ray &ray, float maxDistance, Hit &hit) const {
+    float tMax = maxDistance;
+    bool found = bvh.intersect(ray, tMax, [&](uint32_t primitive, float &closest) {
+        Entity entity = entities[primitive];
+        TransformSystem::Handle transform = scene.getTransform(entity);
+
+        if (!scene.has<ColliderComponent>(entity)) {
+            float t;
+            if (!intersectBox(bounds[primitive], ray, closest, t)) { return false; }
+            closest = t;
+            hit.entity = entity;
+            hit.normal = -ray.direction;
+            return true;
+        }
+
+        // The local direction is left unnormalized so t means the same distance in both spaces
+        const glm::mat4 invWorld = glm::inverse(scene.getTransforms().getWorldMatrix(transform));
+        Ray localRay{glm::vec3(invWorld * glm::vec4(ray.origin, 1.f)), glm::vec3(invWorld * glm::vec4(ray.direction, 0.f))};
+        glm::vec3 localNormal;
+        if (!scene.get<ColliderComponent>(entity).collider->intersect(localRay, closest, localNormal)) { return false; }
+
+        hit.entity = entity;
+        hit.normal = glm::normalize(scene.getTransforms().getNormalMatrix(transform) * localNormal);
+        return true;
+    });
+    if (!found) { return false; }
+
+    // Report the side facing the ray
+    if (glm::dot(hit.normal, ray.direction) > 0.f) { hit.normal = -hit.normal; }
+    hit.distance = tMax;
+    hit.position = ray.origin + ray.direction * tMax;
+    return true;
+}
+
+float SceneBvh::sweepSphere(const EntityRegistry &scene, const glm::vec3 &origin, const glm::vec3 &direction, float distance, float radius, Hit &hit) const {
+    // Approximated by the center ray and four parallel rays on the rim, each padded by the radius
+    glm::vec3 helper = std::abs(direction.y) < .99f ? glm::vec3{0.f, 1.f, 0.f} : glm::vec3{1.f, 0.f, 0.f};
+    glm::vec3 side = glm::normalize(glm::cross(direction, helper));
+    glm::vec3 up = glm::cross(side, direction);
+    const glm::vec3 offsets[5] = {glm::vec3{0.f}, side * radius, -side * radius, up * radius, -up * radius};
+
+    float travel = distance;
+    hit.distance = distance + radius;
+    for (const auto &offset : offsets) {
+        Hit rayHit{};
+        if (!raycast(scene, Ray{origin + offset, direction}, distance + radius, rayHit)) { continue; }
+        float allowed = std::max(rayHit.distance - radius, 0.f);
+        if (allowed < travel) {
+            travel = allowed;
+            hit = rayHit;
+        }
+    }
+    return travel;
+}
@@ -0,0 +1,488 @@
+//
+//  ShadowCascades.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/ShadowCascades.hpp"
+
+//std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+    // Slope scaled bias against acne, in depth units of the shadow map
+    constexpr float DEPTH_BIAS_CONSTANT = 1.25f;
+    constexpr float DEPTH_BIAS_SLOPE = 1.75f;
+
+    struct ShadowPushConstants {
+        glm::mat4 lightMatrix{1.f};     // Light clip space times the caster's world matrix
+        glm::vec4 boundsMin{0.f};
+        glm::vec4 boundsExtent{1.f};
+    };
+
+    glm::vec3 unproject(const glm::mat4 &inverseProjection, float x, float y, float z) {
+        glm::vec4 point = inverseProjection * glm::vec4(x, y, z, 1.f);
+        return glm::vec3(point) / point.w;
+    }
+
+    float projectDepth(const glm::mat4 &projection, float viewDepth) {
+        glm::vec4 point = projection * glm::vec4(0.f, 0.f, viewDepth, 1.f);
+        return point.z / point.w;
+    }
+}
+
+ShadowCascades::ShadowCascades(Device &device, const std::string &shaderDirectory) : device{device} {
+    depthFormat = device.findSupportedFormat(
+        {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM},
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+    createImage();
+    createRenderPasses();
+    createFramebuffers();
+    createSampler();
+    createPipelineLayout();
+    createPipelines(shaderDirectory);
+}
+
+ShadowCascades::~ShadowCascades() {
+    vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+    vkDestroySampler(device.device(), sampler, nullptr);
+    for (auto framebuffer : framebuffers) { vkDestroyFramebuffer(device.device(), framebuffer, nullptr); }
+    vkDestroyRenderPass(device.device(), clearRenderPass, nullptr);
+    vkDestroyRenderPass(device.device(), loadRenderPass, nullptr);
+    for (auto view : layerViews) { vkDestroyImageView(device.device(), view, nullptr); }
+    vkDestroyImageView(device.device(), sampledView, nullptr);
+    vkDestroyImage(device.device(), image, nullptr);
+    vkFreeMemory(device.device(), imageMemory, nullptr);
+}
+
+void ShadowCascades::createImage() {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = RESOLUTION;
+    imageInfo.extent.height = RESOLUTION;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = CASCADE_COUNT * 2;
+    imageInfo.format = depthFormat;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = depthFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = CASCADE_COUNT;
+    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &sampledView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow map image view!");
+    }
+
+    // One attachment view per layer, caches included
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.subresourceRange.layerCount = 1;
+    for (uint32_t layer = 0; layer < layerViews.size(); layer++) {
+        viewInfo.subresourceRange.baseArrayLayer = layer;
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &layerViews[layer]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow map layer view!");
+        }
+    }
+}
+
+void ShadowCascades::createRenderPasses() {
+    // Layouts are handled by barriers around the passes, the attachment stays in its depth layout throughout
+    auto createRenderPass = [&](VkAttachmentLoadOp loadOp, VkRenderPass &renderPass) {
+        VkAttachmentDescription attachment{};
+        attachment.format = depthFormat;
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = loadOp;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depthRef{0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 0;
+        subpass.pDepthStencilAttachment = &depthRef;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &attachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+
+        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow render pass!");
+        }
+    };
+
+    // Caches start from scratch, sampled layers keep the copied cache under the moving casters
+    createRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, clearRenderPass);
+    createRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD, loadRenderPass);
+}
+
+void ShadowCascades::createFramebuffers() {
+    for (uint32_t layer = 0; layer < framebuffers.size(); layer++) {
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = clearRenderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &layerViews[layer];
+        framebufferInfo.width = RESOLUTION;
+        framebufferInfo.height = RESOLUTION;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &framebuffers[layer]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow framebuffer!");
+        }
+    }
+}
+
+void ShadowCascades::createSampler() {
+    // Hardware comparison with bilinear weights, everything outside the cascades is lit
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeV = samplerInfo.addressModeU;
+    samplerInfo.addressModeW = samplerInfo.addressModeU;
+
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.mipLodBias = 0.0f;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 1.0f;
+
+    if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow sampler!");
+    }
+}
+
+void ShadowCascades::createPipelineLayout() {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ShadowPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 0;
+    pipelineLayoutInfo.pSetLayouts = nullptr;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+}
+
+void ShadowCascades::createPipelines(const std::string &shaderDirectory) {
+    assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+    PipelineConfigInfo pipelineConfig{};
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.renderPass = clearRenderPass;
+    pipelineConfig.pipelineLayout = pipelineLayout;
+
+    // Both faces cast, thin sheets like curtains and leaves have no back side
+    pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+    pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
+    pipelineConfig.rasterizationInfo.depthBiasConstantFactor = DEPTH_BIAS_CONSTANT;
+    pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = DEPTH_BIAS_SLOPE;
+    pipelineConfig.colorBlendInfo.attachmentCount = 0;
+    pipelineConfig.colorBlendInfo.pAttachments = nullptr;
+    pipelineConfig.bindingDescriptions = Model::getPositionBindingDescriptions();
+    pipelineConfig.attributeDescriptions = Model::getPositionAttributeDescriptions();
+
+    pipeline = std::make_unique<Pipeline>(
+        device,
+        shaderDirectory+"shadow.vert.spv",
+        shaderDirectory+"depth.frag.spv",
+        pipelineConfig);
+
+    // Packed models are drawn from their own stream, decoded on constant_id 0
+    VkBool32 packed = VK_TRUE;
+    VkSpecializationMapEntry specializationEntry{0, 0, sizeof(VkBool32)};
+    VkSpecializationInfo specializationInfo{1, &specializationEntry, sizeof(VkBool32), &packed};
+    pipelineConfig.bindingDescriptions = Model::PackedVertex::getBindingDescriptions();
+    pipelineConfig.attributeDescriptions = {Model::PackedVertex::getAttributeDescriptions()[0]};
+    pipelineConfig.vertexSpecializationInfo = &specializationInfo;
+
+    packedPipeline = std::make_unique<Pipeline>(
+        device,
+        shaderDirectory+"shadow.vert.spv",
+        shaderDirectory+"depth.frag.spv",
+        pipelineConfig);
+}
+
+glm::vec4 ShadowCascades::getSplitDepths() const {
+    glm::vec4 splits{0.f};
+    for (uint32_t i = 0; i < CASCADE_COUNT; i++) { splits[i] = cascades[i].splitDepth; }
+    return splits;
+}
+
+void ShadowCascades::update(const Camera &camera, const glm::vec3 &lightDirection, EntityRegistry &scene) {
+    // World boxes of every caster, the static ones decide the depth range of the cascades
+    casters.clear();
+    hasDynamicCasters = false;
+    Aabb staticBounds{};
+    auto &renderables = scene.view<RenderComponent>();
+    auto &transforms = scene.getTransforms();
+    for (size_t i = 0; i < renderables.size(); i++) {
+        const Entity entity = renderables.getEntities()[i];
+        // Only what the scene passes draw casts a shadow
+        if (!scene.isRenderable(entity)) { continue; }
+        const Model *model = renderables.getComponents()[i].model.get();
+        if (!model) { continue; }
+        Aabb local{};
+        local.min = model->getBoundsMin();
+        local.max = model->getBoundsMin() + model->getBoundsExtent();
+        Caster caster{entity, local.transformed(transforms.getWorldMatrix(scene.getTransform(entity))), scene.has<PhysicsComponent>(entity)};
+        if (caster.dynamic) {
+            hasDynamicCasters = true;
+        } else {
+            staticBounds.grow(caster.bounds);
+        }
+        casters.push_back(caster);
+    }
+
+    // Turning the light or changing the static scene invalidates every cache
+    const glm::vec3 direction = glm::normalize(lightDirection);
+    bool refitAll = !cacheStatic || glm::dot(direction, cachedLightDirection) < LIGHT_TOLERANCE
+        || staticBounds.min != cachedBounds.min || staticBounds.max != cachedBounds.max;
+    if (refitAll) {
+        cachedLightDirection = direction;
+        cachedBounds = staticBounds;
+    }
+
+    Camera lightCamera{};
+    const glm::vec3 up = std::abs(cachedLightDirection.y) > .99f ? glm::vec3{0.f, 0.f, 1.f} : glm::vec3{0.f, -1.f, 0.f};
+    lightCamera.setViewDirection(glm::vec3{0.f}, cachedLightDirection, up);
+    const glm::mat4 &lightView = lightCamera.getView();
+
+    // Depth range covers the whole static scene, casters outside the camera frustum still throw shadows into it
+    float minDepth = -maxDistance, maxDepth = maxDistance;
+    if (!cachedBounds.isEmpty()) {
+        Aabb lightBounds = cachedBounds.transformed(lightView);
+        const float padding = .05f * (lightBounds.max.z - lightBounds.min.z) + .1f;
+        minDepth = lightBounds.min.z - padding;
+        maxDepth = lightBounds.max.z + padding;
+    }
+
+    // Practical split scheme between the camera near plane and maxDistance
+    const glm::mat4 &projection = camera.getProjection();
+    const glm::mat4 inverseProjection = glm::inverse(projection);
+    const float near = std::max(unproject(inverseProjection, 0.f, 0.f, 0.f).z, 1e-3f);
+    const float far = std::min(unproject(inverseProjection, 0.f, 0.f, 1.f).z, maxDistance);
+    float sliceNear = near;
+    for (uint32_t i = 0; i < CASCADE_COUNT; i++) {
+        auto &cascade = cascades[i];
+        const float fraction = static_cast<float>(i + 1) / CASCADE_COUNT;
+        const float logSplit = near * std::pow(far / near, fraction);
+        const float uniformSplit = near + (far - near) * fraction;
+        cascade.splitDepth = SPLIT_LAMBDA * logSplit + (1.f - SPLIT_LAMBDA) * uniformSplit;
+
+        // Bounding sphere of the slice, its radius only changes with the projection
+        glm::vec3 corners[8];
+        glm::vec3 center{0.f};
+        const float depths[2] = {projectDepth(projection, sliceNear), projectDepth(projection, cascade.splitDepth)};
+        for (uint32_t corner = 0; corner < 8; corner++) {
+            glm::vec3 point = unproject(inverseProjection, corner & 1 ? 1.f : -1.f, corner & 2 ? 1.f : -1.f, depths[corner >> 2]);
+            corners[corner] = glm::vec3(camera.getInverseView() * glm::vec4(point, 1.f));
+            center += corners[corner] / 8.f;
+        }
+        float radius = 0.f;
+        for (const auto &corner : corners) { radius = std::max(radius, glm::length(corner - center)); }
+        // Rounded up so rotating the camera doesn't refit on float noise
+        radius = std::ceil(radius * 16.f) / 16.f;
+        sliceNear = cascade.splitDepth;
+
+        // The cache holds while the slice sphere stays inside the square it was drawn for
+        const glm::vec2 lightCenter{lightView * glm::vec4(center, 1.f)};
+        const glm::vec2 offset = glm::abs(lightCenter - cascade.center) + radius;
+        if (!refitAll && radius == cascade.radius && offset.x <= cascade.halfSize && offset.y <= cascade.halfSize) { continue; }
+
+        // Snapped to whole texels, so consecutive refits keep the same rasterization grid
+        cascade.radius = radius;
+        cascade.halfSize = radius * (1.f + CACHE_MARGIN);
+        const float texelSize = 2.f * cascade.halfSize / RESOLUTION;
+        cascade.center = glm::floor(lightCenter / texelSize) * texelSize;
+        lightCamera.setOrthographicProjection(
+            cascade.center.x - cascade.halfSize, cascade.center.x + cascade.halfSize,
+            cascade.center.y - cascade.halfSize, cascade.center.y + cascade.halfSize,
+            minDepth, maxDepth);
+        cascade.viewProjection = lightCamera.getProjection() * lightView;
+        cascade.stale = true;
+    }
+}
+
+void ShadowCascades::transitionLayers(
+    VkCommandBuffer commandBuffer,
+    uint32_t baseLayer,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout,
+    VkPipelineStageFlags srcStage,
+    VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStage,
+    VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = baseLayer;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+uint32_t ShadowCascades::drawCasters(VkCommandBuffer commandBuffer, EntityRegistry &scene, uint32_t cascade, uint32_t layer, bool dynamic, VkRenderPass renderPass) {
+    VkClearValue clearValue{};
+    clearValue.depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = framebuffers[layer];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = {RESOLUTION, RESOLUTION};
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearValue;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport{0.f, 0.f, static_cast<float>(RESOLUTION), static_cast<float>(RESOLUTION), 0.f, 1.f};
+    VkRect2D scissor{{0, 0}, {RESOLUTION, RESOLUTION}};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    const glm::mat4 &viewProjection = cascades[cascade].viewProjection;
+    auto &transforms = scene.getTransforms();
+    Pipeline *boundPipeline = nullptr;
+    uint32_t drawCount = 0;
+    for (const auto &caster : casters) {
+        if (caster.dynamic != dynamic) { continue; }
+        // Light clip space is affine, the box only has to overlap the cascade square
+        Aabb clip = caster.bounds.transformed(viewProjection);
+        if (clip.max.x < -1.f || clip.min.x > 1.f || clip.max.y < -1.f || clip.min.y > 1.f) { continue; }
+
+        Model *model = scene.get<RenderComponent>(caster.entity).model.get();
+        const bool packed = model->getVertexFormat() == Model::VertexFormat::Packed;
+        Pipeline *casterPipeline = packed ? packedPipeline.get() : pipeline.get();
+        if (casterPipeline != boundPipeline) {
+            casterPipeline->bind(commandBuffer);
+            boundPipeline = casterPipeline;
+        }
+        if (packed) {
+            model->bind(commandBuffer);
+        } else {
+            model->bindPositionsOnly(commandBuffer);
+        }
+
+        ShadowPushConstants push{};
+        push.lightMatrix = viewProjection * transforms.getWorldMatrix(scene.getTransform(caster.entity));
+        push.boundsMin = glm::vec4(model->getBoundsMin(), 0.f);
+        push.boundsExtent = glm::vec4(model->getBoundsExtent(), 0.f);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShadowPushConstants), &push);
+        model->draw(commandBuffer);
+        drawCount++;
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+    return drawCount;
+}
+
+void ShadowCascades::render(VkCommandBuffer commandBuffer, EntityRegistry &scene) {
+    stats = {};
+
+    // Caches of the refitted cascades, their old content is dropped
+    for (uint32_t i = 0; i < CASCADE_COUNT; i++) {
+        if (!cascades[i].stale) { continue; }
+        const uint32_t layer = CASCADE_COUNT + i;
+        transitionLayers(commandBuffer, layer,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+        stats.staticDraws += drawCasters(commandBuffer, scene, i, layer, false, clearRenderPass);
+        transitionLayers(commandBuffer, layer,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        stats.redrawnCascades++;
+    }
+
+    // Sampled layers are only touched when their cache changed or moving casters are around
+    for (uint32_t i = 0; i < CASCADE_COUNT; i++) {
+        auto &cascade = cascades[i];
+        if (!cascade.stale && !cascade.hasDynamic && !hasDynamicCasters) { continue; }
+
+        // Fully overwritten, earlier frames only have to be done sampling it
+        transitionLayers(commandBuffer, i,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+        VkImageCopy region{};
+        region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, CASCADE_COUNT + i, 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1};
+        region.extent = {RESOLUTION, RESOLUTION, 1};
+        vkCmdCopyImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        cascade.hasDynamic = false;
+        if (hasDynamicCasters) {
+            transitionLayers(commandBuffer, i,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+            uint32_t draws = drawCasters(commandBuffer, scene, i, i, true, loadRenderPass);
+            cascade.hasDynamic = draws > 0;
+            stats.dynamicDraws += draws;
+            transitionLayers(commandBuffer, i,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        } else {
+            transitionLayers(commandBuffer, i,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        }
+        cascade.stale = false;
+        stats.copiedCascades++;
+    }
+}
@@ -0,0 +1,150 @@
+//
+//  TransformSystem.cpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#include "include/TransformSystem.hpp"
+
+//std
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+TransformSystem::Handle TransformSystem::create(glm::vec3 translation, glm::vec3 rotation, glm::vec3 scale, Handle parent) {
+    // Any free slot works for a root, a child needs one past its parent to keep the topological order
+    auto reusable = std::find_if(freeList.begin(), freeList.end(), [&](Handle slot) { return parent == NO_PARENT || slot > parent; });
+
+    Handle handle;
+    if (reusable != freeList.end()) {
+        handle = *reusable;
+        *reusable = freeList.back();
+        freeList.pop_back();
+        translations[handle] = translation;
+        rotations[handle] = rotation;
+        scales[handle] = scale;
+    } else {
+        handle = size();
+        translations.push_back(translation);
+        rotations.push_back(rotation);
+        scales.push_back(scale);
+        parents.push_back(NO_PARENT);
+        dirty.push_back(0);
+        worldMatrices.emplace_back(1.f);
+        normalMatrices.emplace_back(1.f);
+    }
+
+    if (parent != NO_PARENT) { setParent(handle, parent); }
+    markDirty(handle);
+    return handle;
+}
+
+void TransformSystem::destroy(Handle handle) {
+    setParent(handle, NO_PARENT);
+    if (parentedCount > 0) {
+        for (Handle i = handle + 1; i < size(); i++) {
+            if (parents[i] == handle) { setParent(i, NO_PARENT); }
+        }
+    }
+    freeList.push_back(handle);
+}
+
+void TransformSystem::setParent(Handle handle, Handle parent) {
+    if (parent != NO_PARENT && parent >= handle) {
+        throw std::runtime_error("transform parent must be created before its children!");
+    }
+    if (parents[handle] == NO_PARENT && parent != NO_PARENT) { parentedCount++; }
+    if (parents[handle] != NO_PARENT && parent == NO_PARENT) { parentedCount--; }
+    parents[handle] = parent;
+    markDirty(handle);
+}
+
+void TransformSystem::markDirty(Handle handle) {
+    if (dirty[handle]) { return; }
+    dirty[handle] = 1;
+    dirtyList.push_back(handle);
+}
+
+void TransformSystem::propagateDirty() {
+    // Parents precede children, one forward pass from the first dirty entry reaches every descendant
+    Handle first = *std::min_element(dirtyList.begin(), dirtyList.end());
+    dirtyList.clear();
+    for (Handle i = first; i < size(); i++) {
+        if (!dirty[i] && parents[i] != NO_PARENT && dirty[parents[i]]) { dirty[i] = 1; }
+        if (dirty[i]) { dirtyList.push_back(i); }
+    }
+}
+
+uint32_t TransformSystem::update() {
+    updatedList.clear();
+    if (dirtyList.empty()) { return 0; }
+
+    if (parentedCount > 0) {
+        propagateDirty();
+    } else {
+        std::sort(dirtyList.begin(), dirtyList.end());
+    }
+
+    for (size_t i = 0; i < dirtyList.size(); i += BATCH_SIZE) {
+        uint32_t count = static_cast<uint32_t>(std::min<size_t>(BATCH_SIZE, dirtyList.size() - i));
+        updateBatch(dirtyList.data() + i, count);
+    }
+    for (Handle handle : dirtyList) { dirty[handle] = 0; }
+
+    // Kept until the next update so dependent structures can refit the same entries
+    updatedList.swap(dirtyList);
+    dirtyList.clear();
+    return static_cast<uint32_t>(updatedList.size());
+}
+
+void TransformSystem::updateBatch(const Handle *batch, uint32_t count) {
+    // Gather the angles into flat lanes so the sin/cos loops vectorize, then compose in handle order
+    float angles[3][BATCH_SIZE];
+    float sines[3][BATCH_SIZE];
+    float cosines[3][BATCH_SIZE];
+    for (uint32_t i = 0; i < count; i++) {
+        const glm::vec3 &rotation = rotations[batch[i]];
+        angles[0][i] = rotation.x;
+        angles[1][i] = rotation.y;
+        angles[2][i] = rotation.z;
+    }
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        for (uint32_t i = 0; i < count; i++) { sines[axis][i] = std::sin(angles[axis][i]); }
+        for (uint32_t i = 0; i < count; i++) { cosines[axis][i] = std::cos(angles[axis][i]); }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        Handle handle = batch[i];
+        const float s1 = sines[1][i], c1 = cosines[1][i];
+        const float s2 = sines[0][i], c2 = cosines[0][i];
+        const float s3 = sines[2][i], c3 = cosines[2][i];
+
+        // Same rotation basis as TransformComponent::mat4(), the normal matrix scales by the inverse instead
+        const glm::mat3 rotation{
+            {c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1},
+            {c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3},
+            {c2 * s1, -s2, c1 * c2}
+        };
+        const glm::vec3 &scale = scales[handle];
+        const glm::vec3 invScale = 1.f / scale;
+
+        glm::mat4 local{
+            glm::vec4(rotation[0] * scale.x, 0.f),
+            glm::vec4(rotation[1] * scale.y, 0.f),
+            glm::vec4(rotation[2] * scale.z, 0.f),
+            glm::vec4(translations[handle], 1.f)
+        };
+        glm::mat3 localNormal{rotation[0] * invScale.x, rotation[1] * invScale.y, rotation[2] * invScale.z};
+
+        // The inverse transpose distributes over products, so normal matrices chain like world matrices
+        Handle parent = parents[handle];
+        if (parent == NO_PARENT) {
+            worldMatrices[handle] = local;
+            normalMatrices[handle] = localNormal;
+        } else {
+            worldMatrices[handle] = worldMatrices[parent] * local;
+            normalMatrices[handle] = normalMatrices[parent] * localNormal;
+        }
+    }
+}
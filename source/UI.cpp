@@ -12,7 +12,7 @@
 #include <iostream>
 #include <fstream>
 
-UI::UI(Device &device, VkRenderPass renderPass, std::string binaryPath) : device{device} {
+UI::UI(Device &device, std::string binaryPath) : device{device}, shaderPath{binaryPath+"imgui"} {
     vertexBuffers = new std::vector<std::unique_ptr<Buffer>>(SwapChain::MAX_FRAMES_IN_FLIGHT);
     indexBuffers = new std::vector<std::unique_ptr<Buffer>>(SwapChain::MAX_FRAMES_IN_FLIGHT);
     
@@ -25,7 +25,7 @@ UI::UI(Device &device, VkRenderPass renderPass, std::string binaryPath) : device
     
     loadFontTexture(binaryPath);
     createDescriptors();
-    createPipeline(renderPass, binaryPath+"imgui");
+    createPipelineLayout();
     
     ImGui::StyleColorsDark();
 }
@@ -33,7 +33,9 @@ UI::UI(Device &device, VkRenderPass renderPass, std::string binaryPath) : device
 UI::~UI() {
     ImGui::DestroyContext();
     
-    vkDestroyPipeline(device.device(), imguiPipeline, nullptr);
+    for (auto pipeline : imguiPipelines) {
+        vkDestroyPipeline(device.device(), pipeline, nullptr);
+    }
     vkDestroyPipelineLayout(device.device(), imguiPipelineLayout, nullptr);
     
     vkDestroySampler(device.device(), fontSampler, nullptr);
@@ -49,7 +51,17 @@ UI::~UI() {
     indexBuffers = nullptr;
 }
 
-void UI::createPipeline(VkRenderPass renderPass, std::string dynamicShaderPath) {
+uint32_t UI::createPipeline(VkRenderPass renderPass, uint32_t subpass) {
+    imguiPipelines.push_back(buildPipeline(renderPass, subpass));
+    return static_cast<uint32_t>(imguiPipelines.size() - 1);
+}
+
+void UI::recreatePipeline(uint32_t index, VkRenderPass renderPass, uint32_t subpass) {
+    vkDestroyPipeline(device.device(), imguiPipelines[index], nullptr);
+    imguiPipelines[index] = buildPipeline(renderPass, subpass);
+}
+
+void UI::createPipelineLayout() {
     VkPushConstantRange pushConstantRanges[1];
 
     pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
@@ -67,15 +79,21 @@ void UI::createPipeline(VkRenderPass renderPass, std::string dynamicShaderPath)
     if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &imguiPipelineLayout) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create pipeline layout!");
     }
-    
+}
+
+VkPipeline UI::buildPipeline(VkRenderPass renderPass, uint32_t subpass) {
     PipelineConfigInfo pipelineConfig{};
     Pipeline::defaultPipelineConfigInfo(pipelineConfig);
     pipelineConfig.renderPass = renderPass;
+    pipelineConfig.subpass = subpass;
     pipelineConfig.pipelineLayout = imguiPipelineLayout;
     pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
     
-    auto vertCode = readFile(dynamicShaderPath+".vert.spv");
-    auto fragCode = readFile(dynamicShaderPath+".frag.spv");
+    auto vertCode = readFile(shaderPath+".vert.spv");
+    auto fragCode = readFile(shaderPath+".frag.spv");
+    
+    VkShaderModule vertShaderModule;
+    VkShaderModule fragShaderModule;
     
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -140,6 +158,7 @@ void UI::createPipeline(VkRenderPass renderPass, std::string dynamicShaderPath)
     pipelineInfo.basePipelineIndex = -1;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     
+    VkPipeline imguiPipeline;
     if(vkCreateGraphicsPipelines(device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &imguiPipeline) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create imgui pipeline");
     }
@@ -147,6 +166,7 @@ void UI::createPipeline(VkRenderPass renderPass, std::string dynamicShaderPath)
     for (auto shaderStage : shaderStages) {
         vkDestroyShaderModule(device.device(), shaderStage.module, nullptr);
     }
+    return imguiPipeline;
 }
 
 void UI::createDescriptors() {
@@ -242,11 +262,11 @@ void UI::updateBuffers(int frameIndex) {
 }
 
 
-void UI::draw(VkCommandBuffer commandBuffer, int frameIndex) {
+void UI::draw(VkCommandBuffer commandBuffer, int frameIndex, uint32_t pipelineIndex) {
     ImGuiIO& io = ImGui::GetIO();
 
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, imguiPipelineLayout, 0, 1, &imguiDescriptorSets->at(frameIndex), 0, nullptr);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, imguiPipeline);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, imguiPipelines[pipelineIndex]);
     
     VkViewport viewport {
         0, 0,
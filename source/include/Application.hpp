@@ -22,12 +22,23 @@
 #include "Model.hpp"
 #include "Renderer.hpp"
 #include "SolidObject.hpp"
+#include "EntityRegistry.hpp"
+#include "SceneBvh.hpp"
+#include "GpuCulling.hpp"
+#include "OcclusionCuller.hpp"
+#include "PotentiallyVisibleSet.hpp"
 #include "Camera.hpp"
 #include "Keyboard.hpp"
 #include "Texture.hpp"
 #include "TextRender.hpp"
 #include "HDRi.hpp"
 #include "CompositionPipeline.hpp"
+#include "DeferredLighting.hpp"
+#include "JobSystem.hpp"
+#include "GpuTimer.hpp"
+#include "LightClusters.hpp"
+#include "ShadowCascades.hpp"
+#include "DynamicResolution.hpp"
 
 //std
 #include <memory>
@@ -38,10 +49,15 @@
 struct GlobalUbo {
     glm::mat4 projectionView{1.f};
     glm::vec4 ambientLightColor{1.f, 1.f, 1.f, .1f};
-    glm::vec4 lightPosition[2] = {{.0f,-1.f,.0f,.0f},{.0f,-1.f,.0f,.0f}};
-    glm::vec4 lightColor{1.f, 1.f, 1.f, 10.f};
     glm::mat4 viewMatrix{1.f};
     glm::mat4 invViewMatrix{1.f};
+    glm::vec4 clusterScale{0.f};    // Fragment to light cluster mapping, see LightClusters
+    glm::uvec4 clusterGrid{0};
+    glm::mat4 invProjectionMatrix{1.f};   // Depth back to view space in the deferred lighting pass
+    glm::vec4 sunDirection{0.f, 1.f, 0.f, 0.f};     // Where sunlight travels, w is 1 when the cascades are sampled
+    glm::vec4 sunColor{0.f};
+    glm::vec4 cascadeSplits{0.f};   // View depth each shadow cascade ends at
+    glm::mat4 cascadeMatrices[ShadowCascades::CASCADE_COUNT]{};
 };
 
 class Application {
@@ -60,26 +76,59 @@ public:
     void simulate();
     void renderImguiContent();
     
+    // Offline tool, writes the PVS of the static scene next to its meshes without opening a window
+    static void bakeVisibility(const char *binaryPath);
+    // Offline tool, times the collision BVH build and random ray queries over the static scene
+    static void benchmarkBvh(const char *binaryPath);
+    
     static int sum(int a) { return a + a; }
     
 private:
     void loadSolidObjects();
+    void spawnLights(uint32_t count);
     
     SDLWindow window{WIDTH, HEIGHT, "Vulkan Engine Development"};
     Device device{window};
     Renderer renderer{window, device};
     Image vulkanImage{device};
+    JobSystem jobSystem{};
     std::unique_ptr<RenderSystem> renderSystem;
     std::unique_ptr<RenderSystem> skyboxSystem;
-    std::unique_ptr<CompositionPipeline> postProcessing;
+    std::unique_ptr<CompositionPipeline> postProcessing;     // Pipeline 0 runs in the forward pass, 1 in the deferred one
+    bool recreatePassPipelines = false;         // Composition, upscale and UI pipelines, rebuilt after an MSAA change
+    DynamicResolution dynamicResolution{Renderer::MIN_RENDER_SCALE, 1.f};
+    bool useDynamicResolution = false;          // Off keeps the render scale picked in the settings
+    std::unique_ptr<DeferredLighting> deferredLighting;
+    bool useDeferred = false;                   // Needs MSAA off, forward otherwise
+    bool useDepthPrepass = false;               // Forward only
+    // Scene pass timings, one scope per way of drawing it so the toggles can be compared
+    enum class GpuScope : uint32_t { Forward, DepthPrepass, Deferred, Shadows, Upscale, Frame };
+    GpuTimer gpuTimer{device};
+    std::unique_ptr<GpuCulling> gpuCulling;     // Null when the device lacks multiDrawIndirect
+    bool useGpuCulling = true;
+    OcclusionCuller occlusionCuller;            // CPU path only, GpuCulling has its own Hi-Z test
+    bool useOcclusionCulling = true;
+    PotentiallyVisibleSet pvs;
+    bool usePvs = true;
+    float lodPixelError = 1.f;
+    LightClusters lightClusters{device};
+    int extraLightCount = 0;                    // Random point lights on top of the two main ones
+    std::unique_ptr<ShadowCascades> shadowCascades;
+    bool useShadows = true;
+    glm::vec2 sunAngles{glm::radians(60.f), glm::radians(30.f)};     // Elevation and azimuth
+    glm::vec3 sunColor{1.f, .95f, .85f};
+    float sunIntensity = 3.f;
     
     std::unordered_map<uint32_t, std::unique_ptr<Texture>> textures{};
     std::vector<VkDescriptorImageInfo> textureInfos{};
     bool assetsLoaded = false;
     
     std::unique_ptr<DescriptorPool> globalPool{};
-    SolidObject::Map solidObjects;
-    SolidObject::Map env;
+    EntityRegistry scene;
+    EntityRegistry env;
+    SceneBvh sceneBvh;
+    Entity pickedEntity{};
+    float pickedDistance{0.f};
     
     SDL_Event sdl_event;
     int frameIndex{0};
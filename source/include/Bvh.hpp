@@ -0,0 +1,223 @@
+//
+//  Bvh.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef Bvh_hpp
+#define Bvh_hpp
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+//std
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+struct Aabb {
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{-std::numeric_limits<float>::max()};
+
+    void grow(const glm::vec3 &point) { min = glm::min(min, point); max = glm::max(max, point); }
+    void grow(const Aabb &other) { min = glm::min(min, other.min); max = glm::max(max, other.max); }
+    bool isEmpty() const { return min.x > max.x; }
+    glm::vec3 center() const { return .5f * (min + max); }
+    float surfaceArea() const;
+
+    // Bounds of the eight transformed corners, computed per axis
+    Aabb transformed(const glm::mat4 &matrix) const;
+};
+
+struct Ray {
+    glm::vec3 origin{};
+    glm::vec3 direction{0.f, 0.f, 1.f};
+};
+
+// Planes point inward, a box is outside when it lies fully behind one of them
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Clip matrix with Vulkan 0..1 depth, as produced by Camera
+    static Frustum fromMatrix(const glm::mat4 &clip);
+
+    bool intersects(const Aabb &box) const;
+};
+
+/*
+ * 4-wide bounding volume hierarchy over axis aligned boxes
+ * Built as a binned SAH binary tree and collapsed so each node tests four children at once,
+ * child bounds are kept as structure-of-arrays lanes so the per-node tests vectorize
+ */
+class Bvh {
+public:
+    static constexpr uint32_t WIDTH = 4;
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+    static constexpr uint32_t SAH_BINS = 16;
+    static constexpr float TRAVERSAL_COST = 1.f;    // Relative to one primitive test
+    static constexpr uint32_t INVALID = UINT32_MAX;
+    static constexpr uint32_t STACK_SIZE = 256;
+    // Past this binary depth the build makes a leaf whatever its size, traversal pushes at most WIDTH - 1 entries per level
+    static constexpr uint32_t MAX_DEPTH = 64;
+    static_assert(MAX_DEPTH * (WIDTH - 1) + 1 <= STACK_SIZE, "traversal stack too small for MAX_DEPTH");
+
+    struct Node {
+        float minX[WIDTH], minY[WIDTH], minZ[WIDTH];
+        float maxX[WIDTH], maxY[WIDTH], maxZ[WIDTH];
+        uint32_t child[WIDTH];  // Inner lane: node index, leaf lane: first entry of primitiveIndices
+        uint32_t count[WIDTH];  // 0 for inner lanes, primitives in the leaf otherwise
+    };
+
+    void build(const std::vector<Aabb> &primitiveBounds);
+
+    // Same topology, recomputes only the nodes above the changed primitives
+    void refit(const std::vector<Aabb> &primitiveBounds, const std::vector<uint32_t> &changedPrimitives);
+
+    bool isEmpty() const { return nodes.empty(); }
+    size_t getNodeCount() const { return nodes.size(); }
+    Aabb getBounds() const;
+
+    // visit(primitive) for every primitive in a leaf not fully outside the frustum, conservative at leaf granularity
+    template<typename Visit>
+    void query(const Frustum &frustum, Visit visit) const;
+
+    // visit(primitive) for every primitive in a leaf overlapping the query box
+    template<typename Visit>
+    void query(const Aabb &box, Visit visit) const;
+
+    // Nearest first, hit(primitive, tMax) returns true and shrinks tMax when it finds a closer hit
+    template<typename Hit>
+    bool intersect(const Ray &ray, float &tMax, Hit hit) const;
+
+private:
+    struct BuildNode {
+        Aabb bounds;
+        uint32_t left, right;
+        uint32_t first, count;
+    };
+
+    uint32_t buildRecursive(std::vector<BuildNode> &buildNodes, const std::vector<Aabb> &bounds, const std::vector<glm::vec3> &centroids, uint32_t first, uint32_t count, uint32_t depth);
+    uint32_t collapse(const std::vector<BuildNode> &buildNodes, uint32_t buildIndex, uint32_t parent);
+    void setLane(Node &node, uint32_t lane, const Aabb &bounds);
+    void refitNode(uint32_t nodeIndex, const std::vector<Aabb> &primitiveBounds);
+
+    std::vector<Node> nodes{};
+    std::vector<uint32_t> parents{};
+    std::vector<uint32_t> primitiveIndices{};
+    std::vector<uint32_t> primitiveNodes{};
+    std::vector<uint8_t> dirtyNodes{};
+};
+
+template<typename Visit>
+void Bvh::query(const Frustum &frustum, Visit visit) const {
+    if (nodes.empty()) { return; }
+    uint32_t stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const Node &node = nodes[stack[--stackSize]];
+        bool inside[WIDTH] = {true, true, true, true};
+        for (const auto &plane : frustum.planes) {
+            // Corner furthest along the plane normal, empty lanes end up at -inf
+            for (uint32_t lane = 0; lane < WIDTH; lane++) {
+                float x = plane.x > 0.f ? node.maxX[lane] : node.minX[lane];
+                float y = plane.y > 0.f ? node.maxY[lane] : node.minY[lane];
+                float z = plane.z > 0.f ? node.maxZ[lane] : node.minZ[lane];
+                inside[lane] = inside[lane] && (plane.x * x + plane.y * y + plane.z * z + plane.w >= 0.f);
+            }
+        }
+        for (uint32_t lane = 0; lane < WIDTH; lane++) {
+            if (!inside[lane] || node.child[lane] == INVALID) { continue; }
+            if (node.count[lane] == 0) {
+                stack[stackSize++] = node.child[lane];
+            } else {
+                for (uint32_t i = 0; i < node.count[lane]; i++) { visit(primitiveIndices[node.child[lane] + i]); }
+            }
+        }
+    }
+}
+
+template<typename Visit>
+void Bvh::query(const Aabb &box, Visit visit) const {
+    if (nodes.empty()) { return; }
+    uint32_t stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const Node &node = nodes[stack[--stackSize]];
+        bool overlap[WIDTH];
+        for (uint32_t lane = 0; lane < WIDTH; lane++) {
+            overlap[lane] =
+                node.minX[lane] <= box.max.x && node.maxX[lane] >= box.min.x &&
+                node.minY[lane] <= box.max.y && node.maxY[lane] >= box.min.y &&
+                node.minZ[lane] <= box.max.z && node.maxZ[lane] >= box.min.z;
+        }
+        for (uint32_t lane = 0; lane < WIDTH; lane++) {
+            if (!overlap[lane] || node.child[lane] == INVALID) { continue; }
+            if (node.count[lane] == 0) {
+                stack[stackSize++] = node.child[lane];
+            } else {
+                for (uint32_t i = 0; i < node.count[lane]; i++) { visit(primitiveIndices[node.child[lane] + i]); }
+            }
+        }
+    }
+}
+
+template<typename Hit>
+bool Bvh::intersect(const Ray &ray, float &tMax, Hit hit) const {
+    if (nodes.empty()) { return false; }
+
+    // Zero components would turn 0 * inf slabs into NaN
+    glm::vec3 direction = ray.direction;
+    for (int axis = 0; axis < 3; axis++) {
+        if (std::abs(direction[axis]) < 1e-12f) { direction[axis] = 1e-12f; }
+    }
+    const glm::vec3 invDirection = 1.f / direction;
+    const glm::vec3 originScaled = -ray.origin * invDirection;
+
+    struct Entry { uint32_t node; float distance; };
+    Entry stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = {0, 0.f};
+    bool found = false;
+
+    while (stackSize > 0) {
+        Entry entry = stack[--stackSize];
+        if (entry.distance > tMax) { continue; }
+        const Node &node = nodes[entry.node];
+
+        float tNear[WIDTH], tFar[WIDTH];
+        for (uint32_t lane = 0; lane < WIDTH; lane++) {
+            float x0 = node.minX[lane] * invDirection.x + originScaled.x, x1 = node.maxX[lane] * invDirection.x + originScaled.x;
+            float y0 = node.minY[lane] * invDirection.y + originScaled.y, y1 = node.maxY[lane] * invDirection.y + originScaled.y;
+            float z0 = node.minZ[lane] * invDirection.z + originScaled.z, z1 = node.maxZ[lane] * invDirection.z + originScaled.z;
+            tNear[lane] = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.f));
+            tFar[lane] = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), tMax));
+        }
+
+        // Push inner children far to near so the nearest is popped first
+        Entry children[WIDTH];
+        uint32_t childCount = 0;
+        for (uint32_t lane = 0; lane < WIDTH; lane++) {
+            if (tNear[lane] > tFar[lane] || node.child[lane] == INVALID) { continue; }
+            if (node.count[lane] == 0) {
+                children[childCount++] = {node.child[lane], tNear[lane]};
+            } else {
+                for (uint32_t i = 0; i < node.count[lane]; i++) {
+                    found |= hit(primitiveIndices[node.child[lane] + i], tMax);
+                }
+            }
+        }
+        std::sort(children, children + childCount, [](const Entry &a, const Entry &b) { return a.distance > b.distance; });
+        for (uint32_t i = 0; i < childCount; i++) { stack[stackSize++] = children[i]; }
+    }
+    return found;
+}
+
+#endif /* Bvh_hpp */
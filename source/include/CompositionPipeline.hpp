@@ -22,7 +22,6 @@ class CompositionPipeline {
  public:
   CompositionPipeline(
     Device &passDevice,
-    VkRenderPass renderPass,
     VkDescriptorSetLayout compositionSetLayout,
     std::string dynamicShaderPath);
   ~CompositionPipeline();
@@ -30,24 +29,53 @@ class CompositionPipeline {
   CompositionPipeline(const CompositionPipeline &) = delete;
   CompositionPipeline &operator=(const CompositionPipeline &) = delete;
 
-  virtual void renderSceneToSwapChain(VkCommandBuffer commandBuffer, VkDescriptorSet &descriptorSets);
+  // One pipeline per render pass composition runs in, returns the index renderSceneToSwapChain takes
+  uint32_t createPipeline(VkRenderPass renderPass, uint32_t subpass);
+  void recreatePipeline(uint32_t index, VkRenderPass renderPass, uint32_t subpass);
+
+  virtual void renderSceneToSwapChain(VkCommandBuffer commandBuffer, VkDescriptorSet &descriptorSets, uint32_t pipelineIndex = 0);
+  
+  // Stretches the tone mapped frame rendered into the top left renderExtent of a frameExtent image over the target
+  void createUpscalePipeline(VkRenderPass renderPass, VkDescriptorSetLayout upscaleSetLayout, const std::string &upscaleShader);
+  void upscale(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, VkExtent2D renderExtent, VkExtent2D frameExtent);
+  
+  // FSR1 style spatial upscaling: EASU resamples the frame into an output sized target along its edges, RCAS sharpens that
+  // Share the upscale pipeline layout, call after createUpscalePipeline
+  void createFsrPipelines(VkRenderPass easuRenderPass, VkRenderPass sharpenRenderPass, const std::string &shaderDirectory);
+  // Rebuilds the upscale, EASU and RCAS pipelines against recreated render passes
+  void recreateUpscalePipelines(VkRenderPass upscaleRenderPass, VkRenderPass easuRenderPass);
+  void easu(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, VkExtent2D renderExtent, VkExtent2D frameExtent);
+  void sharpen(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet);
   
   float exposure = 1.5f;
   float peak_brightness = 2.f;
   float gamma = 2.2f;
+  
+  enum class Upscaler { Bilinear, Fsr };
+  Upscaler upscaler = Upscaler::Fsr;
+  // RCAS strength in stops below the maximum, 0 is the sharpest
+  float sharpness = .2f;
 
  private:
   void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-  void createPipeline(VkRenderPass renderPass);
+  std::unique_ptr<Pipeline> buildPipeline(VkRenderPass renderPass, uint32_t subpass);
+  std::unique_ptr<Pipeline> buildUpscalePipeline(VkRenderPass renderPass, const std::string &fragmentShaderPath);
+  void createQuad();
 
 protected:
     Device &device;
 
     std::unique_ptr<Model> quad;
-    std::unique_ptr<Pipeline> pipeline;
+    std::vector<std::unique_ptr<Pipeline>> pipelines;
     VkPipelineLayout pipelineLayout;
+    std::unique_ptr<Pipeline> upscalePipeline;
+    VkPipelineLayout upscalePipelineLayout{VK_NULL_HANDLE};
+    std::unique_ptr<Pipeline> easuPipeline;
+    std::unique_ptr<Pipeline> rcasPipeline;
 
     std::string shaderPath;
+    std::string upscaleShaderPath;
+    std::string fsrShaderDirectory;
 };
 
 #endif /* CompositionPipeline_hpp */
@@ -0,0 +1,50 @@
+//
+//  DeferredLighting.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef DeferredLighting_hpp
+#define DeferredLighting_hpp
+
+#include "Device.hpp"
+#include "Pipeline.hpp"
+
+//std
+#include <memory>
+#include <string>
+
+/*
+ * Lighting subpass of the deferred path, one full screen triangle shading every covered pixel once
+ * Reads the G-buffer through input attachments and the lights and environment through the global set
+ */
+class DeferredLighting {
+public:
+    static constexpr uint32_t SUBPASS = 1;
+
+    DeferredLighting(
+        Device &passDevice,
+        VkRenderPass renderPass,
+        VkDescriptorSetLayout globalSetLayout,
+        VkDescriptorSetLayout gbufferSetLayout,
+        std::string dynamicShaderPath);
+    ~DeferredLighting();
+
+    // Prevent Obj copy
+    DeferredLighting(const DeferredLighting &) = delete;
+    DeferredLighting &operator=(const DeferredLighting &) = delete;
+
+    void render(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet, VkDescriptorSet gbufferDescriptorSet);
+
+private:
+    void createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout gbufferSetLayout);
+    void createPipeline(VkRenderPass renderPass);
+
+    Device &device;
+    std::unique_ptr<Pipeline> pipeline;
+    VkPipelineLayout pipelineLayout;
+    std::string shaderPath;
+};
+
+#endif /* DeferredLighting_hpp */
@@ -0,0 +1,40 @@
+//
+//  DynamicResolution.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef DynamicResolution_hpp
+#define DynamicResolution_hpp
+
+/*
+ * Picks the render scale that keeps the measured GPU frame time under a budget
+ * GPU time roughly follows the shaded pixel count, so the scale moves by the square root of the time ratio
+ * Timings lag a few frames behind the scale they were measured at, the steps are damped and small errors are ignored
+ */
+class DynamicResolution {
+public:
+    // Frame time aimed for, below the budget so a spike doesn't miss it right away
+    static constexpr float HEADROOM = .9f;
+    // Relative scale error left alone, keeps the scale from wandering with timing noise
+    static constexpr float DEAD_BAND = .03f;
+    // Part of the error corrected per frame
+    static constexpr float RESPONSE = .15f;
+
+    DynamicResolution(float minScale, float maxScale) : minScale{minScale}, maxScale{maxScale} {}
+
+    // Returns the scale for the next frame, gpuMilliseconds is the latest measured frame time
+    float update(float gpuMilliseconds);
+    float getScale() const { return scale; }
+    void reset() { scale = maxScale; }
+
+    float budgetMilliseconds{1000.f / 60.f};
+
+private:
+    float minScale;
+    float maxScale;
+    float scale{maxScale};
+};
+
+#endif /* DynamicResolution_hpp */
@@ -0,0 +1,198 @@
+//
+//  EntityRegistry.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef EntityRegistry_hpp
+#define EntityRegistry_hpp
+
+#include "Model.hpp"
+#include "MeshCollider.hpp"
+#include "OccluderMesh.hpp"
+#include "TransformSystem.hpp"
+
+//std
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Generational handle, a stale Entity stops resolving once its slot is recycled
+struct Entity {
+    uint32_t index{UINT32_MAX};
+    uint32_t generation{0};
+
+    bool operator==(const Entity &other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity &other) const { return !(*this == other); }
+};
+
+struct TransformHandle {
+    TransformSystem::Handle handle{TransformSystem::INVALID};
+};
+
+struct RenderComponent {
+    std::shared_ptr<Model> model{};
+};
+
+struct MaterialComponent {
+    glm::vec3 color{};
+    int textureIndex{-1};
+    float metalness{0.f};
+    float roughness{.4f};
+};
+
+// Optional triangle level geometry for ray and collision queries
+struct ColliderComponent {
+    std::shared_ptr<MeshCollider> collider{};
+};
+
+// Simplified geometry drawn into the CPU occlusion buffer
+struct OccluderComponent {
+    std::shared_ptr<OccluderMesh> mesh{};
+};
+
+// Bit index of the entity in a baked PotentiallyVisibleSet
+struct PvsComponent {
+    uint32_t object{0};
+};
+
+struct PhysicsComponent {
+    glm::vec3 velocity{};
+    float mass{1.f};
+};
+
+/*
+ * Densely packed storage for one component type
+ * sparse maps entity index -> dense slot, removal swaps the last element into the hole
+ */
+template<typename T>
+class ComponentArray {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    bool has(uint32_t entityIndex) const { return entityIndex < sparse.size() && sparse[entityIndex] != NONE; }
+
+    T &add(Entity entity, T component) {
+        if (has(entity.index)) { throw std::runtime_error("entity already has this component!"); }
+        if (entity.index >= sparse.size()) { sparse.resize(entity.index + 1, NONE); }
+        sparse[entity.index] = static_cast<uint32_t>(components.size());
+        components.push_back(std::move(component));
+        entities.push_back(entity);
+        return components.back();
+    }
+
+    void remove(uint32_t entityIndex) {
+        if (!has(entityIndex)) { return; }
+        uint32_t slot = sparse[entityIndex];
+        uint32_t last = static_cast<uint32_t>(components.size()) - 1;
+        if (slot != last) {
+            components[slot] = std::move(components[last]);
+            entities[slot] = entities[last];
+            sparse[entities[slot].index] = slot;
+        }
+        components.pop_back();
+        entities.pop_back();
+        sparse[entityIndex] = NONE;
+    }
+
+    T &get(uint32_t entityIndex) { return components[sparse[entityIndex]]; }
+    const T &get(uint32_t entityIndex) const { return components[sparse[entityIndex]]; }
+
+    // Contiguous iteration, entities[i] owns components[i]
+    size_t size() const { return components.size(); }
+    T *data() { return components.data(); }
+    const std::vector<T> &getComponents() const { return components; }
+    const std::vector<Entity> &getEntities() const { return entities; }
+
+private:
+    std::vector<T> components{};
+    std::vector<Entity> entities{};
+    std::vector<uint32_t> sparse{};
+};
+
+/*
+ * Entity storage with one dense ComponentArray per component type
+ * Transforms live in the owned TransformSystem, TransformHandle links an entity to its slot there
+ */
+class EntityRegistry {
+public:
+    EntityRegistry() = default;
+
+    // Prevent Obj copy
+    EntityRegistry(const EntityRegistry &) = delete;
+    EntityRegistry &operator=(const EntityRegistry &) = delete;
+
+    Entity create();
+    void destroy(Entity entity);
+    bool isAlive(Entity entity) const { return entity.index < generations.size() && generations[entity.index] == entity.generation; }
+    uint32_t getEntityCount() const { return aliveCount; }
+
+    // Registers a transform for the entity, rotation is EULER YXZ
+    TransformSystem::Handle addTransform(Entity entity, glm::vec3 translation = {}, glm::vec3 rotation = {}, glm::vec3 scale = {1.f, 1.f, 1.f}, Entity parent = {});
+    TransformSystem::Handle getTransform(Entity entity) const { return transformHandles.get(entity.index).handle; }
+
+    template<typename T>
+    T &add(Entity entity, T component = {}) {
+        checkAlive(entity);
+        return store<T>().add(entity, std::move(component));
+    }
+
+    template<typename T>
+    void remove(Entity entity) { if (isAlive(entity)) { store<T>().remove(entity.index); } }
+
+    template<typename T>
+    bool has(Entity entity) const { return isAlive(entity) && store<T>().has(entity.index); }
+
+    template<typename T>
+    T &get(Entity entity) { return store<T>().get(entity.index); }
+
+    template<typename T>
+    const T &get(Entity entity) const { return store<T>().get(entity.index); }
+
+    template<typename T>
+    ComponentArray<T> &view() { return store<T>(); }
+    
+    // Renderables are only drawn with a material and a transform, entities missing either are skipped
+    bool isRenderable(Entity entity) const { return has<RenderComponent>(entity) && has<MaterialComponent>(entity) && has<TransformHandle>(entity); }
+
+    TransformSystem &getTransforms() { return transforms; }
+    const TransformSystem &getTransforms() const { return transforms; }
+
+private:
+    void checkAlive(Entity entity) const {
+        if (!isAlive(entity)) { throw std::runtime_error("stale or invalid entity handle!"); }
+    }
+
+    template<typename T>
+    ComponentArray<T> &store() { return const_cast<ComponentArray<T> &>(static_cast<const EntityRegistry *>(this)->store<T>()); }
+
+    template<typename T>
+    const ComponentArray<T> &store() const {
+        if constexpr (std::is_same_v<T, TransformHandle>) { return transformHandles; }
+        else if constexpr (std::is_same_v<T, RenderComponent>) { return renderComponents; }
+        else if constexpr (std::is_same_v<T, MaterialComponent>) { return materialComponents; }
+        else if constexpr (std::is_same_v<T, ColliderComponent>) { return colliderComponents; }
+        else if constexpr (std::is_same_v<T, OccluderComponent>) { return occluderComponents; }
+        else if constexpr (std::is_same_v<T, PvsComponent>) { return pvsComponents; }
+        else if constexpr (std::is_same_v<T, PhysicsComponent>) { return physicsComponents; }
+        else { static_assert(!std::is_same_v<T, T>, "unregistered component type"); }
+    }
+
+    std::vector<uint32_t> generations{};
+    std::vector<uint32_t> freeIndices{};
+    uint32_t aliveCount{0};
+
+    TransformSystem transforms{};
+    ComponentArray<TransformHandle> transformHandles{};
+    ComponentArray<RenderComponent> renderComponents{};
+    ComponentArray<MaterialComponent> materialComponents{};
+    ComponentArray<ColliderComponent> colliderComponents{};
+    ComponentArray<OccluderComponent> occluderComponents{};
+    ComponentArray<PvsComponent> pvsComponents{};
+    ComponentArray<PhysicsComponent> physicsComponents{};
+};
+
+#endif /* EntityRegistry_hpp */
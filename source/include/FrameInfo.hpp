@@ -9,7 +9,9 @@
 #define FrameInfo_hpp
 
 #include "Camera.hpp"
-#include "SolidObject.hpp"
+#include "EntityRegistry.hpp"
+#include "SceneBvh.hpp"
+#include "OcclusionCuller.hpp"
 
 //lib
 #include <vulkan/vulkan.h>
@@ -20,7 +22,10 @@ struct FrameInfo {
     VkCommandBuffer commandBuffer;
     Camera &camera;
     std::vector<VkDescriptorSet> globalDescriptorSet;
-    SolidObject::Map &solidObjects;
+    EntityRegistry &scene;
+    const SceneBvh *sceneBvh = nullptr;     // Enables frustum culling when set
+    OcclusionCuller *occlusionCuller = nullptr;     // Rasterized for this frame, needs sceneBvh
+    const uint8_t *pvsCell = nullptr;       // Camera cell of a PotentiallyVisibleSet, tested with PvsComponent
 };
 
 #endif /* FrameInfo_hpp */
@@ -0,0 +1,149 @@
+//
+//  GpuCulling.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef GpuCulling_hpp
+#define GpuCulling_hpp
+
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Descriptors.hpp"
+#include "Pipeline.hpp"
+#include "Renderer.hpp"
+#include "Model.hpp"
+#include "EntityRegistry.hpp"
+#include "PotentiallyVisibleSet.hpp"
+
+//std
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * GPU driven visibility for the scene, one compute invocation per (object, level of detail, cull cluster) record
+ * Each object's level is picked from its projected bounding sphere like RenderSystem does, only records of that level go on
+ * Records surviving the baked cluster visibility of the camera cell, the frustum, the meshlet normal cone and the Hi-Z test
+ * against last frame's depth pyramid are appended to the command range of their batch,
+ * each batch is then one indirect draw with a GPU written count
+ */
+class GpuCulling {
+public:
+    static constexpr uint32_t MAX_RECORDS = 65536;
+    static constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+
+    // Objects sharing model and material, drawn by a single indirect call
+    struct Batch {
+        Model *model;
+        int textureIndex;
+        uint32_t commandOffset;
+        uint32_t maxDraws;
+    };
+
+    GpuCulling(Device &device, Renderer &renderer, const std::string &shaderDir, const std::vector<VkDescriptorBufferInfo> &instanceBufferInfos);
+    ~GpuCulling();
+
+    // Prevent Obj copy
+    GpuCulling(const GpuCulling &) = delete;
+    GpuCulling &operator=(const GpuCulling &) = delete;
+
+    // Object i owns instance slot i until the next build, rebuild after adding or removing renderables
+    // Clusters of entities with a PvsComponent take their bits from pvs, it must outlive the build
+    void build(EntityRegistry &scene, const PotentiallyVisibleSet *pvs = nullptr);
+
+    // Compute pass writing this frame's draws, record outside any render pass before executing them
+    // pvsCell is the camera cell of the PVS given to build, nullptr keeps every cluster
+    void cull(VkCommandBuffer commandBuffer, int frameIndex, const glm::mat4 &projectionView, const glm::vec3 &cameraPosition, const uint8_t *pvsCell = nullptr);
+
+    // Same targets as RenderSystem::setLodTarget, projectionScale is the [1][1] entry of the camera projection
+    void setLodTarget(float viewportHeight, float pixelError, float projectionScale) {
+        lodViewportHeight = viewportHeight;
+        lodPixelError = pixelError;
+        lodProjectionScale = projectionScale;
+    }
+
+    // Reduces the depth just written by the offscreen pass, projectionView is the one it was rendered with
+    void buildDepthPyramid(VkCommandBuffer commandBuffer, const glm::mat4 &projectionView);
+
+    void drawBatch(VkCommandBuffer commandBuffer, int frameIndex, uint32_t batchIndex);
+
+    const std::vector<Entity> &getObjects() const { return objects; }
+    const std::vector<Batch> &getBatches() const { return batches; }
+    uint32_t getRecordCount() const { return recordCount; }
+    uint32_t getRecordTriangleCount() const { return recordTriangles; }
+    // Records and triangles drawn by the last frame that used the current frame slot
+    uint32_t getLastDrawnCount() const { return lastDrawnCount; }
+    uint32_t getLastDrawnTriangleCount() const { return lastDrawnTriangles; }
+    // Records with baked visibility, and how many of them the last frame using the current frame slot rejected by it
+    uint32_t getPvsRecordCount() const { return pvsRecordCount; }
+    uint32_t getLastPvsCulledCount() const { return lastPvsCulled; }
+    // Objects per level picked by the last frame using the current frame slot
+    const std::array<uint32_t, Model::MAX_LODS> &getLastLodCounts() const { return lastLodCounts; }
+
+    bool occlusionEnabled = true;
+    bool coneCullingEnabled = true;
+
+private:
+    void createBuffers(const std::vector<VkDescriptorBufferInfo> &instanceBufferInfos);
+    void createPipelines(const std::string &shaderDir);
+    void createDepthPyramid();
+    void destroyDepthPyramid();
+    void writeDescriptorSets();
+
+    Device &device;
+    Renderer &renderer;
+
+    std::vector<Entity> objects{};
+    std::vector<Batch> batches{};
+    uint32_t recordCount{0};
+    uint32_t totalDraws{0};
+    uint32_t lastDrawnCount{0};
+    uint32_t recordTriangles{0};
+    uint32_t lastDrawnTriangles{0};
+    const PotentiallyVisibleSet *pvs{nullptr};
+    uint32_t pvsRecordCount{0};
+    uint32_t lastPvsCulled{0};
+    std::array<uint32_t, Model::MAX_LODS> lastLodCounts{};
+    float lodViewportHeight{1080.f};
+    float lodPixelError{1.f};
+    float lodProjectionScale{1.f};
+    uint32_t lodStateHalf{0};   // Half of the level state written by the next cull, the other one holds the last picks
+
+    std::unique_ptr<Buffer> recordBuffer;
+    std::unique_ptr<Buffer> objectBuffer;
+    std::unique_ptr<Buffer> lodStateBuffer;     // Level picked per object, the hysteresis starts from it
+    std::unique_ptr<Buffer> commandBuffers[SwapChain::MAX_FRAMES_IN_FLIGHT];
+    std::unique_ptr<Buffer> countBuffers[SwapChain::MAX_FRAMES_IN_FLIGHT];
+    std::unique_ptr<Buffer> uboBuffers[SwapChain::MAX_FRAMES_IN_FLIGHT];
+    std::unique_ptr<Buffer> pvsBuffers[SwapChain::MAX_FRAMES_IN_FLIGHT];     // Cluster bits of the camera cell
+    std::vector<VkDescriptorBufferInfo> instanceInfos{};
+
+    std::unique_ptr<DescriptorPool> descriptorPool;
+    std::unique_ptr<DescriptorSetLayout> cullSetLayout;
+    std::unique_ptr<DescriptorSetLayout> reduceSetLayout;
+    VkDescriptorSet cullDescriptorSets[SwapChain::MAX_FRAMES_IN_FLIGHT];
+    VkDescriptorSet reduceDescriptorSets[MAX_PYRAMID_LEVELS];
+
+    VkPipelineLayout cullPipelineLayout;
+    VkPipelineLayout reducePipelineLayout;
+    std::unique_ptr<ComputePipeline> cullPipeline;
+    std::unique_ptr<ComputePipeline> reducePipeline;
+    std::unique_ptr<ComputePipeline> resolvePipeline;   // Level 0 out of a multisampled depth
+
+    struct DepthPyramid {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory mem;
+        VkImageView view;
+        VkImageView levelViews[MAX_PYRAMID_LEVELS];
+        VkSampler sampler;
+        uint32_t width, height, levels;
+        uint32_t offscreenGeneration{0};
+        bool valid = false;             // Holds the depth of a rendered frame
+        glm::mat4 projectionView{1.f};  // Matrix of the frame it holds
+    } pyramid;
+};
+
+#endif /* GpuCulling_hpp */
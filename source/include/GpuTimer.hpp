@@ -0,0 +1,52 @@
+//
+//  GpuTimer.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef GpuTimer_hpp
+#define GpuTimer_hpp
+
+#include "Device.hpp"
+#include "SwapChain.hpp"
+
+//std
+#include <array>
+#include <cstdint>
+
+/*
+ * Timestamp queries around a few scopes of the frame, one query range per frame in flight
+ * A frame's results are read when its slot comes around again, so they lag a few frames and are smoothed
+ */
+class GpuTimer {
+public:
+    static constexpr uint32_t MAX_SCOPES = 8;
+
+    GpuTimer(Device &device);
+    ~GpuTimer();
+
+    // Prevent Obj copy
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+    // Collects the slot's previous results and resets its queries, must be recorded outside render passes
+    void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+    void begin(VkCommandBuffer commandBuffer, int frameIndex, uint32_t scope);
+    void end(VkCommandBuffer commandBuffer, int frameIndex, uint32_t scope);
+
+    // False when the graphics queue can't write timestamps, every call is then a no-op
+    bool isSupported() const { return queryPool != VK_NULL_HANDLE; }
+    float getMilliseconds(uint32_t scope) const { return milliseconds[scope]; }
+
+private:
+    uint32_t queryIndex(int frameIndex, uint32_t scope) const { return (frameIndex * MAX_SCOPES + scope) * 2; }
+
+    Device &device;
+    VkQueryPool queryPool{VK_NULL_HANDLE};
+    float nanosecondsPerTick{1.f};
+    std::array<uint32_t, SwapChain::MAX_FRAMES_IN_FLIGHT> writtenScopes{};     // Bit per scope with both timestamps recorded
+    std::array<float, MAX_SCOPES> milliseconds{};
+};
+
+#endif /* GpuTimer_hpp */
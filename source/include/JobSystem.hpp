@@ -0,0 +1,61 @@
+//
+//  JobSystem.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef JobSystem_hpp
+#define JobSystem_hpp
+
+//std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed pool of worker threads running fork-join batches
+ * The dispatching thread works on the batch too and is always the last worker index
+ */
+class JobSystem {
+public:
+    using Job = std::function<void(uint32_t jobIndex, uint32_t workerIndex)>;
+
+    JobSystem(uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1);
+    ~JobSystem();
+
+    // Prevent Obj copy
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // Worker threads plus the dispatching one
+    uint32_t getWorkerCount() const { return static_cast<uint32_t>(threads.size()) + 1; }
+
+    // Blocks until every job ran, the first exception thrown by a job is rethrown here
+    void dispatch(uint32_t jobCount, const Job &job);
+
+private:
+    void workerLoop(uint32_t workerIndex);
+    void runJobs(uint32_t workerIndex);
+
+    std::vector<std::thread> threads{};
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+
+    const Job *currentJob = nullptr;
+    uint32_t jobCount{0};
+    uint64_t generation{0};
+    std::atomic<uint32_t> nextJob{0};
+    uint32_t finishedJobs{0};
+    uint32_t activeWorkers{0};
+    std::exception_ptr error{};
+    bool stopping = false;
+};
+
+#endif /* JobSystem_hpp */
@@ -0,0 +1,118 @@
+//
+//  LightClusters.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef LightClusters_hpp
+#define LightClusters_hpp
+
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Camera.hpp"
+#include "JobSystem.hpp"
+#include "SwapChain.hpp"
+
+//std
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * Clustered forward lighting, point and spot lights binned into a view space froxel grid every frame
+ * Tiles split the screen evenly, slices split depth exponentially between the projection's near and far planes
+ * Every slice is binned by its own job into its own range of the index list, shader.frag then loops
+ * over the lights of its fragment's cluster only
+ */
+class LightClusters {
+public:
+    static constexpr uint32_t GRID_X = 16;
+    static constexpr uint32_t GRID_Y = 9;
+    static constexpr uint32_t GRID_Z = 24;
+    static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+    static constexpr uint32_t MAX_LIGHTS = 4096;
+    static constexpr uint32_t INDICES_PER_SLICE = GRID_X * GRID_Y * 64;
+
+    enum class LightType : uint32_t { Point = 0, Spot = 1 };
+
+    struct Light {
+        glm::vec3 position{0.f};
+        float range{30.f};                      // Radiance fades out to zero at this distance
+        glm::vec3 color{1.f};
+        float intensity{10.f};
+        glm::vec3 direction{0.f, 1.f, 0.f};     // Spot lights only, like the cosines below
+        float innerCone{.9f};
+        float outerCone{.8f};
+        LightType type{LightType::Point};
+    };
+
+    struct Stats {
+        uint32_t lights;
+        uint32_t visibleLights;     // Overlapping the froxel grid
+        uint32_t indices;
+        uint32_t maxPerCluster;
+        uint32_t dropped;           // Past a slice's index budget
+        float milliseconds;
+    };
+
+    LightClusters(Device &device);
+
+    // Prevent Obj copy
+    LightClusters(const LightClusters &) = delete;
+    LightClusters &operator=(const LightClusters &) = delete;
+
+    // Bins the lights against camera and writes them into the frameIndex buffers, extent is the viewport in pixels
+    void update(int frameIndex, const Camera &camera, VkExtent2D extent, JobSystem &jobSystem);
+
+    VkDescriptorBufferInfo getLightBufferInfo(int frameIndex) { return lightBuffers[frameIndex]->descriptorInfo(); }
+    VkDescriptorBufferInfo getClusterBufferInfo(int frameIndex) { return clusterBuffers[frameIndex]->descriptorInfo(); }
+    VkDescriptorBufferInfo getIndexBufferInfo(int frameIndex) { return indexBuffers[frameIndex]->descriptorInfo(); }
+
+    // Fragment to cluster mapping of the last update: tiles per pixel in x and y, then log depth scale and bias
+    glm::vec4 getClusterScale() const { return clusterScale; }
+    glm::uvec4 getClusterGrid() const { return {GRID_X, GRID_Y, GRID_Z, 0}; }
+
+    std::vector<Light> lights{};
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    // View space sphere enclosing everything a light reaches
+    struct Bounds {
+        glm::vec3 center;
+        float radius;
+        uint32_t minSlice;
+        uint32_t maxSlice;
+    };
+
+    void buildGrid(const glm::mat4 &projection);
+    bool computeBounds(const Light &light, const glm::mat4 &view, Bounds &bounds) const;
+    // Tiles under the view space box of half size halfSize around center in x and y, spanning depths z0 to z1
+    bool findTiles(const glm::vec3 &center, float halfSize, float z0, float z1, uint32_t minTile[2], uint32_t maxTile[2]) const;
+    void binSlice(uint32_t slice, uint32_t *clusters, uint32_t *indices);
+
+    Device &device;
+    std::unique_ptr<Buffer> lightBuffers[SwapChain::MAX_FRAMES_IN_FLIGHT];
+    std::unique_ptr<Buffer> clusterBuffers[SwapChain::MAX_FRAMES_IN_FLIGHT];
+    std::unique_ptr<Buffer> indexBuffers[SwapChain::MAX_FRAMES_IN_FLIGHT];
+
+    // View space cluster boxes as plain arrays, one row of tiles is tested per light at a time
+    std::vector<float> boxMinX, boxMinY, boxMinZ, boxMaxX, boxMaxY, boxMaxZ;
+    glm::mat4 gridProjection{0.f};
+    float near{0.f}, far{0.f};
+    float sliceNear{0.f};       // First exponential slice boundary, clamped above zero
+    std::array<float, GRID_Z + 1> sliceDepths{};
+    glm::vec4 clusterScale{0.f};
+
+    std::vector<Bounds> visibleBounds{};
+    std::vector<uint32_t> visibleLights{};
+    std::vector<std::vector<uint32_t>> slicePairs{};
+    std::vector<uint32_t> sliceUsed{};
+    std::vector<uint32_t> sliceDropped{};
+    std::vector<uint32_t> sliceMaxPerCluster{};
+    Stats stats{};
+};
+
+#endif /* LightClusters_hpp */
@@ -0,0 +1,44 @@
+//
+//  MeshCollider.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef MeshCollider_hpp
+#define MeshCollider_hpp
+
+#include "Model.hpp"
+#include "Bvh.hpp"
+
+//std
+#include <vector>
+
+/*
+ * CPU copy of a mesh's triangles with a triangle BVH, built from Model::Data at import
+ * Queries run in the mesh's local space
+ */
+class MeshCollider {
+public:
+    // Expects the base index buffer alone, call before MeshSimplifier::generateLods and Model::Data::splitIntoShortIndexChunks
+    MeshCollider(const Model::Data &data);
+
+    // Prevent Obj copy
+    MeshCollider(const MeshCollider &) = delete;
+    MeshCollider &operator=(const MeshCollider &) = delete;
+
+    // Closest hit before tMax, tMax and normal are updated on success
+    bool intersect(const Ray &ray, float &tMax, glm::vec3 &normal) const;
+
+    const Bvh &getBvh() const { return bvh; }
+    const Aabb &getBounds() const { return bounds; }
+    size_t getTriangleCount() const { return indices.size() / 3; }
+
+private:
+    std::vector<glm::vec3> positions{};
+    std::vector<uint32_t> indices{};
+    Aabb bounds{};
+    Bvh bvh{};
+};
+
+#endif /* MeshCollider_hpp */
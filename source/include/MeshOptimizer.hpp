@@ -0,0 +1,49 @@
+//
+//  MeshOptimizer.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef MeshOptimizer_hpp
+#define MeshOptimizer_hpp
+
+#include "Model.hpp"
+
+//std
+#include <vector>
+
+/*
+ * Offline index/vertex reordering applied between import and upload
+ * Weld identical vertices -> Tipsify vertex cache order -> overdraw cluster sort -> vertex fetch remap
+ */
+class MeshOptimizer {
+public:
+    // Matches the post-transform cache size Tipsify targets, also used by the statistics
+    static constexpr uint32_t CACHE_SIZE = 16;
+
+    struct CacheStats {
+        float acmr{0.f};    // Vertex shader invocations per triangle
+        float atvr{0.f};    // Vertex shader invocations per referenced vertex
+    };
+
+    struct Report {
+        CacheStats before{};
+        CacheStats after{};
+        size_t verticesBefore{0};
+        size_t verticesAfter{0};
+        size_t clusters{0};
+    };
+
+    static Report optimize(Model::Data &data, float overdrawThreshold = 1.05f);
+
+    static void weldVertices(std::vector<Model::Vertex> &vertices, std::vector<uint32_t> &indices);
+    static std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+    static std::vector<uint32_t> splitClusters(const std::vector<uint32_t> &indices, const std::vector<uint32_t> &hardBoundaries, size_t vertexCount, float threshold);
+    static void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &clusters);
+    static void optimizeVertexFetch(std::vector<Model::Vertex> &vertices, std::vector<uint32_t> &indices);
+
+    static CacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+};
+
+#endif /* MeshOptimizer_hpp */
@@ -0,0 +1,44 @@
+//
+//  MeshSimplifier.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef MeshSimplifier_hpp
+#define MeshSimplifier_hpp
+
+#include "Model.hpp"
+
+//std
+#include <vector>
+
+/*
+ * Quadric error metric simplification by half-edge collapse, vertices only ever move onto existing ones
+ * so every level of detail indexes the base vertex buffer
+ * Border and attribute seam vertices only slide along their border or seam, both sides of a seam together
+ */
+class MeshSimplifier {
+public:
+    struct Report {
+        uint32_t lods{1};
+        size_t triangles[Model::MAX_LODS] = {};
+        float errors[Model::MAX_LODS] = {};
+    };
+
+    // Returns indices of at most targetIndexCount, or the closest reachable under maxError
+    // error receives the largest collapse error in model units, an RMS distance to the original surface
+    static std::vector<uint32_t> simplify(
+        const std::vector<Model::Vertex> &vertices,
+        const std::vector<uint32_t> &indices,
+        size_t targetIndexCount,
+        float maxError,
+        float &error);
+
+    // Appends each level after the base one to data.indices and describes them in data.lods
+    // Every level halves the previous one until the error bound, relative to the mesh size, stops it
+    // Run after MeshCollider and OccluderMesh read the base indices and before splitIntoShortIndexChunks
+    static Report generateLods(Model::Data &data, float reduction = .5f, float maxRelativeError = .02f);
+};
+
+#endif /* MeshSimplifier_hpp */
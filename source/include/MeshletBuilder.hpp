@@ -0,0 +1,38 @@
+//
+//  MeshletBuilder.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef MeshletBuilder_hpp
+#define MeshletBuilder_hpp
+
+#include "Model.hpp"
+
+//std
+#include <vector>
+
+/*
+ * Splits the base level into meshlets, small connected patches culled one by one on the GPU
+ * Triangles are regrouped so every meshlet is a contiguous index range drawable by a plain indexed draw
+ * Each meshlet carries a bounding sphere for the frustum and a normal cone for backface rejection
+ */
+class MeshletBuilder {
+public:
+    static constexpr uint32_t MAX_VERTICES = 64;
+    static constexpr uint32_t MAX_TRIANGLES = 124;
+
+    struct Report {
+        size_t meshlets{0};
+        float averageVertices{0.f};
+        float averageTriangles{0.f};
+        size_t coneCullable{0};     // Meshlets narrow enough for the backface cone test
+    };
+
+    // Reorders the base level triangles and fills data.meshlets
+    // Run after MeshSimplifier::generateLods and before splitIntoShortIndexChunks
+    static Report build(Model::Data &data, uint32_t maxVertices = MAX_VERTICES, uint32_t maxTriangles = MAX_TRIANGLES);
+};
+
+#endif /* MeshletBuilder_hpp */
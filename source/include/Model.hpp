@@ -37,39 +37,129 @@ public:
         }
     };
     
+    // 20 bytes compact layout, decoded in shader.vert through the PACKED_VERTEX specialization constant
+    struct PackedVertex {
+        uint16_t position[4];   // xyz unorm inside the mesh bounds, w holds the tangent handedness
+        int16_t normal[2];      // octahedral snorm
+        int16_t tangent[2];     // octahedral snorm
+        uint16_t uv[2];         // half float
+        
+        static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        static PackedVertex pack(const Vertex &vertex, const glm::vec3 &boundsMin, const glm::vec3 &boundsExtent);
+    };
+    
+    enum class VertexFormat { Float, Packed };
+    
+    // Range of a mesh addressable with 16-bit indices, indices are relative to vertexOffset
+    struct Submesh {
+        uint32_t firstIndex{0};
+        uint32_t indexCount{0};
+        int32_t vertexOffset{0};
+    };
+    
+    static constexpr uint32_t MAX_SHORT_INDEX_VERTICES = 65535;
+    
+    // Contiguous run of triangles inside one submesh with its model space bounds, the unit of GPU culling
+    // Meshlets come out of MeshletBuilder, models imported without them fall back to fixed size runs
+    struct CullCluster {
+        uint32_t firstIndex{0};
+        uint32_t indexCount{0};
+        int32_t vertexOffset{0};
+        uint32_t vertexCount{0};
+        glm::vec3 boundsMin{0.f};
+        glm::vec3 boundsMax{0.f};
+        glm::vec3 center{0.f};
+        float radius{0.f};
+        glm::vec3 coneAxis{0.f, 0.f, 1.f};  // Average facing of the triangles
+        float coneCutoff{1.f};              // Sine of the normal cone half angle, 1 never backface culls
+    };
+    
+    static constexpr uint32_t CULL_CLUSTER_TRIANGLES = 512;
+    
+    // Index range of one level of detail, every level reads the same vertex buffer
+    struct Lod {
+        uint32_t firstIndex{0};
+        uint32_t indexCount{0};
+        uint32_t firstSubmesh{0};   // Short index chunks of the level, none when the model is not split
+        uint32_t submeshCount{0};
+        float error{0.f};           // Model space distance to the base surface
+    };
+    
+    static constexpr uint32_t MAX_LODS = 4;
+    
     struct Data {
         std::vector<Vertex> vertices{};
         std::vector<uint32_t> indices{};
+        std::vector<Submesh> submeshes{};
+        std::vector<Lod> lods{};    // Empty when indices only hold the base mesh, see MeshSimplifier
+        std::vector<CullCluster> meshlets{};    // Base level only, in unsplit index space, see MeshletBuilder
+        
+        // Regroup vertices so every submesh references at most MAX_SHORT_INDEX_VERTICES of them
+        // A submesh never spans two levels of detail, later levels reuse the vertices of the open chunk
+        void splitIntoShortIndexChunks();
         
         void computeTangentBasis(Model::Vertex &v0, Model::Vertex &v1, Model::Vertex &v2, glm::vec3 *tanOut);
         
         void loadModel(const std::string &filePath, bool allUniqueVertices);
     };
     
-    Model(Device &dev, const Data &data);
+    Model(Device &dev, const Data &data, VertexFormat format = VertexFormat::Float);
     ~Model();
     
     // Prevent Obj copy
     Model(const Model &) = delete;
     Model &operator=(const Model &) = delete;
         
-    static std::unique_ptr<Model> createModelFromFile(Device &device, const std::string &filePath, bool allUniqueVertices = VK_FALSE);
+    // Tightly packed vec3 stream for depth-only and cube passes, see bindPositionsOnly
+    static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
+    
+    static std::unique_ptr<Model> createModelFromFile(Device &device, const std::string &filePath, bool allUniqueVertices = VK_FALSE, VertexFormat format = VertexFormat::Float);
+    
+    VertexFormat getVertexFormat() const { return vertexFormat; }
+    glm::vec3 getBoundsMin() const { return boundsMin; }
+    glm::vec3 getBoundsExtent() const { return boundsExtent; }
+    VkIndexType getIndexType() const { return indexType; }
+    // Clusters of one level, coarser levels are fixed size runs of their own index range
+    const std::vector<CullCluster> &getCullClusters(uint32_t lod = 0) const { return cullClusters[lod]; }
+    // Same base level clusters a Model built from data gets, for offline tools without a device
+    static std::vector<CullCluster> buildCullClusters(const Data &data);
+    uint32_t getLodCount() const { return static_cast<uint32_t>(lods.size()); }
+    const Lod &getLod(uint32_t lod) const { return lods[lod]; }
     
     void bind(VkCommandBuffer commandBuffer);
-    void draw(VkCommandBuffer commandBuffer);
+    // Float models only
+    void bindPositionsOnly(VkCommandBuffer commandBuffer);
+    void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0, uint32_t lod = 0);
     
 private:
     void createVertexBuffer(const std::vector<Vertex> &vertices);
     void createIndexBuffer(const std::vector<uint32_t> &indices);
+    void createPositionBuffer(const std::vector<Vertex> &vertices);
+    void createCullClusters(const Data &data);
+    static std::vector<Submesh> getLevelRanges(const Data &data, const Lod &level);
+    static std::vector<CullCluster> buildRunClusters(const Data &data, const Lod &level);
+    std::unique_ptr<Buffer> uploadVertexBuffer(const void *data, uint32_t vertexSize);
+    void uploadIndexBuffer(const void *data, uint32_t indexSize);
     
     Device &device;
     
+    VertexFormat vertexFormat;
+    glm::vec3 boundsMin{0.f};
+    glm::vec3 boundsExtent{1.f};
+    
     std::unique_ptr<Buffer> vertexBuffer;
+    std::unique_ptr<Buffer> positionBuffer;
     uint32_t vertexCount;
     
     std::unique_ptr<Buffer> indexBuffer;
     uint32_t indexCount;
     bool hasIndexBuffer = false;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    std::vector<Submesh> submeshes{};
+    std::vector<Lod> lods{};
+    std::vector<std::vector<CullCluster>> cullClusters{};   // One list per level
 };
 
 #endif /* Model_hpp */
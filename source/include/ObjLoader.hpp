@@ -0,0 +1,97 @@
+//
+//  ObjLoader.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef ObjLoader_hpp
+#define ObjLoader_hpp
+
+#include "Model.hpp"
+
+//std
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+/*
+ * Native Wavefront OBJ reader
+ * The file is memory mapped and split into chunks on line boundaries, every chunk is parsed
+ * by its own thread, then faces are resolved straight into engine vertices and indices
+ */
+class ObjLoader {
+public:
+    struct Stats {
+        size_t bytes{0};
+        double seconds{0.};
+
+        double megabytesPerSecond() const { return seconds > 0. ? (bytes / (1024. * 1024.)) / seconds : 0.; }
+    };
+
+    ObjLoader(const std::string &filePath);
+    ~ObjLoader();
+
+    // Prevent Obj copy
+    ObjLoader(const ObjLoader &) = delete;
+    ObjLoader &operator=(const ObjLoader &) = delete;
+
+    void load(std::vector<Model::Vertex> &vertices, std::vector<uint32_t> &indices, bool allUniqueVertices);
+
+    // Accumulated over every file parsed so far
+    static Stats getTotalStats();
+    static void resetTotalStats();
+
+private:
+    // Face corner, either a global index or a chunk-local one for relative (negative) references
+    struct Corner {
+        int32_t v, vt, vn;
+
+        bool operator==(const Corner &other) const { return v == other.v && vt == other.vt && vn == other.vn; }
+    };
+
+    struct CornerHash {
+        size_t operator()(const Corner &corner) const;
+    };
+
+    struct Chunk {
+        const char *begin, *end;
+        std::vector<float> positions{};
+        std::vector<float> colors{};
+        std::vector<float> normals{};
+        std::vector<float> texcoords{};
+        std::vector<Corner> corners{};
+
+        // Global offsets computed once every chunk has been parsed
+        int32_t positionBase{0}, normalBase{0}, texcoordBase{0};
+        size_t cornerBase{0};
+    };
+
+    void mapFile();
+    void unmapFile();
+    void splitChunks(size_t chunkCount);
+    static void parseChunk(Chunk &chunk);
+    static int32_t resolve(int32_t index, int32_t base);
+
+    static const char *parseFloat(const char *p, const char *end, float &value);
+    static const char *parseIndex(const char *p, const char *end, int32_t &value);
+
+    std::string filePath;
+    const char *data = nullptr;
+    size_t size{0};
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#else
+    int fileDescriptor{-1};
+#endif
+
+    std::vector<Chunk> chunks{};
+    std::chrono::high_resolution_clock::time_point startTime;
+
+    static Stats totalStats;
+    static std::mutex statsMutex;
+};
+
+#endif /* ObjLoader_hpp */
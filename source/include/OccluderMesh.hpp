@@ -0,0 +1,41 @@
+//
+//  OccluderMesh.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef OccluderMesh_hpp
+#define OccluderMesh_hpp
+
+#include "Model.hpp"
+
+//std
+#include <cstdint>
+#include <vector>
+
+/*
+ * Reduced copy of a mesh drawn by the CPU occlusion rasterizer, built from Model::Data at import
+ * Keeps the largest triangles up to a budget, a subset of the surface never hides more than the full mesh
+ */
+class OccluderMesh {
+public:
+    static constexpr uint32_t DEFAULT_TRIANGLE_BUDGET = 1024;
+
+    // Expects the base index buffer alone, call before MeshSimplifier::generateLods and Model::Data::splitIntoShortIndexChunks
+    OccluderMesh(const Model::Data &data, uint32_t maxTriangles = DEFAULT_TRIANGLE_BUDGET);
+
+    // Prevent Obj copy
+    OccluderMesh(const OccluderMesh &) = delete;
+    OccluderMesh &operator=(const OccluderMesh &) = delete;
+
+    const std::vector<glm::vec3> &getPositions() const { return positions; }
+    const std::vector<uint32_t> &getIndices() const { return indices; }
+    size_t getTriangleCount() const { return indices.size() / 3; }
+
+private:
+    std::vector<glm::vec3> positions{};
+    std::vector<uint32_t> indices{};
+};
+
+#endif /* OccluderMesh_hpp */
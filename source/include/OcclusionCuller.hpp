@@ -0,0 +1,81 @@
+//
+//  OcclusionCuller.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef OcclusionCuller_hpp
+#define OcclusionCuller_hpp
+
+#include "EntityRegistry.hpp"
+#include "SceneBvh.hpp"
+#include "JobSystem.hpp"
+
+//std
+#include <cstdint>
+#include <vector>
+
+/*
+ * CPU occlusion culling against a low resolution depth buffer, costs no GPU time
+ * OccluderComponent meshes are rasterized in screen tiles on the job system, spans of LANES pixels
+ * are shaded as plain arrays so the compiler emits SIMD for whatever target it builds
+ * Each BLOCK_SIZE square keeps its farthest depth, most boxes are rejected or kept at that level
+ */
+class OcclusionCuller {
+public:
+    static constexpr uint32_t WIDTH = 256;
+    static constexpr uint32_t HEIGHT = 128;
+    static constexpr uint32_t TILE_WIDTH = 64;
+    static constexpr uint32_t TILE_HEIGHT = 32;
+    static constexpr uint32_t BLOCK_SIZE = 8;
+    static constexpr uint32_t LANES = 8;
+
+    struct Stats {
+        uint32_t occluders;
+        uint32_t triangles;     // Triangles reaching the tiles after near and guard band rejection
+        uint32_t tested;
+        uint32_t culled;
+        float rasterMilliseconds;
+        float testMilliseconds;
+    };
+
+    OcclusionCuller();
+
+    // Prevent Obj copy
+    OcclusionCuller(const OcclusionCuller &) = delete;
+    OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+
+    // Fills the depth buffer with every occluder of the scene as seen through the clip matrix
+    void rasterize(EntityRegistry &scene, const glm::mat4 &clip, JobSystem &jobSystem);
+
+    // Removes the entities whose world box lies fully behind the rasterized occluders, order is kept
+    void cull(const EntityRegistry &scene, const SceneBvh &sceneBvh, std::vector<Entity> &entities);
+
+    bool isOccluded(const Aabb &worldBox) const;
+
+    const Stats &getStats() const { return stats; }
+    const std::vector<float> &getDepth() const { return depth; }
+
+private:
+    // Screen space triangle, edges are A * x + B * y + C and positive inside
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthX, depthY, depthC;
+        int minX, minY, maxX, maxY;
+    };
+
+    void transformOccluder(const OccluderMesh &mesh, const glm::mat4 &clip, std::vector<Triangle> &out) const;
+    void rasterizeTile(uint32_t tile);
+    void rasterizeSpan(const Triangle &triangle, uint32_t y, uint32_t xBegin, uint32_t xEnd);
+
+    std::vector<float> depth;
+    std::vector<float> blockDepth;  // Farthest depth of each BLOCK_SIZE square
+    std::vector<std::vector<Triangle>> occluderTriangles{};
+    std::vector<Triangle> triangles{};
+    glm::mat4 projectionView{1.f};
+    bool valid = false;
+    Stats stats{};
+};
+
+#endif /* OcclusionCuller_hpp */
@@ -31,6 +31,9 @@ struct PipelineConfigInfo {
     VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
     std::vector<VkDynamicState> dynamicStateEnables;
     VkPipelineDynamicStateCreateInfo dynamicStateInfo;
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+    const VkSpecializationInfo *vertexSpecializationInfo = nullptr;
     VkPipelineLayout pipelineLayout = nullptr;
     VkRenderPass renderPass = nullptr;
     uint32_t subpass = 0;
@@ -49,10 +52,9 @@ public:
     void bind(VkCommandBuffer commandBuffer);
 
     static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
-    
-private:
     static std::vector<char> readFile(const std::string &filepath);
     
+private:
     void createGraphicsPipeline(const std::string &vertFilepath, const std::string &fragFilepath, const PipelineConfigInfo &configInfo);
     
     void createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule);
@@ -63,4 +65,25 @@ private:
     VkShaderModule fragShaderModule;
 };
 
+/*
+ * Single stage compute pipeline, the layout is owned by the caller
+ */
+class ComputePipeline {
+public:
+    ComputePipeline(Device &dev, const std::string &compFilepath, VkPipelineLayout pipelineLayout);
+    
+    ~ComputePipeline();
+    
+    // Prevent Obj copy
+    ComputePipeline(const ComputePipeline &) = delete;
+    ComputePipeline &operator=(const ComputePipeline &) = delete;
+    
+    void bind(VkCommandBuffer commandBuffer);
+    
+private:
+    Device &device;
+    VkPipeline computePipeline;
+    VkShaderModule compShaderModule;
+};
+
 #endif /* Pipeline_hpp */
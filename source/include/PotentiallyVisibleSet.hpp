@@ -0,0 +1,81 @@
+//
+//  PotentiallyVisibleSet.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef PotentiallyVisibleSet_hpp
+#define PotentiallyVisibleSet_hpp
+
+#include "MeshCollider.hpp"
+#include "JobSystem.hpp"
+
+//std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Offline visibility for static geometry, a uniform grid of cells each holding one bit per object and one per cull cluster
+ * Baking ray casts from random points of every walkable cell, a hit sets the bit of the object and of its clusters around the hit point
+ * Meshes spanning the scene are seen from almost every cell, their clusters are what the GPU culling actually rejects
+ * Files store each cell run-length compressed, load() expands them so a query is a single table lookup
+ */
+class PotentiallyVisibleSet {
+public:
+    struct BakeSettings {
+        float cellSize{1.f};
+        uint32_t raysPerCell{4096};
+        uint32_t maxCellsPerAxis{256};
+    };
+
+    PotentiallyVisibleSet() = default;
+
+    // Prevent Obj copy
+    PotentiallyVisibleSet(const PotentiallyVisibleSet &) = delete;
+    PotentiallyVisibleSet &operator=(const PotentiallyVisibleSet &) = delete;
+
+    // Object i is objects[i] and owns the cull clusters clusterBounds[i], in the order Model::buildCullClusters makes them
+    // Colliders and cluster bounds are taken in world space
+    void bake(
+        const std::vector<std::shared_ptr<MeshCollider>> &objects,
+        const std::vector<std::vector<Aabb>> &clusterBounds,
+        const BakeSettings &settings,
+        JobSystem &jobSystem);
+
+    void save(const std::string &filePath) const;
+    // False when the file does not exist or was baked for other objects, clusterCounts[i] is the cluster count of object i
+    bool load(const std::string &filePath, const std::vector<uint32_t> &clusterCounts);
+
+    // Visibility bits of the cell holding position, nullptr outside the grid or in a cell that was not baked
+    // Object bits come first, isVisible takes the cell directly
+    const uint8_t *findCell(const glm::vec3 &position) const;
+    static bool isVisible(const uint8_t *bits, uint32_t index) { return bits[index >> 3] & (1u << (index & 7)); }
+    // Cluster c of object i is bit getClusterOffset(i) + c
+    const uint8_t *getClusterBits(const uint8_t *cell) const { return cell + objectBytes(); }
+    uint32_t getClusterByteCount() const { return clusterBytes(); }
+    uint32_t getClusterOffset(uint32_t object) const { return clusterOffsets[object]; }
+
+    bool isLoaded() const { return objectCount > 0; }
+    uint32_t getObjectCount() const { return objectCount; }
+    uint32_t getClusterCount() const { return clusterOffsets.empty() ? 0 : clusterOffsets.back(); }
+    uint32_t getCellCount() const { return cellCounts.x * cellCounts.y * cellCounts.z; }
+    uint32_t getBakedCellCount() const;
+
+private:
+    uint32_t objectBytes() const { return (objectCount + 7) / 8; }
+    uint32_t clusterBytes() const { return (getClusterCount() + 7) / 8; }
+    uint32_t bytesPerCell() const { return objectBytes() + clusterBytes(); }
+
+    glm::vec3 origin{0.f};
+    float cellSize{1.f};
+    glm::uvec3 cellCounts{0};
+    uint32_t objectCount{0};
+    std::vector<uint32_t> clusterOffsets{};     // objectCount + 1 entries
+    std::vector<uint8_t> bits{};                // bytesPerCell() per cell
+    std::vector<uint8_t> baked{};               // 1 for walkable cells
+};
+
+#endif /* PotentiallyVisibleSet_hpp */
@@ -0,0 +1,156 @@
+//
+//  RenderGraph.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef RenderGraph_hpp
+#define RenderGraph_hpp
+
+#include "Device.hpp"
+
+//std
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * Passes declare the images they read and write, compile then culls the passes nothing depends on,
+ * places transient images with disjoint lifetimes in the same memory and plans every barrier and layout transition
+ * Passes with attachments get a render pass and framebuffer built for them, execute begins it around their recording
+ * unless the pass begins a render pass of its own, the graph then only transitions its attachments
+ * Imported images are owned elsewhere and are left in the layout they were imported with
+ */
+class RenderGraph {
+public:
+    using Resource = uint32_t;
+    using Pass = uint32_t;
+
+    enum class Access {
+        ColorAttachment,
+        DepthAttachment,    // Tested and written
+        DepthRead,          // Tested only
+        Sampled,            // Fragment shader reads
+        ComputeSampled,
+        StorageWrite,       // Compute shader writes, in GENERAL layout
+        TransferSrc,
+        TransferDst
+    };
+
+    struct ImageDesc {
+        VkFormat format{VK_FORMAT_UNDEFINED};
+        VkExtent2D extent{0, 0};
+        VkSampleCountFlagBits samples{VK_SAMPLE_COUNT_1_BIT};
+    };
+
+    struct Use {
+        Resource resource;
+        Access access;
+        VkAttachmentLoadOp loadOp{VK_ATTACHMENT_LOAD_OP_DONT_CARE};     // Written attachments only
+        VkClearValue clearValue{};
+    };
+
+    struct PassDesc {
+        std::string name;
+        std::vector<Use> reads{};
+        std::vector<Use> writes{};
+        std::function<void(VkCommandBuffer commandBuffer)> record{};
+        bool sideEffects{false};    // Kept even when none of its writes are used
+        // record begins a render pass over the attachments, which must keep them in the layouts of their accesses
+        bool ownRenderPass{false};
+    };
+
+    struct Stats {
+        uint32_t passes;
+        uint32_t culledPasses;
+        uint32_t transientImages;
+        VkDeviceSize transientBytes;    // Memory actually allocated for transient images
+        VkDeviceSize aliasedBytes;      // Saved by sharing it
+        uint32_t barriers;
+    };
+
+    RenderGraph(Device &device);
+    ~RenderGraph();
+
+    // Prevent Obj copy
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    // layout is what the image is in before execute, it is transitioned to finalLayout after the last pass using it
+    Resource importImage(const std::string &name, VkImage image, VkImageView view, const ImageDesc &desc, VkImageLayout layout, VkImageLayout finalLayout);
+    // Usage follows from the passes using it, contents don't survive between executes
+    Resource createImage(const std::string &name, const ImageDesc &desc);
+    Pass addPass(PassDesc pass);
+
+    // Must be called again after adding passes or resources, recreates every transient image
+    void compile();
+    void execute(VkCommandBuffer commandBuffer);
+    // Drops every pass and resource
+    void reset();
+
+    // Transient images only exist after compile
+    VkImage getImage(Resource resource) const { return resources[resource].image; }
+    VkImageView getView(Resource resource) const { return resources[resource].view; }
+    // Null for culled passes, passes without attachments and passes with their own, pipelines built against it stay valid across compiles
+    VkRenderPass getRenderPass(Pass pass) const { return passes[pass].renderPass; }
+    bool isCulled(Pass pass) const { return passes[pass].culled; }
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    struct ResourceNode {
+        std::string name;
+        ImageDesc desc;
+        bool imported;
+        VkImage image{VK_NULL_HANDLE};
+        VkImageView view{VK_NULL_HANDLE};
+        VkImageLayout initialLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+        VkImageLayout finalLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+        VkImageAspectFlags aspect{VK_IMAGE_ASPECT_COLOR_BIT};
+        // Compile results, first and last pass are indices into the live passes
+        VkImageUsageFlags usage{0};
+        uint32_t firstPass{0}, lastPass{0};
+        VkDeviceSize offset{0}, size{0};
+        VkMemoryRequirements requirements{};
+        // What the memory was last used for before the first use, in this execute or the previous one
+        VkPipelineStageFlags aliasStages{0};
+        VkAccessFlags aliasAccess{0};
+    };
+
+    struct PassNode {
+        PassDesc desc;
+        bool culled{false};
+        VkRenderPass renderPass{VK_NULL_HANDLE};
+        VkFramebuffer framebuffer{VK_NULL_HANDLE};
+        VkExtent2D extent{0, 0};
+        std::vector<VkClearValue> clearValues{};
+        std::vector<VkImageMemoryBarrier> barriers{};
+        VkPipelineStageFlags srcStages{0}, dstStages{0};
+    };
+
+    // Layout, stages and accesses of one kind of use
+    struct AccessInfo {
+        VkImageLayout layout;
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        bool write;
+    };
+    static AccessInfo accessInfo(Access access, VkImageAspectFlags aspect);
+
+    void cullPasses();
+    void allocateTransients(const std::vector<Pass> &livePasses);
+    void createRenderPass(PassNode &pass, uint32_t liveIndex);
+    void planBarriers(const std::vector<Pass> &livePasses);
+    void release();
+
+    Device &device;
+    std::vector<ResourceNode> resources{};
+    std::vector<PassNode> passes{};
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    std::vector<VkImageMemoryBarrier> finalBarriers{};
+    VkPipelineStageFlags finalSrcStages{0};
+    Stats stats{};
+};
+
+#endif /* RenderGraph_hpp */
@@ -0,0 +1,103 @@
+//
+//  RenderQueue.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef RenderQueue_hpp
+#define RenderQueue_hpp
+
+#include "Pipeline.hpp"
+#include "EntityRegistry.hpp"
+
+//std
+#include <functional>
+#include <vector>
+
+/*
+ * Per-frame list of draw packets, radix sorted on a 64-bit key and submitted with redundant binds skipped
+ * Key layout, most significant first: pass (4) | pipeline (8) | material (16) | model (10) | lod (2) | depth (24)
+ * Runs of packets sharing pipeline, material, model and lod become one instanced draw, packet i is instance i
+ */
+class RenderQueue {
+public:
+    enum class Pass : uint8_t { Opaque = 0, Transparent = 1 };
+
+    struct Packet {
+        uint64_t key;
+        Pipeline *pipeline;
+        VkDescriptorSet descriptorSet;
+        Model *model;
+        Entity entity;
+        uint8_t lod;
+    };
+
+    // Instanced draw of packets [first, first + count)
+    struct Run {
+        uint32_t first;
+        uint32_t count;
+        uint32_t depthKey;      // Nearest instance of the run
+    };
+
+    struct Stats {
+        uint32_t draws{0};
+        uint32_t instances{0};
+        uint32_t pipelineBinds{0};
+        uint32_t descriptorBinds{0};
+        uint32_t bufferBinds{0};
+        uint32_t skippedBinds{0};
+        uint32_t triangles{0};
+        
+        Stats &operator+=(const Stats &other) {
+            draws += other.draws;
+            instances += other.instances;
+            pipelineBinds += other.pipelineBinds;
+            descriptorBinds += other.descriptorBinds;
+            bufferBinds += other.bufferBinds;
+            skippedBinds += other.skippedBinds;
+            triangles += other.triangles;
+            return *this;
+        }
+    };
+
+    // Opaque instances sort front to back, transparent ones back to front
+    static uint64_t makeKey(Pass pass, uint8_t pipelineId, uint16_t materialId, const Model *model, uint8_t lod, float viewDepth);
+
+    void clear() { packets.clear(); }
+    void push(const Packet &packet) { packets.push_back(packet); }
+    void sort();
+
+    using PushConstantsFn = std::function<void(VkCommandBuffer, const Packet &)>;
+
+    // pushConstants runs before every instanced draw with the first packet of the run
+    void submit(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool positionsOnly, const PushConstantsFn &pushConstants);
+
+    // Records packets [begin, end) assuming nothing is bound yet, safe to call from several threads on distinct ranges
+    Stats submitRange(
+        VkCommandBuffer commandBuffer,
+        VkPipelineLayout pipelineLayout,
+        bool positionsOnly,
+        const PushConstantsFn &pushConstants,
+        size_t begin,
+        size_t end) const;
+
+    // Runs of the sorted queue, nearest first, for depth only passes where materials don't matter
+    void collectRunsFrontToBack(std::vector<Run> &runs) const;
+
+    const std::vector<Packet> &getPackets() const { return packets; }
+    const Stats &getStats() const { return stats; }
+    void setStats(const Stats &frameStats) { stats = frameStats; }
+
+private:
+    // Nothing but per-instance data changes from first to next
+    static bool sharesDraw(const Packet &first, const Packet &next) {
+        return next.pipeline == first.pipeline && next.descriptorSet == first.descriptorSet && next.model == first.model && next.lod == first.lod;
+    }
+
+    std::vector<Packet> packets{};
+    std::vector<Packet> scratch{};
+    Stats stats{};
+};
+
+#endif /* RenderQueue_hpp */
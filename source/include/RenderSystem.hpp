@@ -10,11 +10,19 @@
 
 #include "Device.hpp"
 #include "Pipeline.hpp"
-#include "SolidObject.hpp"
 #include "Camera.hpp"
 #include "FrameInfo.hpp"
+#include "RenderQueue.hpp"
+#include "JobSystem.hpp"
+#include "Buffer.hpp"
+#include "SwapChain.hpp"
+#include "GpuCulling.hpp"
+#include "PotentiallyVisibleSet.hpp"
 
 //std
+#include <array>
+#include <cassert>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <string>
@@ -22,31 +30,124 @@
 
 class RenderSystem {
  public:
+  // Per-frame instance storage, bound by the caller at set 0 binding INSTANCE_BINDING
+  static constexpr uint32_t MAX_INSTANCES = 16384;
+  static constexpr uint32_t INSTANCE_BINDING = 9;
+  // Margin below the pixel error a coarser level needs before it replaces the current one
+  static constexpr float LOD_HYSTERESIS = .25f;
+
+  // Vertex streams read by the system pipelines
+  enum class VertexInput {
+    Attributes,         // Model::Vertex only
+    PackedAttributes,   // Model::Vertex plus a Model::PackedVertex variant
+    Positions           // Position stream only, for depth and cube passes
+  };
+
   RenderSystem(
     Device &passDevice,
     VkRenderPass renderPass,
     VkDescriptorSetLayout globalSetLayout,
     std::string dynamicShaderPath,
-    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT,
+    VertexInput input = VertexInput::Attributes,
+    bool instanced = true);
   ~RenderSystem();
 
   RenderSystem(const RenderSystem &) = delete;
   RenderSystem &operator=(const RenderSystem &) = delete;
   
   void recreatePipeline(VkRenderPass renderPass, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+  // Pipelines for a subpass of the deferred pass, same vertex stage and layout as the forward ones
+  // fragmentShaderPath replaces the forward fragment shader and writes colorAttachmentCount unblended targets
+  void createDeferredPipelines(
+    VkRenderPass renderPass,
+    uint32_t subpass,
+    const std::string &fragmentShaderPath,
+    uint32_t colorAttachmentCount,
+    bool depthWrite = true);
+  // Draws recorded from now on go through the deferred pipelines
+  void setDeferred(bool enabled) { deferred = enabled && deferredPipeline; }
+  
+  // Depth only pipelines for a prepass in the forward render pass, plus forward variants testing EQUAL without depth writes
+  // depthShaderPath is a position only vertex shader that must compute gl_Position exactly like the forward one
+  void createDepthPrepassPipelines(VkRenderPass renderPass, const std::string &depthShaderPath);
+  // Forward draws recorded from now on expect the prepass depth, so every pixel is shaded once
+  void setDepthPrepass(bool enabled) { depthPrepass = enabled && depthPipeline; }
+  // Depth of the draws recorded this frame, nearest runs first, either from the queue or from the GPU culled batches
+  std::vector<VkCommandBuffer> recordDepthPrepass(
+    FrameInfo &frameInfo,
+    GpuCulling *gpuCulling,
+    const std::function<VkCommandBuffer(uint32_t workerIndex)> &beginSecondary);
   virtual void renderSolidObjects(FrameInfo &frameInfo);
+  
+  // Splits the sorted queue across the job system, one secondary command buffer per job, returned in draw order
+  std::vector<VkCommandBuffer> recordSolidObjects(
+    FrameInfo &frameInfo,
+    JobSystem &jobSystem,
+    const std::function<VkCommandBuffer(uint32_t workerIndex)> &beginSecondary);
+  
+  // GPU driven variant, object i of gpuCulling takes instance slot i and every batch is one indirect draw
+  // CPU work scales with objects and batches only, visibility is decided by GpuCulling::cull
+  std::vector<VkCommandBuffer> recordIndirect(
+    FrameInfo &frameInfo,
+    GpuCulling &gpuCulling,
+    const std::function<VkCommandBuffer(uint32_t workerIndex)> &beginSecondary);
+  
+  const RenderQueue::Stats &getQueueStats() const { return renderQueue.getStats(); }
+  uint32_t getCulledCount() const { return culledCount; }
+  uint32_t getPvsCulledCount() const { return pvsCulledCount; }
+  // Objects drawn at each level of detail by the last queue
+  const std::array<uint32_t, Model::MAX_LODS> &getLodCounts() const { return lodCounts; }
+  
+  // Screen space error, in pixels of a viewport this tall, under which a coarser level is picked
+  void setLodTarget(float viewportHeight, float pixelError) { lodViewportHeight = viewportHeight; lodPixelError = pixelError; }
+  // Systems created without instancing have no instance storage, their shaders read transforms elsewhere
+  bool isInstanced() const { return instanced; }
+  VkDescriptorBufferInfo getInstanceBufferInfo(int frameIndex) {
+    assert(instanced && "RenderSystem created without instance buffers");
+    return instanceBuffers[frameIndex]->descriptorInfo();
+  }
 
  private:
   void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
   void createPipeline(VkRenderPass renderPass);
+  Pipeline *selectPipeline(bool packed) const;
+  void createInstanceBuffers();
+  void buildRenderQueue(FrameInfo &frameInfo);
+  void writeInstances(FrameInfo &frameInfo, size_t begin, size_t end);
+  void writeInstance(FrameInfo &frameInfo, Entity entity, int slot);
+  void pushConstants(VkCommandBuffer commandBuffer, const Model *model);
+  uint8_t selectLod(Entity entity, const Model &model, const glm::mat4 &world, const glm::vec3 &cameraPosition, float projectionScale);
 
 protected:
     Device &device;
 
     std::unique_ptr<Pipeline> pipeline;
+    std::unique_ptr<Pipeline> packedPipeline;   // Same shaders, Model::PackedVertex input
+    std::unique_ptr<Pipeline> deferredPipeline;
+    std::unique_ptr<Pipeline> deferredPackedPipeline;
+    bool deferred{false};
+    std::unique_ptr<Pipeline> depthPipeline;    // Position stream, or the packed stream for packed models
+    std::unique_ptr<Pipeline> depthPackedPipeline;
+    std::unique_ptr<Pipeline> equalPipeline;    // Forward shading after the prepass
+    std::unique_ptr<Pipeline> equalPackedPipeline;
+    std::string depthShaderPath{};
+    bool depthPrepass{false};
+    std::vector<RenderQueue::Run> depthRuns{};
+    RenderQueue renderQueue{};
+    std::vector<Entity> visibleEntities{};
+    uint32_t culledCount{0};
+    uint32_t pvsCulledCount{0};
+    std::vector<uint8_t> entityLods{};      // Last level per entity index, the hysteresis starts from it
+    std::array<uint32_t, Model::MAX_LODS> lodCounts{};
+    float lodViewportHeight{1080.f};
+    float lodPixelError{1.f};
+    std::unique_ptr<Buffer> instanceBuffers[SwapChain::MAX_FRAMES_IN_FLIGHT];
     VkPipelineLayout pipelineLayout;
     VkSampleCountFlagBits sampleCount;
     std::string shaderPath;
+    VertexInput vertexInput;
+    bool instanced;
 };
 
 #endif /* RenderSystem_hpp */
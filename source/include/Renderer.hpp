@@ -14,8 +14,10 @@
 #include "Descriptors.hpp"
 #include "Pipeline.hpp"
 #include "SolidObject.hpp"
+#include "RenderGraph.hpp"
 
 //std
+#include <functional>
 #include <memory>
 #include <vector>
 #include <cassert>
@@ -30,8 +32,9 @@ public:
     Renderer(const Renderer &) = delete;
     Renderer &operator=(const Renderer &) = delete;
     
+    // The scene subpass, then the composition subpass tone mapping it into the swapchain image
+    static constexpr uint32_t COMPOSITION_SUBPASS = 1;
     VkRenderPass getOffscreenRenderPass() const { return offscreen.renderPass; }
-    VkRenderPass getSwapChainRenderPass() const { return swapChain->getCompositionRenderPass(); }
     float getAspectRatio() const { return swapChain->extentAspectRatio(); }
     bool isFrameInProgress() const { return  isFrameStarted; }
     
@@ -58,11 +61,71 @@ public:
     
     VkCommandBuffer beginFrame();
     void endFrame();
-    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
-    void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
-    void beginOffscreenRenderPass(VkCommandBuffer commandBuffer);
+    void beginOffscreenRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+    // Last subpass of the offscreen and deferred passes, HDR color is read back as an input attachment and never stored
+    void beginCompositionSubpass(VkCommandBuffer commandBuffer);
     void endOffscreenRenderPass(VkCommandBuffer commandBuffer);
     
+    // Deferred path: a G-buffer subpass, then a lighting subpass reading it back as input attachments, then composition
+    // The render pass always exists so pipelines can be built against it, the G-buffer targets only without MSAA
+    static constexpr uint32_t GBUFFER_ATTACHMENTS = 3;     // Albedo, octahedral normal, occlusion roughness metalness
+    static constexpr uint32_t DEFERRED_COMPOSITION_SUBPASS = 2;
+    VkRenderPass getDeferredRenderPass() const { return deferred.renderPass; }
+    bool isDeferredAvailable() const { return !deferred.frameBuffers.empty(); }
+    void beginDeferredRenderPass(VkCommandBuffer commandBuffer);    // G-buffer subpass contents are secondary buffers
+    void nextDeferredSubpass(VkCommandBuffer commandBuffer);        // Lighting subpass, recorded inline
+    VkDescriptorSetLayout getGBufferDescriptorSetLayout() { return gbufferSetLayout->getDescriptorSetLayout(); }
+    VkDescriptorSet getGBufferDescriptorSet() const { return gbufferDescriptorSet; }
+    
+    // One command pool per recording thread and frame in flight, pools of the current frame are reset by beginFrame
+    void createThreadCommandPools(uint32_t threadCount);
+    VkCommandBuffer beginOffscreenSecondaryCommandBuffer(uint32_t threadIndex, bool deferredPass = false);
+    
+    // Offscreen depth, DEPTH_STENCIL_READ_ONLY_OPTIMAL once the offscreen pass ends
+    VkImageView getOffscreenDepthView() const { return offscreen.depth.view; }
+    VkExtent2D getOffscreenExtent() const { return {static_cast<uint32_t>(offscreen.width), static_cast<uint32_t>(offscreen.height)}; }
+    // Bumped whenever the offscreen attachments are recreated
+    uint32_t getOffscreenGeneration() const { return offscreenGeneration; }
+    // Off when nothing samples depth after the scene pass, it is then transient and never stored
+    void setDepthReadback(bool enabled);
+    
+    // Memory of the frame attachments, transient ones prefer lazily allocated memory where the device has it
+    struct TargetMemory {
+        VkDeviceSize backed;        // Regular device memory
+        VkDeviceSize lazy;          // Lazily allocated, what the images would take if fully backed
+        VkDeviceSize committed;     // Of the lazy memory, what the driver actually backs
+    };
+    TargetMemory getTargetMemory() const;
+    
+    // Dynamic resolution: the offscreen targets keep the swapchain size and the scene renders into their top left renderScale part
+    // Below 1 the scene passes tone map into an LDR target instead of the swapchain image and the upscale pass stretches it over
+    static constexpr float MIN_RENDER_SCALE = .5f;
+    void setRenderScale(float scale);
+    float getRenderScale() const { return renderScale; }
+    bool isUpscaling() const { return renderScale < 1.f; }
+    // Viewport of the scene and composition subpasses
+    VkExtent2D getRenderExtent() const;
+    
+    // Upscaled frames run on a render graph: the scene pass tone maps into a transient LDR target, EASU resamples it
+    // into a transient output sized target and the upscale pass writes the swapchain image from either
+    // The targets only exist while upscaling, without EASU its pass is culled and its target never allocated
+    // Settled before beginFrame like the render scale, the graph is rebuilt there when either changes
+    void setEasuEnabled(bool enabled) { easuEnabled = enabled; }
+    struct UpscaledFrame {
+        std::function<void(VkCommandBuffer)> scene;     // Begins and ends the offscreen or deferred pass
+        std::function<void(VkCommandBuffer)> easu;      // Within the EASU pass, samples the LDR target
+        std::function<void(VkCommandBuffer)> output;    // Within the upscale pass, after the upscale the UI goes on top
+    };
+    void recordUpscaledFrame(VkCommandBuffer commandBuffer, const UpscaledFrame &frame);
+    const RenderGraph::Stats &getUpscaleGraphStats() const { return upscaleGraph.getStats(); }
+    VkRenderPass getUpscaleRenderPass() const { return upscale.renderPass; }
+    VkDescriptorSetLayout getUpscaleDescriptorSetLayout() { return upscaleSetLayout->getDescriptorSetLayout(); }
+    // Upscale set layout over the LDR target, and over the EASU target with EASU enabled
+    VkDescriptorSet getUpscaleDescriptorSet() const { return upscaleDescriptorSet; }
+    VkDescriptorSet getEasuDescriptorSet() const { return easuDescriptorSet; }
+    // Compatible with the graph's EASU pass, which only exists while upscaling
+    VkRenderPass getEasuRenderPass() const { return upscale.easuRenderPass; }
+    
     VkDescriptorSetLayout getPostProcessingDescriptorSetLayout() { return postprocSetLayout->getDescriptorSetLayout(); }
     std::vector<VkDescriptorSet> *getPostProcessingDescriptorSets() { return postprocDescriptorSets; }
     
@@ -72,37 +135,105 @@ private:
     
     void createOffscreenPass();
     void destroyOffscreenPass();
+    void createDeferredPass();
+    void destroyDeferredPass();
+    void createUpscalePass();
+    void destroyUpscalePass();
+    // Compiles the upscale graph when upscaling starts or the upscaler changes, drops it when upscaling stops
+    void updateUpscaleGraph();
+    void releaseUpscaleGraph();
+    void beginUpscaleRenderPass(VkCommandBuffer commandBuffer);
+    void endUpscaleRenderPass(VkCommandBuffer commandBuffer);
+    void setRenderViewport(VkCommandBuffer commandBuffer);
+    void setOutputViewport(VkCommandBuffer commandBuffer);
+    // Swapchain sized
+    void createFrameBuffer(VkRenderPass renderPass, const std::vector<VkImageView> &views, VkFramebuffer &frameBuffer);
+    // One per swapchain image, recreated with the swapchain
+    void createFrameBuffers();
+    void destroyFrameBuffers();
+    
+    void destroyThreadCommandPools();
     
     struct FrameBufferAttachment {
-        VkImage image;
-        VkDeviceMemory mem;
-        VkImageView view;
+        VkImage image{VK_NULL_HANDLE};
+        VkDeviceMemory mem{VK_NULL_HANDLE};
+        VkImageView view{VK_NULL_HANDLE};
+        VkDeviceSize size{0};
+        bool lazy{false};   // Bound to lazily allocated memory
     };
+    void allocateAttachment(const VkImageCreateInfo &imageInfo, FrameBufferAttachment &target);
     
     SDLWindow &window;
     Device &device;
     std::unique_ptr<SwapChain> swapChain;
     std::vector<VkCommandBuffer> commandBuffers;
     
+    struct ThreadCommandPool {
+        VkCommandPool pool;
+        std::vector<VkCommandBuffer> secondaryBuffers{};
+        uint32_t usedBuffers{0};
+    };
+    std::vector<ThreadCommandPool> threadPools[SwapChain::MAX_FRAMES_IN_FLIGHT];
+    
     FrameBufferAttachment brdf;
     VkSampler brdfSampler;
     VkDescriptorImageInfo brdfImageInfo;
     
     struct OffscreenPass {
 		int32_t width, height;
-		VkFramebuffer frameBuffer;
+		std::vector<VkFramebuffer> frameBuffers;
 		FrameBufferAttachment color, depth, multisampling;
 		VkRenderPass renderPass;
-		VkSampler sampler;
-		VkDescriptorImageInfo descriptor;
+        // Same pass writing the upscale graph's LDR target instead of the swapchain image
+        VkRenderPass upscaledRenderPass{VK_NULL_HANDLE};
+        VkFramebuffer upscaledFrameBuffer{VK_NULL_HANDLE};
         const VkFormat colorFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
         VkFormat depthFormat;
+        VkFormat swapChainFormat;
 	} offscreen;
     
+    // Shares the color and depth targets of the offscreen pass
+    struct DeferredPass {
+        std::vector<VkFramebuffer> frameBuffers{};
+        FrameBufferAttachment albedo{}, normal{}, material{};
+        VkRenderPass renderPass{VK_NULL_HANDLE};
+        VkRenderPass upscaledRenderPass{VK_NULL_HANDLE};
+        VkFramebuffer upscaledFrameBuffer{VK_NULL_HANDLE};
+        const VkFormat albedoFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        const VkFormat normalFormat = VK_FORMAT_R16G16_SNORM;
+        const VkFormat materialFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    } deferred;
+    
+    std::unique_ptr<DescriptorPool> gbufferPool;
+    std::unique_ptr<DescriptorSetLayout> gbufferSetLayout;
+    VkDescriptorSet gbufferDescriptorSet{VK_NULL_HANDLE};
+    
     std::unique_ptr<DescriptorPool> postprocPool;
     std::unique_ptr<DescriptorSetLayout> postprocSetLayout;
     std::vector<VkDescriptorSet> *postprocDescriptorSets;
     
+    // Samples the LDR target, or the EASU target, into the swapchain image
+    struct UpscalePass {
+        VkRenderPass renderPass{VK_NULL_HANDLE};
+        std::vector<VkFramebuffer> frameBuffers{};
+        VkSampler sampler{VK_NULL_HANDLE};
+        VkRenderPass easuRenderPass{VK_NULL_HANDLE};
+        bool compiled{false};
+        bool withEasu{false};
+        RenderGraph::Resource ldr{0}, easuTarget{0};
+        const UpscaledFrame *frame{nullptr};        // Recorded by the graph passes during recordUpscaledFrame
+    } upscale;
+    RenderGraph upscaleGraph{device};
+    bool easuEnabled{true};
+    std::unique_ptr<DescriptorPool> upscalePool;
+    std::unique_ptr<DescriptorSetLayout> upscaleSetLayout;
+    VkDescriptorSet upscaleDescriptorSet{VK_NULL_HANDLE};
+    VkDescriptorSet easuDescriptorSet{VK_NULL_HANDLE};
+    float renderScale{1.f};
+    
+    uint32_t offscreenGeneration{0};
+    bool depthReadback{true};
+    
     uint32_t currentImageIndex;
     int currentFrameIndex{0};
     bool isFrameStarted = false;
@@ -0,0 +1,60 @@
+//
+//  SceneBvh.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef SceneBvh_hpp
+#define SceneBvh_hpp
+
+#include "Bvh.hpp"
+#include "EntityRegistry.hpp"
+
+//std
+#include <vector>
+
+/*
+ * Top level BVH over the world bounds of every renderable entity
+ * Ray queries descend into the entity's MeshCollider when it has one, its world box otherwise
+ * Rebuild after adding or removing entities, update() refits what the TransformSystem touched this frame
+ */
+class SceneBvh {
+public:
+    struct Hit {
+        Entity entity{};
+        float distance{0.f};
+        glm::vec3 position{};
+        glm::vec3 normal{};
+    };
+
+    void build(EntityRegistry &scene);
+    void update(EntityRegistry &scene);
+
+    // Entities whose world box is not fully outside the clip space of projectionView
+    void cullFrustum(const glm::mat4 &projectionView, std::vector<Entity> &visible) const;
+
+    // Direction must be normalized, distance is in world units
+    bool raycast(const EntityRegistry &scene, const Ray &ray, float maxDistance, Hit &hit) const;
+
+    // Sphere cast along a segment, returns the travel left before contact and the hit surface
+    float sweepSphere(const EntityRegistry &scene, const glm::vec3 &origin, const glm::vec3 &direction, float distance, float radius, Hit &hit) const;
+
+    // Box kept by the last build or update, the entity must have been renderable at build time
+    const Aabb &getWorldBounds(const EntityRegistry &scene, Entity entity) const { return bounds[transformPrimitives[scene.getTransform(entity)]]; }
+
+    size_t getEntityCount() const { return entities.size(); }
+    uint32_t getLastRefitCount() const { return lastRefitCount; }
+
+private:
+    Aabb worldBounds(const EntityRegistry &scene, Entity entity) const;
+
+    Bvh bvh{};
+    std::vector<Entity> entities{};
+    std::vector<Aabb> bounds{};
+    std::vector<uint32_t> transformPrimitives{};
+    std::vector<uint32_t> changed{};
+    uint32_t lastRefitCount{0};
+};
+
+#endif /* SceneBvh_hpp */
@@ -0,0 +1,131 @@
+//
+//  ShadowCascades.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef ShadowCascades_hpp
+#define ShadowCascades_hpp
+
+#include "Device.hpp"
+#include "Pipeline.hpp"
+#include "Camera.hpp"
+#include "Bvh.hpp"
+#include "EntityRegistry.hpp"
+
+//std
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Cascaded shadow maps for one directional light, every cascade is a layer of a single depth image
+ * Cascades are fitted to bounding spheres of slices of the camera frustum, which keeps their size fixed while the camera turns
+ * Casters without a PhysicsComponent are static, they are drawn into cache layers that stay valid until the light turns
+ * or a slice leaves its cascade, the sampled layers are copies of the caches with the moving casters drawn on top
+ */
+class ShadowCascades {
+public:
+    static constexpr uint32_t CASCADE_COUNT = 4;
+    static constexpr uint32_t RESOLUTION = 2048;
+    // Blend between logarithmic and uniform split distances
+    static constexpr float SPLIT_LAMBDA = .8f;
+    // Cascades are fitted this much wider than their slice, the slack lets the camera move before a cache redraw
+    static constexpr float CACHE_MARGIN = .2f;
+    // Cosine of the light rotation cached content tolerates
+    static constexpr float LIGHT_TOLERANCE = .99999f;
+
+    struct Stats {
+        uint32_t redrawnCascades;   // Static content drawn again this frame
+        uint32_t copiedCascades;
+        uint32_t staticDraws;
+        uint32_t dynamicDraws;
+    };
+
+    ShadowCascades(Device &device, const std::string &shaderDirectory);
+    ~ShadowCascades();
+
+    // Prevent Obj copy
+    ShadowCascades(const ShadowCascades &) = delete;
+    ShadowCascades &operator=(const ShadowCascades &) = delete;
+
+    // Fits the cascades to camera up to maxDistance and marks the stale caches, lightDirection is where the light travels
+    void update(const Camera &camera, const glm::vec3 &lightDirection, EntityRegistry &scene);
+    // Redraws the stale caches and refreshes the sampled layers, must be recorded outside render passes
+    void render(VkCommandBuffer commandBuffer, EntityRegistry &scene);
+
+    // World to light clip space of a cascade
+    const glm::mat4 &getMatrix(uint32_t cascade) const { return cascades[cascade].viewProjection; }
+    // View depth every cascade ends at
+    glm::vec4 getSplitDepths() const;
+    // Sampled layers as one array view, with a depth compare sampler
+    VkDescriptorImageInfo descriptorInfo() const { return {sampler, sampledView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}; }
+
+    float maxDistance{60.f};
+    bool cacheStatic{true};     // Off redraws every cascade every frame
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    struct Cascade {
+        glm::mat4 viewProjection{1.f};
+        float splitDepth{0.f};
+        // Light space square the cache was drawn for, and the slice radius it was fitted to
+        glm::vec2 center{0.f};
+        float halfSize{0.f};
+        float radius{0.f};
+        bool stale{true};
+        bool hasDynamic{false};     // Sampled layer differs from the cache
+    };
+
+    struct Caster {
+        Entity entity;
+        Aabb bounds;
+        bool dynamic;
+    };
+
+    void createImage();
+    void createRenderPasses();
+    void createFramebuffers();
+    void createSampler();
+    void createPipelineLayout();
+    void createPipelines(const std::string &shaderDirectory);
+    void transitionLayers(
+        VkCommandBuffer commandBuffer,
+        uint32_t baseLayer,
+        VkImageLayout oldLayout,
+        VkImageLayout newLayout,
+        VkPipelineStageFlags srcStage,
+        VkAccessFlags srcAccess,
+        VkPipelineStageFlags dstStage,
+        VkAccessFlags dstAccess);
+    // Draws the casters of one kind overlapping the cascade into the framebuffer of layer
+    uint32_t drawCasters(VkCommandBuffer commandBuffer, EntityRegistry &scene, uint32_t cascade, uint32_t layer, bool dynamic, VkRenderPass renderPass);
+
+    Device &device;
+    // Layers 0 to CASCADE_COUNT are sampled, the next CASCADE_COUNT hold the static caches
+    VkImage image{VK_NULL_HANDLE};
+    VkDeviceMemory imageMemory{VK_NULL_HANDLE};
+    VkImageView sampledView{VK_NULL_HANDLE};
+    std::array<VkImageView, CASCADE_COUNT * 2> layerViews{};
+    std::array<VkFramebuffer, CASCADE_COUNT * 2> framebuffers{};
+    VkRenderPass clearRenderPass{VK_NULL_HANDLE};
+    VkRenderPass loadRenderPass{VK_NULL_HANDLE};
+    VkSampler sampler{VK_NULL_HANDLE};
+    VkFormat depthFormat{VK_FORMAT_D32_SFLOAT};
+
+    VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+    std::unique_ptr<Pipeline> pipeline;
+    std::unique_ptr<Pipeline> packedPipeline;
+
+    std::array<Cascade, CASCADE_COUNT> cascades{};
+    glm::vec3 cachedLightDirection{0.f};
+    Aabb cachedBounds{};
+    std::vector<Caster> casters{};
+    bool hasDynamicCasters{false};
+    Stats stats{};
+};
+
+#endif /* ShadowCascades_hpp */
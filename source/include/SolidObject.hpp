@@ -27,12 +27,6 @@ struct TransformComponent {
     glm::mat3 normalMatrix();
 };
 
-// GravityPhysicsSystem
-struct RigidBody2dComponent {
-    glm::vec2 velocity;
-    float mass{1.0f};
-};
-
 class SolidObject {
 public:
     using id_t = unsigned int;
@@ -57,8 +51,6 @@ public:
     float roughness{.4f};
     TransformComponent transform{};
     
-    RigidBody2dComponent rigidBody2d{};
-    
 private:
     SolidObject(id_t objId) : id{objId} {}
     
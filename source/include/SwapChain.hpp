@@ -31,8 +31,6 @@ class SwapChain {
   SwapChain(const SwapChain &) = delete;
   SwapChain &operator=(const SwapChain &) = delete;
 
-  VkRenderPass getCompositionRenderPass() { return compositionRenderPass; }
-  VkFramebuffer getSwapChainFrameBuffer(int index) { return swapChainFramebuffers[index]; }
   VkImage getImage(int index) { return swapChainImages[index]; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
   VkFence *getCurrentImageFence(int imageIndex) { return &imagesInFlight[imageIndex]; }
@@ -62,9 +60,6 @@ class SwapChain {
     void init();
     void createSwapChain();
     void createImageViews();
-    void createDepthStencilResources();
-    void createCompositionRenderPass();
-    void createSwapChainFramebuffers();
     void createSyncObjects();
     
     // Helper functions
@@ -74,19 +69,9 @@ class SwapChain {
       const std::vector<VkPresentModeKHR> &availablePresentModes);
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
     
-    struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
-	};
-    FrameBufferAttachment depthStencil;
- 
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
  
-    std::vector<VkFramebuffer> swapChainFramebuffers;
-    VkRenderPass compositionRenderPass;
-    
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
 
@@ -0,0 +1,82 @@
+//
+//  TransformSystem.hpp
+//  vulkan_engine
+//
+//  Created by Lorenzo Bozza on 19/10/26.
+//
+
+#ifndef TransformSystem_hpp
+#define TransformSystem_hpp
+
+//libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+//std
+#include <cstdint>
+#include <vector>
+
+/*
+ * Structure-of-arrays transform storage with cached world and normal matrices
+ * Setters only flag entries dirty, update() rebuilds the flagged ones in batches so static scenes cost nothing per frame
+ * A parent must be created before its children, handle order is then a valid topological order
+ * Destroyed slots are recycled, a child only reuses a slot that comes after its parent
+ */
+class TransformSystem {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle INVALID = UINT32_MAX;
+    static constexpr Handle NO_PARENT = INVALID;
+    static constexpr uint32_t BATCH_SIZE = 64;
+
+    // Rotation is EULER YXZ, like TransformComponent
+    Handle create(glm::vec3 translation = {}, glm::vec3 rotation = {}, glm::vec3 scale = {1.f, 1.f, 1.f}, Handle parent = NO_PARENT);
+    
+    // Children of a destroyed transform are detached and keep their local values
+    void destroy(Handle handle);
+
+    void setTranslation(Handle handle, glm::vec3 translation) { translations[handle] = translation; markDirty(handle); }
+    void setRotation(Handle handle, glm::vec3 rotation) { rotations[handle] = rotation; markDirty(handle); }
+    void setScale(Handle handle, glm::vec3 scale) { scales[handle] = scale; markDirty(handle); }
+    void setParent(Handle handle, Handle parent);
+
+    const glm::vec3 &getTranslation(Handle handle) const { return translations[handle]; }
+    const glm::vec3 &getRotation(Handle handle) const { return rotations[handle]; }
+    const glm::vec3 &getScale(Handle handle) const { return scales[handle]; }
+    Handle getParent(Handle handle) const { return parents[handle]; }
+
+    // Valid after update()
+    const glm::mat4 &getWorldMatrix(Handle handle) const { return worldMatrices[handle]; }
+    const glm::mat3 &getNormalMatrix(Handle handle) const { return normalMatrices[handle]; }
+    glm::vec3 getWorldPosition(Handle handle) const { return glm::vec3(worldMatrices[handle][3]); }
+
+    // Returns how many entries were rebuilt
+    uint32_t update();
+
+    // Slot count including recycled ones
+    uint32_t size() const { return static_cast<uint32_t>(translations.size()); }
+    uint32_t getLastUpdateCount() const { return static_cast<uint32_t>(updatedList.size()); }
+    const std::vector<Handle> &getLastUpdated() const { return updatedList; }
+
+private:
+    void markDirty(Handle handle);
+    void propagateDirty();
+    void updateBatch(const Handle *batch, uint32_t count);
+
+    std::vector<glm::vec3> translations{};
+    std::vector<glm::vec3> rotations{};
+    std::vector<glm::vec3> scales{};
+    std::vector<Handle> parents{};
+    std::vector<uint8_t> dirty{};
+
+    std::vector<glm::mat4> worldMatrices{};
+    std::vector<glm::mat3> normalMatrices{};
+
+    std::vector<Handle> dirtyList{};
+    std::vector<Handle> updatedList{};
+    std::vector<Handle> freeList{};
+    uint32_t parentedCount{0};
+};
+
+#endif /* TransformSystem_hpp */
@@ -18,7 +18,7 @@
 
 class UI {
 public:
-    UI(Device &device, VkRenderPass renderPass, std::string binaryPath);
+    UI(Device &device, std::string binaryPath);
     ~UI();
     
     struct PushConstBlock {
@@ -28,21 +28,24 @@ public:
     
     void newFrame(Application *app);
     void updateBuffers(int frameIndex);
-    void draw(VkCommandBuffer commandBuffer, int frameIndex);
+    // One pipeline per render pass the UI is drawn in, returns the index draw takes
+    uint32_t createPipeline(VkRenderPass renderPass, uint32_t subpass);
+    void recreatePipeline(uint32_t index, VkRenderPass renderPass, uint32_t subpass);
+    void draw(VkCommandBuffer commandBuffer, int frameIndex, uint32_t pipelineIndex = 0);
 
 private:
     std::vector<char> readFile(const std::string &filepath);
     void loadFontTexture(std::string binaryPath);
     void createDescriptors();
-    void createPipeline(VkRenderPass renderPass, std::string dynamicShaderPath);
+    void createPipelineLayout();
+    VkPipeline buildPipeline(VkRenderPass renderPass, uint32_t subpass);
 
     Device &device;
     Image vulkanImage{device};
     
-    VkPipeline imguiPipeline;
+    std::vector<VkPipeline> imguiPipelines{};
     VkPipelineLayout imguiPipelineLayout;
-    VkShaderModule vertShaderModule;
-    VkShaderModule fragShaderModule;
+    std::string shaderPath;
     
     std::vector<std::unique_ptr<Buffer>> *vertexBuffers;
     std::vector<std::unique_ptr<Buffer>> *indexBuffers;
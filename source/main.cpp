@@ -11,9 +11,25 @@
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
 int main(int argc, const char * argv[]) {
     
+    const std::string tool = argc > 1 ? argv[1] : "";
+    if (tool == "--bake-pvs" || tool == "--bench-bvh") {
+        try {
+            if (tool == "--bake-pvs") {
+                Application::bakeVisibility(argv[0]);
+            } else {
+                Application::benchmarkBvh(argv[0]);
+            }
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    
     Application app{argv[0]};
     
     try {